@@ -694,6 +694,10 @@ pub enum FirmwareYieldReason {
     PowerOff,
     /// An error occurred.
     Error,
+    /// Step budget ran out with work left.
+    BudgetExhausted,
+    /// Serial TX backlog is full.
+    SerialBackpressure,
 }
 
 impl fmt::Display for FirmwareYieldReason {
@@ -705,6 +709,8 @@ impl fmt::Display for FirmwareYieldReason {
             FirmwareYieldReason::Reboot => write!(f, "REBOOT"),
             FirmwareYieldReason::PowerOff => write!(f, "POWER_OFF"),
             FirmwareYieldReason::Error => write!(f, "ERROR"),
+            FirmwareYieldReason::BudgetExhausted => write!(f, "BUDGET_EXHAUSTED"),
+            FirmwareYieldReason::SerialBackpressure => write!(f, "SERIAL_BACKPRESSURE"),
         }
     }
 }
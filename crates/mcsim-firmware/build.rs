@@ -2,7 +2,9 @@
 //!
 //! Compiles the MeshCore simulator DLLs (companion, repeater, room_server)
 //! using clang compiler. Each DLL is isolated to prevent symbol conflicts
-//! between firmware variants.
+//! between firmware variants. The shared runtime library (mcsim_runtime),
+//! which the firmware DLLs attach to at load time for process-wide caches
+//! and the fiber worker pool, is built alongside them.
 
 use std::env;
 use std::fs;
@@ -107,6 +109,17 @@ fn main() {
     println!("cargo:rerun-if-changed={}", meshcore_src.display());
     println!("cargo:rerun-if-changed={}", meshcore_lib.display());
 
+    // Shared runtime the firmware DLLs attach to
+    build_runtime_dll(
+        "mcsim_runtime",
+        &clang,
+        &linker,
+        &out_dir,
+        &sim_common_dir,
+        &meshcore_lib,
+        &simulator_dir.join("runtime"),
+    );
+
     // Build each firmware DLL
     build_firmware_dll(
         "meshcore_repeater",
@@ -395,12 +408,27 @@ fn build_firmware_dll(
     let sim_common_sources = [
         "Arduino.cpp",
         "sim_radio.cpp",
+        "sim_airtime.cpp",
+        "sim_placement.cpp",
+        "sim_packet_manager.cpp",
         "sim_board.cpp",
         "sim_clock.cpp",
         "sim_rng.cpp",
         "sim_serial.cpp",
         "sim_filesystem.cpp",
         "sim_node_base.cpp",
+        "sim_bindings.cpp",
+        "sim_fiber.cpp",
+        "sim_crypto_cache.cpp",
+        "sim_crypto_accel.cpp",
+        "sim_fs_arena.cpp",
+        "sim_handoff.cpp",
+        "sim_heap.cpp",
+        "sim_bench.cpp",
+        "sim_mesh_tables_check.cpp",
+        "sim_trace.cpp",
+        "sim_record.cpp",
+        "sim_runtime.cpp",
         "target.cpp",
     ];
 
@@ -568,6 +596,11 @@ fn build_firmware_dll(
     // =========================================================================
     // Link into DLL
     // =========================================================================
+    link_and_install(name, linker, clang, out_dir, &objects);
+}
+
+/// Link objects into `name`'s DLL and copy it next to the Cargo outputs
+fn link_and_install(name: &str, linker: &str, clang: &str, out_dir: &Path, objects: &[PathBuf]) {
     let dll_name = if cfg!(windows) {
         format!("{}.dll", name)
     } else if cfg!(target_os = "macos") {
@@ -578,7 +611,7 @@ fn build_firmware_dll(
 
     let dll_path = out_dir.join(&dll_name);
 
-    if link_dll(linker, &objects, &dll_path, clang) {
+    if link_dll(linker, objects, &dll_path, clang) {
         // Copy DLL to target directory for easier access
         if let Ok(target_dir) = env::var("CARGO_TARGET_DIR") {
             let profile = env::var("PROFILE").unwrap_or_else(|_| "debug".to_string());
@@ -589,3 +622,85 @@ fn build_firmware_dll(
         panic!("Failed to link DLL: {}", name);
     }
 }
+
+/// Build the shared runtime: the process-wide services of sim_common (crypto
+/// caches, airtime tables, fiber worker pool) without any node code
+fn build_runtime_dll(
+    name: &str,
+    clang: &str,
+    linker: &str,
+    out_dir: &Path,
+    sim_common_dir: &Path,
+    meshcore_lib: &Path,
+    runtime_dir: &Path,
+) {
+    let sim_include_dir = sim_common_dir.join("include");
+    let ed25519_dir = meshcore_lib.join("ed25519");
+
+    let obj_dir = out_dir.join(format!("{}_obj", name));
+    fs::create_dir_all(&obj_dir).expect("Failed to create object directory");
+
+    // The simulator's ed_25519.h comes first and #include_next's the real one
+    let include_refs: Vec<&Path> = vec![sim_include_dir.as_path(), ed25519_dir.as_path()];
+
+    // No firmware is compiled in, so no Arduino environment or prefix header
+    let defines: Vec<(&str, Option<&str>)> = vec![
+        ("SIM_BUILD", Some("1")),
+        ("SIM_DLL_EXPORT", Some("1")),
+        ("SIM_TRACEPOINTS", Some("0")),
+        ("NOMINMAX", None),
+        ("_CRT_SECURE_NO_WARNINGS", None),
+    ];
+
+    let mut objects: Vec<PathBuf> = Vec::new();
+
+    let mut sources: Vec<PathBuf> = vec![runtime_dir.join("sim_main.cpp")];
+    for src in &[
+        "sim_crypto_cache.cpp",
+        "sim_crypto_accel.cpp",
+        "sim_airtime.cpp",
+        "sim_fiber.cpp",
+    ] {
+        sources.push(sim_common_dir.join("src").join(src));
+    }
+
+    for source in &sources {
+        let stem = source.file_stem().unwrap().to_string_lossy();
+        let obj = obj_dir.join(format!("{}.obj", stem));
+        if compile_source(clang, source, &obj, &include_refs, &defines, None, true) {
+            objects.push(obj);
+        } else {
+            panic!("Failed to compile {}", source.display());
+        }
+    }
+
+    // The caches run the real verify and key exchange on a miss
+    let ed25519_includes: Vec<&Path> = vec![ed25519_dir.as_path()];
+    let ed25519_defines: Vec<(&str, Option<&str>)> = vec![("SIM_BUILD", Some("1"))];
+    for src in &[
+        "fe.c",
+        "ge.c",
+        "sc.c",
+        "sha512.c",
+        "verify.c",
+        "key_exchange.c",
+    ] {
+        let source = ed25519_dir.join(src);
+        let obj = obj_dir.join(format!("ed_{}.obj", src.replace(".c", "")));
+        if compile_source(
+            clang,
+            &source,
+            &obj,
+            &ed25519_includes,
+            &ed25519_defines,
+            None,
+            false, // C, not C++
+        ) {
+            objects.push(obj);
+        } else {
+            panic!("Failed to compile {}", source.display());
+        }
+    }
+
+    link_and_install(name, linker, clang, out_dir, &objects);
+}
@@ -22,9 +22,10 @@
 //! ```
 
 use libloading::Library;
-use std::ffi::{c_char, CStr, CString};
+use std::ffi::{c_char, c_void, CStr, CString};
+use std::marker::PhantomData;
 use std::path::{Path, PathBuf};
-use std::sync::Arc;
+use std::sync::{Arc, OnceLock};
 use thiserror::Error;
 
 // ============================================================================
@@ -43,6 +44,16 @@ pub const DEFAULT_SPIN_DETECTION_THRESHOLD: u32 = 3;
 /// This matches the property default from mcsim_model::properties::FIRMWARE_IDLE_LOOPS_BEFORE_YIELD.
 pub const DEFAULT_IDLE_LOOPS_BEFORE_YIELD: u32 = 2;
 
+/// Default longest idle sleep when no firmware deadline is known
+/// (matches SIM_DEFAULT_IDLE_WAKE_MS in sim_api.h).
+/// This matches the property default from mcsim_model::properties::FIRMWARE_IDLE_WAKE_INTERVAL_MS.
+pub const DEFAULT_IDLE_WAKE_INTERVAL_MS: u32 = 100;
+
+/// Default radio RX queue depth in packets
+/// (matches SIM_DEFAULT_RX_QUEUE_DEPTH in sim_api.h).
+/// This matches the property default from mcsim_model::properties::FIRMWARE_RX_QUEUE_DEPTH.
+pub const DEFAULT_RX_QUEUE_DEPTH: u32 = 4;
+
 /// Maximum length of node name.
 pub const MAX_NODE_NAME: usize = 32;
 /// Size of public key in bytes.
@@ -51,10 +62,50 @@ pub const PUB_KEY_SIZE: usize = 32;
 pub const PRV_KEY_SIZE: usize = 64;
 /// Maximum radio packet size.
 pub const MAX_RADIO_PACKET: usize = 256;
-/// Maximum serial TX buffer size (must match SIM_MAX_SERIAL_TX in sim_api.h).
+/// Maximum serial TX output carried by one step result (must match
+/// SIM_MAX_SERIAL_TX in sim_api.h). Anything beyond it is reported in
+/// `StepResult::serial_tx_pending` and fetched with `collect_serial_tx()`.
 pub const MAX_SERIAL_TX: usize = 32768;
-/// Maximum log output buffer size.
+/// Serial TX queued in a node before it yields `SerialBackpressure` (must
+/// match SIM_MAX_SERIAL_TX_BACKLOG in sim_api.h).
+pub const MAX_SERIAL_TX_BACKLOG: usize = 8 * MAX_SERIAL_TX;
+/// Maximum log output per step (including the terminating NUL).
 pub const MAX_LOG_OUTPUT: usize = 4096;
+/// Largest frame accepted by the serial frame API (must match
+/// SIM_MAX_SERIAL_FRAME in sim_api.h).
+pub const MAX_SERIAL_FRAME: usize = 256;
+/// Longest line accepted by `inject_cli_line()` (must match
+/// SIM_MAX_CLI_LINE in sim_api.h).
+pub const MAX_CLI_LINE: usize = 159;
+/// `inject_cli_line()` flag: echo the line and its reply to the serial
+/// output (SIM_CLI_ECHO).
+const CLI_ECHO: u32 = 0x01;
+/// Buckets of `NodeStats::step_cpu_histogram` (must match
+/// SIM_STEP_CPU_BUCKETS in sim_api.h).
+pub const STEP_CPU_BUCKETS: usize = 16;
+/// Payload lengths covered by `FirmwareDll::airtime_table()` (must match
+/// SIM_AIRTIME_TABLE_LEN in sim_api.h).
+pub const AIRTIME_TABLE_LEN: usize = 256;
+
+/// Trace categories for `FirmwareDll::enable_trace()` (match
+/// `SimTraceCategory` in sim_api.h).
+pub const TRACE_STEP: u32 = 1 << 0;
+/// Packets received and transmitted.
+pub const TRACE_RADIO: u32 = 1 << 1;
+/// File opens, reads, writes and flushes.
+pub const TRACE_FS: u32 = 1 << 2;
+/// Ed25519, AES128 and SHA256.
+pub const TRACE_CRYPTO: u32 = 1 << 3;
+/// Serial formatting and writes.
+pub const TRACE_SERIAL: u32 = 1 << 4;
+/// Every trace category.
+pub const TRACE_ALL: u32 = 0x1F;
+
+/// Events requested per FFI call when draining the trace rings.
+const TRACE_DRAIN_CHUNK: usize = 4096;
+
+/// Frames requested per FFI call when draining a node's frame queue.
+const FRAME_COLLECT_BATCH: usize = 64;
 
 // ============================================================================
 // Error Types
@@ -86,6 +137,14 @@ pub enum DllError {
     /// Filesystem operation failed.
     #[error("Filesystem error: {0}")]
     FilesystemError(i32),
+
+    /// A snapshot was applied to a node of another firmware type.
+    #[error("Snapshot is of a different node type")]
+    SnapshotMismatch,
+
+    /// A recording could not be read, or is of another firmware type.
+    #[error("Invalid recording: {0}")]
+    InvalidRecording(String),
 }
 
 // ============================================================================
@@ -106,6 +165,25 @@ pub struct FirmwareSimulationParams {
     pub log_spin_detection: bool,
     /// Enable debug logging for loop iterations.
     pub log_loop_iterations: bool,
+    /// Longest idle sleep when no firmware deadline is known (ms).
+    pub idle_wake_interval_ms: u32,
+    /// Radio RX queue depth in packets.
+    pub rx_queue_depth: u32,
+    /// Answer idle steps whose inputs have not changed without running the
+    /// firmware loop.
+    pub skip_idle_steps: bool,
+    /// Keep running the firmware after a TX starts until it is idle, instead
+    /// of ending the step there.
+    pub continue_after_tx: bool,
+    /// `loop()` iterations a step may run before it yields
+    /// `BudgetExhausted` (0 = unlimited).
+    pub step_budget_loops: u32,
+    /// Wall-clock microseconds a step may run before it yields
+    /// `BudgetExhausted` (0 = unlimited).
+    pub step_budget_us: u32,
+    /// Stage firmware file writes and store each file once at the end of
+    /// the step.
+    pub fs_write_back: bool,
     /// Initial RTC Unix timestamp.
     pub initial_rtc_secs: u64,
     /// Startup time in microseconds. Events before this time are dropped.
@@ -119,6 +197,13 @@ impl Default for FirmwareSimulationParams {
             idle_loops_before_yield: DEFAULT_IDLE_LOOPS_BEFORE_YIELD,
             log_spin_detection: false,
             log_loop_iterations: false,
+            idle_wake_interval_ms: DEFAULT_IDLE_WAKE_INTERVAL_MS,
+            rx_queue_depth: DEFAULT_RX_QUEUE_DEPTH,
+            skip_idle_steps: false,
+            continue_after_tx: false,
+            step_budget_loops: 0,
+            step_budget_us: 0,
+            fs_write_back: false,
             initial_rtc_secs: DEFAULT_INITIAL_RTC_SECS,
             startup_time_us: 0,
         }
@@ -145,8 +230,364 @@ pub enum YieldReason {
     PowerOff = 4,
     /// An error occurred.
     Error = 5,
+    /// The step budget ran out before the node was idle; step it again at
+    /// the same time to continue.
+    BudgetExhausted = 6,
+    /// `SIM_MAX_SERIAL_TX_BACKLOG` bytes of serial output are queued; collect
+    /// them (`collect_serial_tx()`) and step again at the same time.
+    SerialBackpressure = 7,
+}
+
+/// Kind of a step event (matches `SimStepEventKind`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum StepEventKind {
+    /// A TX started; `data()` is the packet.
+    RadioTx = 0,
+    /// `data()` is the next chunk of the step's serial output.
+    SerialTx = 1,
+    /// The firmware requested a reboot.
+    Reboot = 2,
+    /// The firmware requested power off.
+    PowerOff = 3,
+    /// The node has nothing to do until `wake_millis`.
+    Wake = 4,
+}
+
+/// One thing a node did during a step, in order (matches `SimStepEvent`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+pub struct StepEvent {
+    /// What happened.
+    pub kind: StepEventKind,
+    /// Airtime of a `RadioTx`, counted from the step's `current_millis`.
+    pub airtime_ms: u32,
+    /// Wake time of a `Wake`.
+    pub wake_millis: u64,
+    data: *const u8,
+    len: usize,
+}
+
+impl StepEvent {
+    /// The packet of a `RadioTx` or the bytes of a `SerialTx`.
+    pub fn data(&self) -> &[u8] {
+        unsafe { view(self.data, self.len) }
+    }
+}
+
+/// How a node's firmware is executed (matches `SimExecutionMode`).
+#[repr(u8)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+pub enum ExecutionMode {
+    /// Dedicated OS thread per node.
+    #[default]
+    Thread = 0,
+    /// Stackful coroutine multiplexed on the library's fiber worker pool.
+    Fiber = 1,
+}
+
+/// Where a node's thread runs and its memory lives (`SimPlacementMode` with
+/// `placement_target`).
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+pub enum Placement {
+    /// Wherever the OS schedules it.
+    #[default]
+    Any,
+    /// Pinned to one CPU.
+    Cpu(u16),
+    /// On the CPUs of one NUMA node.
+    NumaNode(u16),
+    /// Pinned to the process's CPUs in turn, in creation order.
+    Spread,
+}
+
+/// Where a node's log output (text written to `Serial`) goes (matches `SimLogMode`).
+#[repr(u8)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+pub enum LogMode {
+    /// Collected per step into `StepResult::log_output`, keeping the first
+    /// `MAX_LOG_OUTPUT - 1` bytes.
+    #[default]
+    Buffer = 0,
+    /// Discarded.
+    Off = 1,
+    /// Collected per step, keeping the last `MAX_LOG_OUTPUT - 1` bytes.
+    Ring = 2,
+    /// Passed to the node's log sink as it is written, without truncation.
+    Stream = 3,
+}
+
+/// Process-wide crypto memo tables of a firmware library (matches
+/// `SimCryptoCacheKind`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum CryptoCacheKind {
+    /// Ed25519 signature verification results.
+    Verify = 0,
+    /// Shared secrets from Ed25519 key exchange.
+    Ecdh = 1,
+}
+
+/// Counters of a crypto cache (matches `SimCryptoCacheStats`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct CryptoCacheStats {
+    /// Lookups answered from the cache.
+    pub hits: u64,
+    /// Lookups that ran the real operation.
+    pub misses: u64,
+    /// Entries currently held.
+    pub entries: u64,
+    /// Configured capacity (0 = disabled).
+    pub capacity: u64,
+}
+
+/// Counters of a node's heap (matches `SimHeapStats`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct HeapStats {
+    /// Blocks allocated since creation.
+    pub allocations: u64,
+    /// Blocks freed individually.
+    pub frees: u64,
+    /// Bytes currently allocated.
+    pub live_bytes: u64,
+    /// Highest `live_bytes` since creation.
+    pub peak_bytes: u64,
+    /// Memory the heap holds from the system.
+    pub reserved_bytes: u64,
+    /// Reboots that reclaimed the whole heap.
+    pub resets: u64,
+}
+
+/// How a node's step handoffs were satisfied (matches `SimHandoffStats`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct HandoffStats {
+    /// Step waits satisfied without sleeping.
+    pub coordinator_spin_waits: u64,
+    /// Step waits that slept until the node yielded.
+    pub coordinator_parked_waits: u64,
+    /// Node thread waits for a step that ended while spinning.
+    pub node_spin_waits: u64,
+    /// Node thread waits that slept until the step began.
+    pub node_parked_waits: u64,
+}
+
+/// When a node next wants a step, read without stepping it (see
+/// `FirmwareNode::peek_next_wake`).
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct NextWake {
+    /// `wake_millis` of the node's last step, or that step's own time if it
+    /// ended without one; 0 before the first step.
+    pub wake_millis: u64,
+    /// A packet, serial input or radio state change arrived since that
+    /// step, so the node should be stepped before `wake_millis`.
+    pub inputs_pending: bool,
+}
+
+/// Runtime counters of a node (matches `SimNodeStats`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct NodeStats {
+    /// Steps since creation, skipped ones included.
+    pub steps: u64,
+    /// Steps answered without running `loop()` (see
+    /// `NodeConfig::with_idle_step_skipping()`).
+    pub skipped_steps: u64,
+    /// Steps cut short by the step budget (see
+    /// `NodeConfig::with_step_budget()`).
+    pub budget_exhausted_steps: u64,
+    /// `loop()` calls across all steps.
+    pub loop_iterations: u64,
+    /// Most `loop()` calls in one step.
+    pub max_loop_iterations: u32,
+    /// Radio polls that hit the spin threshold.
+    pub spin_detections: u32,
+    /// Host CPU time of the timed (not skipped) steps (ns).
+    pub step_cpu_total_ns: u64,
+    /// Shortest timed step (ns).
+    pub step_cpu_min_ns: u64,
+    /// Longest timed step (ns).
+    pub step_cpu_max_ns: u64,
+    /// Timed steps by CPU time: bucket 0 under 1 µs, bucket `i` under
+    /// 2^`i` µs, the last bucket everything longer.
+    pub step_cpu_histogram: [u64; STEP_CPU_BUCKETS],
+    /// Packets the firmware received.
+    pub packets_recv: u32,
+    /// Packets the firmware transmitted.
+    pub packets_sent: u32,
+    /// Received packets that failed to decode.
+    pub packets_recv_errors: u32,
+    /// Injected packets dropped on a full RX queue.
+    pub rx_dropped: u32,
+    /// Most packets queued at once.
+    pub rx_queue_high_water: u32,
+    /// Estimated airtime of the packets sent (ms).
+    pub tx_airtime_ms: u32,
+    /// Estimated airtime of the packets received (ms).
+    pub rx_airtime_ms: u32,
+    _padding: u32,
+    /// Injected serial bytes queued for the firmware (stream and frames).
+    pub serial_rx_bytes: u64,
+    /// Injected serial bytes dropped on a full buffer.
+    pub serial_rx_dropped: u64,
+    /// Serial bytes the firmware wrote (stream and frames).
+    pub serial_tx_bytes: u64,
+    /// `Ed25519::verify()` calls, verify cache hits included.
+    pub ed25519_verifies: u64,
+    /// `Ed25519::sign()` calls.
+    pub ed25519_signs: u64,
+    /// ECDH shared secrets computed, cache hits included.
+    pub key_exchanges: u64,
+    /// AES-128 blocks encrypted or decrypted.
+    pub aes_blocks: u64,
+    /// SHA-256 blocks compressed.
+    pub sha256_blocks: u64,
+    /// HMAC-SHA256 computations.
+    pub hmacs: u64,
+    /// Files the firmware opened.
+    pub fs_opens: u64,
+    /// Bytes the firmware read from files.
+    pub fs_bytes_read: u64,
+    /// Bytes the firmware wrote to files; a stand-in for flash wear.
+    pub fs_bytes_written: u64,
+    /// Bytes copied when the firmware wrote a file shared with a reader,
+    /// snapshot or image.
+    pub fs_bytes_copied: u64,
+    /// Write-back: bytes stored when staged files were committed at the end
+    /// of a step (compare with `fs_bytes_written`).
+    pub fs_bytes_committed: u64,
+    /// Write-back: rewrites of a file folded into its pending commit.
+    pub fs_rewrites_coalesced: u64,
+    /// Arduino `String` buffers taken from the heap; strings shorter than
+    /// the inline storage never count.
+    pub string_heap_allocs: u64,
+    /// Bytes of those buffers.
+    pub string_heap_bytes: u64,
+    /// Received packets the packet-seen table already held (duplicates).
+    pub mesh_seen_hits: u64,
+    /// Received packets it had not seen, and so recorded.
+    pub mesh_seen_misses: u64,
+    /// Recorded packets that pushed a live entry out of the table.
+    pub mesh_seen_evictions: u64,
+}
+
+impl NodeStats {
+    /// Mean CPU time of a timed step (ns), or 0 before the first one.
+    pub fn step_cpu_mean_ns(&self) -> u64 {
+        let timed = self.steps - self.skipped_steps;
+        if timed == 0 {
+            0
+        } else {
+            self.step_cpu_total_ns / timed
+        }
+    }
+}
+
+/// Outcome of replaying a recorded node (matches `SimReplayResult`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct ReplayResult {
+    /// Steps replayed.
+    pub steps: u64,
+    /// Steps and serial collections whose output differed from the recording.
+    pub diverged: u64,
+    /// Index of the step at (or after) the first difference (`u64::MAX` = none).
+    pub first_divergence: u64,
+    /// Simulation time of that step (ms).
+    pub first_divergence_millis: u64,
+    /// Yield reason recorded for that step.
+    pub expected_reason: u32,
+    /// Yield reason the replay returned.
+    pub actual_reason: u32,
+    /// Wake time recorded for that step (ms).
+    pub expected_wake_millis: u64,
+    /// Wake time the replay returned (ms).
+    pub actual_wake_millis: u64,
+    /// Host time the replay took (ns).
+    pub replay_ns: u64,
+}
+
+impl ReplayResult {
+    /// True if every output matched the recording.
+    pub fn matched(&self) -> bool {
+        self.diverged == 0
+    }
+}
+
+/// An event recorded by a tracepoint inside the firmware library (matches
+/// `SimTraceEvent`).
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+pub struct FirmwareTraceEvent {
+    node: SimNodeHandle,
+    name: *const c_char,
+    /// Host monotonic clock at the start of the event (ns).
+    pub wall_start_ns: u64,
+    /// Duration (ns), 0 for instant events.
+    pub wall_duration_ns: u64,
+    /// Simulation time of the node's step (ms).
+    pub sim_millis: u64,
+    /// One of the `TRACE_*` categories.
+    pub category: u32,
+    /// Host thread that recorded the event, numbered in order of first event.
+    pub thread: u32,
+}
+
+// SAFETY: the pointers are only identifiers and names of static strings;
+// nothing is accessed through the node handle.
+unsafe impl Send for FirmwareTraceEvent {}
+
+impl FirmwareTraceEvent {
+    /// `node_id()` of the node that was running, or `None` outside a step.
+    pub fn node_id(&self) -> Option<usize> {
+        if self.node.is_null() {
+            None
+        } else {
+            Some(self.node as usize)
+        }
+    }
+
+    /// Tracepoint name, e.g. `"loop"` or `"ed25519.verify"`.
+    ///
+    /// Names are static strings of the library; the event must not outlive
+    /// the `FirmwareDll` that recorded it.
+    pub fn name(&self) -> &str {
+        if self.name.is_null() {
+            return "";
+        }
+        unsafe { CStr::from_ptr(self.name) }.to_str().unwrap_or("")
+    }
+
+    #[cfg(test)]
+    pub(crate) fn new_for_test(
+        node: usize,
+        name: &'static CStr,
+        wall_start_ns: u64,
+        wall_duration_ns: u64,
+        sim_millis: u64,
+        category: u32,
+        thread: u32,
+    ) -> Self {
+        Self {
+            node: node as SimNodeHandle,
+            name: name.as_ptr(),
+            wall_start_ns,
+            wall_duration_ns,
+            sim_millis,
+            category,
+            thread,
+        }
+    }
 }
 
+/// Callback receiving a node's log output in `LogMode::Stream`.
+///
+/// Runs on the node's own thread (or fiber worker) while it is stepping,
+/// once per `Serial` write.
+pub type LogSink = Box<dyn FnMut(&[u8]) + Send>;
+
 /// Configuration for creating a firmware node.
 #[repr(C)]
 #[derive(Clone)]
@@ -186,11 +627,59 @@ pub struct NodeConfig {
     pub log_spin_detection: u8,
     /// Enable debug logging for loop iterations (bool as u8).
     pub log_loop_iterations: u8,
-    /// Alignment padding.
-    _padding: [u8; 2],
+    /// Execution mode (`ExecutionMode` as u8).
+    pub execution_mode: u8,
+    /// Log routing (`LogMode` as u8).
+    pub log_mode: u8,
+
+    /// Longest idle sleep when no firmware deadline is known (ms, 0 = 100).
+    pub idle_wake_interval_ms: u32,
+
+    /// Packets the radio RX FIFO holds before dropping (0 = 4).
+    pub rx_queue_depth: u32,
+
+    /// Drop `Serial` output instead of returning it as serial TX (bool as u8).
+    pub discard_serial_tx: u8,
+    /// Companion: exchange protocol frames through `collect_serial_frames()`
+    /// instead of the serial byte stream (bool as u8).
+    pub serial_frames: u8,
+    /// Allocate the firmware objects, `String` buffers and file handles from
+    /// a per-node heap (bool as u8).
+    pub node_heap: u8,
+    /// Answer an idle step without running the firmware when nothing it
+    /// could react to changed since the last idle step (bool as u8).
+    pub skip_idle_steps: u8,
+
+    /// `SimFsImageHandle` the node starts from (0 = none), set by
+    /// `create_node_with_image()`. Kept as an address so the config stays `Send`.
+    fs_image: usize,
+    /// NUL-terminated path the node records its inputs to (0 = none), set by
+    /// `create_node_recording()` for the duration of the create call.
+    record_path: usize,
+
+    /// Keep running the firmware after a TX starts until it is idle, instead
+    /// of ending the step there (bool as u8).
+    pub continue_after_tx: u8,
+
+    /// `SimPlacementMode` (u8); set with `with_placement()`.
+    pub placement: u8,
+    /// CPU or NUMA node index of the placement.
+    pub placement_target: u16,
+    /// Stack reserved for the node's thread or fiber in KiB (0 = platform
+    /// default for threads, 256 for fibers).
+    pub stack_size_kb: u32,
+
+    /// `loop()` iterations per step (0 = unlimited); set with `with_step_budget()`.
+    pub step_budget_loops: u32,
+    /// Wall-clock microseconds per step (0 = unlimited).
+    pub step_budget_us: u32,
+
+    /// Stage firmware file writes until the end of the step (bool as u8);
+    /// set with `with_fs_write_back()`.
+    pub fs_write_back: u8,
 
     /// Reserved for future use.
-    _reserved: [u8; 56],
+    _reserved: [u8; 11],
 }
 
 impl Default for NodeConfig {
@@ -211,8 +700,24 @@ impl Default for NodeConfig {
             idle_loops_before_yield: DEFAULT_IDLE_LOOPS_BEFORE_YIELD,
             log_spin_detection: 0,
             log_loop_iterations: 0,
-            _padding: [0; 2],
-            _reserved: [0; 56],
+            execution_mode: ExecutionMode::Thread as u8,
+            log_mode: LogMode::Buffer as u8,
+            idle_wake_interval_ms: DEFAULT_IDLE_WAKE_INTERVAL_MS,
+            rx_queue_depth: DEFAULT_RX_QUEUE_DEPTH,
+            discard_serial_tx: 0,
+            serial_frames: 0,
+            node_heap: 0,
+            skip_idle_steps: 0,
+            fs_image: 0,
+            record_path: 0,
+            continue_after_tx: 0,
+            placement: 0,
+            placement_target: 0,
+            stack_size_kb: 0,
+            step_budget_loops: 0,
+            step_budget_us: 0,
+            fs_write_back: 0,
+            _reserved: [0; 11],
         }
     }
 }
@@ -272,12 +777,139 @@ impl NodeConfig {
         self.log_loop_iterations = log_loops as u8;
         self
     }
+
+    /// Set the execution mode (thread-per-node or fiber).
+    pub fn with_execution_mode(mut self, mode: ExecutionMode) -> Self {
+        self.execution_mode = mode as u8;
+        self
+    }
+
+    /// Set the longest idle sleep used when the firmware has no known deadline.
+    ///
+    /// Scheduled packets always wake the node on time; this bounds the lateness
+    /// of firmware timers the simulator cannot observe (adverts, noise floor
+    /// calibration).
+    pub fn with_idle_wake_interval(mut self, millis: u32) -> Self {
+        self.idle_wake_interval_ms = millis;
+        self
+    }
+
+    /// Set how many received packets the radio queues before dropping new ones.
+    pub fn with_rx_queue_depth(mut self, depth: u32) -> Self {
+        self.rx_queue_depth = depth;
+        self
+    }
+
+    /// Set where the node's log output goes.
+    pub fn with_log_mode(mut self, mode: LogMode) -> Self {
+        self.log_mode = mode as u8;
+        self
+    }
+
+    /// Drop the node's `Serial` output instead of returning it as serial TX.
+    ///
+    /// Combined with `LogMode::Off`, the firmware skips formatting console
+    /// output altogether.
+    pub fn with_serial_tx_discarded(mut self, discard: bool) -> Self {
+        self.discard_serial_tx = discard as u8;
+        self
+    }
+
+    /// Route companion protocol frames through the frame API instead of the
+    /// serial byte stream.
+    pub fn with_serial_frames(mut self, enabled: bool) -> Self {
+        self.serial_frames = enabled as u8;
+        self
+    }
+
+    /// Give the node its own heap for firmware allocations (see `heap_stats()`).
+    pub fn with_node_heap(mut self, enabled: bool) -> Self {
+        self.node_heap = enabled as u8;
+        self
+    }
+
+    /// Skip idle steps whose inputs have not changed since the last idle step.
+    ///
+    /// A skipped step returns the previous idle result (including its wake
+    /// time) without running the firmware's `loop()`. Off by default, since
+    /// it changes how many loop iterations a run performs.
+    pub fn with_idle_step_skipping(mut self, enabled: bool) -> Self {
+        self.skip_idle_steps = enabled as u8;
+        self
+    }
+
+    /// Let a step run on after its firmware starts a TX.
+    ///
+    /// The radio is busy until `notify_tx_complete()`, so the firmware keeps
+    /// processing input and writing serial output until it is idle. The step
+    /// still yields `RadioTxStart`; `StepResult::events()` lists the TX with
+    /// the output around it and the node's next wake time, saving a round
+    /// trip per forwarded packet.
+    pub fn with_tx_continuation(mut self, enabled: bool) -> Self {
+        self.continue_after_tx = enabled as u8;
+        self
+    }
+
+    /// Bound how long one step may run (0 = unlimited).
+    ///
+    /// A step that reaches `max_loops` firmware loop iterations or
+    /// `max_us` wall-clock microseconds before the node is idle yields
+    /// `BudgetExhausted` with `wake_millis` at the current time; the next
+    /// step continues the work. Keeps a node processing a burst from
+    /// holding up the others in realtime runs. The time budget depends on
+    /// the host, so runs that must repeat should use only `max_loops`.
+    pub fn with_step_budget(mut self, max_loops: u32, max_us: u32) -> Self {
+        self.step_budget_loops = max_loops;
+        self.step_budget_us = max_us;
+        self
+    }
+
+    /// Coalesce the firmware's file saves within a step.
+    ///
+    /// A file opened for writing is staged, and rewriting it again in the
+    /// same step reuses the staged buffer; each file is stored once when the
+    /// step ends. The firmware reads its own staged writes, and `fs_read()`
+    /// and the other coordinator calls only ever see committed files.
+    /// `NodeStats::fs_bytes_committed` against `fs_bytes_written` shows what
+    /// was saved.
+    pub fn with_fs_write_back(mut self, enabled: bool) -> Self {
+        self.fs_write_back = enabled as u8;
+        self
+    }
+
+    /// Set where the node's thread runs. The node's state is allocated on
+    /// the NUMA node of that CPU or node. Applies to `ExecutionMode::Thread`
+    /// nodes; ignored where the platform cannot pin threads.
+    pub fn with_placement(mut self, placement: Placement) -> Self {
+        let (mode, target) = match placement {
+            Placement::Any => (0, 0),
+            Placement::Cpu(cpu) => (1, cpu),
+            Placement::NumaNode(node) => (2, node),
+            Placement::Spread => (3, 0),
+        };
+        self.placement = mode;
+        self.placement_target = target;
+        self
+    }
+
+    /// Set the stack reserved for the node's thread or fiber, in KiB (0 =
+    /// default). The default thread stack reserves 8 MiB of address space on
+    /// Linux, which limits how many nodes a process can hold.
+    pub fn with_stack_size_kb(mut self, kb: u32) -> Self {
+        self.stack_size_kb = kb;
+        self
+    }
 }
 
 /// Result of a simulation step.
+///
+/// This is a small header; the output data is not copied. `radio_tx()`,
+/// `serial_tx()` and `log_output()` read buffers owned by the firmware node,
+/// which stay valid until that node is stepped, rebooted or dropped again. The
+/// lifetime ties the result to the borrow of the node that produced it.
 #[repr(C)]
-#[derive(Clone)]
-pub struct StepResult {
+#[derive(Clone, Copy)]
+pub struct StepResult<'a> {
     /// Why the step yielded.
     pub reason: YieldReason,
 
@@ -287,60 +919,97 @@ pub struct StepResult {
     pub wake_millis: u64,
 
     /// Radio TX data (valid when reason == RadioTxStart).
-    pub radio_tx_data: [u8; MAX_RADIO_PACKET],
+    radio_tx_data: *const u8,
     /// Length of radio TX data.
     pub radio_tx_len: usize,
     /// Estimated TX airtime in milliseconds.
     pub radio_tx_airtime_ms: u32,
 
     /// Serial TX output (accumulated during step).
-    pub serial_tx_data: [u8; MAX_SERIAL_TX],
+    serial_tx_data: *const u8,
     /// Length of serial TX data.
     pub serial_tx_len: usize,
+    /// Serial TX bytes still queued in the node after this result.
+    pub serial_tx_pending: usize,
+    /// Frames (companion) or CLI replies (repeater, room server) waiting for
+    /// `collect_serial_frames()` / `collect_cli_replies()`.
+    pub serial_frames_pending: usize,
 
     /// Log output from Serial.print() calls.
-    pub log_output: [c_char; MAX_LOG_OUTPUT],
+    log_output: *const c_char,
     /// Length of log output.
     pub log_output_len: usize,
 
     /// Error message (if reason == Error).
-    pub error_msg: [c_char; 256],
+    error_msg: *const c_char,
+
+    /// Rolling hash of this node's step results, RNG streams, radio counters
+    /// and file writes so far; equal across two runs until they diverge.
+    pub state_hash: u64,
+
+    /// The step's events (see `events()`).
+    events: *const StepEvent,
+    /// Number of events.
+    pub event_count: usize,
+
+    _node: PhantomData<&'a ()>,
+}
+
+/// C callback registered with `sim_set_log_sink`; `user` is the node's boxed `LogSink`.
+unsafe extern "C" fn log_sink_trampoline(user: *mut c_void, data: *const c_char, len: usize) {
+    let sink = &mut *(user as *mut LogSink);
+    let bytes = view(data as *const u8, len);
+    // A panic must not unwind into the firmware
+    let _ = std::panic::catch_unwind(std::panic::AssertUnwindSafe(|| sink(bytes)));
+}
+
+/// Build a slice from a C view, tolerating a null pointer for empty data.
+///
+/// # Safety
+///
+/// If `len` is non-zero, `ptr` must point to `len` readable bytes that outlive `'a`.
+unsafe fn view<'a, T>(ptr: *const T, len: usize) -> &'a [T] {
+    if ptr.is_null() || len == 0 {
+        &[]
+    } else {
+        std::slice::from_raw_parts(ptr, len)
+    }
 }
 
-impl StepResult {
+impl<'a> StepResult<'a> {
     /// Get the radio TX data as a slice.
-    pub fn radio_tx(&self) -> &[u8] {
-        &self.radio_tx_data[..self.radio_tx_len]
+    pub fn radio_tx(&self) -> &'a [u8] {
+        unsafe { view(self.radio_tx_data, self.radio_tx_len) }
     }
 
     /// Get the serial TX data as a slice.
-    pub fn serial_tx(&self) -> &[u8] {
-        &self.serial_tx_data[..self.serial_tx_len]
+    pub fn serial_tx(&self) -> &'a [u8] {
+        unsafe { view(self.serial_tx_data, self.serial_tx_len) }
+    }
+
+    /// What the node did during the step, in order: TX starts, serial output
+    /// chunks, reboot or power-off requests and the final wake time.
+    pub fn events(&self) -> &'a [StepEvent] {
+        unsafe { view(self.events, self.event_count) }
     }
 
     /// Get the log output as a string.
     pub fn log_output(&self) -> String {
-        if self.log_output_len == 0 {
-            return String::new();
-        }
-        let bytes: Vec<u8> = self.log_output[..self.log_output_len]
-            .iter()
-            .map(|&c| c as u8)
-            .collect();
-        String::from_utf8_lossy(&bytes).into_owned()
+        let bytes = unsafe { view(self.log_output as *const u8, self.log_output_len) };
+        String::from_utf8_lossy(bytes).into_owned()
     }
 
     /// Get the error message as a string.
     pub fn error_message(&self) -> Option<String> {
-        if self.reason != YieldReason::Error {
+        if self.reason != YieldReason::Error || self.error_msg.is_null() {
             return None;
         }
-        let cstr = unsafe { CStr::from_ptr(self.error_msg.as_ptr()) };
+        let cstr = unsafe { CStr::from_ptr(self.error_msg) };
         Some(cstr.to_string_lossy().into_owned())
     }
 }
 
-impl std::fmt::Debug for StepResult {
+impl std::fmt::Debug for StepResult<'_> {
     fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
         f.debug_struct("StepResult")
             .field("reason", &self.reason)
@@ -349,7 +1018,11 @@ impl std::fmt::Debug for StepResult {
             .field("radio_tx_len", &self.radio_tx_len)
             .field("radio_tx_airtime_ms", &self.radio_tx_airtime_ms)
             .field("serial_tx_len", &self.serial_tx_len)
+            .field("serial_tx_pending", &self.serial_tx_pending)
+            .field("serial_frames_pending", &self.serial_frames_pending)
             .field("log_output_len", &self.log_output_len)
+            .field("state_hash", &self.state_hash)
+            .field("events", &self.events())
             .finish()
     }
 }
@@ -362,6 +1035,59 @@ struct SimNodeImpl {
 
 type SimNodeHandle = *mut SimNodeImpl;
 
+/// Opaque filesystem image handle.
+#[repr(C)]
+struct SimFsImage {
+    _private: [u8; 0],
+}
+
+type SimFsImageHandle = *mut SimFsImage;
+
+/// Opaque node snapshot handle.
+#[repr(C)]
+struct SimSnapshot {
+    _private: [u8; 0],
+}
+
+type SimSnapshotHandle = *mut SimSnapshot;
+
+/// One entry of a batched step - must match SimStepRequest in sim_api.h.
+#[repr(C)]
+#[derive(Clone, Copy)]
+struct StepRequest {
+    node: SimNodeHandle,
+    sim_millis: u64,
+    sim_rtc_secs: u32,
+}
+
+/// One receiver of a batched radio injection - must match SimRxTarget in sim_api.h.
+#[repr(C)]
+#[derive(Clone, Copy)]
+struct RxTarget {
+    node: SimNodeHandle,
+    rssi: f32,
+    snr: f32,
+}
+
+/// Location of one frame inside a contiguous frame buffer - must match
+/// SimFrameSpan in sim_api.h.
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct FrameSpan {
+    /// Byte offset of the frame in the buffer.
+    pub offset: u32,
+    /// Frame length in bytes.
+    pub len: u32,
+}
+
+impl FrameSpan {
+    /// The bytes of this frame within `buffer`.
+    pub fn get<'b>(&self, buffer: &'b [u8]) -> &'b [u8] {
+        let start = self.offset as usize;
+        &buffer[start..start + self.len as usize]
+    }
+}
+
 // ============================================================================
 // Function Types
 // ============================================================================
@@ -369,13 +1095,27 @@ type SimNodeHandle = *mut SimNodeImpl;
 type FnSimCreate = unsafe extern "C" fn(*const NodeConfig) -> SimNodeHandle;
 type FnSimDestroy = unsafe extern "C" fn(SimNodeHandle);
 type FnSimReboot = unsafe extern "C" fn(SimNodeHandle, *const NodeConfig);
+type FnSimHibernate = unsafe extern "C" fn(SimNodeHandle) -> i32;
+type FnSimWake = unsafe extern "C" fn(SimNodeHandle) -> i32;
+type FnSimIsHibernating = unsafe extern "C" fn(SimNodeHandle) -> i32;
+type FnSimPeekNextWake = unsafe extern "C" fn(SimNodeHandle, *mut i32) -> u64;
 type FnSimStepBegin = unsafe extern "C" fn(SimNodeHandle, u64, u32);
-type FnSimStepWait = unsafe extern "C" fn(SimNodeHandle) -> StepResult;
-type FnSimStep = unsafe extern "C" fn(SimNodeHandle, u64, u32) -> StepResult;
+type FnSimStepWait = unsafe extern "C" fn(SimNodeHandle) -> StepResult<'static>;
+type FnSimStep = unsafe extern "C" fn(SimNodeHandle, u64, u32) -> StepResult<'static>;
+type FnSimStepBatch = unsafe extern "C" fn(*const StepRequest, *mut StepResult<'static>, usize);
 type FnSimInjectRadioRx = unsafe extern "C" fn(SimNodeHandle, *const u8, usize, f32, f32);
+type FnSimInjectRadioRxBatch = unsafe extern "C" fn(*const RxTarget, usize, *const u8, usize);
 type FnSimInjectSerialRx = unsafe extern "C" fn(SimNodeHandle, *const u8, usize);
 type FnSimInjectSerialFrame = unsafe extern "C" fn(SimNodeHandle, *const u8, usize);
 type FnSimCollectSerialFrame = unsafe extern "C" fn(SimNodeHandle, *mut u8, usize) -> usize;
+type FnSimCollectSerialTx = unsafe extern "C" fn(SimNodeHandle, *mut u8, usize) -> usize;
+type FnSimInjectSerialFrames =
+    unsafe extern "C" fn(SimNodeHandle, *const u8, usize, *const FrameSpan, usize) -> usize;
+type FnSimCollectSerialFrames =
+    unsafe extern "C" fn(SimNodeHandle, *mut u8, usize, *mut FrameSpan, usize) -> usize;
+type FnSimInjectCliLine = unsafe extern "C" fn(SimNodeHandle, *const c_char, u32) -> i32;
+type FnSimLogSink = unsafe extern "C" fn(*mut c_void, *const c_char, usize);
+type FnSimSetLogSink = unsafe extern "C" fn(SimNodeHandle, Option<FnSimLogSink>, *mut c_void);
 type FnSimNotifyTxComplete = unsafe extern "C" fn(SimNodeHandle);
 type FnSimNotifyStateChange = unsafe extern "C" fn(SimNodeHandle, u32);
 type FnSimGetNodeType = unsafe extern "C" fn() -> *const c_char;
@@ -384,6 +1124,35 @@ type FnSimFsWrite = unsafe extern "C" fn(SimNodeHandle, *const c_char, *const u8
 type FnSimFsRead = unsafe extern "C" fn(SimNodeHandle, *const c_char, *mut u8, usize) -> i32;
 type FnSimFsExists = unsafe extern "C" fn(SimNodeHandle, *const c_char) -> i32;
 type FnSimFsRemove = unsafe extern "C" fn(SimNodeHandle, *const c_char) -> i32;
+type FnSimFsImageCreate = unsafe extern "C" fn() -> SimFsImageHandle;
+type FnSimFsImageWrite =
+    unsafe extern "C" fn(SimFsImageHandle, *const c_char, *const u8, usize) -> i32;
+type FnSimFsImageRelease = unsafe extern "C" fn(SimFsImageHandle);
+type FnSimSetFsDir = unsafe extern "C" fn(*const c_char);
+type FnSimSnapshot = unsafe extern "C" fn(SimNodeHandle) -> SimSnapshotHandle;
+type FnSimRestore = unsafe extern "C" fn(SimNodeHandle, SimSnapshotHandle) -> i32;
+type FnSimFork = unsafe extern "C" fn(SimSnapshotHandle, *const NodeConfig) -> SimNodeHandle;
+type FnSimSnapshotRelease = unsafe extern "C" fn(SimSnapshotHandle);
+type FnSimCreateBatch = unsafe extern "C" fn(*const NodeConfig, *mut SimNodeHandle, usize) -> usize;
+type FnSimForkBatch =
+    unsafe extern "C" fn(SimSnapshotHandle, *const NodeConfig, *mut SimNodeHandle, usize) -> usize;
+type FnSimFsFlush = unsafe extern "C" fn(SimNodeHandle) -> i32;
+type FnSimFsView = unsafe extern "C" fn(SimNodeHandle, *const c_char, *mut usize) -> *const u8;
+type FnSimSetFiberWorkers = unsafe extern "C" fn(u32);
+type FnSimSetStepSpin = unsafe extern "C" fn(u32, u32);
+type FnSimSetCryptoCache = unsafe extern "C" fn(CryptoCacheKind, u32);
+type FnSimGetCryptoCacheStats = unsafe extern "C" fn(CryptoCacheKind, *mut CryptoCacheStats);
+type FnSimGetAirtimeTable = unsafe extern "C" fn(f32, u8, u8, *mut u32, usize) -> usize;
+type FnSimGetHeapStats = unsafe extern "C" fn(SimNodeHandle, *mut HeapStats);
+type FnSimGetHandoffStats = unsafe extern "C" fn(SimNodeHandle, *mut HandoffStats);
+type FnSimGetStats = unsafe extern "C" fn(SimNodeHandle, *mut NodeStats);
+type FnSimTraceEnable = unsafe extern "C" fn(u32, u32);
+type FnSimTraceDrain = unsafe extern "C" fn(*mut FirmwareTraceEvent, usize) -> usize;
+type FnSimTraceDropped = unsafe extern "C" fn() -> u64;
+type FnSimReplay = unsafe extern "C" fn(*const c_char, *mut ReplayResult) -> i32;
+type FnSimCheckMeshTables = unsafe extern "C" fn(u64, u32) -> u32;
+type FnSimAttachRuntime = unsafe extern "C" fn(*const c_void) -> i32;
+type FnSimRuntimeGet = unsafe extern "C" fn(u32) -> *const c_void;
 
 // ============================================================================
 // Firmware Types
@@ -429,6 +1198,80 @@ impl FirmwareType {
     }
 }
 
+// ============================================================================
+// SharedRuntime - Process-wide services shared by the firmware DLLs
+// ============================================================================
+
+/// Major version of the shared runtime's C ABI (`SIM_RUNTIME_ABI_MAJOR`).
+pub const RUNTIME_ABI_MAJOR: u32 = 1;
+
+/// Set to skip the shared runtime: each firmware DLL then keeps its own
+/// crypto caches, airtime tables and fiber worker pool.
+pub const NO_SHARED_RUNTIME_ENV: &str = "MCSIM_NO_SHARED_RUNTIME";
+
+/// The shared runtime library (`mcsim_runtime`).
+///
+/// Holds one set of crypto caches, airtime tables and fiber workers for the
+/// whole process. `FirmwareDll::load_from_path()` attaches every firmware DLL
+/// to it, so mixed meshes share one cache and one scheduler across node
+/// types and firmware versions. Loaded on first use and never unloaded,
+/// since attached DLLs keep pointers into it.
+pub struct SharedRuntime {
+    _library: Library,
+    api: *const c_void,
+}
+
+// SAFETY: the runtime's function table is immutable and its functions are
+// thread-safe.
+unsafe impl Send for SharedRuntime {}
+unsafe impl Sync for SharedRuntime {}
+
+impl SharedRuntime {
+    /// The process's shared runtime, or `None` if the library is not found,
+    /// does not implement `RUNTIME_ABI_MAJOR`, or `MCSIM_NO_SHARED_RUNTIME`
+    /// is set.
+    pub fn get() -> Option<&'static SharedRuntime> {
+        static RUNTIME: OnceLock<Option<SharedRuntime>> = OnceLock::new();
+        RUNTIME
+            .get_or_init(|| {
+                if std::env::var_os(NO_SHARED_RUNTIME_ENV).is_some() {
+                    return None;
+                }
+                let path = find_library_path(runtime_dll_name()).ok()?;
+                Self::load_from_path(&path).ok().flatten()
+            })
+            .as_ref()
+    }
+
+    fn load_from_path(path: &Path) -> Result<Option<Self>, DllError> {
+        // SAFETY: We're loading a DLL that we built ourselves
+        let library = unsafe { Library::new(path)? };
+        let api = unsafe {
+            let sim_runtime_get: FnSimRuntimeGet =
+                *library.get::<FnSimRuntimeGet>(b"sim_runtime_get")?;
+            sim_runtime_get(RUNTIME_ABI_MAJOR)
+        };
+        if api.is_null() {
+            return Ok(None);
+        }
+        Ok(Some(Self {
+            _library: library,
+            api,
+        }))
+    }
+}
+
+/// Library filename of the shared runtime.
+fn runtime_dll_name() -> &'static str {
+    if cfg!(target_os = "windows") {
+        "mcsim_runtime.dll"
+    } else if cfg!(target_os = "macos") {
+        "libmcsim_runtime.dylib"
+    } else {
+        "libmcsim_runtime.so"
+    }
+}
+
 // ============================================================================
 // FirmwareDll - Loaded DLL with function pointers
 // ============================================================================
@@ -440,6 +1283,7 @@ impl FirmwareType {
 pub struct FirmwareDll {
     _library: Arc<Library>,
     firmware_type: FirmwareType,
+    shares_runtime: bool,
 
     // Function pointers
     sim_create: FnSimCreate,
@@ -448,10 +1292,17 @@ pub struct FirmwareDll {
     sim_step_begin: FnSimStepBegin,
     sim_step_wait: FnSimStepWait,
     sim_step: FnSimStep,
+    sim_step_batch: FnSimStepBatch,
     sim_inject_radio_rx: FnSimInjectRadioRx,
+    sim_inject_radio_rx_batch: FnSimInjectRadioRxBatch,
     sim_inject_serial_rx: FnSimInjectSerialRx,
     sim_inject_serial_frame: FnSimInjectSerialFrame,
     sim_collect_serial_frame: FnSimCollectSerialFrame,
+    sim_collect_serial_tx: FnSimCollectSerialTx,
+    sim_inject_serial_frames: FnSimInjectSerialFrames,
+    sim_collect_serial_frames: FnSimCollectSerialFrames,
+    sim_inject_cli_line: FnSimInjectCliLine,
+    sim_set_log_sink: FnSimSetLogSink,
     sim_notify_tx_complete: FnSimNotifyTxComplete,
     sim_notify_state_change: FnSimNotifyStateChange,
     sim_get_node_type: FnSimGetNodeType,
@@ -460,6 +1311,35 @@ pub struct FirmwareDll {
     sim_fs_read: FnSimFsRead,
     sim_fs_exists: FnSimFsExists,
     sim_fs_remove: FnSimFsRemove,
+    sim_fs_image_create: FnSimFsImageCreate,
+    sim_fs_image_write: FnSimFsImageWrite,
+    sim_fs_image_release: FnSimFsImageRelease,
+    sim_set_fs_dir: FnSimSetFsDir,
+    sim_snapshot: FnSimSnapshot,
+    sim_restore: FnSimRestore,
+    sim_fork: FnSimFork,
+    sim_snapshot_release: FnSimSnapshotRelease,
+    sim_hibernate: FnSimHibernate,
+    sim_wake: FnSimWake,
+    sim_is_hibernating: FnSimIsHibernating,
+    sim_peek_next_wake: FnSimPeekNextWake,
+    sim_create_batch: FnSimCreateBatch,
+    sim_fork_batch: FnSimForkBatch,
+    sim_fs_flush: FnSimFsFlush,
+    sim_fs_view: FnSimFsView,
+    sim_set_fiber_workers: FnSimSetFiberWorkers,
+    sim_set_step_spin: FnSimSetStepSpin,
+    sim_set_crypto_cache: FnSimSetCryptoCache,
+    sim_get_crypto_cache_stats: FnSimGetCryptoCacheStats,
+    sim_get_airtime_table: FnSimGetAirtimeTable,
+    sim_get_heap_stats: FnSimGetHeapStats,
+    sim_get_handoff_stats: FnSimGetHandoffStats,
+    sim_get_stats: FnSimGetStats,
+    sim_trace_enable: FnSimTraceEnable,
+    sim_trace_drain: FnSimTraceDrain,
+    sim_trace_dropped: FnSimTraceDropped,
+    sim_replay: FnSimReplay,
+    sim_check_mesh_tables: FnSimCheckMeshTables,
 }
 
 impl FirmwareDll {
@@ -483,17 +1363,32 @@ impl FirmwareDll {
             let sim_create: FnSimCreate = *library.get::<FnSimCreate>(b"sim_create")?;
             let sim_destroy: FnSimDestroy = *library.get::<FnSimDestroy>(b"sim_destroy")?;
             let sim_reboot: FnSimReboot = *library.get::<FnSimReboot>(b"sim_reboot")?;
-            let sim_step_begin: FnSimStepBegin = *library.get::<FnSimStepBegin>(b"sim_step_begin")?;
+            let sim_step_begin: FnSimStepBegin =
+                *library.get::<FnSimStepBegin>(b"sim_step_begin")?;
             let sim_step_wait: FnSimStepWait = *library.get::<FnSimStepWait>(b"sim_step_wait")?;
             let sim_step: FnSimStep = *library.get::<FnSimStep>(b"sim_step")?;
+            let sim_step_batch: FnSimStepBatch =
+                *library.get::<FnSimStepBatch>(b"sim_step_batch")?;
             let sim_inject_radio_rx: FnSimInjectRadioRx =
                 *library.get::<FnSimInjectRadioRx>(b"sim_inject_radio_rx")?;
+            let sim_inject_radio_rx_batch: FnSimInjectRadioRxBatch =
+                *library.get::<FnSimInjectRadioRxBatch>(b"sim_inject_radio_rx_batch")?;
             let sim_inject_serial_rx: FnSimInjectSerialRx =
                 *library.get::<FnSimInjectSerialRx>(b"sim_inject_serial_rx")?;
             let sim_inject_serial_frame: FnSimInjectSerialFrame =
                 *library.get::<FnSimInjectSerialFrame>(b"sim_inject_serial_frame")?;
             let sim_collect_serial_frame: FnSimCollectSerialFrame =
                 *library.get::<FnSimCollectSerialFrame>(b"sim_collect_serial_frame")?;
+            let sim_collect_serial_tx: FnSimCollectSerialTx =
+                *library.get::<FnSimCollectSerialTx>(b"sim_collect_serial_tx")?;
+            let sim_inject_serial_frames: FnSimInjectSerialFrames =
+                *library.get::<FnSimInjectSerialFrames>(b"sim_inject_serial_frames")?;
+            let sim_collect_serial_frames: FnSimCollectSerialFrames =
+                *library.get::<FnSimCollectSerialFrames>(b"sim_collect_serial_frames")?;
+            let sim_inject_cli_line: FnSimInjectCliLine =
+                *library.get::<FnSimInjectCliLine>(b"sim_inject_cli_line")?;
+            let sim_set_log_sink: FnSimSetLogSink =
+                *library.get::<FnSimSetLogSink>(b"sim_set_log_sink")?;
             let sim_notify_tx_complete: FnSimNotifyTxComplete =
                 *library.get::<FnSimNotifyTxComplete>(b"sim_notify_tx_complete")?;
             let sim_notify_state_change: FnSimNotifyStateChange =
@@ -506,20 +1401,87 @@ impl FirmwareDll {
             let sim_fs_read: FnSimFsRead = *library.get::<FnSimFsRead>(b"sim_fs_read")?;
             let sim_fs_exists: FnSimFsExists = *library.get::<FnSimFsExists>(b"sim_fs_exists")?;
             let sim_fs_remove: FnSimFsRemove = *library.get::<FnSimFsRemove>(b"sim_fs_remove")?;
+            let sim_fs_image_create: FnSimFsImageCreate =
+                *library.get::<FnSimFsImageCreate>(b"sim_fs_image_create")?;
+            let sim_fs_image_write: FnSimFsImageWrite =
+                *library.get::<FnSimFsImageWrite>(b"sim_fs_image_write")?;
+            let sim_fs_image_release: FnSimFsImageRelease =
+                *library.get::<FnSimFsImageRelease>(b"sim_fs_image_release")?;
+            let sim_set_fs_dir: FnSimSetFsDir = *library.get::<FnSimSetFsDir>(b"sim_set_fs_dir")?;
+            let sim_snapshot: FnSimSnapshot = *library.get::<FnSimSnapshot>(b"sim_snapshot")?;
+            let sim_restore: FnSimRestore = *library.get::<FnSimRestore>(b"sim_restore")?;
+            let sim_fork: FnSimFork = *library.get::<FnSimFork>(b"sim_fork")?;
+            let sim_snapshot_release: FnSimSnapshotRelease =
+                *library.get::<FnSimSnapshotRelease>(b"sim_snapshot_release")?;
+            let sim_hibernate: FnSimHibernate = *library.get::<FnSimHibernate>(b"sim_hibernate")?;
+            let sim_wake: FnSimWake = *library.get::<FnSimWake>(b"sim_wake")?;
+            let sim_is_hibernating: FnSimIsHibernating =
+                *library.get::<FnSimIsHibernating>(b"sim_is_hibernating")?;
+            let sim_peek_next_wake: FnSimPeekNextWake =
+                *library.get::<FnSimPeekNextWake>(b"sim_peek_next_wake")?;
+            let sim_create_batch: FnSimCreateBatch =
+                *library.get::<FnSimCreateBatch>(b"sim_create_batch")?;
+            let sim_fork_batch: FnSimForkBatch =
+                *library.get::<FnSimForkBatch>(b"sim_fork_batch")?;
+            let sim_fs_flush: FnSimFsFlush = *library.get::<FnSimFsFlush>(b"sim_fs_flush")?;
+            let sim_fs_view: FnSimFsView = *library.get::<FnSimFsView>(b"sim_fs_view")?;
+            let sim_set_fiber_workers: FnSimSetFiberWorkers =
+                *library.get::<FnSimSetFiberWorkers>(b"sim_set_fiber_workers")?;
+            let sim_set_step_spin: FnSimSetStepSpin =
+                *library.get::<FnSimSetStepSpin>(b"sim_set_step_spin")?;
+            let sim_set_crypto_cache: FnSimSetCryptoCache =
+                *library.get::<FnSimSetCryptoCache>(b"sim_set_crypto_cache")?;
+            let sim_get_crypto_cache_stats: FnSimGetCryptoCacheStats =
+                *library.get::<FnSimGetCryptoCacheStats>(b"sim_get_crypto_cache_stats")?;
+            let sim_get_airtime_table: FnSimGetAirtimeTable =
+                *library.get::<FnSimGetAirtimeTable>(b"sim_get_airtime_table")?;
+            let sim_get_heap_stats: FnSimGetHeapStats =
+                *library.get::<FnSimGetHeapStats>(b"sim_get_heap_stats")?;
+            let sim_get_handoff_stats: FnSimGetHandoffStats =
+                *library.get::<FnSimGetHandoffStats>(b"sim_get_handoff_stats")?;
+            let sim_get_stats: FnSimGetStats = *library.get::<FnSimGetStats>(b"sim_get_stats")?;
+            let sim_trace_enable: FnSimTraceEnable =
+                *library.get::<FnSimTraceEnable>(b"sim_trace_enable")?;
+            let sim_trace_drain: FnSimTraceDrain =
+                *library.get::<FnSimTraceDrain>(b"sim_trace_drain")?;
+            let sim_trace_dropped: FnSimTraceDropped =
+                *library.get::<FnSimTraceDropped>(b"sim_trace_dropped")?;
+            let sim_replay: FnSimReplay = *library.get::<FnSimReplay>(b"sim_replay")?;
+            let sim_check_mesh_tables: FnSimCheckMeshTables =
+                *library.get::<FnSimCheckMeshTables>(b"sim_check_mesh_tables")?;
+
+            // Libraries built before the shared runtime keep their own services
+            let shares_runtime = match (
+                library
+                    .get::<FnSimAttachRuntime>(b"sim_attach_runtime")
+                    .ok(),
+                SharedRuntime::get(),
+            ) {
+                (Some(sim_attach_runtime), Some(runtime)) => sim_attach_runtime(runtime.api) != 0,
+                _ => false,
+            };
 
             Ok(Self {
                 _library: library,
                 firmware_type,
+                shares_runtime,
                 sim_create,
                 sim_destroy,
                 sim_reboot,
                 sim_step_begin,
                 sim_step_wait,
                 sim_step,
+                sim_step_batch,
                 sim_inject_radio_rx,
+                sim_inject_radio_rx_batch,
                 sim_inject_serial_rx,
                 sim_inject_serial_frame,
                 sim_collect_serial_frame,
+                sim_collect_serial_tx,
+                sim_inject_serial_frames,
+                sim_collect_serial_frames,
+                sim_inject_cli_line,
+                sim_set_log_sink,
                 sim_notify_tx_complete,
                 sim_notify_state_change,
                 sim_get_node_type,
@@ -528,6 +1490,35 @@ impl FirmwareDll {
                 sim_fs_read,
                 sim_fs_exists,
                 sim_fs_remove,
+                sim_fs_image_create,
+                sim_fs_image_write,
+                sim_fs_image_release,
+                sim_set_fs_dir,
+                sim_snapshot,
+                sim_restore,
+                sim_fork,
+                sim_snapshot_release,
+                sim_hibernate,
+                sim_wake,
+                sim_is_hibernating,
+                sim_peek_next_wake,
+                sim_create_batch,
+                sim_fork_batch,
+                sim_fs_flush,
+                sim_fs_view,
+                sim_set_fiber_workers,
+                sim_set_step_spin,
+                sim_set_crypto_cache,
+                sim_get_crypto_cache_stats,
+                sim_get_airtime_table,
+                sim_get_heap_stats,
+                sim_get_handoff_stats,
+                sim_get_stats,
+                sim_trace_enable,
+                sim_trace_drain,
+                sim_trace_dropped,
+                sim_replay,
+                sim_check_mesh_tables,
             })
         }
     }
@@ -537,6 +1528,13 @@ impl FirmwareDll {
         self.firmware_type
     }
 
+    /// Whether this library's crypto caches, airtime tables and fiber
+    /// workers are the shared runtime's (see `SharedRuntime`), and so also
+    /// those of every other library attached to it.
+    pub fn shares_runtime(&self) -> bool {
+        self.shares_runtime
+    }
+
     /// Get the node type string from the DLL.
     pub fn node_type(&self) -> String {
         unsafe {
@@ -548,127 +1546,309 @@ impl FirmwareDll {
         }
     }
 
-    /// Create a new firmware node.
-    pub fn create_node(&self, config: &NodeConfig) -> Result<FirmwareNode<'_>, DllError> {
-        let handle = unsafe { (self.sim_create)(config) };
-        if handle.is_null() {
-            return Err(DllError::CreateFailed);
+    /// Set the number of worker threads for `ExecutionMode::Fiber` nodes of this
+    /// library (0 = one per hardware thread). With `shares_runtime()` this
+    /// sizes the shared pool that runs the fiber nodes of every library.
+    ///
+    /// Only takes effect before the first fiber node is stepped.
+    pub fn set_fiber_workers(&self, count: u32) {
+        unsafe {
+            (self.sim_set_fiber_workers)(count);
         }
-        Ok(FirmwareNode {
-            dll: self,
-            handle,
-        })
     }
-}
 
-// ============================================================================
-// FirmwareNode - A running firmware instance
-// ============================================================================
+    /// Set how many polls of the step state the coordinator and node threads
+    /// make before sleeping, for all nodes of this library.
+    ///
+    /// Each side adapts below its limit. The defaults are 4096 and 512, or no
+    /// spinning on a single CPU.
+    pub fn set_step_spin(&self, coordinator_spins: u32, node_spins: u32) {
+        unsafe {
+            (self.sim_set_step_spin)(coordinator_spins, node_spins);
+        }
+    }
 
-/// A running firmware node instance.
-///
-/// This represents a single simulated node. The node is destroyed when this
-/// struct is dropped.
-pub struct FirmwareNode<'a> {
-    dll: &'a FirmwareDll,
-    handle: SimNodeHandle,
-}
+    /// Enable a crypto cache shared by all nodes of this library, holding up
+    /// to `entries` results (0 disables it, the default). With
+    /// `shares_runtime()` this is the shared runtime's cache, used by every
+    /// attached library.
+    ///
+    /// Clears the cache and its counters.
+    pub fn set_crypto_cache(&self, kind: CryptoCacheKind, entries: u32) {
+        unsafe {
+            (self.sim_set_crypto_cache)(kind, entries);
+        }
+    }
 
-impl<'a> FirmwareNode<'a> {
-    /// Get the public key of this node.
-    pub fn public_key(&self) -> [u8; PUB_KEY_SIZE] {
-        let mut key = [0u8; PUB_KEY_SIZE];
+    /// Read the hit/miss counters of a crypto cache.
+    pub fn crypto_cache_stats(&self, kind: CryptoCacheKind) -> CryptoCacheStats {
+        let mut stats = CryptoCacheStats::default();
         unsafe {
-            (self.dll.sim_get_public_key)(self.handle, key.as_mut_ptr());
+            (self.sim_get_crypto_cache_stats)(kind, &mut stats);
         }
-        key
+        stats
     }
 
-    /// Reboot the node with a new configuration.
-    pub fn reboot(&mut self, config: &NodeConfig) {
+    /// Time on air in milliseconds, indexed by payload length, that nodes of
+    /// this library use for these radio settings (bandwidth in kHz, as in
+    /// `NodeConfig::lora_bw`).
+    ///
+    /// Feed it to `mcsim_lora::AirtimeTable` so the coordinator's channel
+    /// model and the firmware agree on every packet's airtime.
+    pub fn airtime_table(&self, bw_khz: f32, sf: u8, cr: u8) -> [u32; AIRTIME_TABLE_LEN] {
+        let mut table = [0u32; AIRTIME_TABLE_LEN];
         unsafe {
-            (self.dll.sim_reboot)(self.handle, config);
+            (self.sim_get_airtime_table)(bw_khz, sf, cr, table.as_mut_ptr(), table.len());
         }
+        table
     }
 
-    /// Begin an async simulation step.
+    /// Record the tracepoints of the `TRACE_*` categories in `categories`
+    /// (0 stops tracing, the default), for all nodes of this library.
     ///
-    /// Call `step_wait()` to get the result.
-    pub fn step_begin(&mut self, sim_millis: u64, sim_rtc_secs: u32) {
+    /// Each host thread buffers up to `events_per_thread` events (0 = 8192)
+    /// until `drain_trace()`; further events are dropped and counted by
+    /// `trace_dropped()`.
+    pub fn enable_trace(&self, categories: u32, events_per_thread: u32) {
         unsafe {
-            (self.dll.sim_step_begin)(self.handle, sim_millis, sim_rtc_secs);
+            (self.sim_trace_enable)(categories, events_per_thread);
         }
     }
 
-    /// Wait for an async step to complete.
-    pub fn step_wait(&mut self) -> StepResult {
-        unsafe { (self.dll.sim_step_wait)(self.handle) }
+    /// Append every buffered trace event to `out` and return how many were
+    /// added. Call from one thread at a time.
+    pub fn drain_trace(&self, out: &mut Vec<FirmwareTraceEvent>) -> usize {
+        let start = out.len();
+        loop {
+            out.reserve(TRACE_DRAIN_CHUNK);
+            let len = out.len();
+            let drained = unsafe {
+                let n = (self.sim_trace_drain)(out.as_mut_ptr().add(len), TRACE_DRAIN_CHUNK);
+                out.set_len(len + n);
+                n
+            };
+            if drained == 0 {
+                return out.len() - start;
+            }
+        }
     }
 
-    /// Perform a synchronous simulation step.
-    ///
-    /// This combines `step_begin()` and `step_wait()`.
-    pub fn step(&mut self, sim_millis: u64, sim_rtc_secs: u32) -> StepResult {
-        unsafe { (self.dll.sim_step)(self.handle, sim_millis, sim_rtc_secs) }
+    /// Trace events dropped on full buffers since the library was loaded.
+    pub fn trace_dropped(&self) -> u64 {
+        unsafe { (self.sim_trace_dropped)() }
     }
 
-    /// Inject a received radio packet.
-    pub fn inject_radio_rx(&mut self, data: &[u8], rssi: f32, snr: f32) {
+    /// Keep the files of nodes created from now on in memory-mapped files
+    /// `<dir>/<node_name>.simfs`, so a node created again with the same name
+    /// resumes them (`None` = in memory only, the default).
+    pub fn set_fs_dir(&self, dir: Option<&Path>) -> Result<(), DllError> {
+        let c_dir = match dir {
+            Some(dir) => Some(path_cstring(dir)?),
+            None => None,
+        };
         unsafe {
-            (self.dll.sim_inject_radio_rx)(self.handle, data.as_ptr(), data.len(), rssi, snr);
+            (self.sim_set_fs_dir)(c_dir.as_ref().map_or(std::ptr::null(), |d| d.as_ptr()));
         }
+        Ok(())
     }
 
-    /// Inject received serial data.
-    pub fn inject_serial_rx(&mut self, data: &[u8]) {
-        unsafe {
-            (self.dll.sim_inject_serial_rx)(self.handle, data.as_ptr(), data.len());
-        }
+    /// Step several nodes of this library with a single FFI call and wait for
+    /// all of them.
+    ///
+    /// Each entry is `(node, sim_millis, sim_rtc_secs)`; the returned results are
+    /// in the same order. Fiber-mode nodes are spread over the library's
+    /// work-stealing pool.
+    ///
+    /// # Panics
+    ///
+    /// Panics if a node was created by a different `FirmwareDll`.
+    pub fn step_batch<'n>(
+        &self,
+        nodes: &'n mut [(&mut FirmwareNode<'_>, u64, u32)],
+    ) -> Vec<StepResult<'n>> {
+        let requests: Vec<StepRequest> = nodes
+            .iter()
+            .map(|(node, sim_millis, sim_rtc_secs)| {
+                assert!(
+                    std::ptr::eq(node.dll, self),
+                    "step_batch: node belongs to a different firmware library"
+                );
+                StepRequest {
+                    node: node.handle,
+                    sim_millis: *sim_millis,
+                    sim_rtc_secs: *sim_rtc_secs,
+                }
+            })
+            .collect();
+        self.run_step_batch(&requests)
     }
 
-    /// Inject a serial frame (for frame-based interfaces like companion).
-    pub fn inject_serial_frame(&mut self, data: &[u8]) {
+    fn run_step_batch<'n>(&self, requests: &[StepRequest]) -> Vec<StepResult<'n>> {
+        let mut results: Vec<StepResult<'static>> = Vec::with_capacity(requests.len());
         unsafe {
-            (self.dll.sim_inject_serial_frame)(self.handle, data.as_ptr(), data.len());
+            (self.sim_step_batch)(requests.as_ptr(), results.as_mut_ptr(), requests.len());
+            results.set_len(requests.len());
         }
+        results
     }
 
-    /// Collect a transmitted serial frame (for frame-based interfaces like companion).
-    /// Returns Some(frame_data) if a frame was available, None otherwise.
-    pub fn collect_serial_frame(&mut self) -> Option<Vec<u8>> {
-        let mut buffer = vec![0u8; 256]; // MAX_FRAME_SIZE is 172, but use some margin
-        let len = unsafe {
-            (self.dll.sim_collect_serial_frame)(self.handle, buffer.as_mut_ptr(), buffer.len())
-        };
-        if len > 0 {
-            buffer.truncate(len);
-            Some(buffer)
-        } else {
-            None
-        }
+    /// Deliver one received packet to several nodes of this library with a
+    /// single FFI call.
+    ///
+    /// Each entry is `(node, rssi, snr)`. The payload is copied once into a
+    /// buffer shared by all receivers, however many there are.
+    ///
+    /// # Panics
+    ///
+    /// Panics if a node was created by a different `FirmwareDll`.
+    pub fn inject_radio_rx_batch(
+        &self,
+        receivers: &mut [(&mut FirmwareNode<'_>, f32, f32)],
+        data: &[u8],
+    ) {
+        let targets: Vec<RxTarget> = receivers
+            .iter()
+            .map(|(node, rssi, snr)| {
+                assert!(
+                    std::ptr::eq(node.dll, self),
+                    "inject_radio_rx_batch: node belongs to a different firmware library"
+                );
+                RxTarget {
+                    node: node.handle,
+                    rssi: *rssi,
+                    snr: *snr,
+                }
+            })
+            .collect();
+        self.run_inject_radio_rx_batch(&targets, data);
     }
 
-    /// Notify that a radio transmission completed.
-    pub fn notify_tx_complete(&mut self) {
+    /// Install (or with `None`, remove) the log sink of a node. `slot` keeps
+    /// the registered sink alive and must not be dropped while it is installed.
+    fn swap_log_sink(
+        &self,
+        handle: SimNodeHandle,
+        slot: &mut Option<Box<LogSink>>,
+        sink: Option<LogSink>,
+    ) {
+        let mut sink = sink.map(Box::new);
         unsafe {
-            (self.dll.sim_notify_tx_complete)(self.handle);
+            match sink.as_mut() {
+                Some(boxed) => (self.sim_set_log_sink)(
+                    handle,
+                    Some(log_sink_trampoline),
+                    &mut **boxed as *mut LogSink as *mut c_void,
+                ),
+                None => (self.sim_set_log_sink)(handle, None, std::ptr::null_mut()),
+            }
         }
+        // The previous sink is unregistered now and may be dropped
+        *slot = sink;
     }
 
-    /// Notify the radio of a state change (coordinator-driven state version update).
-    /// This is used to synchronize radio state between the coordinator and the DLL.
-    pub fn notify_state_change(&mut self, state_version: u32) {
+    /// Append all serial TX output still queued in a node to `out`.
+    fn run_collect_serial_tx(&self, handle: SimNodeHandle, out: &mut Vec<u8>) -> usize {
+        let start = out.len();
+        loop {
+            let offset = out.len();
+            out.resize(offset + MAX_SERIAL_TX, 0);
+            let len = unsafe {
+                (self.sim_collect_serial_tx)(handle, out[offset..].as_mut_ptr(), MAX_SERIAL_TX)
+            };
+            out.truncate(offset + len);
+            if len < MAX_SERIAL_TX {
+                return out.len() - start;
+            }
+        }
+    }
+
+    /// Queue `frames` for a node's frame-based serial interface; returns how
+    /// many were accepted.
+    fn run_inject_serial_frames(&self, handle: SimNodeHandle, frames: &[&[u8]]) -> usize {
+        let mut data = Vec::with_capacity(frames.iter().map(|f| f.len()).sum());
+        let spans: Vec<FrameSpan> = frames
+            .iter()
+            .map(|frame| {
+                let span = FrameSpan {
+                    offset: data.len() as u32,
+                    len: frame.len() as u32,
+                };
+                data.extend_from_slice(frame);
+                span
+            })
+            .collect();
         unsafe {
-            (self.dll.sim_notify_state_change)(self.handle, state_version);
+            (self.sim_inject_serial_frames)(
+                handle,
+                data.as_ptr(),
+                data.len(),
+                spans.as_ptr(),
+                spans.len(),
+            )
         }
     }
 
-    /// Write a file to the node's filesystem.
-    pub fn fs_write(&mut self, path: &str, data: &[u8]) -> Result<(), DllError> {
-        let c_path = CString::new(path).map_err(|_| DllError::InvalidPath(path.to_string()))?;
-        let result = unsafe {
-            (self.dll.sim_fs_write)(self.handle, c_path.as_ptr(), data.as_ptr(), data.len())
+    /// Append every frame pending in a node to `data`, with one span each
+    /// (offsets relative to the start of `data`).
+    fn run_collect_serial_frames(
+        &self,
+        handle: SimNodeHandle,
+        data: &mut Vec<u8>,
+        spans: &mut Vec<FrameSpan>,
+    ) -> usize {
+        let first = spans.len();
+        loop {
+            let base = data.len();
+            let span_base = spans.len();
+            data.resize(base + FRAME_COLLECT_BATCH * MAX_SERIAL_FRAME, 0);
+            spans.resize(span_base + FRAME_COLLECT_BATCH, FrameSpan::default());
+            let count = unsafe {
+                (self.sim_collect_serial_frames)(
+                    handle,
+                    data[base..].as_mut_ptr(),
+                    FRAME_COLLECT_BATCH * MAX_SERIAL_FRAME,
+                    spans[span_base..].as_mut_ptr(),
+                    FRAME_COLLECT_BATCH,
+                )
+            };
+            spans.truncate(span_base + count);
+            let mut end = base;
+            for span in &mut spans[span_base..] {
+                span.offset += base as u32;
+                end = (span.offset + span.len) as usize;
+            }
+            data.truncate(end);
+            if count < FRAME_COLLECT_BATCH {
+                return spans.len() - first;
+            }
+        }
+    }
+
+    /// Queue a CLI line for a repeater or room server; false if not accepted.
+    fn run_inject_cli_line(&self, handle: SimNodeHandle, line: &str, echo: bool) -> bool {
+        let c_line = match CString::new(line) {
+            Ok(c_line) => c_line,
+            Err(_) => return false,
         };
+        let flags = if echo { CLI_ECHO } else { 0 };
+        unsafe { (self.sim_inject_cli_line)(handle, c_line.as_ptr(), flags) != 0 }
+    }
+
+    /// Append every pending CLI reply (a NUL-terminated frame each) to `out`.
+    fn run_collect_cli_replies(&self, handle: SimNodeHandle, out: &mut Vec<String>) -> usize {
+        let mut data = Vec::new();
+        let mut spans = Vec::new();
+        let count = self.run_collect_serial_frames(handle, &mut data, &mut spans);
+        out.extend(spans.iter().map(|span| {
+            let reply = span.get(&data);
+            let text = reply.strip_suffix(&[0]).unwrap_or(reply);
+            String::from_utf8_lossy(text).into_owned()
+        }));
+        count
+    }
+
+    fn run_fs_flush(&self, handle: SimNodeHandle) -> Result<(), DllError> {
+        let result = unsafe { (self.sim_fs_flush)(handle) };
         if result < 0 {
             Err(DllError::FilesystemError(result))
         } else {
@@ -676,75 +1856,370 @@ impl<'a> FirmwareNode<'a> {
         }
     }
 
-    /// Read a file from the node's filesystem.
-    pub fn fs_read(&mut self, path: &str, max_len: usize) -> Result<Vec<u8>, DllError> {
+    fn run_fs_view(&self, handle: SimNodeHandle, path: &str) -> Result<Option<&[u8]>, DllError> {
         let c_path = CString::new(path).map_err(|_| DllError::InvalidPath(path.to_string()))?;
-        let mut buffer = vec![0u8; max_len];
-        let result = unsafe {
-            (self.dll.sim_fs_read)(self.handle, c_path.as_ptr(), buffer.as_mut_ptr(), max_len)
+        let mut len = 0usize;
+        let data = unsafe { (self.sim_fs_view)(handle, c_path.as_ptr(), &mut len) };
+        if data.is_null() {
+            return Ok(None);
+        }
+        if len == 0 {
+            return Ok(Some(&[]));
+        }
+        Ok(Some(unsafe { std::slice::from_raw_parts(data, len) }))
+    }
+
+    fn run_heap_stats(&self, handle: SimNodeHandle) -> HeapStats {
+        let mut stats = HeapStats::default();
+        unsafe {
+            (self.sim_get_heap_stats)(handle, &mut stats);
+        }
+        stats
+    }
+
+    fn run_handoff_stats(&self, handle: SimNodeHandle) -> HandoffStats {
+        let mut stats = HandoffStats::default();
+        unsafe {
+            (self.sim_get_handoff_stats)(handle, &mut stats);
+        }
+        stats
+    }
+
+    fn run_stats(&self, handle: SimNodeHandle) -> NodeStats {
+        let mut stats = NodeStats::default();
+        unsafe {
+            (self.sim_get_stats)(handle, &mut stats);
+        }
+        stats
+    }
+
+    fn run_inject_radio_rx_batch(&self, targets: &[RxTarget], data: &[u8]) {
+        unsafe {
+            (self.sim_inject_radio_rx_batch)(
+                targets.as_ptr(),
+                targets.len(),
+                data.as_ptr(),
+                data.len(),
+            );
+        }
+    }
+
+    /// Create a new firmware node.
+    pub fn create_node(&self, config: &NodeConfig) -> Result<FirmwareNode<'_>, DllError> {
+        let handle = unsafe { (self.sim_create)(config) };
+        if handle.is_null() {
+            return Err(DllError::CreateFailed);
+        }
+        Ok(FirmwareNode {
+            dll: self,
+            handle,
+            log_sink: None,
+        })
+    }
+
+    /// Create a filesystem image that nodes of this library can start from.
+    pub fn create_fs_image(&self) -> FsImage<'_> {
+        let handle = unsafe { (self.sim_fs_image_create)() };
+        FsImage { dll: self, handle }
+    }
+
+    /// Create a new firmware node whose filesystem starts with the files of
+    /// `image`, shared with the image until the firmware changes them.
+    ///
+    /// # Panics
+    ///
+    /// Panics if the image was created by a different `FirmwareDll`.
+    pub fn create_node_with_image(
+        &self,
+        config: &NodeConfig,
+        image: &FsImage<'_>,
+    ) -> Result<FirmwareNode<'_>, DllError> {
+        assert!(
+            std::ptr::eq(image.dll, self),
+            "create_node_with_image: image belongs to a different firmware library"
+        );
+        self.create_node(&image.apply(config))
+    }
+
+    /// Create a new firmware node that logs every call feeding it to `path`,
+    /// for `replay()`. The log ends when the node is dropped or restored from
+    /// a snapshot.
+    pub fn create_node_recording(
+        &self,
+        config: &NodeConfig,
+        path: &Path,
+    ) -> Result<FirmwareNode<'_>, DllError> {
+        let c_path = path_cstring(path)?;
+        let mut config = config.clone();
+        config.record_path = c_path.as_ptr() as usize;
+        self.create_node(&config)
+    }
+
+    /// Run the node history recorded at `path` on a new node of this library,
+    /// without a coordinator or other nodes, and compare its outputs with the
+    /// recording.
+    pub fn replay(&self, path: &Path) -> Result<ReplayResult, DllError> {
+        let c_path = path_cstring(path)?;
+        let mut result = ReplayResult::default();
+        let status = unsafe { (self.sim_replay)(c_path.as_ptr(), &mut result) };
+        if status < 0 {
+            Err(DllError::InvalidRecording(path.display().to_string()))
+        } else {
+            Ok(result)
+        }
+    }
+
+    /// Compare the shim's hashed packet-seen table with MeshCore's
+    /// `SimpleMeshTables` over `operations` random calls seeded by `seed`.
+    /// Returns the 1-based number of the first operation whose results
+    /// differed (`operations + 1` for the final saved tables), or `None`.
+    pub fn check_mesh_tables(&self, seed: u64, operations: u32) -> Option<u32> {
+        match unsafe { (self.sim_check_mesh_tables)(seed, operations) } {
+            0 => None,
+            op => Some(op),
+        }
+    }
+
+    /// Create a new firmware node from `snapshot`. `config` (default: the
+    /// snapshot's) may give it its own identity, name, RNG seed or radio
+    /// parameters; a different `rng_seed` or identity makes its random
+    /// streams diverge.
+    ///
+    /// # Panics
+    ///
+    /// Panics if the snapshot was taken by a different `FirmwareDll`.
+    pub fn fork_node(
+        &self,
+        snapshot: &Snapshot<'_>,
+        config: Option<&NodeConfig>,
+    ) -> Result<FirmwareNode<'_>, DllError> {
+        let handle = self.run_fork(snapshot, config)?;
+        Ok(FirmwareNode {
+            dll: self,
+            handle,
+            log_sink: None,
+        })
+    }
+
+    /// Create one node per config with a single FFI call. The nodes boot in
+    /// parallel on their own threads.
+    pub fn create_nodes(&self, configs: &[NodeConfig]) -> Result<Vec<FirmwareNode<'_>>, DllError> {
+        let handles = self.run_create_batch(None, configs)?;
+        Ok(handles
+            .into_iter()
+            .map(|handle| FirmwareNode {
+                dll: self,
+                handle,
+                log_sink: None,
+            })
+            .collect())
+    }
+
+    /// Stamp out one node per config from a template snapshot, booting them
+    /// in parallel. Each config supplies the clone's identity, name, RNG
+    /// seed and radio parameters.
+    ///
+    /// # Panics
+    ///
+    /// Panics if the snapshot was taken by a different `FirmwareDll`.
+    pub fn fork_nodes(
+        &self,
+        snapshot: &Snapshot<'_>,
+        configs: &[NodeConfig],
+    ) -> Result<Vec<FirmwareNode<'_>>, DllError> {
+        let handles = self.run_create_batch(Some(snapshot), configs)?;
+        Ok(handles
+            .into_iter()
+            .map(|handle| FirmwareNode {
+                dll: self,
+                handle,
+                log_sink: None,
+            })
+            .collect())
+    }
+
+    fn run_create_batch(
+        &self,
+        snapshot: Option<&Snapshot<'_>>,
+        configs: &[NodeConfig],
+    ) -> Result<Vec<SimNodeHandle>, DllError> {
+        let mut handles = vec![std::ptr::null_mut(); configs.len()];
+        let created = match snapshot {
+            Some(snapshot) => {
+                assert!(
+                    std::ptr::eq(snapshot.dll, self),
+                    "fork_nodes: snapshot belongs to a different firmware library"
+                );
+                unsafe {
+                    (self.sim_fork_batch)(
+                        snapshot.handle,
+                        configs.as_ptr(),
+                        handles.as_mut_ptr(),
+                        configs.len(),
+                    )
+                }
+            }
+            None => unsafe {
+                (self.sim_create_batch)(configs.as_ptr(), handles.as_mut_ptr(), configs.len())
+            },
         };
+        if created != configs.len() {
+            for handle in handles.into_iter().filter(|h| !h.is_null()) {
+                unsafe { (self.sim_destroy)(handle) };
+            }
+            return Err(match snapshot {
+                Some(_) => DllError::SnapshotMismatch,
+                None => DllError::CreateFailed,
+            });
+        }
+        Ok(handles)
+    }
+
+    /// Capture the state of an owned node of this library (see
+    /// `FirmwareNode::snapshot`).
+    ///
+    /// # Panics
+    ///
+    /// Panics if the node was created by a different `FirmwareDll`.
+    pub fn snapshot_node(&self, node: &mut OwnedFirmwareNode) -> Snapshot<'_> {
+        assert!(
+            std::ptr::eq(&*node.dll, self),
+            "snapshot_node: node belongs to a different firmware library"
+        );
+        self.run_snapshot(node.handle)
+    }
+
+    fn run_snapshot(&self, handle: SimNodeHandle) -> Snapshot<'_> {
+        let handle = unsafe { (self.sim_snapshot)(handle) };
+        Snapshot { dll: self, handle }
+    }
+
+    fn run_restore(&self, handle: SimNodeHandle, snapshot: &Snapshot<'_>) -> Result<(), DllError> {
+        assert!(
+            std::ptr::eq(snapshot.dll, self),
+            "restore: snapshot belongs to a different firmware library"
+        );
+        let result = unsafe { (self.sim_restore)(handle, snapshot.handle) };
         if result < 0 {
-            Err(DllError::FilesystemError(result))
+            Err(DllError::SnapshotMismatch)
         } else {
-            buffer.truncate(result as usize);
-            Ok(buffer)
+            Ok(())
         }
     }
 
-    /// Check if a file exists on the node's filesystem.
-    pub fn fs_exists(&self, path: &str) -> Result<bool, DllError> {
-        let c_path = CString::new(path).map_err(|_| DllError::InvalidPath(path.to_string()))?;
-        let result = unsafe { (self.dll.sim_fs_exists)(self.handle, c_path.as_ptr()) };
-        Ok(result != 0)
+    fn run_fork(
+        &self,
+        snapshot: &Snapshot<'_>,
+        config: Option<&NodeConfig>,
+    ) -> Result<SimNodeHandle, DllError> {
+        assert!(
+            std::ptr::eq(snapshot.dll, self),
+            "fork: snapshot belongs to a different firmware library"
+        );
+        let config = config.map_or(std::ptr::null(), |c| c as *const NodeConfig);
+        let handle = unsafe { (self.sim_fork)(snapshot.handle, config) };
+        if handle.is_null() {
+            Err(DllError::SnapshotMismatch)
+        } else {
+            Ok(handle)
+        }
     }
+}
 
-    /// Remove a file from the node's filesystem.
-    pub fn fs_remove(&mut self, path: &str) -> Result<(), DllError> {
+// ============================================================================
+// FsImage - Shared base filesystem
+// ============================================================================
+
+/// A set of files many nodes start from.
+///
+/// Nodes created from the image reference its file contents instead of
+/// copying them; a node's first write to a file gives it a private copy.
+/// Writing to the image only affects nodes created afterwards, and the image
+/// may be dropped once its nodes exist.
+pub struct FsImage<'a> {
+    dll: &'a FirmwareDll,
+    handle: SimFsImageHandle,
+}
+
+impl<'a> FsImage<'a> {
+    /// Add or replace a file in the image.
+    pub fn write(&mut self, path: &str, data: &[u8]) -> Result<(), DllError> {
         let c_path = CString::new(path).map_err(|_| DllError::InvalidPath(path.to_string()))?;
-        let result = unsafe { (self.dll.sim_fs_remove)(self.handle, c_path.as_ptr()) };
+        let result = unsafe {
+            (self.dll.sim_fs_image_write)(self.handle, c_path.as_ptr(), data.as_ptr(), data.len())
+        };
         if result < 0 {
             Err(DllError::FilesystemError(result))
         } else {
             Ok(())
         }
     }
+
+    /// `config` with this image as its starting filesystem.
+    fn apply(&self, config: &NodeConfig) -> NodeConfig {
+        let mut config = config.clone();
+        config.fs_image = self.handle as usize;
+        config
+    }
 }
 
-impl<'a> Drop for FirmwareNode<'a> {
+impl<'a> Drop for FsImage<'a> {
     fn drop(&mut self) {
         unsafe {
-            (self.dll.sim_destroy)(self.handle);
+            (self.dll.sim_fs_image_release)(self.handle);
         }
     }
 }
 
-// SAFETY: FirmwareNode can be sent between threads as long as only one thread
-// accesses it at a time (which is enforced by &mut self on all methods).
-unsafe impl<'a> Send for FirmwareNode<'a> {}
+// SAFETY: the image is only used through &mut self or while creating nodes,
+// and the C side locks it for both.
+unsafe impl<'a> Send for FsImage<'a> {}
+unsafe impl<'a> Sync for FsImage<'a> {}
 
 // ============================================================================
-// OwnedFirmwareNode - Self-contained firmware instance
+// Snapshot - Captured node state
 // ============================================================================
 
-/// An owned firmware node that can be stored persistently.
-/// 
-/// Unlike `FirmwareNode` which borrows the DLL, this type owns an Arc
-/// to the DLL, allowing it to be stored in structs without lifetime issues.
-pub struct OwnedFirmwareNode {
-    dll: Arc<FirmwareDll>,
-    handle: SimNodeHandle,
+/// The state of a node between steps, taken with `FirmwareNode::snapshot`.
+///
+/// Restore it into a node of the same firmware type, or fork any number of
+/// new nodes from it. Files and queued packets are shared by reference. The
+/// firmware's objects are rebuilt from the restored filesystem by running
+/// setup, so RAM-only firmware state such as queued outbound packets is not
+/// kept. The snapshot may be dropped once its nodes exist.
+pub struct Snapshot<'a> {
+    dll: &'a FirmwareDll,
+    handle: SimSnapshotHandle,
 }
 
-impl OwnedFirmwareNode {
-    /// Create a new owned firmware node.
-    pub fn new(dll: Arc<FirmwareDll>, config: &NodeConfig) -> Result<Self, DllError> {
-        let handle = unsafe { (dll.sim_create)(config) };
-        if handle.is_null() {
-            return Err(DllError::CreateFailed);
+impl<'a> Drop for Snapshot<'a> {
+    fn drop(&mut self) {
+        unsafe {
+            (self.dll.sim_snapshot_release)(self.handle);
         }
-        Ok(OwnedFirmwareNode { dll, handle })
     }
+}
 
+// SAFETY: a snapshot is immutable once taken and reference counted on the
+// C side.
+unsafe impl<'a> Send for Snapshot<'a> {}
+unsafe impl<'a> Sync for Snapshot<'a> {}
+
+// ============================================================================
+// FirmwareNode - A running firmware instance
+// ============================================================================
+
+/// A running firmware node instance.
+///
+/// This represents a single simulated node. The node is destroyed when this
+/// struct is dropped.
+pub struct FirmwareNode<'a> {
+    dll: &'a FirmwareDll,
+    handle: SimNodeHandle,
+    log_sink: Option<Box<LogSink>>,
+}
+
+impl<'a> FirmwareNode<'a> {
     /// Get the public key of this node.
     pub fn public_key(&self) -> [u8; PUB_KEY_SIZE] {
         let mut key = [0u8; PUB_KEY_SIZE];
@@ -754,6 +2229,27 @@ impl OwnedFirmwareNode {
         key
     }
 
+    /// Counters of this node's heap (all zero unless created with
+    /// `NodeConfig::with_node_heap()`).
+    pub fn heap_stats(&self) -> HeapStats {
+        self.dll.run_heap_stats(self.handle)
+    }
+
+    /// How this node's step handoffs were satisfied (spinning or sleeping).
+    pub fn handoff_stats(&self) -> HandoffStats {
+        self.dll.run_handoff_stats(self.handle)
+    }
+
+    /// Runtime counters of this node: steps, CPU time, radio and serial.
+    pub fn stats(&self) -> NodeStats {
+        self.dll.run_stats(self.handle)
+    }
+
+    /// Identifies this node in `FirmwareTraceEvent::node_id()`.
+    pub fn node_id(&self) -> usize {
+        self.handle as usize
+    }
+
     /// Reboot the node with a new configuration.
     pub fn reboot(&mut self, config: &NodeConfig) {
         unsafe {
@@ -761,7 +2257,56 @@ impl OwnedFirmwareNode {
         }
     }
 
+    /// Release this node's thread (or fiber), firmware objects and heap
+    /// until it is next stepped, rebooted, snapshotted or woken.
+    ///
+    /// The state is kept as a snapshot, or only the files are kept if the
+    /// last step yielded `PowerOff`; waking then powers the node back on.
+    /// Returns false if the node already hibernates.
+    pub fn hibernate(&mut self) -> bool {
+        unsafe { (self.dll.sim_hibernate)(self.handle) == 0 }
+    }
+
+    /// Rebuild a hibernated node now rather than at its next step. Returns
+    /// false if the node does not hibernate.
+    pub fn wake(&mut self) -> bool {
+        unsafe { (self.dll.sim_wake)(self.handle) == 0 }
+    }
+
+    /// True while the node hibernates.
+    pub fn is_hibernating(&self) -> bool {
+        unsafe { (self.dll.sim_is_hibernating)(self.handle) != 0 }
+    }
+
+    /// When the node next wants a step, without stepping (or waking) it.
+    /// A coordinator can keep these in one event queue and leave nodes
+    /// with nothing due unstepped.
+    pub fn peek_next_wake(&self) -> NextWake {
+        let mut pending: i32 = 0;
+        let wake_millis = unsafe { (self.dll.sim_peek_next_wake)(self.handle, &mut pending) };
+        NextWake {
+            wake_millis,
+            inputs_pending: pending != 0,
+        }
+    }
+
+    /// Capture this node's state (waits for a running step to finish).
+    pub fn snapshot(&mut self) -> Snapshot<'a> {
+        self.dll.run_snapshot(self.handle)
+    }
+
+    /// Put this node back into `snapshot`, including its config.
+    ///
+    /// # Panics
+    ///
+    /// Panics if the snapshot was taken by a different `FirmwareDll`.
+    pub fn restore(&mut self, snapshot: &Snapshot<'_>) -> Result<(), DllError> {
+        self.dll.run_restore(self.handle, snapshot)
+    }
+
     /// Begin an async simulation step.
+    ///
+    /// Call `step_wait()` to get the result.
     pub fn step_begin(&mut self, sim_millis: u64, sim_rtc_secs: u32) {
         unsafe {
             (self.dll.sim_step_begin)(self.handle, sim_millis, sim_rtc_secs);
@@ -769,12 +2314,14 @@ impl OwnedFirmwareNode {
     }
 
     /// Wait for an async step to complete.
-    pub fn step_wait(&mut self) -> StepResult {
+    pub fn step_wait(&mut self) -> StepResult<'_> {
         unsafe { (self.dll.sim_step_wait)(self.handle) }
     }
 
     /// Perform a synchronous simulation step.
-    pub fn step(&mut self, sim_millis: u64, sim_rtc_secs: u32) -> StepResult {
+    ///
+    /// This combines `step_begin()` and `step_wait()`.
+    pub fn step(&mut self, sim_millis: u64, sim_rtc_secs: u32) -> StepResult<'_> {
         unsafe { (self.dll.sim_step)(self.handle, sim_millis, sim_rtc_secs) }
     }
 
@@ -785,6 +2332,20 @@ impl OwnedFirmwareNode {
         }
     }
 
+    /// Set the callback that receives this node's log output in
+    /// `LogMode::Stream` (`None` discards it). Kept across reboots.
+    pub fn set_log_sink(&mut self, sink: Option<LogSink>) {
+        self.dll
+            .swap_log_sink(self.handle, &mut self.log_sink, sink);
+    }
+
+    /// Append serial TX output that did not fit in the last step result
+    /// (`StepResult::serial_tx_pending`) to `out`. Returns the number of
+    /// bytes appended.
+    pub fn collect_serial_tx(&mut self, out: &mut Vec<u8>) -> usize {
+        self.dll.run_collect_serial_tx(self.handle, out)
+    }
+
     /// Inject received serial data.
     pub fn inject_serial_rx(&mut self, data: &[u8]) {
         unsafe {
@@ -792,223 +2353,1473 @@ impl OwnedFirmwareNode {
         }
     }
 
-    /// Notify the firmware that a radio TX completed.
-    pub fn notify_tx_complete(&mut self) {
+    /// Inject a serial frame (for frame-based interfaces like companion).
+    pub fn inject_serial_frame(&mut self, data: &[u8]) {
         unsafe {
-            (self.dll.sim_notify_tx_complete)(self.handle);
+            (self.dll.sim_inject_serial_frame)(self.handle, data.as_ptr(), data.len());
         }
     }
 
-    /// Notify the radio of a state change.
-    pub fn notify_state_change(&mut self, state_version: u32) {
-        unsafe {
-            (self.dll.sim_notify_state_change)(self.handle, state_version);
+    /// Collect a transmitted serial frame (for frame-based interfaces like companion).
+    /// Returns Some(frame_data) if a frame was available, None otherwise.
+    pub fn collect_serial_frame(&mut self) -> Option<Vec<u8>> {
+        let mut buffer = vec![0u8; MAX_SERIAL_FRAME];
+        let len = unsafe {
+            (self.dll.sim_collect_serial_frame)(self.handle, buffer.as_mut_ptr(), buffer.len())
+        };
+        if len > 0 {
+            buffer.truncate(len);
+            Some(buffer)
+        } else {
+            None
         }
     }
-}
 
-impl Drop for OwnedFirmwareNode {
-    fn drop(&mut self) {
-        unsafe {
-            (self.dll.sim_destroy)(self.handle);
-        }
+    /// Inject several serial frames with one FFI call (frame-based
+    /// interfaces like companion). Frames are queued in order until one is
+    /// empty, longer than `MAX_SERIAL_FRAME` or does not fit; returns the
+    /// number queued.
+    pub fn inject_serial_frames(&mut self, frames: &[&[u8]]) -> usize {
+        self.dll.run_inject_serial_frames(self.handle, frames)
     }
-}
 
-// SAFETY: OwnedFirmwareNode can be sent between threads as long as only one thread
-// accesses it at a time (which is enforced by &mut self on all methods).
-unsafe impl Send for OwnedFirmwareNode {}
+    /// Collect every pending transmitted frame. Frame bytes are appended to
+    /// `data` back to back and located by the spans appended to `spans`.
+    /// Returns the number of frames collected; check
+    /// `StepResult::serial_frames_pending` to skip the call when there are none.
+    pub fn collect_serial_frames(
+        &mut self,
+        data: &mut Vec<u8>,
+        spans: &mut Vec<FrameSpan>,
+    ) -> usize {
+        self.dll.run_collect_serial_frames(self.handle, data, spans)
+    }
 
-// ============================================================================
+    /// Queue a CLI command line (repeater and room server), without a line
+    /// terminator. Queued lines run at the start of the next step, several
+    /// per step; each reply is collected with `collect_cli_replies()` instead
+    /// of appearing in the serial output, which only shows the exchange when
+    /// `echo` is set. Returns false if the line is longer than
+    /// `MAX_CLI_LINE`, the queue is full or the firmware has no CLI.
+    pub fn inject_cli_line(&mut self, line: &str, echo: bool) -> bool {
+        self.dll.run_inject_cli_line(self.handle, line, echo)
+    }
+
+    /// Append the replies to the CLI lines run so far to `out`, one per
+    /// line and in order (empty for a command without a reply). Returns the
+    /// number appended; `StepResult::serial_frames_pending` counts them.
+    pub fn collect_cli_replies(&mut self, out: &mut Vec<String>) -> usize {
+        self.dll.run_collect_cli_replies(self.handle, out)
+    }
+
+    /// Notify that a radio transmission completed.
+    pub fn notify_tx_complete(&mut self) {
+        unsafe {
+            (self.dll.sim_notify_tx_complete)(self.handle);
+        }
+    }
+
+    /// Notify the radio of a state change (coordinator-driven state version update).
+    /// This is used to synchronize radio state between the coordinator and the DLL.
+    pub fn notify_state_change(&mut self, state_version: u32) {
+        unsafe {
+            (self.dll.sim_notify_state_change)(self.handle, state_version);
+        }
+    }
+
+    /// Write a file to the node's filesystem.
+    pub fn fs_write(&mut self, path: &str, data: &[u8]) -> Result<(), DllError> {
+        let c_path = CString::new(path).map_err(|_| DllError::InvalidPath(path.to_string()))?;
+        let result = unsafe {
+            (self.dll.sim_fs_write)(self.handle, c_path.as_ptr(), data.as_ptr(), data.len())
+        };
+        if result < 0 {
+            Err(DllError::FilesystemError(result))
+        } else {
+            Ok(())
+        }
+    }
+
+    /// Read a file from the node's filesystem.
+    pub fn fs_read(&mut self, path: &str, max_len: usize) -> Result<Vec<u8>, DllError> {
+        let c_path = CString::new(path).map_err(|_| DllError::InvalidPath(path.to_string()))?;
+        let mut buffer = vec![0u8; max_len];
+        let result = unsafe {
+            (self.dll.sim_fs_read)(self.handle, c_path.as_ptr(), buffer.as_mut_ptr(), max_len)
+        };
+        if result < 0 {
+            Err(DllError::FilesystemError(result))
+        } else {
+            buffer.truncate(result as usize);
+            Ok(buffer)
+        }
+    }
+
+    /// Check if a file exists on the node's filesystem.
+    pub fn fs_exists(&self, path: &str) -> Result<bool, DllError> {
+        let c_path = CString::new(path).map_err(|_| DllError::InvalidPath(path.to_string()))?;
+        let result = unsafe { (self.dll.sim_fs_exists)(self.handle, c_path.as_ptr()) };
+        Ok(result != 0)
+    }
+
+    /// Remove a file from the node's filesystem.
+    pub fn fs_remove(&mut self, path: &str) -> Result<(), DllError> {
+        let c_path = CString::new(path).map_err(|_| DllError::InvalidPath(path.to_string()))?;
+        let result = unsafe { (self.dll.sim_fs_remove)(self.handle, c_path.as_ptr()) };
+        if result < 0 {
+            Err(DllError::FilesystemError(result))
+        } else {
+            Ok(())
+        }
+    }
+
+    /// Borrow a file's stored bytes without copying (`None` if it does not
+    /// exist).
+    pub fn fs_view(&self, path: &str) -> Result<Option<&[u8]>, DllError> {
+        self.dll.run_fs_view(self.handle, path)
+    }
+
+    /// Write the node's persistent files (`FirmwareDll::set_fs_dir`) back to
+    /// disk and wait for them.
+    pub fn fs_flush(&mut self) -> Result<(), DllError> {
+        self.dll.run_fs_flush(self.handle)
+    }
+}
+
+impl<'a> Drop for FirmwareNode<'a> {
+    fn drop(&mut self) {
+        unsafe {
+            (self.dll.sim_destroy)(self.handle);
+        }
+    }
+}
+
+// SAFETY: FirmwareNode can be sent between threads as long as only one thread
+// accesses it at a time (which is enforced by &mut self on all methods).
+unsafe impl<'a> Send for FirmwareNode<'a> {}
+
+// ============================================================================
+// OwnedFirmwareNode - Self-contained firmware instance
+// ============================================================================
+
+/// An owned firmware node that can be stored persistently.
+///
+/// Unlike `FirmwareNode` which borrows the DLL, this type owns an Arc
+/// to the DLL, allowing it to be stored in structs without lifetime issues.
+pub struct OwnedFirmwareNode {
+    dll: Arc<FirmwareDll>,
+    handle: SimNodeHandle,
+    log_sink: Option<Box<LogSink>>,
+}
+
+impl OwnedFirmwareNode {
+    /// Create a new owned firmware node.
+    pub fn new(dll: Arc<FirmwareDll>, config: &NodeConfig) -> Result<Self, DllError> {
+        let handle = unsafe { (dll.sim_create)(config) };
+        if handle.is_null() {
+            return Err(DllError::CreateFailed);
+        }
+        Ok(OwnedFirmwareNode {
+            dll,
+            handle,
+            log_sink: None,
+        })
+    }
+
+    /// Create a new owned firmware node whose filesystem starts with the
+    /// files of `image` (see `FirmwareDll::create_node_with_image`).
+    ///
+    /// # Panics
+    ///
+    /// Panics if the image was created by a different `FirmwareDll`.
+    pub fn with_image(
+        dll: Arc<FirmwareDll>,
+        config: &NodeConfig,
+        image: &FsImage<'_>,
+    ) -> Result<Self, DllError> {
+        assert!(
+            std::ptr::eq(image.dll, &*dll),
+            "with_image: image belongs to a different firmware library"
+        );
+        let config = image.apply(config);
+        Self::new(dll, &config)
+    }
+
+    /// Create a new owned firmware node that records its inputs to `path`
+    /// (see `FirmwareDll::create_node_recording`).
+    pub fn recording(
+        dll: Arc<FirmwareDll>,
+        config: &NodeConfig,
+        path: &Path,
+    ) -> Result<Self, DllError> {
+        let c_path = path_cstring(path)?;
+        let mut config = config.clone();
+        config.record_path = c_path.as_ptr() as usize;
+        Self::new(dll, &config)
+    }
+
+    /// Create one owned node per config, booting them in parallel (see
+    /// `FirmwareDll::create_nodes`).
+    pub fn create_batch(
+        dll: Arc<FirmwareDll>,
+        configs: &[NodeConfig],
+    ) -> Result<Vec<Self>, DllError> {
+        let handles = dll.run_create_batch(None, configs)?;
+        Ok(Self::wrap_all(&dll, handles))
+    }
+
+    /// Stamp out owned nodes from a template snapshot (see
+    /// `FirmwareDll::fork_nodes`).
+    ///
+    /// # Panics
+    ///
+    /// Panics if the snapshot was taken by a different `FirmwareDll`.
+    pub fn fork_batch(
+        dll: Arc<FirmwareDll>,
+        snapshot: &Snapshot<'_>,
+        configs: &[NodeConfig],
+    ) -> Result<Vec<Self>, DllError> {
+        let handles = dll.run_create_batch(Some(snapshot), configs)?;
+        Ok(Self::wrap_all(&dll, handles))
+    }
+
+    fn wrap_all(dll: &Arc<FirmwareDll>, handles: Vec<SimNodeHandle>) -> Vec<Self> {
+        handles
+            .into_iter()
+            .map(|handle| OwnedFirmwareNode {
+                dll: Arc::clone(dll),
+                handle,
+                log_sink: None,
+            })
+            .collect()
+    }
+
+    /// Create a new owned firmware node from `snapshot` (see
+    /// `FirmwareDll::fork_node`).
+    ///
+    /// # Panics
+    ///
+    /// Panics if the snapshot was taken by a different `FirmwareDll`.
+    pub fn fork(
+        dll: Arc<FirmwareDll>,
+        snapshot: &Snapshot<'_>,
+        config: Option<&NodeConfig>,
+    ) -> Result<Self, DllError> {
+        let handle = dll.run_fork(snapshot, config)?;
+        Ok(OwnedFirmwareNode {
+            dll,
+            handle,
+            log_sink: None,
+        })
+    }
+
+    /// Step several nodes that share one firmware library with a single FFI
+    /// call and wait for all of them.
+    ///
+    /// Each entry is `(node, sim_millis, sim_rtc_secs)`; the returned results are
+    /// in the same order. Returns an empty vector if `nodes` is empty.
+    ///
+    /// # Panics
+    ///
+    /// Panics if the nodes were loaded from different `FirmwareDll`s.
+    pub fn step_batch<'n>(
+        nodes: &'n mut [(&mut OwnedFirmwareNode, u64, u32)],
+    ) -> Vec<StepResult<'n>> {
+        let dll = match nodes.first() {
+            Some((node, _, _)) => Arc::clone(&node.dll),
+            None => return Vec::new(),
+        };
+        let requests: Vec<StepRequest> = nodes
+            .iter()
+            .map(|(node, sim_millis, sim_rtc_secs)| {
+                assert!(
+                    Arc::ptr_eq(&node.dll, &dll),
+                    "step_batch: nodes belong to different firmware libraries"
+                );
+                StepRequest {
+                    node: node.handle,
+                    sim_millis: *sim_millis,
+                    sim_rtc_secs: *sim_rtc_secs,
+                }
+            })
+            .collect();
+        dll.run_step_batch(&requests)
+    }
+
+    /// Deliver one received packet to several nodes that share one firmware
+    /// library with a single FFI call.
+    ///
+    /// Each entry is `(node, rssi, snr)`. The payload is copied once into a
+    /// buffer shared by all receivers, however many there are.
+    ///
+    /// # Panics
+    ///
+    /// Panics if the nodes were loaded from different `FirmwareDll`s.
+    pub fn inject_radio_rx_batch(
+        receivers: &mut [(&mut OwnedFirmwareNode, f32, f32)],
+        data: &[u8],
+    ) {
+        let dll = match receivers.first() {
+            Some((node, _, _)) => Arc::clone(&node.dll),
+            None => return,
+        };
+        let targets: Vec<RxTarget> = receivers
+            .iter()
+            .map(|(node, rssi, snr)| {
+                assert!(
+                    Arc::ptr_eq(&node.dll, &dll),
+                    "inject_radio_rx_batch: nodes belong to different firmware libraries"
+                );
+                RxTarget {
+                    node: node.handle,
+                    rssi: *rssi,
+                    snr: *snr,
+                }
+            })
+            .collect();
+        dll.run_inject_radio_rx_batch(&targets, data);
+    }
+
+    /// Get the public key of this node.
+    pub fn public_key(&self) -> [u8; PUB_KEY_SIZE] {
+        let mut key = [0u8; PUB_KEY_SIZE];
+        unsafe {
+            (self.dll.sim_get_public_key)(self.handle, key.as_mut_ptr());
+        }
+        key
+    }
+
+    /// Counters of this node's heap (all zero unless created with
+    /// `NodeConfig::with_node_heap()`).
+    pub fn heap_stats(&self) -> HeapStats {
+        self.dll.run_heap_stats(self.handle)
+    }
+
+    /// How this node's step handoffs were satisfied (spinning or sleeping).
+    pub fn handoff_stats(&self) -> HandoffStats {
+        self.dll.run_handoff_stats(self.handle)
+    }
+
+    /// Runtime counters of this node: steps, CPU time, radio and serial.
+    pub fn stats(&self) -> NodeStats {
+        self.dll.run_stats(self.handle)
+    }
+
+    /// Identifies this node in `FirmwareTraceEvent::node_id()`.
+    pub fn node_id(&self) -> usize {
+        self.handle as usize
+    }
+
+    /// Reboot the node with a new configuration.
+    pub fn reboot(&mut self, config: &NodeConfig) {
+        unsafe {
+            (self.dll.sim_reboot)(self.handle, config);
+        }
+    }
+
+    /// Release this node's thread (or fiber), firmware objects and heap
+    /// until it is next stepped, rebooted, snapshotted or woken.
+    ///
+    /// The state is kept as a snapshot, or only the files are kept if the
+    /// last step yielded `PowerOff`; waking then powers the node back on.
+    /// Returns false if the node already hibernates.
+    pub fn hibernate(&mut self) -> bool {
+        unsafe { (self.dll.sim_hibernate)(self.handle) == 0 }
+    }
+
+    /// Rebuild a hibernated node now rather than at its next step. Returns
+    /// false if the node does not hibernate.
+    pub fn wake(&mut self) -> bool {
+        unsafe { (self.dll.sim_wake)(self.handle) == 0 }
+    }
+
+    /// True while the node hibernates.
+    pub fn is_hibernating(&self) -> bool {
+        unsafe { (self.dll.sim_is_hibernating)(self.handle) != 0 }
+    }
+
+    /// When the node next wants a step, without stepping (or waking) it.
+    /// A coordinator can keep these in one event queue and leave nodes
+    /// with nothing due unstepped.
+    pub fn peek_next_wake(&self) -> NextWake {
+        let mut pending: i32 = 0;
+        let wake_millis = unsafe { (self.dll.sim_peek_next_wake)(self.handle, &mut pending) };
+        NextWake {
+            wake_millis,
+            inputs_pending: pending != 0,
+        }
+    }
+
+    /// Put this node back into `snapshot` (see `FirmwareNode::restore`).
+    ///
+    /// # Panics
+    ///
+    /// Panics if the snapshot was taken by a different `FirmwareDll`.
+    pub fn restore(&mut self, snapshot: &Snapshot<'_>) -> Result<(), DllError> {
+        self.dll.run_restore(self.handle, snapshot)
+    }
+
+    /// Begin an async simulation step.
+    pub fn step_begin(&mut self, sim_millis: u64, sim_rtc_secs: u32) {
+        unsafe {
+            (self.dll.sim_step_begin)(self.handle, sim_millis, sim_rtc_secs);
+        }
+    }
+
+    /// Wait for an async step to complete.
+    pub fn step_wait(&mut self) -> StepResult<'_> {
+        unsafe { (self.dll.sim_step_wait)(self.handle) }
+    }
+
+    /// Perform a synchronous simulation step.
+    pub fn step(&mut self, sim_millis: u64, sim_rtc_secs: u32) -> StepResult<'_> {
+        unsafe { (self.dll.sim_step)(self.handle, sim_millis, sim_rtc_secs) }
+    }
+
+    /// Inject a received radio packet.
+    pub fn inject_radio_rx(&mut self, data: &[u8], rssi: f32, snr: f32) {
+        unsafe {
+            (self.dll.sim_inject_radio_rx)(self.handle, data.as_ptr(), data.len(), rssi, snr);
+        }
+    }
+
+    /// Set the callback that receives this node's log output in
+    /// `LogMode::Stream` (`None` discards it). Kept across reboots.
+    pub fn set_log_sink(&mut self, sink: Option<LogSink>) {
+        self.dll
+            .swap_log_sink(self.handle, &mut self.log_sink, sink);
+    }
+
+    /// Append serial TX output that did not fit in the last step result
+    /// (`StepResult::serial_tx_pending`) to `out`. Returns the number of
+    /// bytes appended.
+    pub fn collect_serial_tx(&mut self, out: &mut Vec<u8>) -> usize {
+        self.dll.run_collect_serial_tx(self.handle, out)
+    }
+
+    /// Inject received serial data.
+    pub fn inject_serial_rx(&mut self, data: &[u8]) {
+        unsafe {
+            (self.dll.sim_inject_serial_rx)(self.handle, data.as_ptr(), data.len());
+        }
+    }
+
+    /// Inject several serial frames with one FFI call (frame-based
+    /// interfaces like companion). Frames are queued in order until one is
+    /// empty, longer than `MAX_SERIAL_FRAME` or does not fit; returns the
+    /// number queued.
+    pub fn inject_serial_frames(&mut self, frames: &[&[u8]]) -> usize {
+        self.dll.run_inject_serial_frames(self.handle, frames)
+    }
+
+    /// Collect every pending transmitted frame. Frame bytes are appended to
+    /// `data` back to back and located by the spans appended to `spans`.
+    /// Returns the number of frames collected; check
+    /// `StepResult::serial_frames_pending` to skip the call when there are none.
+    pub fn collect_serial_frames(
+        &mut self,
+        data: &mut Vec<u8>,
+        spans: &mut Vec<FrameSpan>,
+    ) -> usize {
+        self.dll.run_collect_serial_frames(self.handle, data, spans)
+    }
+
+    /// Queue a CLI command line (repeater and room server), without a line
+    /// terminator. Queued lines run at the start of the next step, several
+    /// per step; each reply is collected with `collect_cli_replies()` instead
+    /// of appearing in the serial output, which only shows the exchange when
+    /// `echo` is set. Returns false if the line is longer than
+    /// `MAX_CLI_LINE`, the queue is full or the firmware has no CLI.
+    pub fn inject_cli_line(&mut self, line: &str, echo: bool) -> bool {
+        self.dll.run_inject_cli_line(self.handle, line, echo)
+    }
+
+    /// Append the replies to the CLI lines run so far to `out`, one per
+    /// line and in order (empty for a command without a reply). Returns the
+    /// number appended; `StepResult::serial_frames_pending` counts them.
+    pub fn collect_cli_replies(&mut self, out: &mut Vec<String>) -> usize {
+        self.dll.run_collect_cli_replies(self.handle, out)
+    }
+
+    /// Notify the firmware that a radio TX completed.
+    pub fn notify_tx_complete(&mut self) {
+        unsafe {
+            (self.dll.sim_notify_tx_complete)(self.handle);
+        }
+    }
+
+    /// Notify the radio of a state change.
+    pub fn notify_state_change(&mut self, state_version: u32) {
+        unsafe {
+            (self.dll.sim_notify_state_change)(self.handle, state_version);
+        }
+    }
+
+    /// Borrow a file's stored bytes without copying (`None` if it does not
+    /// exist).
+    pub fn fs_view(&self, path: &str) -> Result<Option<&[u8]>, DllError> {
+        self.dll.run_fs_view(self.handle, path)
+    }
+
+    /// Write the node's persistent files (`FirmwareDll::set_fs_dir`) back to
+    /// disk and wait for them.
+    pub fn fs_flush(&mut self) -> Result<(), DllError> {
+        self.dll.run_fs_flush(self.handle)
+    }
+}
+
+impl Drop for OwnedFirmwareNode {
+    fn drop(&mut self) {
+        unsafe {
+            (self.dll.sim_destroy)(self.handle);
+        }
+    }
+}
+
+// SAFETY: OwnedFirmwareNode can be sent between threads as long as only one thread
+// accesses it at a time (which is enforced by &mut self on all methods).
+unsafe impl Send for OwnedFirmwareNode {}
+
+// ============================================================================
 // Helper Functions
 // ============================================================================
 
-/// Find the path to a firmware DLL.
-///
-/// Searches in:
-/// 1. Current directory
-/// 2. OUT_DIR from build script (embedded at compile time)
-/// 3. target/debug or target/release directories
-fn find_dll_path(firmware_type: FirmwareType) -> Result<PathBuf, DllError> {
-    let dll_name = firmware_type.dll_name();
+/// `path` as a C string for the library.
+fn path_cstring(path: &Path) -> Result<CString, DllError> {
+    let text = path
+        .to_str()
+        .ok_or_else(|| DllError::InvalidPath(path.display().to_string()))?;
+    CString::new(text).map_err(|_| DllError::InvalidPath(text.to_string()))
+}
+
+/// Find the path to a firmware DLL.
+fn find_dll_path(firmware_type: FirmwareType) -> Result<PathBuf, DllError> {
+    find_library_path(firmware_type.dll_name())
+}
+
+/// Find the path to a library built by this crate.
+///
+/// Searches in:
+/// 1. Current directory
+/// 2. OUT_DIR from build script (embedded at compile time)
+/// 3. target/debug or target/release directories
+fn find_library_path(dll_name: &str) -> Result<PathBuf, DllError> {
+    // Check current directory
+    let current_dir = PathBuf::from(dll_name);
+    if current_dir.exists() {
+        return Ok(current_dir);
+    }
+
+    // Check OUT_DIR (set during build)
+    if let Some(out_dir) = option_env!("OUT_DIR") {
+        let out_path = PathBuf::from(out_dir).join(dll_name);
+        if out_path.exists() {
+            return Ok(out_path);
+        }
+    }
+
+    // Check relative to executable
+    if let Ok(exe_path) = std::env::current_exe() {
+        if let Some(exe_dir) = exe_path.parent() {
+            let exe_dll = exe_dir.join(dll_name);
+            if exe_dll.exists() {
+                return Ok(exe_dll);
+            }
+        }
+    }
+
+    // Check target directories
+    for profile in &["debug", "release"] {
+        // Check target/<profile>/build/mcsim-firmware-*/out/
+        let target_dir = PathBuf::from("target").join(profile).join("build");
+
+        if target_dir.exists() {
+            if let Ok(entries) = std::fs::read_dir(&target_dir) {
+                for entry in entries.flatten() {
+                    let path = entry.path();
+                    if path.is_dir() {
+                        if let Some(name) = path.file_name() {
+                            if name.to_string_lossy().starts_with("mcsim-firmware-") {
+                                let out_dll = path.join("out").join(dll_name);
+                                if out_dll.exists() {
+                                    return Ok(out_dll);
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    Err(DllError::NotFound(dll_name.to_string()))
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_node_config_default() {
+        let config = NodeConfig::default();
+        assert_eq!(config.lora_freq, 915.0);
+        assert_eq!(config.lora_sf, 11);
+        assert_eq!(config.rng_seed, 12345);
+        assert_eq!(config.lora_bw, 250.0);
+        assert_eq!(config.lora_cr, 5);
+        assert_eq!(config.lora_tx_power, 20);
+        assert_eq!(config.initial_millis, 0);
+        assert_eq!(config.initial_rtc, DEFAULT_INITIAL_RTC_SECS as u32);
+        assert_eq!(
+            config.spin_detection_threshold,
+            DEFAULT_SPIN_DETECTION_THRESHOLD
+        );
+        assert_eq!(
+            config.idle_loops_before_yield,
+            DEFAULT_IDLE_LOOPS_BEFORE_YIELD
+        );
+        assert_eq!(config.log_spin_detection, 0);
+        assert_eq!(config.log_loop_iterations, 0);
+        assert_eq!(config.execution_mode, ExecutionMode::Thread as u8);
+        assert_eq!(config.continue_after_tx, 0);
+        assert_eq!(config.placement, 0);
+        assert_eq!(config.stack_size_kb, 0);
+        assert_eq!(config.step_budget_loops, 0);
+        assert_eq!(config.step_budget_us, 0);
+        assert_eq!(config.fs_write_back, 0);
+        assert_eq!(config.idle_wake_interval_ms, DEFAULT_IDLE_WAKE_INTERVAL_MS);
+        assert_eq!(config.rx_queue_depth, DEFAULT_RX_QUEUE_DEPTH);
+        assert_eq!(config.log_mode, LogMode::Buffer as u8);
+        assert_eq!(config.discard_serial_tx, 0);
+        assert_eq!(config.serial_frames, 0);
+        assert_eq!(config.skip_idle_steps, 0);
+    }
+
+    #[test]
+    fn test_firmware_simulation_params_default() {
+        let params = FirmwareSimulationParams::default();
+        assert_eq!(
+            params.spin_detection_threshold,
+            DEFAULT_SPIN_DETECTION_THRESHOLD
+        );
+        assert_eq!(
+            params.idle_loops_before_yield,
+            DEFAULT_IDLE_LOOPS_BEFORE_YIELD
+        );
+        assert_eq!(params.log_spin_detection, false);
+        assert_eq!(params.log_loop_iterations, false);
+        assert_eq!(params.initial_rtc_secs, DEFAULT_INITIAL_RTC_SECS);
+    }
+
+    #[test]
+    fn test_node_config_builder() {
+        let config = NodeConfig::default()
+            .with_name("test_node")
+            .with_rng_seed(42)
+            .with_initial_time(1000, 1700000000);
+
+        assert_eq!(config.rng_seed, 42);
+        assert_eq!(config.initial_millis, 1000);
+        assert_eq!(config.initial_rtc, 1700000000);
+    }
+
+    #[test]
+    fn test_node_config_with_name() {
+        let config = NodeConfig::default().with_name("my_node");
+        // Check the name was set (first few bytes should match)
+        assert_eq!(config.node_name[0], b'm' as c_char);
+        assert_eq!(config.node_name[1], b'y' as c_char);
+        assert_eq!(config.node_name[7], 0); // null terminator
+    }
+
+    #[test]
+    fn test_node_config_with_name_truncation() {
+        // Name longer than MAX_NODE_NAME should be truncated
+        let long_name = "this_is_a_very_long_node_name_that_exceeds_the_maximum";
+        let config = NodeConfig::default().with_name(long_name);
+        // Should be truncated and null-terminated
+        assert_eq!(config.node_name[MAX_NODE_NAME - 1], 0);
+    }
+
+    #[test]
+    fn test_node_config_with_keys() {
+        let pub_key = [1u8; 32];
+        let prv_key = [2u8; 64];
+        let config = NodeConfig::default().with_keys(&pub_key, &prv_key);
+
+        assert_eq!(config.public_key, pub_key);
+        assert_eq!(config.private_key, prv_key);
+    }
+
+    #[test]
+    fn test_node_config_with_lora() {
+        let config = NodeConfig::default().with_lora(868.0, 125.0, 12, 8, 14);
+
+        assert_eq!(config.lora_freq, 868.0);
+        assert_eq!(config.lora_bw, 125.0);
+        assert_eq!(config.lora_sf, 12);
+        assert_eq!(config.lora_cr, 8);
+        assert_eq!(config.lora_tx_power, 14);
+    }
+
+    #[test]
+    fn test_firmware_type_dll_names() {
+        #[cfg(target_os = "windows")]
+        {
+            assert_eq!(FirmwareType::Repeater.dll_name(), "meshcore_repeater.dll");
+            assert_eq!(
+                FirmwareType::RoomServer.dll_name(),
+                "meshcore_room_server.dll"
+            );
+            assert_eq!(FirmwareType::Companion.dll_name(), "meshcore_companion.dll");
+        }
+
+        #[cfg(target_os = "linux")]
+        {
+            assert_eq!(FirmwareType::Repeater.dll_name(), "libmeshcore_repeater.so");
+            assert_eq!(
+                FirmwareType::RoomServer.dll_name(),
+                "libmeshcore_room_server.so"
+            );
+            assert_eq!(
+                FirmwareType::Companion.dll_name(),
+                "libmeshcore_companion.so"
+            );
+        }
+
+        #[cfg(target_os = "macos")]
+        {
+            assert_eq!(
+                FirmwareType::Repeater.dll_name(),
+                "libmeshcore_repeater.dylib"
+            );
+            assert_eq!(
+                FirmwareType::RoomServer.dll_name(),
+                "libmeshcore_room_server.dylib"
+            );
+            assert_eq!(
+                FirmwareType::Companion.dll_name(),
+                "libmeshcore_companion.dylib"
+            );
+        }
+    }
+
+    #[test]
+    fn test_yield_reason_values() {
+        // Ensure enum values match C API
+        assert_eq!(YieldReason::Idle as i32, 0);
+        assert_eq!(YieldReason::RadioTxStart as i32, 1);
+        assert_eq!(YieldReason::RadioTxComplete as i32, 2);
+        assert_eq!(YieldReason::Reboot as i32, 3);
+        assert_eq!(YieldReason::PowerOff as i32, 4);
+        assert_eq!(YieldReason::Error as i32, 5);
+        assert_eq!(YieldReason::BudgetExhausted as i32, 6);
+        assert_eq!(YieldReason::SerialBackpressure as i32, 7);
+    }
+
+    #[test]
+    fn test_execution_mode_values() {
+        // Ensure enum values match C API
+        assert_eq!(ExecutionMode::Thread as u8, 0);
+        assert_eq!(ExecutionMode::Fiber as u8, 1);
+
+        let config = NodeConfig::default().with_execution_mode(ExecutionMode::Fiber);
+        assert_eq!(config.execution_mode, 1);
+    }
+
+    #[test]
+    fn test_placement_values() {
+        // Ensure modes match SimPlacementMode
+        let config = NodeConfig::default().with_placement(Placement::Cpu(3));
+        assert_eq!((config.placement, config.placement_target), (1, 3));
+        let config = config.with_placement(Placement::NumaNode(1));
+        assert_eq!((config.placement, config.placement_target), (2, 1));
+        let config = config
+            .with_placement(Placement::Spread)
+            .with_stack_size_kb(256);
+        assert_eq!((config.placement, config.placement_target), (3, 0));
+        assert_eq!(config.stack_size_kb, 256);
+    }
+
+    #[test]
+    fn test_log_mode_values() {
+        // Ensure enum values match C API
+        assert_eq!(LogMode::Buffer as u8, 0);
+        assert_eq!(LogMode::Off as u8, 1);
+        assert_eq!(LogMode::Ring as u8, 2);
+        assert_eq!(LogMode::Stream as u8, 3);
+
+        let config = NodeConfig::default()
+            .with_log_mode(LogMode::Stream)
+            .with_serial_tx_discarded(true);
+        assert_eq!(config.log_mode, 3);
+        assert_eq!(config.discard_serial_tx, 1);
+    }
+
+    #[test]
+    fn test_crypto_cache_config() {
+        assert_eq!(CryptoCacheKind::Verify as i32, 0);
+        assert_eq!(CryptoCacheKind::Ecdh as i32, 1);
+
+        let dll = match FirmwareDll::load(FirmwareType::Repeater) {
+            Ok(dll) => dll,
+            Err(DllError::NotFound(_)) => {
+                println!("Skipping test: DLL not found");
+                return;
+            }
+            Err(e) => panic!("Unexpected error: {}", e),
+        };
+
+        dll.set_crypto_cache(CryptoCacheKind::Verify, 1024);
+        let stats = dll.crypto_cache_stats(CryptoCacheKind::Verify);
+        assert_eq!(stats.capacity, 1024);
+        assert_eq!(stats.hits, 0);
+        assert_eq!(stats.entries, 0);
+
+        dll.set_crypto_cache(CryptoCacheKind::Verify, 0);
+        assert_eq!(dll.crypto_cache_stats(CryptoCacheKind::Verify).capacity, 0);
+
+        // Each kind is configured on its own
+        dll.set_crypto_cache(CryptoCacheKind::Ecdh, 256);
+        assert_eq!(dll.crypto_cache_stats(CryptoCacheKind::Ecdh).capacity, 256);
+        assert_eq!(dll.crypto_cache_stats(CryptoCacheKind::Verify).capacity, 0);
+        dll.set_crypto_cache(CryptoCacheKind::Ecdh, 0);
+    }
+
+    #[test]
+    fn test_airtime_table() {
+        let dll = match FirmwareDll::load(FirmwareType::Repeater) {
+            Ok(dll) => dll,
+            Err(DllError::NotFound(_)) => {
+                println!("Skipping test: DLL not found");
+                return;
+            }
+            Err(e) => panic!("Unexpected error: {}", e),
+        };
+
+        // The shim's default settings (a compile-time preset)
+        let table = dll.airtime_table(250.0, 11, 5);
+        assert_eq!((table[0], table[50], table[255]), (165, 903, 3631));
+        assert!(table.windows(2).all(|w| w[0] <= w[1]));
+
+        // Settings without a preset build the same way
+        let table = dll.airtime_table(62.5, 7, 6);
+        assert!(table[0] > 0 && table[255] > table[0]);
+    }
+
+    #[test]
+    fn test_mesh_tables_match_upstream() {
+        let dll = match FirmwareDll::load(FirmwareType::Repeater) {
+            Ok(dll) => dll,
+            Err(DllError::NotFound(_)) => {
+                println!("Skipping test: DLL not found");
+                return;
+            }
+            Err(e) => panic!("Unexpected error: {}", e),
+        };
+
+        // Each seed picks its own pool sizes, from half to several times
+        // the ring sizes, so runs range from mostly hits to mostly evictions
+        for seed in 1..=32 {
+            assert_eq!(dll.check_mesh_tables(seed, 20_000), None, "seed {}", seed);
+        }
+    }
 
-    // Check current directory
-    let current_dir = PathBuf::from(dll_name);
-    if current_dir.exists() {
-        return Ok(current_dir);
+    #[test]
+    fn test_shared_runtime() {
+        let load = |firmware_type| match FirmwareDll::load(firmware_type) {
+            Ok(dll) => Some(dll),
+            Err(DllError::NotFound(_)) => None,
+            Err(e) => panic!("Unexpected error: {}", e),
+        };
+        let pair = (load(FirmwareType::Repeater), load(FirmwareType::Companion));
+        let (repeater, companion) = match pair {
+            (Some(repeater), Some(companion)) => (repeater, companion),
+            _ => {
+                println!("Skipping test: DLL not found");
+                return;
+            }
+        };
+
+        // Every library attaches to the one runtime, or none does
+        let shared = SharedRuntime::get().is_some();
+        assert_eq!(repeater.shares_runtime(), shared);
+        assert_eq!(companion.shares_runtime(), shared);
+
+        // Fiber nodes of both libraries run on the same pool
+        let config = NodeConfig::default().with_execution_mode(ExecutionMode::Fiber);
+        let mut a = repeater
+            .create_node(&config.clone().with_name("rt-a"))
+            .expect("Failed to create node");
+        let mut b = companion
+            .create_node(&config.with_name("rt-b"))
+            .expect("Failed to create node");
+        for t in [1000, 2000, 3000] {
+            assert_ne!(a.step(t, 1700000001).reason, YieldReason::Error);
+            assert_ne!(b.step(t, 1700000001).reason, YieldReason::Error);
+        }
+
+        assert_eq!(
+            repeater.airtime_table(62.5, 7, 6),
+            companion.airtime_table(62.5, 7, 6)
+        );
     }
 
-    // Check OUT_DIR (set during build)
-    if let Some(out_dir) = option_env!("OUT_DIR") {
-        let out_path = PathBuf::from(out_dir).join(dll_name);
-        if out_path.exists() {
-            return Ok(out_path);
+    #[test]
+    fn test_fs_image_shared_across_nodes() {
+        let dll = match FirmwareDll::load(FirmwareType::Repeater) {
+            Ok(dll) => dll,
+            Err(DllError::NotFound(_)) => {
+                println!("Skipping test: DLL not found");
+                return;
+            }
+            Err(e) => panic!("Unexpected error: {}", e),
+        };
+
+        let mut image = dll.create_fs_image();
+        image.write("/seed.bin", b"base").unwrap();
+        let mut a = dll
+            .create_node_with_image(&NodeConfig::default().with_name("image_a"), &image)
+            .expect("Failed to create node");
+        let mut b = dll
+            .create_node_with_image(&NodeConfig::default().with_name("image_b"), &image)
+            .expect("Failed to create node");
+
+        // Later image writes only reach nodes created afterwards
+        image.write("/seed.bin", b"newer").unwrap();
+        drop(image);
+
+        // A node's own write is private to it
+        a.fs_write("/seed.bin", b"mine").unwrap();
+        assert_eq!(a.fs_read("/seed.bin", 16).unwrap(), b"mine");
+        assert_eq!(b.fs_read("/seed.bin", 16).unwrap(), b"base");
+    }
+
+    #[test]
+    fn test_snapshot_restore_and_fork() {
+        let dll = match FirmwareDll::load(FirmwareType::Repeater) {
+            Ok(dll) => dll,
+            Err(DllError::NotFound(_)) => {
+                println!("Skipping test: DLL not found");
+                return;
+            }
+            Err(e) => panic!("Unexpected error: {}", e),
+        };
+
+        let config = NodeConfig::default().with_name("snap_origin");
+        let mut origin = dll.create_node(&config).expect("Failed to create node");
+        origin.step(1000, 1000);
+        origin.fs_write("/state.bin", b"checkpoint").unwrap();
+        let snapshot = origin.snapshot();
+
+        // Diverge, then go back
+        origin.fs_write("/state.bin", b"diverged").unwrap();
+        origin.step(2000, 1001);
+        origin.restore(&snapshot).unwrap();
+        assert_eq!(origin.fs_read("/state.bin", 32).unwrap(), b"checkpoint");
+
+        let fork_config = NodeConfig::default().with_name("snap_fork");
+        let mut fork = dll
+            .fork_node(&snapshot, Some(&fork_config))
+            .expect("Failed to fork node");
+        drop(snapshot);
+        assert_eq!(fork.fs_read("/state.bin", 32).unwrap(), b"checkpoint");
+
+        // Forks copy a shared file only when they change it
+        fork.fs_write("/state.bin", b"variant").unwrap();
+        assert_eq!(origin.fs_read("/state.bin", 32).unwrap(), b"checkpoint");
+        let result = fork.step(2000, 1001);
+        assert!(result.error_message().is_none());
+    }
+
+    #[test]
+    fn test_peek_next_wake() {
+        let dll = match FirmwareDll::load(FirmwareType::Repeater) {
+            Ok(dll) => dll,
+            Err(DllError::NotFound(_)) => {
+                println!("Skipping test: DLL not found");
+                return;
+            }
+            Err(e) => panic!("Unexpected error: {}", e),
+        };
+
+        let config = NodeConfig::default().with_name("peeker");
+        let mut node = dll.create_node(&config).expect("Failed to create node");
+        let result = node.step(1000, 1000);
+        let expected = if result.wake_millis != 0 {
+            result.wake_millis
+        } else {
+            result.current_millis
+        };
+        let peek = node.peek_next_wake();
+        assert_eq!(peek.wake_millis, expected);
+        assert!(!peek.inputs_pending);
+
+        node.inject_radio_rx(&[0u8; 16], -80.0, 5.0);
+        assert!(node.peek_next_wake().inputs_pending);
+    }
+
+    #[test]
+    fn test_hibernate_and_wake() {
+        let dll = match FirmwareDll::load(FirmwareType::Repeater) {
+            Ok(dll) => dll,
+            Err(DllError::NotFound(_)) => {
+                println!("Skipping test: DLL not found");
+                return;
+            }
+            Err(e) => panic!("Unexpected error: {}", e),
+        };
+
+        let config = NodeConfig::default().with_name("sleeper");
+        let mut node = dll.create_node(&config).expect("Failed to create node");
+        node.step(1000, 1000);
+        node.fs_write("/state.bin", b"kept").unwrap();
+
+        assert!(node.hibernate());
+        assert!(node.is_hibernating());
+        assert!(!node.hibernate());
+
+        // Stepping wakes the node with its files intact
+        let result = node.step(2000, 1001);
+        assert!(result.error_message().is_none());
+        assert!(!node.is_hibernating());
+        assert!(!node.wake());
+        assert_eq!(node.fs_read("/state.bin", 16).unwrap(), b"kept");
+    }
+
+    #[test]
+    fn test_fork_nodes_from_template() {
+        let dll = match FirmwareDll::load(FirmwareType::Repeater) {
+            Ok(dll) => dll,
+            Err(DllError::NotFound(_)) => {
+                println!("Skipping test: DLL not found");
+                return;
+            }
+            Err(e) => panic!("Unexpected error: {}", e),
+        };
+
+        let mut template = dll
+            .create_node(&NodeConfig::default().with_name("template"))
+            .expect("Failed to create node");
+        template.fs_write("/shared.bin", b"template").unwrap();
+        let snapshot = template.snapshot();
+        drop(template);
+
+        let configs: Vec<NodeConfig> = (0..8)
+            .map(|i| {
+                let mut config = NodeConfig::default().with_name(&format!("clone_{}", i));
+                config.rng_seed = i + 1;
+                config
+            })
+            .collect();
+        let mut clones = dll.fork_nodes(&snapshot, &configs).expect("Failed to fork");
+        drop(snapshot);
+        assert_eq!(clones.len(), configs.len());
+        for clone in &mut clones {
+            assert_eq!(clone.fs_read("/shared.bin", 16).unwrap(), b"template");
         }
+
+        let fresh = dll.create_nodes(&configs).expect("Failed to create nodes");
+        assert_eq!(fresh.len(), configs.len());
+        assert!(!fresh[0].fs_exists("/shared.bin").unwrap());
     }
 
-    // Check relative to executable
-    if let Ok(exe_path) = std::env::current_exe() {
-        if let Some(exe_dir) = exe_path.parent() {
-            let exe_dll = exe_dir.join(dll_name);
-            if exe_dll.exists() {
-                return Ok(exe_dll);
+    #[test]
+    fn test_fs_dir_persists_across_nodes() {
+        let dll = match FirmwareDll::load(FirmwareType::Repeater) {
+            Ok(dll) => dll,
+            Err(DllError::NotFound(_)) => {
+                println!("Skipping test: DLL not found");
+                return;
+            }
+            Err(e) => panic!("Unexpected error: {}", e),
+        };
+
+        let dir = std::env::temp_dir().join(format!("mcsim-fs-{}", std::process::id()));
+        std::fs::create_dir_all(&dir).unwrap();
+        let config = NodeConfig::default().with_name("persist_node");
+
+        // The directory is read when a node is created
+        dll.set_fs_dir(Some(&dir)).unwrap();
+        let mut node = dll.create_node(&config).expect("Failed to create node");
+        dll.set_fs_dir(None).unwrap();
+        node.fs_write("/kept.bin", b"persisted").unwrap();
+        assert_eq!(node.fs_view("/kept.bin").unwrap(), Some(&b"persisted"[..]));
+        assert_eq!(node.fs_view("/missing.bin").unwrap(), None);
+        node.fs_flush().unwrap();
+        drop(node);
+        assert!(dir.join("persist_node.simfs").exists());
+
+        dll.set_fs_dir(Some(&dir)).unwrap();
+        let node = dll.create_node(&config).expect("Failed to create node");
+        dll.set_fs_dir(None).unwrap();
+        assert_eq!(node.fs_view("/kept.bin").unwrap(), Some(&b"persisted"[..]));
+        drop(node);
+
+        // Without a directory the node starts empty and cannot flush
+        let mut node = dll.create_node(&config).expect("Failed to create node");
+        assert!(!node.fs_exists("/kept.bin").unwrap());
+        assert!(node.fs_flush().is_err());
+        drop(node);
+
+        std::fs::remove_dir_all(&dir).unwrap();
+    }
+
+    #[test]
+    fn test_fs_write_back() {
+        let dll = match FirmwareDll::load(FirmwareType::Repeater) {
+            Ok(dll) => dll,
+            Err(DllError::NotFound(_)) => {
+                println!("Skipping test: DLL not found");
+                return;
             }
+            Err(e) => panic!("Unexpected error: {}", e),
+        };
+
+        let config = NodeConfig::default()
+            .with_name("write_back")
+            .with_fs_write_back(true);
+        let mut node = dll.create_node(&config).expect("Failed to create node");
+        node.step(1000, 1700000000);
+        let before = node.stats();
+
+        // Each command saves the prefs; all three run in one step
+        for name in ["first", "second", "third"] {
+            assert!(node.inject_cli_line(&format!("set name {}", name), false));
         }
+        node.step(2000, 1700000001);
+
+        let stats = node.stats();
+        let written = stats.fs_bytes_written - before.fs_bytes_written;
+        let committed = stats.fs_bytes_committed - before.fs_bytes_committed;
+        assert!(committed > 0);
+        assert!(committed < written);
+        assert!(stats.fs_rewrites_coalesced > before.fs_rewrites_coalesced);
     }
 
-    // Check target directories
-    for profile in &["debug", "release"] {
-        // Check target/<profile>/build/mcsim-firmware-*/out/
-        let target_dir = PathBuf::from("target")
-            .join(profile)
-            .join("build");
-        
-        if target_dir.exists() {
-            if let Ok(entries) = std::fs::read_dir(&target_dir) {
-                for entry in entries.flatten() {
-                    let path = entry.path();
-                    if path.is_dir() {
-                        if let Some(name) = path.file_name() {
-                            if name.to_string_lossy().starts_with("mcsim-firmware-") {
-                                let out_dll = path.join("out").join(dll_name);
-                                if out_dll.exists() {
-                                    return Ok(out_dll);
-                                }
-                            }
-                        }
-                    }
-                }
+    #[test]
+    fn test_record_and_replay() {
+        let dll = match FirmwareDll::load(FirmwareType::Repeater) {
+            Ok(dll) => dll,
+            Err(DllError::NotFound(_)) => {
+                println!("Skipping test: DLL not found");
+                return;
+            }
+            Err(e) => panic!("Unexpected error: {}", e),
+        };
+
+        let path = std::env::temp_dir().join(format!("mcsim-record-{}.bin", std::process::id()));
+        let config = NodeConfig::default().with_name("recorded_node");
+        let mut node = dll
+            .create_node_recording(&config, &path)
+            .expect("Failed to create node");
+        node.fs_write("/seed.bin", b"seed").unwrap();
+        for i in 1..=50u64 {
+            if i % 10 == 0 {
+                node.inject_radio_rx(&[i as u8; 24], -90.0, 4.5);
+            }
+            let result = node.step(i * 100, 1000 + i as u32 / 10);
+            if result.reason == YieldReason::RadioTxStart {
+                node.notify_tx_complete();
             }
         }
+        drop(node);
+
+        let replay = dll.replay(&path).expect("Failed to replay");
+        assert_eq!(replay.steps, 50);
+        assert!(replay.matched(), "replay diverged: {:?}", replay);
+        assert_eq!(replay.first_divergence, u64::MAX);
+
+        std::fs::remove_file(&path).unwrap();
+        assert!(matches!(
+            dll.replay(&path),
+            Err(DllError::InvalidRecording(_))
+        ));
     }
 
-    Err(DllError::NotFound(dll_name.to_string()))
-}
+    #[test]
+    fn test_node_heap_stats() {
+        let dll = match FirmwareDll::load(FirmwareType::Repeater) {
+            Ok(dll) => dll,
+            Err(DllError::NotFound(_)) => {
+                println!("Skipping test: DLL not found");
+                return;
+            }
+            Err(e) => panic!("Unexpected error: {}", e),
+        };
 
-#[cfg(test)]
-mod tests {
-    use super::*;
+        let config = NodeConfig::default().with_name("heap_off");
+        let node = dll.create_node(&config).expect("Failed to create node");
+        assert_eq!(node.heap_stats(), HeapStats::default());
+        drop(node);
+
+        let config = NodeConfig::default()
+            .with_name("heap_on")
+            .with_node_heap(true);
+        let mut node = dll.create_node(&config).expect("Failed to create node");
+        node.step(1000, 1700000001);
+        let stats = node.heap_stats();
+        assert!(stats.allocations > 0);
+        assert!(stats.live_bytes > 0);
+        assert!(stats.peak_bytes >= stats.live_bytes);
+        assert!(stats.reserved_bytes >= stats.live_bytes);
+        assert_eq!(stats.resets, 0);
+
+        // A reboot reclaims the heap and setup() fills it again
+        node.reboot(&config);
+        node.step(2000, 1700000002);
+        let stats = node.heap_stats();
+        assert_eq!(stats.resets, 1);
+        assert!(stats.live_bytes > 0);
+    }
 
     #[test]
-    fn test_node_config_default() {
-        let config = NodeConfig::default();
-        assert_eq!(config.lora_freq, 915.0);
-        assert_eq!(config.lora_sf, 11);
-        assert_eq!(config.rng_seed, 12345);
-        assert_eq!(config.lora_bw, 250.0);
-        assert_eq!(config.lora_cr, 5);
-        assert_eq!(config.lora_tx_power, 20);
-        assert_eq!(config.initial_millis, 0);
-        assert_eq!(config.initial_rtc, DEFAULT_INITIAL_RTC_SECS as u32);
-        assert_eq!(config.spin_detection_threshold, DEFAULT_SPIN_DETECTION_THRESHOLD);
-        assert_eq!(config.idle_loops_before_yield, DEFAULT_IDLE_LOOPS_BEFORE_YIELD);
-        assert_eq!(config.log_spin_detection, 0);
-        assert_eq!(config.log_loop_iterations, 0);
+    fn test_idle_step_skipping() {
+        let dll = match FirmwareDll::load(FirmwareType::Repeater) {
+            Ok(dll) => dll,
+            Err(DllError::NotFound(_)) => {
+                println!("Skipping test: DLL not found");
+                return;
+            }
+            Err(e) => panic!("Unexpected error: {}", e),
+        };
+
+        let config = NodeConfig::default()
+            .with_name("skip")
+            .with_idle_step_skipping(true);
+        assert_eq!(config.skip_idle_steps, 1);
+        let mut node = dll.create_node(&config).expect("Failed to create node");
+
+        // Settle until the node idles with nothing to do
+        let mut t = 1000;
+        let mut wake = 0;
+        for _ in 0..20 {
+            let result = node.step(t, 1700000001);
+            if result.reason == YieldReason::RadioTxStart {
+                node.notify_tx_complete();
+            } else if result.reason == YieldReason::Idle {
+                wake = result.wake_millis;
+            }
+            t += 10;
+        }
+
+        // A step before the wake time with no new input repeats the idle result
+        let result = node.step(wake - 1, 1700000001);
+        assert_eq!(result.reason, YieldReason::Idle);
+        assert_eq!(result.wake_millis, wake);
     }
 
     #[test]
-    fn test_firmware_simulation_params_default() {
-        let params = FirmwareSimulationParams::default();
-        assert_eq!(params.spin_detection_threshold, DEFAULT_SPIN_DETECTION_THRESHOLD);
-        assert_eq!(params.idle_loops_before_yield, DEFAULT_IDLE_LOOPS_BEFORE_YIELD);
-        assert_eq!(params.log_spin_detection, false);
-        assert_eq!(params.log_loop_iterations, false);
-        assert_eq!(params.initial_rtc_secs, DEFAULT_INITIAL_RTC_SECS);
+    fn test_step_events_with_tx_continuation() {
+        let dll = match FirmwareDll::load(FirmwareType::Repeater) {
+            Ok(dll) => dll,
+            Err(DllError::NotFound(_)) => {
+                println!("Skipping test: DLL not found");
+                return;
+            }
+            Err(e) => panic!("Unexpected error: {}", e),
+        };
+
+        let config = NodeConfig::default()
+            .with_name("events")
+            .with_tx_continuation(true);
+        assert_eq!(config.continue_after_tx, 1);
+        let mut node = dll.create_node(&config).expect("Failed to create node");
+
+        let mut t = 1000;
+        for _ in 0..20 {
+            let result = node.step(t, 1700000001);
+            let events = result.events();
+
+            // Serial chunks reassemble the step's serial output
+            let serial: Vec<u8> = events
+                .iter()
+                .filter(|e| e.kind == StepEventKind::SerialTx)
+                .flat_map(|e| e.data().iter().copied())
+                .collect();
+            assert_eq!(serial, result.serial_tx());
+
+            match result.reason {
+                YieldReason::RadioTxStart => {
+                    let tx = events
+                        .iter()
+                        .find(|e| e.kind == StepEventKind::RadioTx)
+                        .unwrap();
+                    assert_eq!(tx.data(), result.radio_tx());
+                    assert_eq!(tx.airtime_ms, result.radio_tx_airtime_ms);
+                    let last = events.last().unwrap();
+                    assert_eq!(last.kind, StepEventKind::Wake);
+                    assert_eq!(last.wake_millis, result.wake_millis);
+                    node.notify_tx_complete();
+                }
+                YieldReason::Idle => {
+                    assert_eq!(events.last().unwrap().kind, StepEventKind::Wake);
+                }
+                _ => {}
+            }
+            t += 10;
+        }
+    }
+
+    #[test]
+    fn test_step_budget() {
+        let dll = match FirmwareDll::load(FirmwareType::Repeater) {
+            Ok(dll) => dll,
+            Err(DllError::NotFound(_)) => {
+                println!("Skipping test: DLL not found");
+                return;
+            }
+            Err(e) => panic!("Unexpected error: {}", e),
+        };
+
+        let config = NodeConfig::default()
+            .with_name("budget")
+            .with_step_budget(1, 0);
+        assert_eq!(config.step_budget_loops, 1);
+        let mut node = dll.create_node(&config).expect("Failed to create node");
+
+        // A loop with output ends the step; a cut step asks to go again now,
+        // and the node still reaches idle
+        let mut t = 1000;
+        let mut idle_steps = 0;
+        for _ in 0..200 {
+            let result = node.step(t, 1700000001);
+            match result.reason {
+                YieldReason::BudgetExhausted => {
+                    assert_eq!(result.wake_millis, t);
+                    assert_eq!(result.events().last().unwrap().kind, StepEventKind::Wake);
+                }
+                YieldReason::RadioTxStart => {
+                    node.notify_tx_complete();
+                    t += 10;
+                }
+                YieldReason::Idle => {
+                    idle_steps += 1;
+                    t += 10;
+                }
+                _ => t += 10,
+            }
+        }
+        assert!(idle_steps > 0);
+
+        // The idle check may run one loop past the budget
+        let stats = node.stats();
+        assert!(stats.max_loop_iterations <= 2);
     }
 
     #[test]
-    fn test_node_config_builder() {
-        let config = NodeConfig::default()
-            .with_name("test_node")
-            .with_rng_seed(42)
-            .with_initial_time(1000, 1700000000);
+    fn test_step_handoff_stats() {
+        let dll = match FirmwareDll::load(FirmwareType::Repeater) {
+            Ok(dll) => dll,
+            Err(DllError::NotFound(_)) => {
+                println!("Skipping test: DLL not found");
+                return;
+            }
+            Err(e) => panic!("Unexpected error: {}", e),
+        };
 
-        assert_eq!(config.rng_seed, 42);
-        assert_eq!(config.initial_millis, 1000);
-        assert_eq!(config.initial_rtc, 1700000000);
-    }
+        let config = NodeConfig::default().with_name("handoff");
+        let mut node = dll.create_node(&config).expect("Failed to create node");
+        assert_eq!(node.handoff_stats(), HandoffStats::default());
 
-    #[test]
-    fn test_node_config_with_name() {
-        let config = NodeConfig::default().with_name("my_node");
-        // Check the name was set (first few bytes should match)
-        assert_eq!(config.node_name[0], b'm' as c_char);
-        assert_eq!(config.node_name[1], b'y' as c_char);
-        assert_eq!(config.node_name[7], 0); // null terminator
+        for i in 1..=5u64 {
+            node.step(i * 1000, 1700000000 + i as u32);
+        }
+        let stats = node.handoff_stats();
+        assert_eq!(
+            stats.coordinator_spin_waits + stats.coordinator_parked_waits,
+            5
+        );
+        assert_eq!(stats.node_spin_waits + stats.node_parked_waits, 5);
     }
 
     #[test]
-    fn test_node_config_with_name_truncation() {
-        // Name longer than MAX_NODE_NAME should be truncated
-        let long_name = "this_is_a_very_long_node_name_that_exceeds_the_maximum";
-        let config = NodeConfig::default().with_name(long_name);
-        // Should be truncated and null-terminated
-        assert_eq!(config.node_name[MAX_NODE_NAME - 1], 0);
-    }
+    fn test_firmware_trace() {
+        let dll = match FirmwareDll::load(FirmwareType::Repeater) {
+            Ok(dll) => dll,
+            Err(DllError::NotFound(_)) => {
+                println!("Skipping test: DLL not found");
+                return;
+            }
+            Err(e) => panic!("Unexpected error: {}", e),
+        };
 
-    #[test]
-    fn test_node_config_with_keys() {
-        let pub_key = [1u8; 32];
-        let prv_key = [2u8; 64];
-        let config = NodeConfig::default().with_keys(&pub_key, &prv_key);
+        let config = NodeConfig::default().with_name("trace");
+        let mut node = dll.create_node(&config).expect("Failed to create node");
 
-        assert_eq!(config.public_key, pub_key);
-        assert_eq!(config.private_key, prv_key);
+        dll.enable_trace(TRACE_ALL, 0);
+        for i in 1..=3u64 {
+            node.step(i * 1000, 1700000000 + i as u32);
+        }
+        dll.enable_trace(0, 0);
+
+        let mut events = Vec::new();
+        dll.drain_trace(&mut events);
+        let ours: Vec<_> = events
+            .iter()
+            .filter(|e| e.node_id() == Some(node.node_id()))
+            .collect();
+        let steps: Vec<_> = ours.iter().filter(|e| e.name() == "step").collect();
+        assert_eq!(steps.len(), 3);
+        assert_eq!(steps[0].category, TRACE_STEP);
+        assert_eq!(steps[0].sim_millis, 1000);
+        assert!(ours.iter().any(|e| e.name() == "loop"));
     }
 
     #[test]
-    fn test_node_config_with_lora() {
-        let config = NodeConfig::default().with_lora(868.0, 125.0, 12, 8, 14);
+    fn test_node_stats() {
+        let dll = match FirmwareDll::load(FirmwareType::Repeater) {
+            Ok(dll) => dll,
+            Err(DllError::NotFound(_)) => {
+                println!("Skipping test: DLL not found");
+                return;
+            }
+            Err(e) => panic!("Unexpected error: {}", e),
+        };
 
-        assert_eq!(config.lora_freq, 868.0);
-        assert_eq!(config.lora_bw, 125.0);
-        assert_eq!(config.lora_sf, 12);
-        assert_eq!(config.lora_cr, 8);
-        assert_eq!(config.lora_tx_power, 14);
-    }
+        let config = NodeConfig::default()
+            .with_name("stats")
+            .with_rx_queue_depth(2);
+        let mut node = dll.create_node(&config).expect("Failed to create node");
+        assert_eq!(node.stats().steps, 0);
+        assert_eq!(node.stats().step_cpu_mean_ns(), 0);
 
-    #[test]
-    fn test_firmware_type_dll_names() {
-        #[cfg(target_os = "windows")]
-        {
-            assert_eq!(FirmwareType::Repeater.dll_name(), "meshcore_repeater.dll");
-            assert_eq!(
-                FirmwareType::RoomServer.dll_name(),
-                "meshcore_room_server.dll"
-            );
-            assert_eq!(FirmwareType::Companion.dll_name(), "meshcore_companion.dll");
+        let packet = [0x01u8, 0x02, 0x03];
+        for _ in 0..3 {
+            node.inject_radio_rx(&packet, -80.0, 5.0);
         }
-
-        #[cfg(target_os = "linux")]
-        {
-            assert_eq!(FirmwareType::Repeater.dll_name(), "libmeshcore_repeater.so");
-            assert_eq!(
-                FirmwareType::RoomServer.dll_name(),
-                "libmeshcore_room_server.so"
-            );
-            assert_eq!(FirmwareType::Companion.dll_name(), "libmeshcore_companion.so");
+        node.inject_serial_rx(b"ver\r");
+        for i in 1..=4u64 {
+            node.step(i * 1000, 1700000000 + i as u32);
         }
 
-        #[cfg(target_os = "macos")]
-        {
-            assert_eq!(FirmwareType::Repeater.dll_name(), "libmeshcore_repeater.dylib");
-            assert_eq!(
-                FirmwareType::RoomServer.dll_name(),
-                "libmeshcore_room_server.dylib"
-            );
-            assert_eq!(FirmwareType::Companion.dll_name(), "libmeshcore_companion.dylib");
-        }
+        let stats = node.stats();
+        assert_eq!(stats.steps, 4);
+        assert!(stats.loop_iterations >= 4);
+        assert!(stats.max_loop_iterations >= 1);
+        assert_eq!(stats.rx_dropped, 1);
+        assert_eq!(stats.rx_queue_high_water, 2);
+        assert_eq!(stats.serial_rx_bytes, 4);
+        assert!(stats.serial_tx_bytes > 0);
+        assert_eq!(stats.step_cpu_histogram.iter().sum::<u64>(), 4);
+        assert!(stats.step_cpu_min_ns <= stats.step_cpu_mean_ns());
+        assert!(stats.step_cpu_mean_ns() <= stats.step_cpu_max_ns);
+
+        // Operation counters only see the firmware's own file access
+        node.fs_write("/stats/probe", b"probe").unwrap();
+        assert_eq!(node.fs_read("/stats/probe", 16).unwrap(), b"probe");
+        let after = node.stats();
+        assert_eq!(after.fs_opens, stats.fs_opens);
+        assert_eq!(after.fs_bytes_written, stats.fs_bytes_written);
+        assert_eq!(after.fs_bytes_read, stats.fs_bytes_read);
     }
 
     #[test]
-    fn test_yield_reason_values() {
-        // Ensure enum values match C API
-        assert_eq!(YieldReason::Idle as i32, 0);
-        assert_eq!(YieldReason::RadioTxStart as i32, 1);
-        assert_eq!(YieldReason::RadioTxComplete as i32, 2);
-        assert_eq!(YieldReason::Reboot as i32, 3);
-        assert_eq!(YieldReason::PowerOff as i32, 4);
-        assert_eq!(YieldReason::Error as i32, 5);
+    fn test_frame_span_get() {
+        let buffer = [1u8, 2, 3, 4, 5];
+        let span = FrameSpan { offset: 1, len: 3 };
+        assert_eq!(span.get(&buffer), &[2, 3, 4]);
+        assert!(FrameSpan { offset: 5, len: 0 }.get(&buffer).is_empty());
     }
 
     #[test]
@@ -1154,13 +3965,102 @@ mod tests {
         let mut time_ms = 0u64;
         for i in 0..10 {
             let result = node.step(time_ms, 1700000000 + (time_ms / 1000) as u32);
-            println!("Step {}: reason={:?}, wake_at={}", i, result.reason, result.wake_millis);
+            println!(
+                "Step {}: reason={:?}, wake_at={}",
+                i, result.reason, result.wake_millis
+            );
 
             // Advance time to wake time or by 1 second
             time_ms = result.wake_millis.max(time_ms + 1000);
         }
     }
 
+    #[test]
+    fn test_fiber_node_step_sequence() {
+        let dll = match FirmwareDll::load(FirmwareType::Repeater) {
+            Ok(dll) => dll,
+            Err(DllError::NotFound(_)) => {
+                println!("Skipping test: DLL not found");
+                return;
+            }
+            Err(e) => panic!("Unexpected error: {}", e),
+        };
+
+        let mut nodes: Vec<_> = (0..4)
+            .map(|i| {
+                let config = NodeConfig::default()
+                    .with_name(&format!("fiber_{}", i))
+                    .with_rng_seed(100 + i)
+                    .with_execution_mode(ExecutionMode::Fiber);
+                dll.create_node(&config).expect("Failed to create node")
+            })
+            .collect();
+
+        // Overlap steps across nodes so several fibers are in flight at once
+        let mut time_ms = 0u64;
+        for _ in 0..10 {
+            for node in nodes.iter_mut() {
+                node.step_begin(time_ms, 1700000000 + (time_ms / 1000) as u32);
+            }
+            for node in nodes.iter_mut() {
+                let result = node.step_wait();
+                assert!(result.current_millis >= time_ms);
+                if result.reason == YieldReason::RadioTxStart {
+                    node.notify_tx_complete();
+                }
+            }
+            time_ms += 1000;
+        }
+    }
+
+    #[test]
+    fn test_step_batch_mixed_modes() {
+        let dll = match FirmwareDll::load(FirmwareType::Repeater) {
+            Ok(dll) => dll,
+            Err(DllError::NotFound(_)) => {
+                println!("Skipping test: DLL not found");
+                return;
+            }
+            Err(e) => panic!("Unexpected error: {}", e),
+        };
+
+        let mut nodes: Vec<_> = (0..4)
+            .map(|i| {
+                let mode = if i % 2 == 0 {
+                    ExecutionMode::Fiber
+                } else {
+                    ExecutionMode::Thread
+                };
+                let config = NodeConfig::default()
+                    .with_name(&format!("batch_{}", i))
+                    .with_rng_seed(200 + i)
+                    .with_execution_mode(mode);
+                dll.create_node(&config).expect("Failed to create node")
+            })
+            .collect();
+
+        let mut time_ms = 0u64;
+        for _ in 0..10 {
+            let rtc = 1700000000 + (time_ms / 1000) as u32;
+            let mut batch: Vec<_> = nodes.iter_mut().map(|n| (n, time_ms, rtc)).collect();
+            let results = dll.step_batch(&mut batch);
+            assert_eq!(results.len(), 4);
+            let transmitting: Vec<bool> = results
+                .iter()
+                .map(|result| {
+                    assert!(result.current_millis >= time_ms);
+                    result.reason == YieldReason::RadioTxStart
+                })
+                .collect();
+            for (node, tx) in nodes.iter_mut().zip(transmitting) {
+                if tx {
+                    node.notify_tx_complete();
+                }
+            }
+            time_ms += 1000;
+        }
+    }
+
     #[test]
     fn test_node_async_step() {
         let dll = match FirmwareDll::load(FirmwareType::Repeater) {
@@ -1205,6 +4105,194 @@ mod tests {
         println!("After injection: {:?}", result);
     }
 
+    #[test]
+    fn test_node_radio_injection_batch() {
+        let dll = match FirmwareDll::load(FirmwareType::Repeater) {
+            Ok(dll) => dll,
+            Err(DllError::NotFound(_)) => {
+                println!("Skipping test: DLL not found");
+                return;
+            }
+            Err(e) => panic!("Unexpected error: {}", e),
+        };
+
+        let mut nodes: Vec<_> = (0..3)
+            .map(|i| {
+                let config = NodeConfig::default()
+                    .with_name(&format!("rx_batch_{}", i))
+                    .with_rx_queue_depth(2);
+                dll.create_node(&config).expect("Failed to create node")
+            })
+            .collect();
+
+        // More packets than the queues hold; the overflow is dropped
+        let fake_packet = [0x01, 0x02, 0x03, 0x04, 0x05];
+        for k in 0..4 {
+            let mut receivers: Vec<_> = nodes
+                .iter_mut()
+                .enumerate()
+                .map(|(i, n)| (n, -60.0 - i as f32, 10.0 - k as f32))
+                .collect();
+            dll.inject_radio_rx_batch(&mut receivers, &fake_packet);
+        }
+        dll.inject_radio_rx_batch(&mut [], &fake_packet);
+
+        for node in nodes.iter_mut() {
+            let result = node.step(1000, 1700000000);
+            assert!(result.current_millis >= 1000);
+        }
+    }
+
+    #[test]
+    fn test_node_log_stream() {
+        let dll = match FirmwareDll::load(FirmwareType::Repeater) {
+            Ok(dll) => dll,
+            Err(DllError::NotFound(_)) => {
+                println!("Skipping test: DLL not found");
+                return;
+            }
+            Err(e) => panic!("Unexpected error: {}", e),
+        };
+
+        let config = NodeConfig::default()
+            .with_name("log_stream")
+            .with_log_mode(LogMode::Stream);
+        let mut node = dll.create_node(&config).expect("Failed to create node");
+
+        let streamed = Arc::new(std::sync::Mutex::new(Vec::new()));
+        let sink_buf = Arc::clone(&streamed);
+        node.set_log_sink(Some(Box::new(move |data: &[u8]| {
+            sink_buf.lock().unwrap().extend_from_slice(data);
+        })));
+
+        // The CLI echoes typed characters to Serial
+        node.inject_serial_rx(b"ver\r");
+        let mut time_ms = 1000u64;
+        for _ in 0..5 {
+            let result = node.step(time_ms, 1700000000);
+            assert!(result.log_output().is_empty());
+            time_ms += 1000;
+        }
+        assert!(!streamed.lock().unwrap().is_empty());
+
+        node.set_log_sink(None);
+        node.step(time_ms, 1700000000);
+    }
+
+    #[test]
+    fn test_node_serial_tx_collect() {
+        let dll = match FirmwareDll::load(FirmwareType::Repeater) {
+            Ok(dll) => dll,
+            Err(DllError::NotFound(_)) => {
+                println!("Skipping test: DLL not found");
+                return;
+            }
+            Err(e) => panic!("Unexpected error: {}", e),
+        };
+
+        let config = NodeConfig::default().with_name("serial_collect");
+        let mut node = dll.create_node(&config).expect("Failed to create node");
+
+        node.inject_serial_rx(b"ver\r");
+        let mut time_ms = 1000u64;
+        for _ in 0..5 {
+            let result = node.step(time_ms, 1700000000);
+            assert!(result.serial_tx_len <= MAX_SERIAL_TX);
+            let pending = result.serial_tx_pending;
+
+            // Collecting drains exactly what the result reported as pending
+            let mut rest = Vec::new();
+            assert_eq!(node.collect_serial_tx(&mut rest), pending);
+            assert_eq!(rest.len(), pending);
+            assert_eq!(node.collect_serial_tx(&mut rest), 0);
+            time_ms += 1000;
+        }
+    }
+
+    #[test]
+    fn test_companion_serial_frames() {
+        let dll = match FirmwareDll::load(FirmwareType::Companion) {
+            Ok(dll) => dll,
+            Err(DllError::NotFound(_)) => {
+                println!("Skipping test: DLL not found");
+                return;
+            }
+            Err(e) => panic!("Unexpected error: {}", e),
+        };
+
+        let config = NodeConfig::default()
+            .with_name("frames")
+            .with_serial_frames(true);
+        let mut node = dll.create_node(&config).expect("Failed to create node");
+
+        // CMD_DEVICE_QUERY (22), app target version 3
+        assert_eq!(node.inject_serial_frames(&[&[22, 3]]), 1);
+        // Empty and oversized frames are rejected
+        assert_eq!(node.inject_serial_frames(&[&[]]), 0);
+        let oversized = [0u8; MAX_SERIAL_FRAME + 1];
+        assert_eq!(node.inject_serial_frames(&[&oversized]), 0);
+
+        let mut data = Vec::new();
+        let mut spans = Vec::new();
+        let mut time_ms = 1000u64;
+        for _ in 0..5 {
+            let result = node.step(time_ms, 1700000000);
+            // Frames do not appear in the serial byte stream
+            assert!(!result.serial_tx().contains(&b'>'));
+            let pending = result.serial_frames_pending;
+            assert_eq!(node.collect_serial_frames(&mut data, &mut spans), pending);
+            time_ms += 1000;
+        }
+
+        // RESP_CODE_DEVICE_INFO (13)
+        assert!(!spans.is_empty());
+        assert_eq!(spans[0].get(&data)[0], 13);
+    }
+
+    #[test]
+    fn test_repeater_cli_lines() {
+        let dll = match FirmwareDll::load(FirmwareType::Repeater) {
+            Ok(dll) => dll,
+            Err(DllError::NotFound(_)) => {
+                println!("Skipping test: DLL not found");
+                return;
+            }
+            Err(e) => panic!("Unexpected error: {}", e),
+        };
+
+        let config = NodeConfig::default().with_name("cli");
+        let mut node = dll.create_node(&config).expect("Failed to create node");
+
+        assert!(node.inject_cli_line("get name", false));
+        assert!(node.inject_cli_line("ver", false));
+        assert!(!node.inject_cli_line(&"x".repeat(MAX_CLI_LINE + 1), false));
+
+        // Both lines run in the first step and nothing is echoed
+        let result = node.step(1000, 1700000000);
+        assert!(!result.serial_tx().windows(4).any(|w| w == b"  ->"));
+        assert_eq!(result.serial_frames_pending, 2);
+        let mut replies = Vec::new();
+        assert_eq!(node.collect_cli_replies(&mut replies), 2);
+        assert!(replies[0].contains("cli"));
+
+        // With echo the exchange also appears in the serial output
+        assert!(node.inject_cli_line("get name", true));
+        let result = node.step(2000, 1700000001);
+        let echoed = String::from_utf8_lossy(result.serial_tx()).into_owned();
+        assert!(echoed.contains("get name"));
+        assert!(echoed.contains("  -> "));
+        replies.clear();
+        assert_eq!(node.collect_cli_replies(&mut replies), 1);
+
+        // Companion has no CLI
+        if let Ok(companion) = FirmwareDll::load(FirmwareType::Companion) {
+            let mut node = companion
+                .create_node(&NodeConfig::default())
+                .expect("Failed to create node");
+            assert!(!node.inject_cli_line("ver", false));
+        }
+    }
+
     #[test]
     fn test_node_filesystem() {
         let dll = match FirmwareDll::load(FirmwareType::Repeater) {
@@ -1222,7 +4310,7 @@ mod tests {
         // Write a test file
         let test_data = b"Hello, MeshCore!";
         let write_result = node.fs_write("/test.txt", test_data);
-        
+
         if write_result.is_ok() {
             // Check it exists
             assert!(node.fs_exists("/test.txt").unwrap_or(false));
@@ -1242,52 +4330,136 @@ mod tests {
     #[test]
     fn test_step_result_accessors() {
         // Test the StepResult accessor methods with a mock result
-        let mut result = StepResult {
+        let radio = [1u8, 2, 3, 4, 5];
+        let serial = [b'A', b'B', b'C'];
+        let log = b"hello\0";
+        let result = StepResult {
             reason: YieldReason::RadioTxStart,
             current_millis: 1000,
             wake_millis: 2000,
-            radio_tx_data: [0; MAX_RADIO_PACKET],
+            radio_tx_data: radio.as_ptr(),
             radio_tx_len: 5,
             radio_tx_airtime_ms: 100,
-            serial_tx_data: [0; MAX_SERIAL_TX],
+            serial_tx_data: serial.as_ptr(),
             serial_tx_len: 3,
-            log_output: [0; MAX_LOG_OUTPUT],
-            log_output_len: 0,
-            error_msg: [0; 256],
+            serial_tx_pending: 0,
+            serial_frames_pending: 0,
+            log_output: log.as_ptr() as *const c_char,
+            log_output_len: 5,
+            error_msg: std::ptr::null(),
+            state_hash: 0,
+            events: std::ptr::null(),
+            event_count: 0,
+            _node: PhantomData,
         };
 
-        // Set some test data
-        result.radio_tx_data[0..5].copy_from_slice(&[1, 2, 3, 4, 5]);
-        result.serial_tx_data[0..3].copy_from_slice(&[b'A', b'B', b'C']);
-
         assert_eq!(result.radio_tx(), &[1, 2, 3, 4, 5]);
         assert_eq!(result.serial_tx(), &[b'A', b'B', b'C']);
+        assert_eq!(result.log_output(), "hello");
+        assert!(result.error_message().is_none());
+    }
+
+    #[test]
+    fn test_step_result_empty_views() {
+        // Idle steps may report null views with zero lengths
+        let result = StepResult {
+            reason: YieldReason::Idle,
+            current_millis: 0,
+            wake_millis: 0,
+            radio_tx_data: std::ptr::null(),
+            radio_tx_len: 0,
+            radio_tx_airtime_ms: 0,
+            serial_tx_data: std::ptr::null(),
+            serial_tx_len: 0,
+            serial_tx_pending: 0,
+            serial_frames_pending: 0,
+            log_output: std::ptr::null(),
+            log_output_len: 0,
+            error_msg: std::ptr::null(),
+            state_hash: 0,
+            events: std::ptr::null(),
+            event_count: 0,
+            _node: PhantomData,
+        };
+
+        assert!(result.radio_tx().is_empty());
+        assert!(result.serial_tx().is_empty());
         assert_eq!(result.log_output(), "");
         assert!(result.error_message().is_none());
     }
 
+    #[test]
+    fn test_step_result_events() {
+        let packet = [7u8, 8, 9];
+        let events = [
+            StepEvent {
+                kind: StepEventKind::RadioTx,
+                airtime_ms: 120,
+                wake_millis: 0,
+                data: packet.as_ptr(),
+                len: packet.len(),
+            },
+            StepEvent {
+                kind: StepEventKind::Wake,
+                airtime_ms: 0,
+                wake_millis: 5000,
+                data: std::ptr::null(),
+                len: 0,
+            },
+        ];
+        let result = StepResult {
+            reason: YieldReason::RadioTxStart,
+            current_millis: 1000,
+            wake_millis: 5000,
+            radio_tx_data: packet.as_ptr(),
+            radio_tx_len: packet.len(),
+            radio_tx_airtime_ms: 120,
+            serial_tx_data: std::ptr::null(),
+            serial_tx_len: 0,
+            serial_tx_pending: 0,
+            serial_frames_pending: 0,
+            log_output: std::ptr::null(),
+            log_output_len: 0,
+            error_msg: std::ptr::null(),
+            state_hash: 0,
+            events: events.as_ptr(),
+            event_count: events.len(),
+            _node: PhantomData,
+        };
+
+        let view = result.events();
+        assert_eq!(view.len(), 2);
+        assert_eq!(view[0].kind, StepEventKind::RadioTx);
+        assert_eq!(view[0].airtime_ms, 120);
+        assert_eq!(view[0].data(), &[7, 8, 9]);
+        assert_eq!(view[1].kind, StepEventKind::Wake);
+        assert_eq!(view[1].wake_millis, 5000);
+        assert!(view[1].data().is_empty());
+    }
+
     #[test]
     fn test_step_result_error_message() {
-        let mut result = StepResult {
+        let msg = b"Test error\0";
+        let result = StepResult {
             reason: YieldReason::Error,
             current_millis: 0,
             wake_millis: 0,
-            radio_tx_data: [0; MAX_RADIO_PACKET],
+            radio_tx_data: std::ptr::null(),
             radio_tx_len: 0,
             radio_tx_airtime_ms: 0,
-            serial_tx_data: [0; MAX_SERIAL_TX],
+            serial_tx_data: std::ptr::null(),
             serial_tx_len: 0,
-            log_output: [0; MAX_LOG_OUTPUT],
+            serial_tx_pending: 0,
+            serial_frames_pending: 0,
+            log_output: std::ptr::null(),
             log_output_len: 0,
-            error_msg: [0; 256],
+            error_msg: msg.as_ptr() as *const c_char,
+            state_hash: 0,
+            events: std::ptr::null(),
+            event_count: 0,
+            _node: PhantomData,
         };
 
-        // Set an error message
-        let msg = b"Test error\0";
-        for (i, &b) in msg.iter().enumerate() {
-            result.error_msg[i] = b as c_char;
-        }
-
         let err = result.error_message();
         assert!(err.is_some());
         assert_eq!(err.unwrap(), "Test error");
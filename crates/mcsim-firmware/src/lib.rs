@@ -51,6 +51,8 @@ fn to_trace_yield_reason(reason: YieldReason) -> FirmwareYieldReason {
         YieldReason::Reboot => FirmwareYieldReason::Reboot,
         YieldReason::PowerOff => FirmwareYieldReason::PowerOff,
         YieldReason::Error => FirmwareYieldReason::Error,
+        YieldReason::BudgetExhausted => FirmwareYieldReason::BudgetExhausted,
+        YieldReason::SerialBackpressure => FirmwareYieldReason::SerialBackpressure,
     }
 }
 
@@ -140,6 +142,8 @@ pub struct FirmwareStepResult {
     pub log_output: String,
     /// Error message if any.
     pub error_message: Option<String>,
+    /// The node's state hash after this step (see `StepResult::state_hash`).
+    pub state_hash: u64,
 }
 
 /// Trait for firmware entities.
@@ -258,7 +262,13 @@ impl RepeaterFirmware {
             .with_spin_logging(
                 sim_params.log_spin_detection,
                 sim_params.log_loop_iterations,
-            );
+            )
+            .with_idle_wake_interval(sim_params.idle_wake_interval_ms)
+            .with_rx_queue_depth(sim_params.rx_queue_depth)
+            .with_idle_step_skipping(sim_params.skip_idle_steps)
+            .with_tx_continuation(sim_params.continue_after_tx)
+            .with_step_budget(sim_params.step_budget_loops, sim_params.step_budget_us)
+            .with_fs_write_back(sim_params.fs_write_back);
 
         // Create the persistent node
         let node = OwnedFirmwareNode::new(dll, &node_config)
@@ -423,6 +433,12 @@ impl Entity for RepeaterFirmware {
                     );
                 }
             }
+            YieldReason::BudgetExhausted | YieldReason::SerialBackpressure => {
+                // More work pending, or serial output to drain first (it is
+                // collected below): step again once the events already
+                // queued for this time have run
+                ctx.post_immediate(vec![self.id], EventPayload::Timer { timer_id: 1 });
+            }
             YieldReason::RadioTxComplete => {
                 // TX completed internally
                 self.awaiting_tx_complete = false;
@@ -436,16 +452,21 @@ impl Entity for RepeaterFirmware {
             _ => {}
         }
 
-        // Emit serial TX data if any
-        let serial_tx = result.serial_tx();
+        // Emit serial TX data if any, including output that did not fit in
+        // the step result
+        let log_str = result.log_output();
+        let mut serial_tx = result.serial_tx().to_vec();
+        if result.serial_tx_pending > 0 {
+            self.node.collect_serial_tx(&mut serial_tx);
+        }
         if !serial_tx.is_empty() {
-            tracer.log_firmware_serial_tx(Some(&self.name), self.id, event.time, serial_tx);
+            tracer.log_firmware_serial_tx(Some(&self.name), self.id, event.time, &serial_tx);
             
             // Send to self first (for UART/TCP bridge)
             ctx.post_immediate(
                 vec![self.id],
                 EventPayload::SerialTx(mcsim_common::SerialTxEvent {
-                    data: serial_tx.to_vec(),
+                    data: serial_tx.clone(),
                 }),
             );
             
@@ -454,14 +475,13 @@ impl Entity for RepeaterFirmware {
                 ctx.post_immediate(
                     vec![cli_agent_id],
                     EventPayload::SerialTx(mcsim_common::SerialTxEvent {
-                        data: serial_tx.to_vec(),
+                        data: serial_tx,
                     }),
                 );
             }
         }
 
         // Log firmware output
-        let log_str = result.log_output();
         tracer.log_firmware_output(Some(&self.name), self.id, event.time, &log_str);
 
         Ok(())
@@ -537,21 +557,30 @@ impl FirmwareEntity for RepeaterFirmware {
             None
         };
         
-        // Get serial TX data
-        let serial_tx = result.serial_tx();
+        let reason = result.reason;
+        let state_hash = result.state_hash;
+        let log_output = result.log_output();
+        let error_message = result.error_message();
+        
+        // Get serial TX data, including output that did not fit in the step result
+        let mut serial_tx = result.serial_tx().to_vec();
+        if result.serial_tx_pending > 0 {
+            self.node.collect_serial_tx(&mut serial_tx);
+        }
         let serial_tx_data = if serial_tx.is_empty() {
             None
         } else {
-            Some(serial_tx.to_vec())
+            Some(serial_tx)
         };
         
         FirmwareStepResult {
-            reason: result.reason,
-            wake_millis: result.wake_millis,
+            reason,
+            wake_millis: self.wake_millis,
             radio_tx_data,
             serial_tx_data,
-            log_output: result.log_output(),
-            error_message: result.error_message(),
+            log_output,
+            error_message,
+            state_hash,
         }
     }
 }
@@ -647,7 +676,13 @@ impl CompanionFirmware {
             .with_spin_logging(
                 sim_params.log_spin_detection,
                 sim_params.log_loop_iterations,
-            );
+            )
+            .with_idle_wake_interval(sim_params.idle_wake_interval_ms)
+            .with_rx_queue_depth(sim_params.rx_queue_depth)
+            .with_idle_step_skipping(sim_params.skip_idle_steps)
+            .with_tx_continuation(sim_params.continue_after_tx)
+            .with_step_budget(sim_params.step_budget_loops, sim_params.step_budget_us)
+            .with_fs_write_back(sim_params.fs_write_back);
 
         // Create the persistent node
         let node = OwnedFirmwareNode::new(dll, &node_config)
@@ -813,6 +848,12 @@ impl Entity for CompanionFirmware {
                     );
                 }
             }
+            YieldReason::BudgetExhausted | YieldReason::SerialBackpressure => {
+                // More work pending, or serial output to drain first (it is
+                // collected below): step again once the events already
+                // queued for this time have run
+                ctx.post_immediate(vec![self.id], EventPayload::Timer { timer_id: 1 });
+            }
             YieldReason::RadioTxComplete => {
                 self.awaiting_tx_complete = false;
                 self.pending_tx = None;
@@ -825,16 +866,21 @@ impl Entity for CompanionFirmware {
             _ => {}
         }
 
-        // Emit serial TX data if any
-        let serial_tx = result.serial_tx();
+        // Emit serial TX data if any, including output that did not fit in
+        // the step result
+        let log_str = result.log_output();
+        let mut serial_tx = result.serial_tx().to_vec();
+        if result.serial_tx_pending > 0 {
+            self.node.collect_serial_tx(&mut serial_tx);
+        }
         if !serial_tx.is_empty() {
-            tracer.log_firmware_serial_tx(Some(&self.name), self.id, event.time, serial_tx);
+            tracer.log_firmware_serial_tx(Some(&self.name), self.id, event.time, &serial_tx);
             
             // Send to self first (for UART/TCP bridge)
             ctx.post_immediate(
                 vec![self.id],
                 EventPayload::SerialTx(mcsim_common::SerialTxEvent {
-                    data: serial_tx.to_vec(),
+                    data: serial_tx.clone(),
                 }),
             );
             
@@ -843,14 +889,13 @@ impl Entity for CompanionFirmware {
                 ctx.post_immediate(
                     vec![agent_id],
                     EventPayload::SerialTx(mcsim_common::SerialTxEvent {
-                        data: serial_tx.to_vec(),
+                        data: serial_tx,
                     }),
                 );
             }
         }
 
         // Log firmware output
-        let log_str = result.log_output();
         tracer.log_firmware_output(Some(&self.name), self.id, event.time, &log_str);
 
         Ok(())
@@ -926,21 +971,30 @@ impl FirmwareEntity for CompanionFirmware {
             None
         };
         
-        // Get serial TX data
-        let serial_tx = result.serial_tx();
+        let reason = result.reason;
+        let state_hash = result.state_hash;
+        let log_output = result.log_output();
+        let error_message = result.error_message();
+        
+        // Get serial TX data, including output that did not fit in the step result
+        let mut serial_tx = result.serial_tx().to_vec();
+        if result.serial_tx_pending > 0 {
+            self.node.collect_serial_tx(&mut serial_tx);
+        }
         let serial_tx_data = if serial_tx.is_empty() {
             None
         } else {
-            Some(serial_tx.to_vec())
+            Some(serial_tx)
         };
         
         FirmwareStepResult {
-            reason: result.reason,
-            wake_millis: result.wake_millis,
+            reason,
+            wake_millis: self.wake_millis,
             radio_tx_data,
             serial_tx_data,
-            log_output: result.log_output(),
-            error_message: result.error_message(),
+            log_output,
+            error_message,
+            state_hash,
         }
     }
 }
@@ -1036,7 +1090,13 @@ impl RoomServerFirmware {
             .with_spin_logging(
                 sim_params.log_spin_detection,
                 sim_params.log_loop_iterations,
-            );
+            )
+            .with_idle_wake_interval(sim_params.idle_wake_interval_ms)
+            .with_rx_queue_depth(sim_params.rx_queue_depth)
+            .with_idle_step_skipping(sim_params.skip_idle_steps)
+            .with_tx_continuation(sim_params.continue_after_tx)
+            .with_step_budget(sim_params.step_budget_loops, sim_params.step_budget_us)
+            .with_fs_write_back(sim_params.fs_write_back);
 
         // Create the persistent node
         let node = OwnedFirmwareNode::new(dll, &node_config)
@@ -1195,6 +1255,12 @@ impl Entity for RoomServerFirmware {
                     );
                 }
             }
+            YieldReason::BudgetExhausted | YieldReason::SerialBackpressure => {
+                // More work pending, or serial output to drain first (it is
+                // collected below): step again once the events already
+                // queued for this time have run
+                ctx.post_immediate(vec![self.id], EventPayload::Timer { timer_id: 1 });
+            }
             YieldReason::RadioTxComplete => {
                 self.awaiting_tx_complete = false;
                 self.pending_tx = None;
@@ -1207,16 +1273,21 @@ impl Entity for RoomServerFirmware {
             _ => {}
         }
 
-        // Emit serial TX data if any
-        let serial_tx = result.serial_tx();
+        // Emit serial TX data if any, including output that did not fit in
+        // the step result
+        let log_str = result.log_output();
+        let mut serial_tx = result.serial_tx().to_vec();
+        if result.serial_tx_pending > 0 {
+            self.node.collect_serial_tx(&mut serial_tx);
+        }
         if !serial_tx.is_empty() {
-            tracer.log_firmware_serial_tx(Some(&self.name), self.id, event.time, serial_tx);
+            tracer.log_firmware_serial_tx(Some(&self.name), self.id, event.time, &serial_tx);
             
             // Send to self first (for UART/TCP bridge)
             ctx.post_immediate(
                 vec![self.id],
                 EventPayload::SerialTx(mcsim_common::SerialTxEvent {
-                    data: serial_tx.to_vec(),
+                    data: serial_tx.clone(),
                 }),
             );
             
@@ -1225,14 +1296,13 @@ impl Entity for RoomServerFirmware {
                 ctx.post_immediate(
                     vec![cli_agent_id],
                     EventPayload::SerialTx(mcsim_common::SerialTxEvent {
-                        data: serial_tx.to_vec(),
+                        data: serial_tx,
                     }),
                 );
             }
         }
 
         // Log firmware output
-        let log_str = result.log_output();
         tracer.log_firmware_output(Some(&self.name), self.id, event.time, &log_str);
 
         Ok(())
@@ -1308,21 +1378,30 @@ impl FirmwareEntity for RoomServerFirmware {
             None
         };
         
-        // Get serial TX data
-        let serial_tx = result.serial_tx();
+        let reason = result.reason;
+        let state_hash = result.state_hash;
+        let log_output = result.log_output();
+        let error_message = result.error_message();
+        
+        // Get serial TX data, including output that did not fit in the step result
+        let mut serial_tx = result.serial_tx().to_vec();
+        if result.serial_tx_pending > 0 {
+            self.node.collect_serial_tx(&mut serial_tx);
+        }
         let serial_tx_data = if serial_tx.is_empty() {
             None
         } else {
-            Some(serial_tx.to_vec())
+            Some(serial_tx)
         };
         
         FirmwareStepResult {
-            reason: result.reason,
-            wake_millis: result.wake_millis,
+            reason,
+            wake_millis: self.wake_millis,
             radio_tx_data,
             serial_tx_data,
-            log_output: result.log_output(),
-            error_message: result.error_message(),
+            log_output,
+            error_message,
+            state_hash,
         }
     }
 }
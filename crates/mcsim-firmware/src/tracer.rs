@@ -1,8 +1,164 @@
 //! Firmware tracing support using the common entity tracer.
 //!
 //! This module provides firmware-specific tracing helpers that work with
-//! the generic EntityTracer from mcsim-common.
+//! the generic EntityTracer from mcsim-common, and exports the tracepoints
+//! recorded inside the firmware library (`FirmwareDll::drain_trace()`) as a
+//! Chrome trace that Perfetto and `chrome://tracing` open directly.
 
 pub use mcsim_common::entity_tracer::{
     EntityTracer, EntityTracerConfig, FirmwareYieldReason, TraceCategory, TraceEvent,
 };
+
+use crate::dll::{
+    FirmwareTraceEvent, TRACE_CRYPTO, TRACE_FS, TRACE_RADIO, TRACE_SERIAL, TRACE_STEP,
+};
+use std::collections::HashMap;
+use std::io::{self, Write};
+
+/// Process id of the node tracks in the exported trace.
+const NODES_PID: u32 = 1;
+/// Process id of the tracks for events recorded outside a node's step.
+const HOST_PID: u32 = 2;
+
+/// Name of a `TRACE_*` category as shown in the trace.
+pub fn firmware_trace_category_name(category: u32) -> &'static str {
+    match category {
+        TRACE_STEP => "step",
+        TRACE_RADIO => "radio",
+        TRACE_FS => "fs",
+        TRACE_CRYPTO => "crypto",
+        TRACE_SERIAL => "serial",
+        _ => "other",
+    }
+}
+
+/// Write firmware trace events as Chrome trace JSON.
+///
+/// Each node gets its own track, named by `node_name` (given the event's
+/// `node_id()`); events recorded outside a step go on one track per host
+/// thread. Times are wall-clock microseconds from the first event, and each
+/// event carries its simulation time as `args.sim_ms`.
+pub fn write_chrome_trace<W, F>(
+    out: &mut W,
+    events: &[FirmwareTraceEvent],
+    mut node_name: F,
+) -> io::Result<()>
+where
+    W: Write,
+    F: FnMut(usize) -> Option<String>,
+{
+    let origin = events.iter().map(|e| e.wall_start_ns).min().unwrap_or(0);
+    let mut node_tids: HashMap<usize, u32> = HashMap::new();
+    let mut host_tids: HashMap<u32, ()> = HashMap::new();
+
+    write!(out, "{{\"displayTimeUnit\":\"ns\",\"traceEvents\":[")?;
+    write!(
+        out,
+        "{{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":{},\"args\":{{\"name\":\"nodes\"}}}}",
+        NODES_PID
+    )?;
+    write!(
+        out,
+        ",{{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":{},\"args\":{{\"name\":\"host\"}}}}",
+        HOST_PID
+    )?;
+
+    for event in events {
+        let (pid, tid) = match event.node_id() {
+            Some(id) => {
+                let next = node_tids.len() as u32 + 1;
+                let tid = *node_tids.entry(id).or_insert_with(|| next);
+                if tid == next {
+                    let name = node_name(id).unwrap_or_else(|| format!("node {:#x}", id));
+                    write!(
+                        out,
+                        ",{{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":{},\"tid\":{},\"args\":{{\"name\":\"{}\"}}}}",
+                        NODES_PID,
+                        tid,
+                        escape_json(&name)
+                    )?;
+                }
+                (NODES_PID, tid)
+            }
+            None => {
+                if host_tids.insert(event.thread, ()).is_none() {
+                    write!(
+                        out,
+                        ",{{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":{},\"tid\":{},\"args\":{{\"name\":\"thread {}\"}}}}",
+                        HOST_PID, event.thread, event.thread
+                    )?;
+                }
+                (HOST_PID, event.thread)
+            }
+        };
+
+        let ts = (event.wall_start_ns - origin) as f64 / 1000.0;
+        write!(
+            out,
+            ",{{\"name\":\"{}\",\"cat\":\"{}\",",
+            escape_json(event.name()),
+            firmware_trace_category_name(event.category)
+        )?;
+        if event.wall_duration_ns > 0 {
+            write!(
+                out,
+                "\"ph\":\"X\",\"ts\":{:.3},\"dur\":{:.3},",
+                ts,
+                event.wall_duration_ns as f64 / 1000.0
+            )?;
+        } else {
+            write!(out, "\"ph\":\"i\",\"s\":\"t\",\"ts\":{:.3},", ts)?;
+        }
+        write!(
+            out,
+            "\"pid\":{},\"tid\":{},\"args\":{{\"sim_ms\":{}}}}}",
+            pid, tid, event.sim_millis
+        )?;
+    }
+
+    writeln!(out, "]}}")
+}
+
+fn escape_json(s: &str) -> String {
+    let mut escaped = String::with_capacity(s.len());
+    for c in s.chars() {
+        match c {
+            '"' => escaped.push_str("\\\""),
+            '\\' => escaped.push_str("\\\\"),
+            c if (c as u32) < 0x20 => escaped.push_str(&format!("\\u{:04x}", c as u32)),
+            c => escaped.push(c),
+        }
+    }
+    escaped
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_write_chrome_trace() {
+        let events = [
+            FirmwareTraceEvent::new_for_test(0x10, c"step", 1_000, 5_000, 42, TRACE_STEP, 0),
+            FirmwareTraceEvent::new_for_test(0x10, c"radio.tx", 2_500, 0, 42, TRACE_RADIO, 0),
+            FirmwareTraceEvent::new_for_test(0, c"fs.read", 3_000, 1_000, 0, TRACE_FS, 7),
+        ];
+        let mut out = Vec::new();
+        write_chrome_trace(&mut out, &events, |id| {
+            (id == 0x10).then(|| "Alice \"A\"".to_string())
+        })
+        .unwrap();
+        let json = String::from_utf8(out).unwrap();
+
+        assert!(json.starts_with("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+        assert!(json.contains("\"args\":{\"name\":\"Alice \\\"A\\\"\"}"));
+        assert!(json.contains(
+            "{\"name\":\"step\",\"cat\":\"step\",\"ph\":\"X\",\"ts\":0.000,\"dur\":5.000,\"pid\":1,\"tid\":1,\"args\":{\"sim_ms\":42}}"
+        ));
+        assert!(json.contains(
+            "{\"name\":\"radio.tx\",\"cat\":\"radio\",\"ph\":\"i\",\"s\":\"t\",\"ts\":1.500,\"pid\":1,\"tid\":1,"
+        ));
+        assert!(json.contains("\"pid\":2,\"tid\":7,\"args\":{\"name\":\"thread 7\"}"));
+        assert!(json.trim_end().ends_with("]}"));
+    }
+}
@@ -9,6 +9,7 @@
 //! - Link model for signal propagation ([`LinkModel`])
 //! - Collision detection ([`check_collision`])
 //! - PHY calculations ([`calculate_time_on_air`], [`calculate_snr_sensitivity`])
+//! - Firmware airtime tables ([`AirtimeTable`])
 //! - Configurable PHY parameters ([`LoraPhyConfig`])
 
 use mcsim_common::{
@@ -19,6 +20,7 @@ use mcsim_metrics::{metric_defs, metrics, MetricLabels};
 use rand::Rng;
 use serde::{Deserialize, Serialize};
 use std::collections::BTreeMap;
+use std::sync::Arc;
 
 // Re-export common types
 pub use mcsim_common::LoraPacket;
@@ -189,6 +191,33 @@ pub fn calculate_time_on_air_with_config(
     SimTime::from_secs(time_seconds)
 }
 
+/// Time on air per payload length, as computed by the firmware shim.
+///
+/// The simulator DLLs look airtimes up in a table per radio configuration
+/// (`sim_get_airtime_table()`, `FirmwareDll::airtime_table()` in
+/// mcsim-firmware). A radio given the same table occupies the channel for
+/// exactly as long as its firmware believes it transmits.
+#[derive(Debug, Clone, PartialEq, Eq)]
+pub struct AirtimeTable {
+    millis: [u32; AirtimeTable::LEN],
+}
+
+impl AirtimeTable {
+    /// Payload lengths covered by the table (0..=255).
+    pub const LEN: usize = 256;
+
+    /// Wrap a table of airtimes in milliseconds, indexed by payload length.
+    pub fn from_millis(millis: [u32; Self::LEN]) -> Self {
+        Self { millis }
+    }
+
+    /// Time on air of a packet. Longer payloads than LoRa allows use the
+    /// last entry.
+    pub fn time_on_air(&self, payload_len: usize) -> SimTime {
+        SimTime::from_millis(self.millis[payload_len.min(Self::LEN - 1)] as u64)
+    }
+}
+
 /// Calculate the SNR sensitivity threshold for a spreading factor.
 ///
 /// This function uses the default SNR thresholds. For configurable
@@ -388,6 +417,18 @@ pub struct RadioConfig {
     pub tx_to_rx_turnaround: SimTime,
     /// Entity ID of the Graph entity (for routing transmissions).
     pub graph_entity: EntityId,
+    /// Firmware airtime table for `params`; [`calculate_time_on_air`] if `None`.
+    pub airtime_table: Option<Arc<AirtimeTable>>,
+}
+
+impl RadioConfig {
+    /// Time on air of a packet with this configuration.
+    pub fn time_on_air(&self, payload_len: usize) -> SimTime {
+        match &self.airtime_table {
+            Some(table) => table.time_on_air(payload_len),
+            None => calculate_time_on_air(&self.params, payload_len),
+        }
+    }
 }
 
 impl Default for RadioConfig {
@@ -403,6 +444,7 @@ impl Default for RadioConfig {
             rx_to_tx_turnaround: SimTime::from_micros(100),
             tx_to_rx_turnaround: SimTime::from_micros(100),
             graph_entity: EntityId::new(0),
+            airtime_table: None,
         }
     }
 }
@@ -623,7 +665,7 @@ impl Radio {
     fn start_transmission(&mut self, ctx: &mut SimContext) {
         if let Some(packet) = self.pending_tx.take() {
             // Calculate airtime
-            let airtime = calculate_time_on_air(&self.config.params, packet.payload.len());
+            let airtime = self.config.time_on_air(packet.payload.len());
             let airtime_us = airtime.as_micros() as u64;
             let end_time = ctx.time() + airtime;
             let packet_size = packet.payload.len();
@@ -955,6 +997,20 @@ mod tests {
         assert!(toa.as_millis() < 5000);
     }
 
+    #[test]
+    fn test_airtime_table_overrides_formula() {
+        let mut millis = [0u32; AirtimeTable::LEN];
+        for (len, ms) in millis.iter_mut().enumerate() {
+            *ms = 100 + len as u32;
+        }
+        let mut config = RadioConfig::default();
+        assert_eq!(config.time_on_air(50), calculate_time_on_air(&config.params, 50));
+
+        config.airtime_table = Some(Arc::new(AirtimeTable::from_millis(millis)));
+        assert_eq!(config.time_on_air(50), SimTime::from_millis(150));
+        assert_eq!(config.time_on_air(1000), SimTime::from_millis(355));
+    }
+
     #[test]
     fn test_snr_sensitivity_thresholds() {
         // Verify SF sensitivity thresholds are reasonable
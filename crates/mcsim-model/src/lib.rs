@@ -50,7 +50,10 @@ pub use properties::{
     METRICS_GROUPS, METRICS_WARMUP_S, ROOM_SERVER_ROOM_ID,
     // Firmware simulation properties
     FIRMWARE_SPIN_DETECTION_THRESHOLD, FIRMWARE_IDLE_LOOPS_BEFORE_YIELD,
-    FIRMWARE_LOG_SPIN_DETECTION, FIRMWARE_LOG_LOOP_ITERATIONS, FIRMWARE_INITIAL_RTC_SECS,
+    FIRMWARE_LOG_SPIN_DETECTION, FIRMWARE_LOG_LOOP_ITERATIONS, FIRMWARE_IDLE_WAKE_INTERVAL_MS,
+    FIRMWARE_RX_QUEUE_DEPTH, FIRMWARE_SKIP_IDLE_STEPS, FIRMWARE_CONTINUE_AFTER_TX,
+    FIRMWARE_STEP_BUDGET_LOOPS, FIRMWARE_STEP_BUDGET_US, FIRMWARE_FS_WRITE_BACK,
+    FIRMWARE_INITIAL_RTC_SECS,
     // Predict-link properties
     PREDICT_FREQUENCY_MHZ, PREDICT_TX_POWER_DBM, PREDICT_SPREADING_FACTOR,
     PREDICT_DEM_DIR, PREDICT_ELEVATION_CACHE_DIR, PREDICT_ELEVATION_SOURCE, PREDICT_ELEVATION_ZOOM_LEVEL, PREDICT_TERRAIN_SAMPLES,
@@ -499,6 +502,13 @@ pub fn build_simulation(model: &Model, seed: u64) -> Result<BuiltSimulation, Mod
         idle_loops_before_yield: sim_props.get(&FIRMWARE_IDLE_LOOPS_BEFORE_YIELD),
         log_spin_detection: sim_props.get(&FIRMWARE_LOG_SPIN_DETECTION),
         log_loop_iterations: sim_props.get(&FIRMWARE_LOG_LOOP_ITERATIONS),
+        idle_wake_interval_ms: sim_props.get(&FIRMWARE_IDLE_WAKE_INTERVAL_MS),
+        rx_queue_depth: sim_props.get(&FIRMWARE_RX_QUEUE_DEPTH),
+        skip_idle_steps: sim_props.get(&FIRMWARE_SKIP_IDLE_STEPS),
+        continue_after_tx: sim_props.get(&FIRMWARE_CONTINUE_AFTER_TX),
+        step_budget_loops: sim_props.get(&FIRMWARE_STEP_BUDGET_LOOPS),
+        step_budget_us: sim_props.get(&FIRMWARE_STEP_BUDGET_US),
+        fs_write_back: sim_props.get(&FIRMWARE_FS_WRITE_BACK),
         initial_rtc_secs: sim_props.get(&FIRMWARE_INITIAL_RTC_SECS),
         startup_time_us: 0, // Default; overridden per-node based on node properties
     };
@@ -525,6 +535,11 @@ pub fn build_simulation(model: &Model, seed: u64) -> Result<BuiltSimulation, Mod
     // Collect node information for display
     let mut node_infos: Vec<NodeInfo> = Vec::new();
 
+    // Firmware airtime tables per (firmware type, bandwidth, SF, CR), shared
+    // by every radio with that configuration. None if the DLL isn't available.
+    let mut firmware_dlls: std::collections::BTreeMap<String, Option<mcsim_firmware::dll::FirmwareDll>> = std::collections::BTreeMap::new();
+    let mut airtime_tables: std::collections::BTreeMap<(String, u32, u8, u8), Option<std::sync::Arc<mcsim_lora::AirtimeTable>>> = std::collections::BTreeMap::new();
+
     // Pre-pass: allocate entity IDs for radio, firmware, and agent (if present)
     for (_, node) in model.nodes() {
         let radio_id = EntityId::new(next_entity_id);
@@ -607,15 +622,51 @@ pub fn build_simulation(model: &Model, seed: u64) -> Result<BuiltSimulation, Mod
             longitude: resolved.get(&properties::LOCATION_LONGITUDE),
             altitude_m: resolved.get(&properties::LOCATION_ALTITUDE_M),
         };
+
+        // Get firmware type
+        let firmware_type: String = resolved.get(&properties::FIRMWARE_TYPE);
+
+        // Take airtimes from the node's firmware so the channel model and the
+        // firmware agree on how long each packet occupies the air
+        let airtime_key = (
+            firmware_type.to_lowercase(),
+            radio_params.bandwidth_hz,
+            radio_params.spreading_factor,
+            radio_params.coding_rate,
+        );
+        let airtime_table = airtime_tables
+            .entry(airtime_key)
+            .or_insert_with_key(|(fw_type, bandwidth_hz, sf, cr)| {
+                let dll = firmware_dlls.entry(fw_type.clone()).or_insert_with(|| {
+                    use mcsim_firmware::dll::{FirmwareDll, FirmwareType};
+                    let dll_type = match fw_type.as_str() {
+                        "repeater" => FirmwareType::Repeater,
+                        "companion" => FirmwareType::Companion,
+                        "room_server" | "roomserver" => FirmwareType::RoomServer,
+                        _ => return None,
+                    };
+                    match FirmwareDll::load(dll_type) {
+                        Ok(dll) => Some(dll),
+                        Err(e) => {
+                            log::warn!("No firmware airtime table for {}: {}", fw_type, e);
+                            None
+                        }
+                    }
+                });
+                dll.as_ref().map(|dll| {
+                    let millis = dll.airtime_table(*bandwidth_hz as f32 / 1000.0, *sf, *cr);
+                    std::sync::Arc::new(mcsim_lora::AirtimeTable::from_millis(millis))
+                })
+            })
+            .clone();
+
         let radio_config = mcsim_lora::RadioConfig {
             params: radio_params,
             rx_to_tx_turnaround: SimTime::from_micros(100),
             tx_to_rx_turnaround: SimTime::from_micros(100),
             graph_entity: graph_id,
+            airtime_table,
         };
-        
-        // Get firmware type
-        let firmware_type: String = resolved.get(&properties::FIRMWARE_TYPE);
 
         let groups: Vec<String> = resolved.get(&properties::METRICS_GROUPS);
         
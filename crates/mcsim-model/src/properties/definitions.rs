@@ -852,6 +852,58 @@ pub const FIRMWARE_LOG_LOOP_ITERATIONS: Property<bool, SimulationScope> = Proper
     PropertyDefault::Bool(false),
 );
 
+/// Longest idle sleep when the firmware has no known deadline.
+pub const FIRMWARE_IDLE_WAKE_INTERVAL_MS: Property<u32, SimulationScope> = Property::new(
+    "firmware/idle_wake_interval_ms",
+    "Longest idle sleep when the firmware has no known deadline",
+    PropertyDefault::Integer(100),
+)
+.with_unit("ms");
+
+/// Radio RX queue depth before received packets are dropped.
+pub const FIRMWARE_RX_QUEUE_DEPTH: Property<u32, SimulationScope> = Property::new(
+    "firmware/rx_queue_depth",
+    "Radio RX queue depth before received packets are dropped",
+    PropertyDefault::Integer(4),
+)
+.with_unit("count");
+
+/// Skip idle firmware steps whose inputs have not changed.
+pub const FIRMWARE_SKIP_IDLE_STEPS: Property<bool, SimulationScope> = Property::new(
+    "firmware/skip_idle_steps",
+    "Answer idle firmware steps without running the loop when no input changed since the last idle step",
+    PropertyDefault::Bool(false),
+);
+
+/// Let a firmware step run on after a TX starts.
+pub const FIRMWARE_CONTINUE_AFTER_TX: Property<bool, SimulationScope> = Property::new(
+    "firmware/continue_after_tx",
+    "Keep running the firmware loop after a TX starts until it is idle, instead of ending the step at the TX",
+    PropertyDefault::Bool(false),
+);
+
+/// Firmware loop iterations one step may run.
+pub const FIRMWARE_STEP_BUDGET_LOOPS: Property<u32, SimulationScope> = Property::new(
+    "firmware/step_budget_loops",
+    "Loop iterations a firmware step may run before it yields and resumes on the next step (0 = unlimited)",
+    PropertyDefault::Integer(0),
+);
+
+/// Wall-clock time one firmware step may run.
+pub const FIRMWARE_STEP_BUDGET_US: Property<u32, SimulationScope> = Property::new(
+    "firmware/step_budget_us",
+    "Wall-clock time a firmware step may run before it yields and resumes on the next step (0 = unlimited; not reproducible across hosts)",
+    PropertyDefault::Integer(0),
+)
+.with_unit("µs");
+
+/// Coalesce firmware file saves within a step.
+pub const FIRMWARE_FS_WRITE_BACK: Property<bool, SimulationScope> = Property::new(
+    "firmware/fs_write_back",
+    "Stage files the firmware writes and store each once at the end of the step, however often it was rewritten",
+    PropertyDefault::Bool(false),
+);
+
 /// Initial RTC Unix timestamp.
 pub const FIRMWARE_INITIAL_RTC_SECS: Property<u64, SimulationScope> = Property::new(
     "firmware/initial_rtc_secs",
@@ -117,6 +117,13 @@ pub use definitions::{
     FIRMWARE_IDLE_LOOPS_BEFORE_YIELD,
     FIRMWARE_LOG_SPIN_DETECTION,
     FIRMWARE_LOG_LOOP_ITERATIONS,
+    FIRMWARE_IDLE_WAKE_INTERVAL_MS,
+    FIRMWARE_RX_QUEUE_DEPTH,
+    FIRMWARE_SKIP_IDLE_STEPS,
+    FIRMWARE_CONTINUE_AFTER_TX,
+    FIRMWARE_STEP_BUDGET_LOOPS,
+    FIRMWARE_STEP_BUDGET_US,
+    FIRMWARE_FS_WRITE_BACK,
     FIRMWARE_INITIAL_RTC_SECS,
     // FSPL Prediction (Simulation scope)
     FSPL_MIN_DISTANCE_M,
@@ -135,6 +135,13 @@ pub const ALL_PROPERTIES: &[&PropertyDef] = &[
     &FIRMWARE_IDLE_LOOPS_BEFORE_YIELD.def,
     &FIRMWARE_LOG_SPIN_DETECTION.def,
     &FIRMWARE_LOG_LOOP_ITERATIONS.def,
+    &FIRMWARE_IDLE_WAKE_INTERVAL_MS.def,
+    &FIRMWARE_RX_QUEUE_DEPTH.def,
+    &FIRMWARE_SKIP_IDLE_STEPS.def,
+    &FIRMWARE_CONTINUE_AFTER_TX.def,
+    &FIRMWARE_STEP_BUDGET_LOOPS.def,
+    &FIRMWARE_STEP_BUDGET_US.def,
+    &FIRMWARE_FS_WRITE_BACK.def,
     &FIRMWARE_INITIAL_RTC_SECS.def,
     // Runner (Simulation scope)
     &RUNNER_WATCHDOG_TIMEOUT_S.def,
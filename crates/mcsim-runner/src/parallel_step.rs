@@ -141,6 +141,19 @@ pub fn process_firmware_results(
                     new_events.push(event);
                 }
             }
+            YieldReason::BudgetExhausted | YieldReason::SerialBackpressure => {
+                // More work pending, or serial output to drain first: step
+                // again at the same time, after the events already queued
+                // for it
+                let event = Event {
+                    id: mcsim_common::EventId(ctx.next_event_id()),
+                    time: current_time,
+                    source: output.entity_id,
+                    targets: vec![output.entity_id],
+                    payload: EventPayload::Timer { timer_id: 1 },
+                };
+                new_events.push(event);
+            }
             YieldReason::RadioTxComplete => {
                 // TX completed internally - no action needed
             }
@@ -0,0 +1,322 @@
+// ============================================================================
+// Simulator Shim Microbenchmarks
+// ============================================================================
+// Loads built firmware libraries and times the shim on its own: steps, radio
+// and serial injection, and the primitives behind sim_bench_kernel(). Each
+// result is printed as one JSON object per line, so runs can be stored and
+// compared per commit.
+//
+//   sim_bench [--iterations N] [--fiber WORKERS] [--filter TEXT] LIBRARY...
+//
+// Build against the same sim_api.h as the libraries, e.g.
+//   clang++ -std=c++17 -O2 -Isimulator/common/include simulator/bench/sim_bench.cpp -o sim_bench -ldl
+
+#include "sim_bench_common.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// ============================================================================
+// Measurement
+// ============================================================================
+
+struct BenchOptions {
+    uint64_t iterations = 2000;
+    uint32_t fiber_workers = 0;          // 0 = thread per node
+    const char* filter = nullptr;
+};
+
+static bool selected(const BenchOptions& options, const std::string& name) {
+    return !options.filter || name.find(options.filter) != std::string::npos;
+}
+
+// One result line. `ops` counts the unit the case measures (steps, packet
+// deliveries, bytes, kernel calls); `samples` are per-iteration times, used
+// for percentiles when present.
+static void report(const char* library, const std::string& name, uint64_t ops,
+                   uint64_t total_ns, std::vector<uint64_t> samples, const char* extra = "") {
+    double ns_per_op = ops ? static_cast<double>(total_ns) / ops : 0.0;
+    double ops_per_sec = total_ns ? ops * 1e9 / total_ns : 0.0;
+    printf("{\"library\":\"%s\",\"case\":\"%s\",\"ops\":%llu,\"total_ns\":%llu,"
+           "\"ns_per_op\":%.1f,\"ops_per_sec\":%.1f",
+           library, name.c_str(), static_cast<unsigned long long>(ops),
+           static_cast<unsigned long long>(total_ns), ns_per_op, ops_per_sec);
+    if (!samples.empty()) {
+        std::sort(samples.begin(), samples.end());
+        auto at = [&](double q) {
+            return static_cast<unsigned long long>(samples[static_cast<size_t>(q * (samples.size() - 1))]);
+        };
+        printf(",\"p50_ns\":%llu,\"p99_ns\":%llu,\"max_ns\":%llu", at(0.50), at(0.99), at(1.0));
+    }
+    printf("%s}\n", extra);
+    fflush(stdout);
+}
+
+// Step every node once (untimed), draining what was injected
+static void stepAll(const SimLibrary& lib, const std::vector<SimNodeHandle>& nodes, uint64_t millis) {
+    std::vector<SimStepRequest> requests(nodes.size());
+    std::vector<SimStepResult> results(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++) {
+        requests[i] = {nodes[i], millis, kRtcBase + static_cast<uint32_t>(millis / 1000)};
+    }
+    lib.step_batch(requests.data(), results.data(), nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++) {
+        if (results[i].reason == SIM_YIELD_RADIO_TX_START) {
+            lib.notify_tx_complete(nodes[i]);
+        }
+    }
+}
+
+// ============================================================================
+// Cases
+// ============================================================================
+
+// sim_step() latency. Idle steps have nothing to do; busy steps receive a
+// packet first (injection not timed). `skip` enables idle step skipping.
+static void benchStep(const SimLibrary& lib, const char* library, const BenchOptions& options,
+                      const char* name, bool busy, bool skip) {
+    if (!selected(options, name)) return;
+    SimNodeConfig config = benchNodeConfig(0, options.fiber_workers != 0);
+    config.skip_idle_steps = skip ? 1 : 0;
+    SimNodeHandle node = lib.create(&config);
+    uint64_t millis = 0;
+    for (int i = 0; i < 20; i++) {
+        stepNode(lib, node, millis += 1000);
+    }
+
+    uint8_t packet[64];
+    for (size_t i = 0; i < sizeof(packet); i++) {
+        packet[i] = static_cast<uint8_t>(i);
+    }
+    std::vector<uint64_t> samples;
+    samples.reserve(options.iterations);
+    uint64_t total = 0;
+    for (uint64_t i = 0; i < options.iterations; i++) {
+        if (busy) {
+            packet[1] = static_cast<uint8_t>(i);
+            lib.inject_radio_rx(node, packet, sizeof(packet), -80.0f, 5.0f);
+        }
+        millis += 1000;
+        uint64_t start = nowNanos();
+        stepNode(lib, node, millis);
+        uint64_t elapsed = nowNanos() - start;
+        samples.push_back(elapsed);
+        total += elapsed;
+    }
+    lib.destroy(node);
+    report(library, name, options.iterations, total, std::move(samples));
+}
+
+// Radio injection of one packet to `fanout` receivers, one call per
+// receiver or a single batched call. Receivers are drained between rounds
+// (untimed) so no packet is dropped.
+static void benchRadioRx(const SimLibrary& lib, const char* library, const BenchOptions& options,
+                         uint32_t fanout, bool batched) {
+    std::string name = std::string(batched ? "radio_rx_batch" : "radio_rx") + "_fanout" +
+                       std::to_string(fanout);
+    if (!selected(options, name)) return;
+    static const uint32_t kQueueDepth = 64;
+
+    std::vector<SimNodeHandle> nodes;
+    std::vector<SimRxTarget> targets;
+    for (uint32_t i = 0; i < fanout; i++) {
+        SimNodeConfig config = benchNodeConfig(i, options.fiber_workers != 0);
+        config.rx_queue_depth = kQueueDepth;
+        nodes.push_back(lib.create(&config));
+        targets.push_back({nodes.back(), -80.0f - (i % 20), 5.0f});
+    }
+    uint64_t millis = 1000;
+    stepAll(lib, nodes, millis);
+
+    uint8_t packet[64] = {};
+    uint64_t rounds = std::max<uint64_t>(16, options.iterations / fanout);
+    std::vector<uint64_t> samples;
+    samples.reserve(rounds);
+    uint64_t total = 0;
+    for (uint64_t round = 0; round < rounds; round++) {
+        packet[1] = static_cast<uint8_t>(round);
+        uint64_t start = nowNanos();
+        if (batched) {
+            lib.inject_radio_rx_batch(targets.data(), targets.size(), packet, sizeof(packet));
+        } else {
+            for (const SimRxTarget& target : targets) {
+                lib.inject_radio_rx(target.node, packet, sizeof(packet), target.rssi, target.snr);
+            }
+        }
+        uint64_t elapsed = nowNanos() - start;
+        samples.push_back(elapsed);
+        total += elapsed;
+        if ((round + 1) % (kQueueDepth / 2) == 0) {
+            stepAll(lib, nodes, millis += 1000);
+        }
+    }
+    for (SimNodeHandle node : nodes) {
+        lib.destroy(node);
+    }
+    char extra[32];
+    snprintf(extra, sizeof(extra), ",\"fanout\":%u", fanout);
+    report(library, name, rounds * fanout, total, std::move(samples), extra);
+}
+
+// Serial byte stream: inject a 64-byte chunk, then step to consume it
+// (untimed). Ops are bytes.
+static void benchSerialRx(const SimLibrary& lib, const char* library, const BenchOptions& options) {
+    const char* name = "serial_rx";
+    if (!selected(options, name)) return;
+    SimNodeConfig config = benchNodeConfig(0, options.fiber_workers != 0);
+    SimNodeHandle node = lib.create(&config);
+    uint64_t millis = 1000;
+    stepNode(lib, node, millis);
+
+    uint8_t chunk[64];
+    memset(chunk, 'x', sizeof(chunk));
+    uint64_t total = 0;
+    for (uint64_t i = 0; i < options.iterations; i++) {
+        // End a line now and then so the firmware's command buffer is reset
+        chunk[sizeof(chunk) - 1] = (i % 4 == 3) ? '\r' : 'x';
+        uint64_t start = nowNanos();
+        lib.inject_serial_rx(node, chunk, sizeof(chunk));
+        total += nowNanos() - start;
+        stepNode(lib, node, millis += 1000);
+    }
+    lib.destroy(node);
+    report(library, name, options.iterations * sizeof(chunk), total, {});
+}
+
+// Companion frames: inject 8 frames, step, collect the responses. The whole
+// round trip is timed; ops are injected frames.
+static void benchSerialFrames(const SimLibrary& lib, const char* library, const BenchOptions& options) {
+    const char* name = "serial_frames";
+    if (!selected(options, name) || !lib.inject_serial_frames || !lib.collect_serial_frames) return;
+    SimNodeConfig config = benchNodeConfig(0, options.fiber_workers != 0);
+    config.serial_frames = 1;
+    SimNodeHandle node = lib.create(&config);
+    uint64_t millis = 1000;
+    stepNode(lib, node, millis);
+
+    static const size_t kFrames = 8;
+    static const size_t kFrameLen = 32;
+    uint8_t data[kFrames * kFrameLen];
+    SimFrameSpan frames[kFrames];
+    for (size_t i = 0; i < kFrames; i++) {
+        frames[i] = {static_cast<uint32_t>(i * kFrameLen), static_cast<uint32_t>(kFrameLen)};
+        memset(data + i * kFrameLen, 0, kFrameLen);
+        data[i * kFrameLen] = 22;        // CMD_DEVICE_QUERY
+        data[i * kFrameLen + 1] = 3;
+    }
+    std::vector<uint8_t> out(SIM_MAX_SERIAL_TX);
+    std::vector<SimFrameSpan> out_frames(64);
+    auto drain = [&]() {
+        while (lib.collect_serial_frames(node, out.data(), out.size(), out_frames.data(),
+                                         out_frames.size()) > 0) {
+        }
+    };
+
+    // Only frame-based firmware (companion) accepts frames
+    if (lib.inject_serial_frames(node, data, sizeof(data), frames, 1) == 0) {
+        lib.destroy(node);
+        return;
+    }
+    stepNode(lib, node, millis += 1000);
+    drain();
+
+    std::vector<uint64_t> samples;
+    samples.reserve(options.iterations);
+    uint64_t total = 0;
+    uint64_t injected = 0;
+    for (uint64_t i = 0; i < options.iterations; i++) {
+        uint64_t start = nowNanos();
+        injected += lib.inject_serial_frames(node, data, sizeof(data), frames, kFrames);
+        stepNode(lib, node, millis += 1000);
+        drain();
+        uint64_t elapsed = nowNanos() - start;
+        samples.push_back(elapsed);
+        total += elapsed;
+    }
+    lib.destroy(node);
+    report(library, name, injected, total, std::move(samples));
+}
+
+// In-library primitives (sim_bench_kernel())
+static void benchKernels(const SimLibrary& lib, const char* library, const BenchOptions& options) {
+    static const char* const kNames[SIM_BENCH_KERNEL_COUNT] = {
+        "fs_write", "fs_read", "airtime", "ed25519_sign", "ed25519_verify",
+        "key_exchange", "aes128_256b", "sha256_256b", "hmac_sha256_256b",
+    };
+    if (!lib.bench_kernel) return;
+    SimNodeConfig config = benchNodeConfig(0, options.fiber_workers != 0);
+    SimNodeHandle node = lib.create(&config);
+    stepNode(lib, node, 1000);
+
+    for (uint32_t kernel = 0; kernel < SIM_BENCH_KERNEL_COUNT; kernel++) {
+        if (!selected(options, kNames[kernel])) continue;
+        // Public-key operations are a few hundred times slower than the rest
+        bool slow = kernel == SIM_BENCH_ED25519_SIGN || kernel == SIM_BENCH_ED25519_VERIFY ||
+                    kernel == SIM_BENCH_KEY_EXCHANGE;
+        uint64_t iterations = slow ? std::max<uint64_t>(1, options.iterations / 10)
+                                   : options.iterations * 10;
+        lib.bench_kernel(node, kernel, iterations / 10 + 1);    // Warm up
+        uint64_t total = lib.bench_kernel(node, kernel, iterations);
+        report(library, kNames[kernel], iterations, total, {});
+    }
+    lib.destroy(node);
+}
+
+// ============================================================================
+// Main
+// ============================================================================
+
+static void usage() {
+    fprintf(stderr, "usage: sim_bench [--iterations N] [--fiber WORKERS] [--filter TEXT] LIBRARY...\n");
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    std::vector<const char*> libraries;
+    for (int i = 1; i < argc; i++) {
+        bool has_value = i + 1 < argc;
+        if (strcmp(argv[i], "--iterations") == 0 && has_value) {
+            options.iterations = std::max<uint64_t>(1, strtoull(argv[++i], nullptr, 10));
+        } else if (strcmp(argv[i], "--fiber") == 0 && has_value) {
+            options.fiber_workers = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        } else if (strcmp(argv[i], "--filter") == 0 && has_value) {
+            options.filter = argv[++i];
+        } else if (argv[i][0] == '-') {
+            usage();
+            return 2;
+        } else {
+            libraries.push_back(argv[i]);
+        }
+    }
+    if (libraries.empty()) {
+        usage();
+        return 2;
+    }
+
+    for (const char* path : libraries) {
+        SimLibrary lib;
+        if (!lib.load(path)) {
+            return 1;
+        }
+        if (options.fiber_workers) {
+            lib.set_fiber_workers(options.fiber_workers);
+        }
+        const char* library = lib.get_node_type();
+
+        benchStep(lib, library, options, "step_idle", false, false);
+        benchStep(lib, library, options, "step_idle_skip", false, true);
+        benchStep(lib, library, options, "step_busy", true, false);
+        for (uint32_t fanout : {1u, 16u, 256u}) {
+            benchRadioRx(lib, library, options, fanout, false);
+            benchRadioRx(lib, library, options, fanout, true);
+        }
+        benchSerialRx(lib, library, options);
+        benchSerialFrames(lib, library, options);
+        benchKernels(lib, library, options);
+    }
+    return 0;
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+// ============================================================================
+// Shared Benchmark Helpers
+// ============================================================================
+// Library loading and node setup used by sim_bench.cpp and sim_load.cpp.
+// Both talk to the firmware libraries through sim_api.h only.
+
+#include "sim_api.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+// ============================================================================
+// Library Loading
+// ============================================================================
+
+struct SimLibrary {
+    std::string path;
+    void* handle = nullptr;
+
+    decltype(&sim_create) create = nullptr;
+    decltype(&sim_destroy) destroy = nullptr;
+    decltype(&sim_step) step = nullptr;
+    decltype(&sim_step_batch) step_batch = nullptr;
+    decltype(&sim_inject_radio_rx) inject_radio_rx = nullptr;
+    decltype(&sim_inject_radio_rx_batch) inject_radio_rx_batch = nullptr;
+    decltype(&sim_inject_serial_rx) inject_serial_rx = nullptr;
+    decltype(&sim_notify_tx_complete) notify_tx_complete = nullptr;
+    decltype(&sim_get_node_type) get_node_type = nullptr;
+    decltype(&sim_set_fiber_workers) set_fiber_workers = nullptr;
+    decltype(&sim_get_stats) get_stats = nullptr;
+    decltype(&sim_get_heap_stats) get_heap_stats = nullptr;
+    decltype(&sim_get_handoff_stats) get_handoff_stats = nullptr;
+    // Optional: companion frames and in-library kernels
+    decltype(&sim_inject_serial_frame) inject_serial_frame = nullptr;
+    decltype(&sim_inject_serial_frames) inject_serial_frames = nullptr;
+    decltype(&sim_collect_serial_frames) collect_serial_frames = nullptr;
+    decltype(&sim_bench_kernel) bench_kernel = nullptr;
+
+    void* symbol(const char* name) const {
+#ifdef _WIN32
+        return reinterpret_cast<void*>(GetProcAddress(static_cast<HMODULE>(handle), name));
+#else
+        return dlsym(handle, name);
+#endif
+    }
+
+    template <typename Fn>
+    bool bind(Fn& fn, const char* name, bool required) {
+        fn = reinterpret_cast<Fn>(symbol(name));
+        if (!fn && required) {
+            fprintf(stderr, "%s: missing %s\n", path.c_str(), name);
+            return false;
+        }
+        return true;
+    }
+
+    bool load(const char* library_path) {
+        path = library_path;
+#ifdef _WIN32
+        handle = LoadLibraryA(library_path);
+#else
+        handle = dlopen(library_path, RTLD_NOW | RTLD_LOCAL);
+#endif
+        if (!handle) {
+            fprintf(stderr, "%s: cannot load library\n", library_path);
+            return false;
+        }
+        return bind(create, "sim_create", true) &&
+               bind(destroy, "sim_destroy", true) &&
+               bind(step, "sim_step", true) &&
+               bind(step_batch, "sim_step_batch", true) &&
+               bind(inject_radio_rx, "sim_inject_radio_rx", true) &&
+               bind(inject_radio_rx_batch, "sim_inject_radio_rx_batch", true) &&
+               bind(inject_serial_rx, "sim_inject_serial_rx", true) &&
+               bind(notify_tx_complete, "sim_notify_tx_complete", true) &&
+               bind(get_node_type, "sim_get_node_type", true) &&
+               bind(set_fiber_workers, "sim_set_fiber_workers", true) &&
+               bind(get_stats, "sim_get_stats", true) &&
+               bind(get_heap_stats, "sim_get_heap_stats", true) &&
+               bind(get_handoff_stats, "sim_get_handoff_stats", true) &&
+               bind(inject_serial_frame, "sim_inject_serial_frame", false) &&
+               bind(inject_serial_frames, "sim_inject_serial_frames", false) &&
+               bind(collect_serial_frames, "sim_collect_serial_frames", false) &&
+               bind(bench_kernel, "sim_bench_kernel", false);
+    }
+};
+
+// ============================================================================
+// Nodes and Time
+// ============================================================================
+
+static const uint32_t kRtcBase = 1700000000;
+
+inline uint64_t nowNanos() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Radio and timing defaults of NodeConfig::default() on the Rust side, with
+// all output discarded
+inline SimNodeConfig benchNodeConfig(uint32_t index, bool fiber) {
+    SimNodeConfig config;
+    memset(&config, 0, sizeof(config));
+    config.lora_freq = 915.0f;
+    config.lora_bw = 250.0f;
+    config.lora_sf = 11;
+    config.lora_cr = 5;
+    config.lora_tx_power = 20;
+    config.initial_rtc = kRtcBase;
+    config.rng_seed = 12345 + index;
+    snprintf(config.node_name, sizeof(config.node_name), "bench%u", index);
+    config.spin_detection_threshold = 3;
+    config.idle_loops_before_yield = 2;
+    config.execution_mode = fiber ? SIM_EXEC_FIBER : SIM_EXEC_THREAD;
+    config.log_mode = SIM_LOG_OFF;
+    config.discard_serial_tx = 1;
+    return config;
+}
+
+// Step a node at `millis`, completing any transmission it starts
+inline void stepNode(const SimLibrary& lib, SimNodeHandle node, uint64_t millis) {
+    SimStepResult result = lib.step(node, millis, kRtcBase + static_cast<uint32_t>(millis / 1000));
+    if (result.reason == SIM_YIELD_RADIO_TX_START) {
+        lib.notify_tx_complete(node);
+    }
+}
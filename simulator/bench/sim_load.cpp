@@ -0,0 +1,620 @@
+// ============================================================================
+// Simulator Shim Load Driver
+// ============================================================================
+// Runs thousands of nodes of one firmware library with a trivial
+// propagation model (every transmission is heard by every other node, or by
+// --hear random ones) and periodic flooded adverts, then reports step
+// throughput, per-step latency, memory per node and handoff behaviour. The
+// coordinator here does nothing but schedule, so the numbers are the shim's
+// own, and the process can be profiled with native tools.
+//
+//   sim_load [--nodes N] [--seconds S] [--advert-interval-ms MS] [--hear K]
+//            [--fiber WORKERS] [--single] [--skip-idle] [--node-heap]
+//            [--rx-queue DEPTH] [--stack-kb KB] [--spread] [--seed SEED]
+//            [--json] LIBRARY
+//
+// Build like sim_bench:
+//   clang++ -std=c++17 -O2 -Isimulator/common/include simulator/bench/sim_load.cpp -o sim_load -ldl -lpthread
+
+#include "sim_bench_common.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <queue>
+#include <random>
+#include <vector>
+
+#ifdef _WIN32
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#endif
+
+// ============================================================================
+// Options
+// ============================================================================
+
+struct LoadOptions {
+    uint32_t nodes = 1000;
+    uint64_t seconds = 600;              // Simulated duration
+    uint64_t advert_interval_ms = 1000;  // A random node floods an advert this often
+    uint32_t hear = 0;                   // Receivers per transmission (0 = all)
+    uint32_t fiber_workers = 0;          // 0 = thread per node
+    bool single = false;                 // sim_step() per node instead of sim_step_batch()
+    bool skip_idle = false;
+    bool node_heap = false;
+    uint32_t rx_queue = 0;
+    uint32_t stack_kb = 0;               // 0 = platform default
+    bool spread = false;                 // Pin node threads to the CPUs in turn
+    uint64_t seed = 1;
+    bool json = false;
+};
+
+static void usage() {
+    fprintf(stderr,
+            "usage: sim_load [--nodes N] [--seconds S] [--advert-interval-ms MS] [--hear K]\n"
+            "                [--fiber WORKERS] [--single] [--skip-idle] [--node-heap]\n"
+            "                [--rx-queue DEPTH] [--stack-kb KB] [--spread] [--seed SEED]\n"
+            "                [--json] LIBRARY\n");
+}
+
+// ============================================================================
+// Process Counters
+// ============================================================================
+
+// Resident set size of the process in bytes (0 if unknown)
+static uint64_t residentBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return counters.WorkingSetSize;
+    }
+    return 0;
+#else
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (!file) return 0;
+    unsigned long long size = 0, resident = 0;
+    int read = fscanf(file, "%llu %llu", &size, &resident);
+    fclose(file);
+    return read == 2 ? resident * 4096ull : 0;
+#endif
+}
+
+// OS threads in the process (0 if unknown)
+static uint32_t threadCount() {
+#ifdef _WIN32
+    return 0;
+#else
+    FILE* file = fopen("/proc/self/status", "r");
+    if (!file) return 0;
+    char line[256];
+    unsigned threads = 0;
+    while (fgets(line, sizeof(line), file)) {
+        if (sscanf(line, "Threads: %u", &threads) == 1) break;
+    }
+    fclose(file);
+    return threads;
+#endif
+}
+
+// ============================================================================
+// Latency Samples
+// ============================================================================
+
+// Uniform reservoir of latency samples, so long runs keep bounded memory
+class LatencySamples {
+public:
+    explicit LatencySamples(uint64_t seed) : rng_(seed) {}
+
+    void add(uint64_t ns) {
+        count_++;
+        if (samples_.size() < kCapacity) {
+            samples_.push_back(ns);
+        } else {
+            uint64_t slot = rng_() % count_;
+            if (slot < kCapacity) samples_[slot] = ns;
+        }
+        if (ns > max_) max_ = ns;
+    }
+
+    uint64_t count() const { return count_; }
+    uint64_t max() const { return max_; }
+
+    uint64_t percentile(double q) {
+        if (samples_.empty()) return 0;
+        size_t index = static_cast<size_t>(q * (samples_.size() - 1));
+        std::nth_element(samples_.begin(), samples_.begin() + index, samples_.end());
+        return samples_[index];
+    }
+
+private:
+    static const size_t kCapacity = 1 << 20;
+    std::vector<uint64_t> samples_;
+    std::mt19937_64 rng_;
+    uint64_t count_ = 0;
+    uint64_t max_ = 0;
+};
+
+// Upper bound (ns) of the step CPU histogram bucket holding quantile q
+static uint64_t histogramPercentile(const uint64_t (&histogram)[SIM_STEP_CPU_BUCKETS], double q) {
+    uint64_t total = 0;
+    for (uint64_t count : histogram) total += count;
+    if (total == 0) return 0;
+    uint64_t target = static_cast<uint64_t>(q * (total - 1)) + 1;
+    uint64_t seen = 0;
+    for (uint32_t bucket = 0; bucket < SIM_STEP_CPU_BUCKETS; bucket++) {
+        seen += histogram[bucket];
+        if (seen >= target) {
+            return bucket == SIM_STEP_CPU_BUCKETS - 1 ? UINT64_MAX : (1000ull << bucket);
+        }
+    }
+    return UINT64_MAX;
+}
+
+// ============================================================================
+// Scheduling
+// ============================================================================
+
+static const uint64_t kNever = UINT64_MAX;
+
+enum class EventKind { DELIVER, TX_DONE, ADVERT };
+
+struct Event {
+    uint64_t millis;
+    uint64_t order;                      // Keeps events at the same time in FIFO order
+    EventKind kind;
+    uint32_t node;                       // Sender (DELIVER), transmitter (TX_DONE)
+    std::vector<uint8_t> packet;
+
+    bool operator>(const Event& other) const {
+        return millis != other.millis ? millis > other.millis : order > other.order;
+    }
+};
+
+struct Wake {
+    uint64_t millis;
+    uint32_t node;
+
+    bool operator>(const Wake& other) const {
+        return millis != other.millis ? millis > other.millis : node > other.node;
+    }
+};
+
+class LoadRun {
+public:
+    LoadRun(const SimLibrary& lib, const LoadOptions& options)
+        : lib_(lib), options_(options), rng_(options.seed), step_latency_(options.seed + 1) {
+        companion_ = strcmp(lib.get_node_type(), "companion") == 0 && lib.inject_serial_frame &&
+                     lib.collect_serial_frames;
+    }
+
+    int run() {
+        if (options_.fiber_workers) {
+            lib_.set_fiber_workers(options_.fiber_workers);
+        }
+        threads_before_ = threadCount();
+        rss_before_ = residentBytes();
+        uint64_t create_start = nowNanos();
+        for (uint32_t i = 0; i < options_.nodes; i++) {
+            SimNodeConfig config = benchNodeConfig(i, options_.fiber_workers != 0);
+            config.skip_idle_steps = options_.skip_idle ? 1 : 0;
+            config.node_heap = options_.node_heap ? 1 : 0;
+            config.rx_queue_depth = options_.rx_queue;
+            config.stack_size_kb = options_.stack_kb;
+            config.placement = options_.spread ? SIM_PLACE_SPREAD : SIM_PLACE_ANY;
+            config.serial_frames = companion_ ? 1 : 0;
+            SimNodeHandle node = lib_.create(&config);
+            if (!node) {
+                fprintf(stderr, "sim_create failed for node %u\n", i);
+                return 1;
+            }
+            nodes_.push_back(node);
+            wake_.push_back(0);
+            wakes_.push({0, i});
+        }
+        create_ns_ = nowNanos() - create_start;
+        rss_created_ = residentBytes();
+        threads_created_ = threadCount();
+
+        receivers_.resize(options_.nodes);
+        for (uint32_t i = 0; i < options_.nodes; i++) receivers_[i] = i;
+        schedule({options_.advert_interval_ms, 0, EventKind::ADVERT, 0, {}});
+
+        uint64_t end_millis = options_.seconds * 1000;
+        uint64_t run_start = nowNanos();
+        while (true) {
+            uint64_t now = nextTime();
+            if (now == kNever || now > end_millis) break;
+            while (!events_.empty() && events_.top().millis <= now) {
+                Event event = events_.top();
+                events_.pop();
+                handle(event, now);
+            }
+            stepDue(now);
+        }
+        run_ns_ = nowNanos() - run_start;
+        rss_end_ = residentBytes();
+
+        print();
+        for (SimNodeHandle node : nodes_) {
+            lib_.destroy(node);
+        }
+        return errors_ ? 1 : 0;
+    }
+
+private:
+    const SimLibrary& lib_;
+    const LoadOptions& options_;
+    std::mt19937_64 rng_;
+    bool companion_ = false;
+
+    std::vector<SimNodeHandle> nodes_;
+    std::vector<uint64_t> wake_;                  // Current wake time per node
+    std::priority_queue<Wake, std::vector<Wake>, std::greater<Wake>> wakes_;   // Stale entries skipped
+    std::priority_queue<Event, std::vector<Event>, std::greater<Event>> events_;
+    uint64_t event_order_ = 0;
+
+    std::vector<uint32_t> receivers_;             // Shuffled for --hear
+    std::vector<SimRxTarget> targets_;
+    std::vector<uint32_t> due_;
+    std::vector<SimStepRequest> requests_;
+    std::vector<SimStepResult> results_;
+
+    // Measurements
+    LatencySamples step_latency_;                 // Per sim_step() (--single) or per batch
+    uint64_t steps_ = 0;
+    uint64_t batches_ = 0;
+    uint64_t shim_ns_ = 0;                        // Inside step and injection calls
+    uint64_t transmissions_ = 0;
+    uint64_t deliveries_ = 0;
+    uint64_t adverts_ = 0;
+    uint64_t errors_ = 0;
+    uint64_t create_ns_ = 0;
+    uint64_t run_ns_ = 0;
+    uint64_t rss_before_ = 0;
+    uint64_t rss_created_ = 0;
+    uint64_t rss_end_ = 0;
+    uint32_t threads_before_ = 0;
+    uint32_t threads_created_ = 0;
+
+    void schedule(Event event) {
+        event.order = event_order_++;
+        events_.push(std::move(event));
+    }
+
+    void wakeAt(uint32_t node, uint64_t millis) {
+        if (millis < wake_[node]) {
+            wake_[node] = millis;
+            wakes_.push({millis, node});
+        }
+    }
+
+    uint64_t nextTime() {
+        while (!wakes_.empty() && wakes_.top().millis != wake_[wakes_.top().node]) {
+            wakes_.pop();
+        }
+        uint64_t next = wakes_.empty() ? kNever : wakes_.top().millis;
+        if (!events_.empty() && events_.top().millis < next) {
+            next = events_.top().millis;
+        }
+        return next;
+    }
+
+    void handle(const Event& event, uint64_t now) {
+        switch (event.kind) {
+        case EventKind::DELIVER:
+            deliver(event, now);
+            break;
+        case EventKind::TX_DONE: {
+            uint64_t start = nowNanos();
+            lib_.notify_tx_complete(nodes_[event.node]);
+            shim_ns_ += nowNanos() - start;
+            wakeAt(event.node, now);
+            break;
+        }
+        case EventKind::ADVERT:
+            advert(now);
+            schedule({now + options_.advert_interval_ms, 0, EventKind::ADVERT, 0, {}});
+            break;
+        }
+    }
+
+    // All-hear-all, or --hear random receivers, all with the same link quality
+    void deliver(const Event& event, uint64_t now) {
+        uint32_t count = options_.nodes - 1;
+        if (options_.hear && options_.hear < count) {
+            count = options_.hear;
+        }
+        targets_.clear();
+        for (uint32_t i = 0; targets_.size() < count && i < options_.nodes; i++) {
+            if (options_.hear) {
+                std::uniform_int_distribution<uint32_t> pick(i, options_.nodes - 1);
+                std::swap(receivers_[i], receivers_[pick(rng_)]);
+            }
+            uint32_t receiver = receivers_[i];
+            if (receiver == event.node) continue;
+            targets_.push_back({nodes_[receiver], -90.0f, 5.0f});
+            wakeAt(receiver, now);
+        }
+        uint64_t start = nowNanos();
+        lib_.inject_radio_rx_batch(targets_.data(), targets_.size(), event.packet.data(),
+                                   event.packet.size());
+        shim_ns_ += nowNanos() - start;
+        deliveries_ += targets_.size();
+    }
+
+    // Ask a random node to flood an advert: the CLI command, or the companion
+    // CMD_SEND_SELF_ADVERT frame
+    void advert(uint64_t now) {
+        std::uniform_int_distribution<uint32_t> pick(0, options_.nodes - 1);
+        uint32_t node = pick(rng_);
+        uint64_t start = nowNanos();
+        if (companion_) {
+            static const uint8_t kSendSelfAdvert[] = {7, 1};
+            lib_.inject_serial_frame(nodes_[node], kSendSelfAdvert, sizeof(kSendSelfAdvert));
+        } else {
+            static const char kAdvert[] = "advert\r";
+            lib_.inject_serial_rx(nodes_[node], reinterpret_cast<const uint8_t*>(kAdvert),
+                                  sizeof(kAdvert) - 1);
+        }
+        shim_ns_ += nowNanos() - start;
+        adverts_++;
+        wakeAt(node, now);
+    }
+
+    void stepDue(uint64_t now) {
+        due_.clear();
+        while (!wakes_.empty() && wakes_.top().millis <= now) {
+            Wake wake = wakes_.top();
+            wakes_.pop();
+            if (wake.millis == wake_[wake.node]) {
+                wake_[wake.node] = kNever;
+                due_.push_back(wake.node);
+            }
+        }
+        if (due_.empty()) return;
+
+        uint32_t rtc = kRtcBase + static_cast<uint32_t>(now / 1000);
+        results_.resize(due_.size());
+        if (options_.single) {
+            for (size_t i = 0; i < due_.size(); i++) {
+                uint64_t start = nowNanos();
+                results_[i] = lib_.step(nodes_[due_[i]], now, rtc);
+                uint64_t elapsed = nowNanos() - start;
+                step_latency_.add(elapsed);
+                shim_ns_ += elapsed;
+            }
+        } else {
+            requests_.resize(due_.size());
+            for (size_t i = 0; i < due_.size(); i++) {
+                requests_[i] = {nodes_[due_[i]], now, rtc};
+            }
+            uint64_t start = nowNanos();
+            lib_.step_batch(requests_.data(), results_.data(), due_.size());
+            uint64_t elapsed = nowNanos() - start;
+            step_latency_.add(elapsed);
+            shim_ns_ += elapsed;
+        }
+        steps_ += due_.size();
+        batches_++;
+
+        for (size_t i = 0; i < due_.size(); i++) {
+            handleResult(due_[i], results_[i], now);
+        }
+    }
+
+    void handleResult(uint32_t node, const SimStepResult& result, uint64_t now) {
+        switch (result.reason) {
+        case SIM_YIELD_RADIO_TX_START: {
+            transmissions_++;
+            uint64_t done = now + std::max<uint32_t>(1, result.radio_tx_airtime_ms);
+            schedule({done, 0, EventKind::DELIVER, node,
+                      std::vector<uint8_t>(result.radio_tx_data,
+                                           result.radio_tx_data + result.radio_tx_len)});
+            schedule({done, 0, EventKind::TX_DONE, node, {}});
+            break;
+        }
+        case SIM_YIELD_ERROR:
+            errors_++;
+            fprintf(stderr, "node %u: %s\n", node, result.error_msg ? result.error_msg : "error");
+            return;                                // Not stepped again
+        case SIM_YIELD_POWER_OFF:
+            return;
+        default:
+            break;
+        }
+        if (companion_ && result.serial_frames_pending) {
+            uint8_t buffer[SIM_MAX_SERIAL_FRAME * 8];
+            SimFrameSpan frames[8];
+            while (lib_.collect_serial_frames(nodes_[node], buffer, sizeof(buffer), frames, 8) > 0) {
+            }
+        }
+        wakeAt(node, std::max(result.wake_millis, now + 1));
+    }
+
+    void print() {
+        SimNodeStats total_stats;
+        memset(&total_stats, 0, sizeof(total_stats));
+        uint64_t cpu_min = UINT64_MAX;
+        SimHandoffStats handoff = {};
+        uint64_t heap_live = 0;
+        uint64_t heap_peak = 0;
+        for (SimNodeHandle node : nodes_) {
+            SimNodeStats stats;
+            lib_.get_stats(node, &stats);
+            total_stats.steps += stats.steps;
+            total_stats.skipped_steps += stats.skipped_steps;
+            total_stats.loop_iterations += stats.loop_iterations;
+            total_stats.step_cpu_total_ns += stats.step_cpu_total_ns;
+            if (stats.steps > stats.skipped_steps && stats.step_cpu_min_ns < cpu_min) {
+                cpu_min = stats.step_cpu_min_ns;
+            }
+            total_stats.step_cpu_max_ns = std::max(total_stats.step_cpu_max_ns, stats.step_cpu_max_ns);
+            for (uint32_t b = 0; b < SIM_STEP_CPU_BUCKETS; b++) {
+                total_stats.step_cpu_histogram[b] += stats.step_cpu_histogram[b];
+            }
+            total_stats.packets_recv += stats.packets_recv;
+            total_stats.packets_sent += stats.packets_sent;
+            total_stats.rx_dropped += stats.rx_dropped;
+
+            SimHandoffStats node_handoff;
+            lib_.get_handoff_stats(node, &node_handoff);
+            handoff.coordinator_spin_waits += node_handoff.coordinator_spin_waits;
+            handoff.coordinator_parked_waits += node_handoff.coordinator_parked_waits;
+            handoff.node_spin_waits += node_handoff.node_spin_waits;
+            handoff.node_parked_waits += node_handoff.node_parked_waits;
+
+            SimHeapStats heap;
+            lib_.get_heap_stats(node, &heap);
+            heap_live += heap.live_bytes;
+            heap_peak += heap.peak_bytes;
+        }
+
+        double run_s = run_ns_ / 1e9;
+        double steps_per_sec = run_s > 0 ? steps_ / run_s : 0.0;
+        double shim_fraction = run_ns_ ? static_cast<double>(shim_ns_) / run_ns_ : 0.0;
+        uint64_t n = options_.nodes;
+        uint64_t rss_per_node = rss_created_ > rss_before_ ? (rss_created_ - rss_before_) / n : 0;
+        uint64_t rss_end_per_node = rss_end_ > rss_before_ ? (rss_end_ - rss_before_) / n : 0;
+        uint64_t timed = total_stats.steps - total_stats.skipped_steps;
+        uint64_t cpu_mean = timed ? total_stats.step_cpu_total_ns / timed : 0;
+        uint64_t p50 = step_latency_.percentile(0.50);
+        uint64_t p90 = step_latency_.percentile(0.90);
+        uint64_t p99 = step_latency_.percentile(0.99);
+        const char* latency_unit = options_.single ? "step" : "batch";
+
+        if (options_.json) {
+            printf("{\"library\":\"%s\",\"nodes\":%u,\"sim_seconds\":%llu,\"mode\":\"%s\","
+                   "\"fiber_workers\":%u,\"create_s\":%.3f,\"run_s\":%.3f,\"steps\":%llu,"
+                   "\"steps_per_sec\":%.1f,\"shim_fraction\":%.3f,"
+                   "\"latency_unit\":\"%s\",\"latency_p50_ns\":%llu,\"latency_p90_ns\":%llu,"
+                   "\"latency_p99_ns\":%llu,\"latency_max_ns\":%llu,"
+                   "\"step_cpu_mean_ns\":%llu,\"step_cpu_p50_le_ns\":%llu,\"step_cpu_p99_le_ns\":%llu,"
+                   "\"skipped_steps\":%llu,\"transmissions\":%llu,\"deliveries\":%llu,\"adverts\":%llu,"
+                   "\"rx_dropped\":%u,\"rss_per_node\":%llu,\"rss_end_per_node\":%llu,"
+                   "\"heap_live_per_node\":%llu,\"heap_peak_per_node\":%llu,\"threads\":%u,"
+                   "\"coordinator_spin_waits\":%llu,\"coordinator_parked_waits\":%llu,"
+                   "\"node_spin_waits\":%llu,\"node_parked_waits\":%llu,\"errors\":%llu}\n",
+                   lib_.get_node_type(), options_.nodes,
+                   static_cast<unsigned long long>(options_.seconds),
+                   options_.single ? "single" : "batch", options_.fiber_workers,
+                   create_ns_ / 1e9, run_s, static_cast<unsigned long long>(steps_), steps_per_sec,
+                   shim_fraction, latency_unit, static_cast<unsigned long long>(p50),
+                   static_cast<unsigned long long>(p90), static_cast<unsigned long long>(p99),
+                   static_cast<unsigned long long>(step_latency_.max()),
+                   static_cast<unsigned long long>(cpu_mean),
+                   static_cast<unsigned long long>(histogramPercentile(total_stats.step_cpu_histogram, 0.50)),
+                   static_cast<unsigned long long>(histogramPercentile(total_stats.step_cpu_histogram, 0.99)),
+                   static_cast<unsigned long long>(total_stats.skipped_steps),
+                   static_cast<unsigned long long>(transmissions_),
+                   static_cast<unsigned long long>(deliveries_),
+                   static_cast<unsigned long long>(adverts_), total_stats.rx_dropped,
+                   static_cast<unsigned long long>(rss_per_node),
+                   static_cast<unsigned long long>(rss_end_per_node),
+                   static_cast<unsigned long long>(heap_live / n),
+                   static_cast<unsigned long long>(heap_peak / n), threads_created_ - threads_before_,
+                   static_cast<unsigned long long>(handoff.coordinator_spin_waits),
+                   static_cast<unsigned long long>(handoff.coordinator_parked_waits),
+                   static_cast<unsigned long long>(handoff.node_spin_waits),
+                   static_cast<unsigned long long>(handoff.node_parked_waits),
+                   static_cast<unsigned long long>(errors_));
+            return;
+        }
+
+        printf("%s: %u nodes, %llu s simulated, %s stepping%s\n", lib_.get_node_type(),
+               options_.nodes, static_cast<unsigned long long>(options_.seconds),
+               options_.single ? "single" : "batch",
+               options_.fiber_workers ? ", fiber workers" : ", thread per node");
+        printf("  create      %.3f s, %u threads added\n", create_ns_ / 1e9,
+               threads_created_ - threads_before_);
+        printf("  run         %.3f s wall, %llu steps (%llu skipped), %.0f steps/s, %.0f%% in the shim\n",
+               run_s, static_cast<unsigned long long>(steps_),
+               static_cast<unsigned long long>(total_stats.skipped_steps), steps_per_sec,
+               shim_fraction * 100);
+        printf("  latency     per %s: p50 %llu ns, p90 %llu ns, p99 %llu ns, max %llu ns\n",
+               latency_unit, static_cast<unsigned long long>(p50),
+               static_cast<unsigned long long>(p90), static_cast<unsigned long long>(p99),
+               static_cast<unsigned long long>(step_latency_.max()));
+        printf("  step cpu    mean %llu ns, min %llu ns, max %llu ns\n",
+               static_cast<unsigned long long>(cpu_mean),
+               static_cast<unsigned long long>(cpu_min == UINT64_MAX ? 0 : cpu_min),
+               static_cast<unsigned long long>(total_stats.step_cpu_max_ns));
+        printf("  traffic     %llu adverts requested, %llu transmissions, %llu deliveries, %u dropped\n",
+               static_cast<unsigned long long>(adverts_),
+               static_cast<unsigned long long>(transmissions_),
+               static_cast<unsigned long long>(deliveries_), total_stats.rx_dropped);
+        printf("  memory      %llu B/node after create, %llu B/node at end",
+               static_cast<unsigned long long>(rss_per_node),
+               static_cast<unsigned long long>(rss_end_per_node));
+        if (options_.node_heap) {
+            printf(", heap live %llu B/node, peak %llu B/node",
+                   static_cast<unsigned long long>(heap_live / n),
+                   static_cast<unsigned long long>(heap_peak / n));
+        }
+        printf("\n");
+        printf("  handoff     coordinator %llu spin / %llu parked, node %llu spin / %llu parked\n",
+               static_cast<unsigned long long>(handoff.coordinator_spin_waits),
+               static_cast<unsigned long long>(handoff.coordinator_parked_waits),
+               static_cast<unsigned long long>(handoff.node_spin_waits),
+               static_cast<unsigned long long>(handoff.node_parked_waits));
+        if (errors_) {
+            printf("  errors      %llu\n", static_cast<unsigned long long>(errors_));
+        }
+    }
+};
+
+// ============================================================================
+// Main
+// ============================================================================
+
+int main(int argc, char** argv) {
+    LoadOptions options;
+    const char* library = nullptr;
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (strcmp(arg, "--nodes") == 0 && has_value) {
+            options.nodes = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        } else if (strcmp(arg, "--seconds") == 0 && has_value) {
+            options.seconds = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(arg, "--advert-interval-ms") == 0 && has_value) {
+            options.advert_interval_ms = std::max<uint64_t>(1, strtoull(argv[++i], nullptr, 10));
+        } else if (strcmp(arg, "--hear") == 0 && has_value) {
+            options.hear = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        } else if (strcmp(arg, "--fiber") == 0 && has_value) {
+            options.fiber_workers = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        } else if (strcmp(arg, "--rx-queue") == 0 && has_value) {
+            options.rx_queue = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        } else if (strcmp(arg, "--stack-kb") == 0 && has_value) {
+            options.stack_kb = static_cast<uint32_t>(strtoul(argv[++i], nullptr, 10));
+        } else if (strcmp(arg, "--seed") == 0 && has_value) {
+            options.seed = strtoull(argv[++i], nullptr, 10);
+        } else if (strcmp(arg, "--single") == 0) {
+            options.single = true;
+        } else if (strcmp(arg, "--skip-idle") == 0) {
+            options.skip_idle = true;
+        } else if (strcmp(arg, "--node-heap") == 0) {
+            options.node_heap = true;
+        } else if (strcmp(arg, "--spread") == 0) {
+            options.spread = true;
+        } else if (strcmp(arg, "--json") == 0) {
+            options.json = true;
+        } else if (arg[0] == '-' || library) {
+            usage();
+            return 2;
+        } else {
+            library = arg;
+        }
+    }
+    if (!library || options.nodes < 2) {
+        usage();
+        return 2;
+    }
+
+    SimLibrary lib;
+    if (!lib.load(library)) {
+        return 1;
+    }
+    LoadRun run(lib, options);
+    return run.run();
+}
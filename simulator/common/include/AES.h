@@ -4,11 +4,17 @@
 // AES Stub for Simulation
 // ============================================================================
 // Provides AES128 encryption/decryption for MeshCore.
+// Uses AES-NI / ARMv8 crypto instructions when the CPU has them
+// (sim_crypto_accel.h), with the table code below as the fallback.
 
 #include <cstdint>
 #include <cstddef>
 #include <cstring>
 
+#include "sim_crypto_accel.h"
+#include "sim_op_stats.h"
+#include "sim_trace.h"
+
 // Simple AES-128 ECB implementation
 // Uses lookup tables for S-box and inverse S-box
 
@@ -17,16 +23,89 @@ public:
     static const size_t KEY_SIZE = 16;
     static const size_t BLOCK_SIZE = 16;
     
-    AES128() {
+    AES128() : accel_(simAesAccel()) {
         memset(round_keys_, 0, sizeof(round_keys_));
+        memset(dec_round_keys_, 0, sizeof(dec_round_keys_));
     }
     
     void setKey(const uint8_t* key, size_t len) {
         if (len < KEY_SIZE) return;
-        keyExpansion(key);
+        // MeshCore builds a fresh AES128 for every packet, so the schedule is
+        // memoized per thread rather than per instance
+        KeySchedule& cached = scheduleSlot(key);
+        if (!cached.valid || memcmp(cached.key, key, KEY_SIZE) != 0) {
+            keyExpansion(key);
+            if (accel_) {
+                accel_->prepareDecryptKeys(dec_round_keys_, round_keys_);
+            }
+            memcpy(cached.key, key, KEY_SIZE);
+            memcpy(cached.round_keys, round_keys_, sizeof(round_keys_));
+            memcpy(cached.dec_round_keys, dec_round_keys_, sizeof(dec_round_keys_));
+            cached.valid = true;
+            return;
+        }
+        memcpy(round_keys_, cached.round_keys, sizeof(round_keys_));
+        memcpy(dec_round_keys_, cached.dec_round_keys, sizeof(dec_round_keys_));
     }
     
     void encryptBlock(uint8_t* output, const uint8_t* input) {
+        encryptBlocks(output, input, 1);
+    }
+    
+    void decryptBlock(uint8_t* output, const uint8_t* input) {
+        decryptBlocks(output, input, 1);
+    }
+
+    // ECB over `blocks` consecutive 16-byte blocks (output may equal input)
+    void encryptBlocks(uint8_t* output, const uint8_t* input, size_t blocks) {
+        SIM_TRACE_SCOPE(SIM_TRACE_CRYPTO, "aes128.encrypt");
+        SIM_COUNT_OP(aes_blocks, blocks);
+        if (accel_) {
+            accel_->encryptBlocks(round_keys_, output, input, blocks);
+            return;
+        }
+        for (size_t i = 0; i < blocks; i++) {
+            encryptBlockPortable(output + i * BLOCK_SIZE, input + i * BLOCK_SIZE);
+        }
+    }
+
+    void decryptBlocks(uint8_t* output, const uint8_t* input, size_t blocks) {
+        SIM_TRACE_SCOPE(SIM_TRACE_CRYPTO, "aes128.decrypt");
+        SIM_COUNT_OP(aes_blocks, blocks);
+        if (accel_) {
+            accel_->decryptBlocks(dec_round_keys_, output, input, blocks);
+            return;
+        }
+        for (size_t i = 0; i < blocks; i++) {
+            decryptBlockPortable(output + i * BLOCK_SIZE, input + i * BLOCK_SIZE);
+        }
+    }
+
+private:
+    struct KeySchedule {
+        bool valid;
+        uint8_t key[16];
+        uint8_t round_keys[176];
+        uint8_t dec_round_keys[176];
+    };
+
+    static KeySchedule& scheduleSlot(const uint8_t* key) {
+        static thread_local KeySchedule schedules[8];
+        return schedules[key[0] & 7];
+    }
+
+    const SimAesAccel* accel_;
+    uint8_t round_keys_[176];      // 11 * 16 bytes for AES-128
+    uint8_t dec_round_keys_[176];  // Inverse-cipher keys for the accelerated path
+    
+    // AES S-box
+    static const uint8_t sbox[256];
+    static const uint8_t inv_sbox[256];
+    
+    // Rijndael round constants
+    static const uint8_t rcon[11];
+    
+    void encryptBlockPortable(uint8_t* output, const uint8_t* input) {
         uint8_t state[16];
         memcpy(state, input, 16);
         
@@ -49,7 +128,7 @@ public:
         memcpy(output, state, 16);
     }
     
-    void decryptBlock(uint8_t* output, const uint8_t* input) {
+    void decryptBlockPortable(uint8_t* output, const uint8_t* input) {
         uint8_t state[16];
         memcpy(state, input, 16);
         
@@ -72,16 +151,6 @@ public:
         memcpy(output, state, 16);
     }
 
-private:
-    uint8_t round_keys_[176];  // 11 * 16 bytes for AES-128
-    
-    // AES S-box
-    static const uint8_t sbox[256];
-    static const uint8_t inv_sbox[256];
-    
-    // Rijndael round constants
-    static const uint8_t rcon[11];
-    
     void keyExpansion(const uint8_t* key) {
         memcpy(round_keys_, key, 16);
         
@@ -189,10 +189,16 @@ extern SimSerialClass Serial1;
 // ============================================================================
 // String Class (simplified)
 // ============================================================================
+// Strings shorter than SIM_STRING_INLINE characters live inside the object,
+// so the CLI's short tokens and replies never allocate. Longer ones move to
+// the node heap (sim_heap.h) and grow geometrically; each such block is
+// counted in the node's string_heap_allocs (sim_get_stats()).
+
+#define SIM_STRING_INLINE 32
 
 class String {
 public:
-    String() : buffer_(nullptr), len_(0), capacity_(0) {}
+    String() : buffer_(inline_), len_(0), capacity_(SIM_STRING_INLINE) { inline_[0] = '\0'; }
     String(const char* str);
     String(const String& other);
     String(String&& other) noexcept;
@@ -206,6 +212,8 @@ public:
     String& operator+=(const char* str);
     String& operator+=(char c);
 
+    bool concat(const char* str, unsigned int len);
+
     bool operator==(const String& other) const;
     bool operator==(const char* str) const;
     bool operator!=(const String& other) const { return !(*this == other); }
@@ -214,7 +222,7 @@ public:
     char operator[](unsigned int index) const;
     char& operator[](unsigned int index);
 
-    const char* c_str() const { return buffer_ ? buffer_ : ""; }
+    const char* c_str() const { return buffer_; }
     unsigned int length() const { return len_; }
     bool isEmpty() const { return len_ == 0; }
 
@@ -232,16 +240,23 @@ public:
     float toFloat() const;
 
 private:
-    char* buffer_;
+    char* buffer_;              // inline_, or a block from the node heap
     unsigned int len_;
-    unsigned int capacity_;
+    unsigned int capacity_;     // Bytes at buffer_, terminator included
+    char inline_[SIM_STRING_INLINE];
 
+    bool isInline() const { return buffer_ == inline_; }
     void ensureCapacity(unsigned int cap);
+    void assign(const char* str, unsigned int len);
+    void release();
 };
 
 String operator+(const String& lhs, const String& rhs);
 String operator+(const String& lhs, const char* rhs);
 String operator+(const char* lhs, const String& rhs);
+// Chains such as a + " " + b append to the temporary instead of copying it
+String operator+(String&& lhs, const String& rhs);
+String operator+(String&& lhs, const char* rhs);
 
 // ============================================================================
 // Print/Printable Interface
@@ -257,6 +272,10 @@ public:
     virtual size_t write(uint8_t) = 0;
     virtual size_t write(const uint8_t* buffer, size_t size);
 
+    // True if everything written is dropped; number printing and printf()
+    // then skip formatting and return 0
+    virtual bool discardsOutput() const { return false; }
+
     size_t print(const char* str);
     size_t print(char c);
     size_t print(int n, int base = DEC);
@@ -321,6 +340,7 @@ public:
     int peek() override;
     size_t write(uint8_t c) override;
     size_t write(const uint8_t* buffer, size_t size) override;
+    bool discardsOutput() const override;
 
     void flush();
 
@@ -346,6 +366,7 @@ public:
     size_t write(uint8_t c) override;
     size_t write(const uint8_t* buffer, size_t size) override;
     size_t write(const char* str) { return write((const uint8_t*)str, strlen(str)); }
+    bool discardsOutput() const override;
 
     void flush() {}
 
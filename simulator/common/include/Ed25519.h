@@ -11,20 +11,25 @@
 
 // Include the actual ed25519 implementation
 extern "C" {
-#include "ed_25519.h"
+#include <ed_25519.h>
 }
 
+#include "sim_crypto_cache.h"
+#include "sim_op_stats.h"
+#include "sim_trace.h"
+
 class Ed25519 {
 public:
-    // Verify a signature
+    // Verify a signature (memoized across nodes when the verify cache is on)
     // sig: 64-byte signature
     // publicKey: 32-byte public key
     // message: message that was signed
     // len: length of message
     static bool verify(const uint8_t* sig, const uint8_t* publicKey, 
                        const void* message, size_t len) {
-        return ed25519_verify(sig, static_cast<const uint8_t*>(message), 
-                             static_cast<int>(len), publicKey) != 0;
+        SIM_TRACE_SCOPE(SIM_TRACE_CRYPTO, "ed25519.verify");
+        SIM_COUNT_OP(ed25519_verifies, 1);
+        return SimCryptoCache::verify(sig, publicKey, static_cast<const uint8_t*>(message), len);
     }
     
     // Sign a message
@@ -35,6 +40,8 @@ public:
     // len: length of message
     static void sign(uint8_t* sig, const uint8_t* privateKey, 
                     const uint8_t* publicKey, const void* message, size_t len) {
+        SIM_TRACE_SCOPE(SIM_TRACE_CRYPTO, "ed25519.sign");
+        SIM_COUNT_OP(ed25519_signs, 1);
         ed25519_sign(sig, static_cast<const uint8_t*>(message), 
                     static_cast<int>(len), publicKey, privateKey);
     }
@@ -4,22 +4,33 @@
 // SHA256 Stub for Simulation
 // ============================================================================
 // Provides a minimal SHA256 implementation for packet hashing.
+// Uses SHA-NI / ARMv8 SHA2 instructions when the CPU has them
+// (sim_crypto_accel.h), with processBlock() below as the fallback.
 
 #include <cstdint>
 #include <cstddef>
 #include <cstring>
 
+#include "sim_crypto_accel.h"
+#include "sim_op_stats.h"
+#include "sim_trace.h"
+
 class SHA256 {
 public:
     static const size_t HASH_SIZE = 32;
     static const size_t BLOCK_SIZE = 64;
 
-    SHA256() {
+    SHA256() : accel_(simShaAccel()), counted_(true) {
         reset();
-        memset(hmac_key_, 0, sizeof(hmac_key_));
+        memset(outer_state_, 0, sizeof(outer_state_));
         hmac_mode_ = false;
     }
 
+    // Hashing done by the simulator itself (crypto cache keys) rather than
+    // the firmware: its blocks are left out of the node's sha256_blocks
+    struct Uncounted {};
+    explicit SHA256(Uncounted) : SHA256() { counted_ = false; }
+
     void reset() {
         // Initialize hash values (first 32 bits of fractional parts of square roots of first 8 primes)
         state_[0] = 0x6a09e667;
@@ -36,26 +47,47 @@ public:
 
     // HMAC mode: reset and set key
     void resetHMAC(const void* key, size_t keyLen) {
-        reset();
-        hmac_mode_ = true;
-        
+        SIM_COUNT_OP(hmacs, 1);
         // If key is longer than block size, hash it
+        uint8_t key_block[BLOCK_SIZE];
+        memset(key_block, 0, BLOCK_SIZE);
         if (keyLen > BLOCK_SIZE) {
             SHA256 keyHash;
             keyHash.update(key, keyLen);
-            keyHash.finalize(hmac_key_, HASH_SIZE);
-            keyLen = HASH_SIZE;
+            keyHash.finalize(key_block, HASH_SIZE);
         } else {
-            memset(hmac_key_, 0, BLOCK_SIZE);
-            memcpy(hmac_key_, key, keyLen);
+            memcpy(key_block, key, keyLen);
         }
-        
-        // XOR key with ipad (0x36) and hash it
-        uint8_t ipad[BLOCK_SIZE];
-        for (size_t i = 0; i < BLOCK_SIZE; i++) {
-            ipad[i] = hmac_key_[i] ^ 0x36;
+
+        // The states after absorbing K XOR ipad and K XOR opad depend only on
+        // the key. MeshCore builds a fresh SHA256 per packet with the same few
+        // channel keys, so they are memoized per thread.
+        HmacSchedule& cached = hmacSlot(key_block);
+        if (!cached.valid || memcmp(cached.key, key_block, BLOCK_SIZE) != 0) {
+            uint8_t pad[BLOCK_SIZE];
+            for (size_t i = 0; i < BLOCK_SIZE; i++) {
+                pad[i] = key_block[i] ^ 0x36;
+            }
+            reset();
+            update(pad, BLOCK_SIZE);
+            memcpy(cached.inner, state_, sizeof(state_));
+
+            for (size_t i = 0; i < BLOCK_SIZE; i++) {
+                pad[i] = key_block[i] ^ 0x5c;
+            }
+            reset();
+            update(pad, BLOCK_SIZE);
+            memcpy(cached.outer, state_, sizeof(state_));
+
+            memcpy(cached.key, key_block, BLOCK_SIZE);
+            cached.valid = true;
         }
-        update(ipad, BLOCK_SIZE);
+
+        memcpy(state_, cached.inner, sizeof(state_));
+        memcpy(outer_state_, cached.outer, sizeof(outer_state_));
+        count_ = BLOCK_SIZE;
+        buffer_len_ = 0;
+        hmac_mode_ = true;
     }
     
     // Finalize HMAC
@@ -67,15 +99,11 @@ public:
         uint8_t innerHash[HASH_SIZE];
         finalize(innerHash, HASH_SIZE);
         
-        // Now compute outer hash: H(K XOR opad || innerHash)
-        reset();
-        
-        // XOR key with opad (0x5c)
-        uint8_t opad[BLOCK_SIZE];
-        for (size_t i = 0; i < BLOCK_SIZE; i++) {
-            opad[i] = hmac_key_[i] ^ 0x5c;
-        }
-        update(opad, BLOCK_SIZE);
+        // Now compute outer hash: H(K XOR opad || innerHash), resuming from
+        // the precomputed K XOR opad state
+        memcpy(state_, outer_state_, sizeof(state_));
+        count_ = BLOCK_SIZE;
+        buffer_len_ = 0;
         update(innerHash, HASH_SIZE);
         finalize(hash, hashLen);
         
@@ -83,9 +111,20 @@ public:
     }
 
     void update(const void* data, size_t len) {
+        SIM_TRACE_SCOPE(SIM_TRACE_CRYPTO, "sha256.update");
         const uint8_t* bytes = static_cast<const uint8_t*>(data);
         
         while (len > 0) {
+            // Whole blocks go straight from the caller's buffer
+            if (buffer_len_ == 0 && len >= BLOCK_SIZE) {
+                size_t blocks = len / BLOCK_SIZE;
+                processBlocks(bytes, blocks);
+                bytes += blocks * BLOCK_SIZE;
+                len -= blocks * BLOCK_SIZE;
+                count_ += blocks * BLOCK_SIZE;
+                continue;
+            }
+
             size_t to_copy = BLOCK_SIZE - buffer_len_;
             if (to_copy > len) to_copy = len;
             
@@ -96,13 +135,14 @@ public:
             count_ += to_copy;
             
             if (buffer_len_ == BLOCK_SIZE) {
-                processBlock(buffer_);
+                processBlocks(buffer_, 1);
                 buffer_len_ = 0;
             }
         }
     }
 
     void finalize(void* hash, size_t len) {
+        SIM_TRACE_SCOPE(SIM_TRACE_CRYPTO, "sha256.finalize");
         // Save state for HMAC
         uint64_t saved_count = count_;
         
@@ -132,13 +172,40 @@ public:
     }
 
 private:
+    struct HmacSchedule {
+        bool valid;
+        uint8_t key[BLOCK_SIZE];
+        uint32_t inner[8];
+        uint32_t outer[8];
+    };
+
+    static HmacSchedule& hmacSlot(const uint8_t* key_block) {
+        static thread_local HmacSchedule schedules[8];
+        return schedules[key_block[0] & 7];
+    }
+
+    const SimShaAccel* accel_;
+    bool counted_;             // Blocks go to sha256_blocks
     uint32_t state_[8];
     uint8_t buffer_[BLOCK_SIZE];
     size_t buffer_len_;
     uint64_t count_;
-    uint8_t hmac_key_[BLOCK_SIZE];  // For HMAC mode
+    uint32_t outer_state_[8];  // For HMAC mode: state after K XOR opad
     bool hmac_mode_;
 
+    void processBlocks(const uint8_t* data, size_t blocks) {
+        if (counted_) {
+            SIM_COUNT_OP(sha256_blocks, blocks);
+        }
+        if (accel_) {
+            accel_->compressBlocks(state_, data, blocks);
+            return;
+        }
+        for (size_t i = 0; i < blocks; i++) {
+            processBlock(data + i * BLOCK_SIZE);
+        }
+    }
+
     static uint32_t rotr(uint32_t x, int n) {
         return (x >> n) | (x << (32 - n));
     }
@@ -22,9 +22,8 @@ SimFilesystem& getSimFilesystem();
 // File wrapper - inherits from Stream so it can be passed to readFrom/writeTo
 class File : public Stream {
 public:
-    File() : fs_(nullptr), file_(nullptr), path_() {}
-    File(SimFilesystem* fs, SimFile* file, const char* path) 
-        : fs_(fs), file_(file), path_(path ? path : "") {}
+    File() : fs_(nullptr), file_(nullptr) {}
+    File(SimFilesystem* fs, SimFile* file) : fs_(fs), file_(file) {}
     
     ~File() {
         close();
@@ -32,7 +31,7 @@ public:
     
     // Move semantics
     File(File&& other) noexcept 
-        : fs_(other.fs_), file_(other.file_), path_(std::move(other.path_)) {
+        : fs_(other.fs_), file_(other.file_) {
         other.fs_ = nullptr;
         other.file_ = nullptr;
     }
@@ -42,7 +41,6 @@ public:
             close();
             fs_ = other.fs_;
             file_ = other.file_;
-            path_ = std::move(other.path_);
             other.fs_ = nullptr;
             other.file_ = nullptr;
         }
@@ -115,26 +113,31 @@ public:
         }
     }
     
+    // Last path component, as on ESP32; path() is the full path
     const char* name() const {
-        return path_.c_str();
+        return file_ ? file_->name() : "";
     }
-    
-    // Directory iteration support (for companion_radio)
+
+    const char* path() const {
+        return file_ ? file_->path() : "";
+    }
+
+    // Directory iteration (companion_radio lists its stores this way)
     File openNextFile() {
-        // In SPIFFS, there aren't real directories, so this is mostly a no-op
-        // Return an invalid file to signal end of iteration
-        return File();
+        return File(fs_, fs_ ? fs_->openNext(file_) : nullptr);
     }
-    
+
+    void rewindDirectory() {
+        if (fs_) fs_->rewind(file_);
+    }
+
     bool isDirectory() const {
-        // SPIFFS doesn't have real directories
-        return false;
+        return file_ && file_->isDirectory();
     }
 
 private:
     SimFilesystem* fs_;
     SimFile* file_;
-    std::string path_;
 };
 
 // Forward declare fs::FS for inheritance
@@ -177,7 +180,7 @@ public:
             file = fs.openAppend(path);
         }
         
-        return File(&fs, file, path);
+        return File(&fs, file);
     }
     
     bool exists(const char* path) override {
@@ -190,7 +193,7 @@ public:
     
     bool mkdir(const char* path) override {
         (void)path;
-        return true;  // Directories are implicit
+        return true;  // Directories are implicit: they exist while they hold files
     }
     
     bool format() override {
@@ -209,9 +212,10 @@ public:
     }
 };
 
-// Thread-local SPIFFS instance - each simulation thread gets its own
-// This ensures filesystem isolation between nodes running in the same DLL
-extern thread_local SPIFFSClass SPIFFS;
+// Global SPIFFS instance. SPIFFSClass is stateless: every call resolves the
+// current node's filesystem through g_sim_ctx, so one instance serves all
+// nodes in both thread and fiber execution modes.
+extern SPIFFSClass SPIFFS;
 
 // Define fs::SPIFFSFS for compatibility with firmware code
 namespace fs {
@@ -0,0 +1,32 @@
+#pragma once
+
+// ============================================================================
+// Cached Key Exchange for Simulation
+// ============================================================================
+// Shadows lib/ed25519/ed_25519.h (the simulator include directory comes first
+// on the include path). The real declarations are pulled in with
+// #include_next, then ed25519_key_exchange() is redirected to
+// sim_cached_key_exchange(), which serves repeated (private key, peer public
+// key) pairs from the process-wide SIM_CRYPTO_CACHE_ECDH cache. MeshCore's
+// Identity calls it for every contact, reboot and DM retry, and with
+// identities fixed by SimNodeConfig the result never changes.
+//
+// The ed25519 C sources are compiled without the simulator include directory
+// and still define the real function.
+
+#include_next <ed_25519.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+void sim_cached_key_exchange(unsigned char* shared_secret, const unsigned char* public_key,
+                             const unsigned char* private_key);
+
+#ifdef __cplusplus
+}
+#endif
+
+#ifndef SIM_CRYPTO_CACHE_IMPL
+#define ed25519_key_exchange sim_cached_key_exchange
+#endif
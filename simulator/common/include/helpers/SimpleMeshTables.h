@@ -0,0 +1,225 @@
+#pragma once
+
+// ============================================================================
+// Hashed Packet-Seen Table for Simulation
+// ============================================================================
+// Shadows MeshCore's helpers/SimpleMeshTables.h (the simulator include
+// directory comes first on the include path). The real header is pulled in
+// with #include_next for MAX_PACKET_HASHES and MAX_PACKET_ACKS, then the name
+// is redirected to SimHashedMeshTables below.
+//
+// MeshCore checks every received packet against a ring of recent packet
+// hashes (and one of recent ACK CRCs) with a linear scan. The replacement
+// keeps the same rings, so eviction is unchanged: a new entry overwrites the
+// oldest slot, and clear() empties a slot in place. Each ring also gets an
+// open-addressed index from key to slot, making hasSeen() O(1) however large
+// the rings are configured. As upstream, an all-zero slot is empty, and a
+// zero key counts as seen while any slot is empty.
+//
+// Lookups count into the node's SimOpStats (mesh_seen_hits, _misses,
+// _evictions). Define SIM_LINEAR_MESH_TABLES to build MeshCore's own class.
+
+#include_next <helpers/SimpleMeshTables.h>
+
+#ifndef SIM_LINEAR_MESH_TABLES
+
+#include "sim_op_stats.h"
+
+#include <cstdint>
+#include <cstring>
+
+// Ring of N recent keys with an index over it. Key 0 marks an empty slot and
+// is never indexed; empty_ counts those slots instead.
+template <typename Key, int N>
+class SimSeenRing {
+public:
+    SimSeenRing() { clearAll(); }
+
+    void clearAll() {
+        memset(keys_, 0, sizeof(keys_));
+        memset(index_, 0xFF, sizeof(index_));
+        next_ = 0;
+        empty_ = N;
+    }
+
+    // Upstream's scan matches a zero key against any empty slot
+    bool contains(Key key) const { return key != 0 ? find(key) >= 0 : empty_ > 0; }
+
+    // Store key in the oldest slot. True if that evicted a live entry.
+    bool insert(Key key) {
+        bool evicted = false;
+        if (keys_[next_] != 0) {
+            unindex(keys_[next_]);
+            evicted = true;
+        } else {
+            empty_--;
+        }
+        keys_[next_] = key;
+        if (key != 0) {
+            int pos = home(key);
+            while (index_[pos] >= 0) pos = (pos + 1) & (INDEX_SIZE - 1);
+            index_[pos] = static_cast<int32_t>(next_);
+        } else {
+            empty_++;
+        }
+        next_ = (next_ + 1) % N;
+        return evicted;
+    }
+
+    // Empty key's slot, leaving the ring position where it was
+    void remove(Key key) {
+        if (key == 0) return;
+        int pos = find(key);
+        if (pos >= 0) {
+            keys_[index_[pos]] = 0;
+            erase(pos);
+            empty_++;
+        }
+    }
+
+    // Upstream layout: the raw slots, then the next write position
+    const Key* slots() const { return keys_; }
+    int nextSlot() const { return next_; }
+
+    void load(const Key* slots, int next) {
+        clearAll();
+        for (int i = 0; i < N; i++) {
+            next_ = i;
+            insert(slots[i]);
+        }
+        next_ = (next >= 0 && next < N) ? next : 0;
+    }
+
+private:
+    // Power of two at least twice N, so probe runs stay short
+    static constexpr int indexSize() {
+        int size = 1;
+        while (size < 2 * N) size <<= 1;
+        return size;
+    }
+    static constexpr int INDEX_SIZE = indexSize();
+
+    static int home(Key key) {
+        // Keys are hash or CRC output already; the multiply spreads the low bits
+        uint64_t h = static_cast<uint64_t>(key) * 0x9e3779b97f4a7c15ULL;
+        return static_cast<int>(h >> 32) & (INDEX_SIZE - 1);
+    }
+
+    int find(Key key) const {
+        for (int pos = home(key); index_[pos] >= 0; pos = (pos + 1) & (INDEX_SIZE - 1)) {
+            if (keys_[index_[pos]] == key) return pos;
+        }
+        return -1;
+    }
+
+    void unindex(Key key) {
+        int pos = find(key);
+        if (pos >= 0) erase(pos);
+    }
+
+    // Backward-shift deletion keeps every probe run unbroken
+    void erase(int pos) {
+        int hole = pos;
+        for (int next = (pos + 1) & (INDEX_SIZE - 1); index_[next] >= 0;
+             next = (next + 1) & (INDEX_SIZE - 1)) {
+            int want = home(keys_[index_[next]]);
+            // Move the entry back unless its home lies in (hole, next]
+            if (((next - want) & (INDEX_SIZE - 1)) >= ((next - hole) & (INDEX_SIZE - 1))) {
+                index_[hole] = index_[next];
+                hole = next;
+            }
+        }
+        index_[hole] = -1;
+    }
+
+    Key keys_[N];
+    int32_t index_[INDEX_SIZE];
+    int next_;
+    int empty_;
+};
+
+class SimHashedMeshTables : public mesh::MeshTables {
+public:
+    static_assert(MAX_HASH_SIZE == sizeof(uint64_t), "packet hashes are indexed as 64-bit keys");
+
+    SimHashedMeshTables() : direct_dups_(0), flood_dups_(0) {}
+
+#ifdef ESP32
+    void restoreFrom(File f) {
+        uint64_t hashes[MAX_PACKET_HASHES];
+        uint32_t acks[MAX_PACKET_ACKS];
+        int next_idx = 0;
+        int next_ack_idx = 0;
+        f.read(reinterpret_cast<uint8_t*>(hashes), sizeof(hashes));
+        f.read(reinterpret_cast<uint8_t*>(&next_idx), sizeof(next_idx));
+        f.read(reinterpret_cast<uint8_t*>(acks), sizeof(acks));
+        f.read(reinterpret_cast<uint8_t*>(&next_ack_idx), sizeof(next_ack_idx));
+        hashes_.load(hashes, next_idx);
+        acks_.load(acks, next_ack_idx);
+    }
+
+    void saveTo(File f) {
+        int next_idx = hashes_.nextSlot();
+        int next_ack_idx = acks_.nextSlot();
+        f.write(reinterpret_cast<const uint8_t*>(hashes_.slots()),
+                sizeof(uint64_t) * MAX_PACKET_HASHES);
+        f.write(reinterpret_cast<const uint8_t*>(&next_idx), sizeof(next_idx));
+        f.write(reinterpret_cast<const uint8_t*>(acks_.slots()),
+                sizeof(uint32_t) * MAX_PACKET_ACKS);
+        f.write(reinterpret_cast<const uint8_t*>(&next_ack_idx), sizeof(next_ack_idx));
+    }
+#endif
+
+    bool hasSeen(const mesh::Packet* packet) override {
+        bool seen;
+        if (packet->getPayloadType() == PAYLOAD_TYPE_ACK) {
+            uint32_t ack;
+            memcpy(&ack, packet->payload, sizeof(ack));
+            seen = acks_.contains(ack);
+            if (!seen && acks_.insert(ack)) SIM_COUNT_OP(mesh_seen_evictions, 1);
+        } else {
+            uint64_t hash;
+            packet->calculatePacketHash(reinterpret_cast<uint8_t*>(&hash));
+            seen = hashes_.contains(hash);
+            if (!seen && hashes_.insert(hash)) SIM_COUNT_OP(mesh_seen_evictions, 1);
+        }
+
+        if (seen) {
+            SIM_COUNT_OP(mesh_seen_hits, 1);
+            if (packet->isRouteDirect()) {
+                direct_dups_++;
+            } else {
+                flood_dups_++;
+            }
+        } else {
+            SIM_COUNT_OP(mesh_seen_misses, 1);
+        }
+        return seen;
+    }
+
+    void clear(const mesh::Packet* packet) override {
+        if (packet->getPayloadType() == PAYLOAD_TYPE_ACK) {
+            uint32_t ack;
+            memcpy(&ack, packet->payload, sizeof(ack));
+            acks_.remove(ack);
+        } else {
+            uint64_t hash;
+            packet->calculatePacketHash(reinterpret_cast<uint8_t*>(&hash));
+            hashes_.remove(hash);
+        }
+    }
+
+    uint32_t getNumDirectDups() const { return direct_dups_; }
+    uint32_t getNumFloodDups() const { return flood_dups_; }
+    void resetStats() { direct_dups_ = flood_dups_ = 0; }
+
+private:
+    SimSeenRing<uint64_t, MAX_PACKET_HASHES> hashes_;
+    SimSeenRing<uint32_t, MAX_PACKET_ACKS> acks_;
+    uint32_t direct_dups_;
+    uint32_t flood_dups_;
+};
+
+#define SimpleMeshTables SimHashedMeshTables
+
+#endif // SIM_LINEAR_MESH_TABLES
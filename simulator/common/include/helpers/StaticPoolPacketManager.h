@@ -0,0 +1,23 @@
+#pragma once
+
+// ============================================================================
+// Heap-Ordered Packet Manager for Simulation
+// ============================================================================
+// Shadows MeshCore's helpers/StaticPoolPacketManager.h (the simulator include
+// directory comes first on the include path). StaticPoolPacketManager scans
+// its whole pool for the next due packet on every Dispatcher loop, and every
+// node runs at least two loops per step. SimPacketManager (sim_packet_manager.h)
+// keeps the same pool and ordering with heaps, and tells the idle logic when
+// the next queued packet is due, so retransmits and deferred inbound
+// processing wake the node exactly then instead of at the next fixed poll.
+//
+// The firmware constructs StaticPoolPacketManager by name, so the name is
+// redirected for every translation unit that includes this header. MeshCore's
+// own StaticPoolPacketManager.cpp includes the real header directly and still
+// defines the original class.
+
+#include_next <helpers/StaticPoolPacketManager.h>
+
+#include "sim_packet_manager.h"
+
+#define StaticPoolPacketManager SimPacketManager
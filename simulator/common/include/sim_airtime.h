@@ -0,0 +1,72 @@
+#pragma once
+
+#include "sim_api.h"
+
+#include <cstdint>
+
+// ============================================================================
+// LoRa Airtime Tables
+// ============================================================================
+// Time on air of every payload length for one radio configuration. SF, BW
+// and CR only change in SimRadio::configure(), so the radio looks airtimes
+// up instead of evaluating the formula (pow, ceil, fmax) on every TX, RX
+// and scheduling query. Nodes with the same settings share one table, and
+// sim_get_airtime_table() hands the same numbers to the coordinator.
+
+// Airtime in milliseconds of a `len`-byte packet: Semtech SX1276 formula
+// with an 8-symbol preamble, explicit header, CRC on, and low data rate
+// optimisation at SF11+ on 125 kHz or less. Rounds like the float formula
+// the radio used before the tables, so airtimes are unchanged, but counts
+// symbols in integers to stay usable in constant expressions.
+constexpr uint32_t simLoraAirtimeMs(float bw_khz, uint8_t sf, uint8_t cr, int len) {
+    double chips = 1.0;
+    for (uint8_t i = 0; i < sf; i++) {
+        chips *= 2.0;
+    }
+    float symbol_s = static_cast<float>(chips / static_cast<double>(bw_khz * 1000.0f));
+
+    int de = (bw_khz <= 125.0f && sf >= 11) ? 1 : 0;
+    int num = 8 * len - 4 * sf + 28 + 16;
+    int den = 4 * (sf - 2 * de);
+    if (den <= 0) {
+        return 0;
+    }
+    int blocks = num > 0 ? (num + den - 1) / den : 0;
+    float payload_symbols = 8.0f + static_cast<float>(blocks * (cr + 4));
+
+    float t_preamble = (8.0f + 4.25f) * symbol_s;
+    float t_payload = payload_symbols * symbol_s;
+    return static_cast<uint32_t>((t_preamble + t_payload) * 1000.0f);
+}
+
+struct SimAirtimeTable {
+    uint32_t ms[SIM_AIRTIME_TABLE_LEN];
+
+    // Airtime of a `len`-byte packet, off the table when len is in range
+    uint32_t lookup(float bw_khz, uint8_t sf, uint8_t cr, int len) const {
+        if (len >= 0 && len < SIM_AIRTIME_TABLE_LEN) {
+            return ms[len];
+        }
+        return simLoraAirtimeMs(bw_khz, sf, cr, len);
+    }
+};
+
+constexpr SimAirtimeTable simBuildAirtimeTable(float bw_khz, uint8_t sf, uint8_t cr) {
+    SimAirtimeTable table{};
+    for (int len = 0; len < SIM_AIRTIME_TABLE_LEN; len++) {
+        table.ms[len] = simLoraAirtimeMs(bw_khz, sf, cr, len);
+    }
+    return table;
+}
+
+// Tables of the common presets, built at compile time
+template <uint32_t BW_HZ, uint8_t SF, uint8_t CR>
+struct SimAirtimePreset {
+    static constexpr SimAirtimeTable table = simBuildAirtimeTable(BW_HZ / 1000.0f, SF, CR);
+};
+
+// The table for a configuration: a preset's, or one built on first use and
+// kept (shared by every node of the library, or by every library attached
+// to the shared runtime) until it unloads. Thread-safe; the pointer stays
+// valid.
+const SimAirtimeTable* simAirtimeTable(float bw_khz, uint8_t sf, uint8_t cr);
@@ -28,6 +28,42 @@ extern "C" {
 #define SIM_PUB_KEY_SIZE 32
 #define SIM_PRV_KEY_SIZE 64
 
+// Idle wake interval used when SimNodeConfig.idle_wake_interval_ms is 0
+#define SIM_DEFAULT_IDLE_WAKE_MS 100
+
+// Radio RX queue depth used when SimNodeConfig.rx_queue_depth is 0
+#define SIM_DEFAULT_RX_QUEUE_DEPTH 4
+
+// How a node's firmware is executed
+typedef enum {
+    SIM_EXEC_THREAD = 0,          // Dedicated OS thread per node (default)
+    SIM_EXEC_FIBER = 1,           // Stackful coroutine on the shared fiber worker pool
+} SimExecutionMode;
+
+// Where a node's log output (text written to Serial) goes
+typedef enum {
+    SIM_LOG_BUFFER = 0,           // Collected per step into SimStepResult.log_output,
+                                  // keeping the first SIM_MAX_LOG_OUTPUT - 1 bytes (default)
+    SIM_LOG_OFF = 1,              // Discarded
+    SIM_LOG_RING = 2,             // Collected per step, keeping the last SIM_MAX_LOG_OUTPUT - 1 bytes
+    SIM_LOG_STREAM = 3,           // Passed to the sim_set_log_sink() callback as it is written,
+                                  // without truncation
+} SimLogMode;
+
+// Where a node's thread runs and its memory lives
+typedef enum {
+    SIM_PLACE_ANY = 0,            // Wherever the OS schedules it (default)
+    SIM_PLACE_CPU = 1,            // Pinned to CPU placement_target
+    SIM_PLACE_NUMA_NODE = 2,      // On the CPUs of NUMA node placement_target
+    SIM_PLACE_SPREAD = 3,         // Pinned to the process's CPUs in turn, in creation order
+} SimPlacementMode;
+
+// Opaque filesystem image handle (see Filesystem API)
+typedef struct SimFsImage* SimFsImageHandle;
+
+// Opaque node snapshot handle (see Snapshot API)
+typedef struct SimSnapshot* SimSnapshotHandle;
+
 typedef struct {
     // Identity (Ed25519 keypair)
     uint8_t public_key[SIM_PUB_KEY_SIZE];
@@ -55,10 +91,74 @@ typedef struct {
     uint32_t idle_loops_before_yield;    // Idle loop count before yield
     uint8_t log_spin_detection;          // Enable debug logging for spin detection (bool as u8)
     uint8_t log_loop_iterations;         // Enable debug logging for loop iterations (bool as u8)
-    uint8_t _padding[2];                 // Alignment padding
+    uint8_t execution_mode;              // SimExecutionMode (u8)
+    uint8_t log_mode;                    // SimLogMode (u8)
+    
+    // Idle wake scheduling
+    uint32_t idle_wake_interval_ms;      // Longest idle sleep when no firmware deadline is known
+                                         // (0 = SIM_DEFAULT_IDLE_WAKE_MS)
+    
+    // Radio
+    uint32_t rx_queue_depth;             // Packets the radio RX FIFO holds before dropping
+                                         // (0 = SIM_DEFAULT_RX_QUEUE_DEPTH)
+    
+    // Serial output
+    uint8_t discard_serial_tx;           // Drop Serial output instead of returning it as serial TX
+                                         // (bool as u8). With log_mode SIM_LOG_OFF as well,
+                                         // Serial print formatting is skipped entirely.
+    uint8_t serial_frames;               // Companion: exchange protocol frames through
+                                         // sim_collect_serial_frames() instead of the serial
+                                         // byte stream (bool as u8)
+    
+    // Memory
+    uint8_t node_heap;                   // Allocate the firmware objects, String buffers and
+                                         // file handles from a per-node heap (bool as u8;
+                                         // see sim_get_heap_stats())
+    
+    // Idle detection
+    uint8_t skip_idle_steps;             // Answer a step whose inputs (radio, serial, timers)
+                                         // are unchanged since the last idle step with that
+                                         // idle result, without running loop() (bool as u8)
+    
+    // Filesystem
+    SimFsImageHandle fs_image;           // Files the node starts with, shared copy-on-write
+                                         // with every node created from the same image
+                                         // (NULL = empty). Read by sim_create() only.
+    
+    // Recording
+    const char* record_path;             // Log the node's inputs to this file for sim_replay()
+                                         // (NULL = off). Read by sim_create() only; forked
+                                         // nodes are not recorded.
+    
+    // Stepping
+    uint8_t continue_after_tx;           // Keep running loop() after a TX starts, until the
+                                         // node is idle, instead of ending the step there; the
+                                         // result's events list what happened in order
+                                         // (bool as u8)
+    
+    // Thread (SIM_EXEC_THREAD; fiber nodes take stack_size_kb only)
+    uint8_t placement;                   // SimPlacementMode (u8). The node's memory is
+                                         // allocated on the NUMA node it runs on.
+    uint16_t placement_target;           // CPU (SIM_PLACE_CPU) or NUMA node (SIM_PLACE_NUMA_NODE)
+    uint32_t stack_size_kb;              // Stack reserved for the node's thread or fiber
+                                         // (0 = platform default for threads, 256 for fibers)
+    
+    // Step budget (0 = unlimited). A step whose loop() still produces output
+    // at either limit ends with SIM_YIELD_BUDGET_EXHAUSTED, and the next
+    // step picks up where it stopped; finishing the idle check can take one
+    // loop past the limit. step_budget_us is wall-clock time, so
+    // where it cuts a step depends on the host: use step_budget_loops where
+    // runs must repeat (state_hash, sim_replay()).
+    uint32_t step_budget_loops;          // loop() iterations per step
+    uint32_t step_budget_us;             // Wall-clock microseconds per step
+    
+    // Filesystem write-back
+    uint8_t fs_write_back;               // Stage files the firmware writes and store each
+                                         // once at the end of the step, however often it was
+                                         // rewritten (bool as u8; see sim_get_stats())
     
     // Reserved for future use
-    uint8_t _reserved[56];               // Reduced from 64 to account for new fields
+    uint8_t _reserved[11];               // Reduced from 64 to account for new fields
 } SimNodeConfig;
 
 // ============================================================================
@@ -72,12 +172,42 @@ typedef enum {
     SIM_YIELD_REBOOT,             // Node requested reboot
     SIM_YIELD_POWER_OFF,          // Node requested power off
     SIM_YIELD_ERROR,              // An error occurred
+    SIM_YIELD_BUDGET_EXHAUSTED,   // Step budget ran out with work left: step again
+                                  // (wake_millis is the current time)
+    SIM_YIELD_SERIAL_BACKPRESSURE, // Serial TX backlog is full: collect it, then step
+                                   // again (wake_millis is the current time)
 } SimYieldReason;
 
 #define SIM_MAX_RADIO_PACKET 256
 #define SIM_MAX_SERIAL_TX 32768   // 32KB to handle large contact list responses (~151 bytes per contact)
+#define SIM_MAX_SERIAL_TX_BACKLOG (8 * SIM_MAX_SERIAL_TX)  // Serial TX queued before the node stops
 #define SIM_MAX_LOG_OUTPUT 4096
+#define SIM_MAX_SERIAL_FRAME 256  // Largest frame accepted by the serial frame API
 
+// One thing a node did during a step. A step's events are in the order the
+// firmware did them, so serial output written before a TX comes before it.
+typedef enum {
+    SIM_STEP_EVENT_RADIO_TX = 0,  // TX started: data/len is the packet (as radio_tx_data), and
+                                  // the radio is busy for airtime_ms from current_millis
+    SIM_STEP_EVENT_SERIAL_TX,     // data/len is the next chunk of serial_tx_data
+    SIM_STEP_EVENT_REBOOT,        // Firmware requested a reboot
+    SIM_STEP_EVENT_POWER_OFF,     // Firmware requested power off
+    SIM_STEP_EVENT_WAKE,          // Node has nothing to do until wake_millis
+} SimStepEventKind;
+
+typedef struct {
+    SimStepEventKind kind;
+    uint32_t airtime_ms;          // SIM_STEP_EVENT_RADIO_TX
+    uint64_t wake_millis;         // SIM_STEP_EVENT_WAKE
+    const uint8_t* data;          // SIM_STEP_EVENT_RADIO_TX, SIM_STEP_EVENT_SERIAL_TX
+    size_t len;
+} SimStepEvent;
+
+// Step results are a small fixed header. Output data is not copied into the
+// result; the pointer fields are views into buffers owned by the node that
+// stay valid until that node's next sim_step_begin()/sim_step()/
+// sim_step_batch(), sim_reboot() or sim_destroy(). Pointers may be NULL when
+// the corresponding length is 0. Copy anything that must outlive the step.
 typedef struct {
     SimYieldReason reason;
     
@@ -86,20 +216,37 @@ typedef struct {
     uint64_t wake_millis;         // Next wake time requested by node
     
     // Radio TX data (valid when reason == SIM_YIELD_RADIO_TX_START)
-    uint8_t radio_tx_data[SIM_MAX_RADIO_PACKET];
+    const uint8_t* radio_tx_data;
     size_t radio_tx_len;
     uint32_t radio_tx_airtime_ms; // Estimated airtime in milliseconds
     
-    // Serial TX output (accumulated during step)
-    uint8_t serial_tx_data[SIM_MAX_SERIAL_TX];
+    // Serial TX output (accumulated during step, at most SIM_MAX_SERIAL_TX)
+    const uint8_t* serial_tx_data;
     size_t serial_tx_len;
+    size_t serial_tx_pending;     // Further output still queued (see sim_collect_serial_tx)
+    size_t serial_frames_pending; // Frames (companion) or CLI replies (repeater, room
+                                  // server) waiting for sim_collect_serial_frames()
     
-    // Log output from Serial.print() calls
-    char log_output[SIM_MAX_LOG_OUTPUT];
+    // Log output from Serial.print() calls (NUL-terminated, at most
+    // SIM_MAX_LOG_OUTPUT - 1 characters)
+    const char* log_output;
     size_t log_output_len;
     
-    // Error message (if reason == SIM_YIELD_ERROR)
-    char error_msg[256];
+    // Error message (NUL-terminated, set only if reason == SIM_YIELD_ERROR)
+    const char* error_msg;
+    
+    // Rolling hash of every step result of this node so far, folded with its
+    // RNG streams, radio counters and a digest of its file writes. Two runs
+    // of a node stay in step exactly while their hashes match, so comparing
+    // it per step finds the first step where a (parallel) run diverged.
+    uint64_t state_hash;
+    
+    // Everything above as an ordered list (views like the other outputs).
+    // Without SimNodeConfig.continue_after_tx a step holds at most one
+    // RADIO_TX, REBOOT or POWER_OFF and ends there; with it, a step that
+    // started a TX runs on and can add serial output and a WAKE after it.
+    const SimStepEvent* events;
+    size_t event_count;
 } SimStepResult;
 
 // ============================================================================
@@ -113,17 +260,155 @@ typedef struct SimNodeImpl* SimNodeHandle;
 // ============================================================================
 
 // Create a new node instance with the given configuration.
-// The node thread is started but waits for sim_step_begin().
+// The node thread is started but waits for sim_step_begin(). In
+// SIM_EXEC_FIBER mode no thread is created; setup runs on the first step.
 SIM_API SimNodeHandle sim_create(const SimNodeConfig* config);
 
+// Create count nodes with one call; nodes[i] gets the node for configs[i].
+// Their setup() runs in parallel on the node threads and the call returns
+// once all have booted. Returns the number of nodes created.
+SIM_API size_t sim_create_batch(const SimNodeConfig* configs, SimNodeHandle* nodes,
+                                size_t count);
+
 // Destroy the node and free all resources.
-// The node thread is terminated.
+// The node thread (or fiber) is terminated.
 SIM_API void sim_destroy(SimNodeHandle node);
 
 // Reboot the node (preserves filesystem state, resets everything else).
-// Can only be called when node is in yielded state.
+// Can only be called when node is in yielded state. Setup runs on the node's
+// own thread/fiber; this call blocks until it has completed.
 SIM_API void sim_reboot(SimNodeHandle node, const SimNodeConfig* config);
 
+// ============================================================================
+// Snapshot API
+// ============================================================================
+// A snapshot captures a node between steps: its filesystem, radio queue and
+// counters, clocks, RNG streams and firmware mesh tables. Files and queued
+// packets are shared by reference, so many nodes can be restored or forked
+// from one snapshot cheaply. The firmware's objects are rebuilt from the
+// restored filesystem by running setup(), as after a power cycle; RAM-only
+// firmware state (queued outbound packets, unsaved contacts) is not kept.
+// Pending serial I/O and the last step result are not part of a snapshot.
+
+// Capture the node's state. Waits for a running step to finish.
+SIM_API SimSnapshotHandle sim_snapshot(SimNodeHandle node);
+
+// Put a node back into a snapshot of the same node type, including its
+// config (the execution mode is kept). Setup runs on the node's own
+// thread/fiber; this call blocks until it has completed. Returns 0, or -1 if
+// the snapshot is of another node type.
+SIM_API int sim_restore(SimNodeHandle node, SimSnapshotHandle snapshot);
+
+// Create a node of this library from a snapshot. config (NULL = the
+// snapshot's) may give the fork its own identity, name, RNG seed or radio
+// parameters; its fs_image is ignored. The RNG streams continue from the
+// snapshot's unless config has a different rng_seed or public key, which
+// reseeds them so forks diverge. Returns NULL if the snapshot is of another node type.
+SIM_API SimNodeHandle sim_fork(SimSnapshotHandle snapshot, const SimNodeConfig* config);
+
+// Stamp out count nodes from one template snapshot, each with its own
+// configs[i] (identity, name, rng_seed, radio parameters), booting them in
+// parallel like sim_create_batch(). To build a template, create one node
+// with the shared config and files, snapshot it, then destroy it. Returns
+// the number of nodes created (0 if the snapshot is of another node type).
+SIM_API size_t sim_fork_batch(SimSnapshotHandle snapshot, const SimNodeConfig* configs,
+                              SimNodeHandle* nodes, size_t count);
+
+// Release the snapshot. Nodes restored or forked from it are unaffected.
+SIM_API void sim_snapshot_release(SimSnapshotHandle snapshot);
+
+// ============================================================================
+// Hibernation API
+// ============================================================================
+// A hibernated node keeps its handle, files, counters and queued input, but
+// no thread, fiber, firmware objects or heap. Its state is held as a
+// snapshot, or not at all if its last step yielded SIM_YIELD_POWER_OFF, in
+// which case waking powers it back on over its files. Stepping, rebooting,
+// snapshotting or restoring a hibernated node wakes it first. The last step
+// result's buffers are released.
+
+// Hibernate a node, waiting for a running step to finish. Returns 0, or -1
+// if it already hibernates.
+SIM_API int sim_hibernate(SimNodeHandle node);
+
+// Rebuild a hibernated node now rather than at its next step. Setup runs on
+// the node's new thread/fiber (fiber nodes boot in their next step). Returns
+// 0, or -1 if the node does not hibernate.
+SIM_API int sim_wake(SimNodeHandle node);
+
+// 1 if the node hibernates, else 0
+SIM_API int sim_is_hibernating(SimNodeHandle node);
+
+// Set the number of worker threads used by SIM_EXEC_FIBER nodes
+// (0 = one per hardware thread). Must be called before the first fiber node
+// is stepped; later calls have no effect. Applies to this library only, or
+// with a shared runtime attached to the runtime's pool.
+SIM_API void sim_set_fiber_workers(uint32_t count);
+
+// Set how long the coordinator (waiting for a step) and a node thread
+// (waiting for the next one) spin before sleeping, in polls of the step
+// state. Each side adapts below its limit: waits that end up sleeping spin
+// less next time. Defaults 4096 and 512, or no spinning on a single CPU.
+// Safe to call at any time; applies to this library only.
+SIM_API void sim_set_step_spin(uint32_t coordinator_spins, uint32_t node_spins);
+
+// ============================================================================
+// Crypto Cache API
+// ============================================================================
+
+// Process-wide memo tables shared by all nodes of this library, or of every
+// library attached to the same shared runtime
+typedef enum {
+    SIM_CRYPTO_CACHE_VERIFY = 0,  // Ed25519 signature verification results
+    SIM_CRYPTO_CACHE_ECDH = 1,    // Shared secrets from ed25519_key_exchange()
+} SimCryptoCacheKind;
+
+typedef struct {
+    uint64_t hits;                // Lookups answered from the cache
+    uint64_t misses;              // Lookups that ran the real operation
+    uint64_t entries;             // Entries currently held
+    uint64_t capacity;            // Configured capacity (0 = disabled)
+} SimCryptoCacheStats;
+
+// Enable a crypto cache holding up to `entries` results (0 disables it, the
+// default). Any call clears the cache and its counters. Safe to call at any
+// time; applies to this library only, or with a shared runtime attached to
+// the runtime's caches.
+SIM_API void sim_set_crypto_cache(SimCryptoCacheKind kind, uint32_t entries);
+
+// Read a crypto cache's counters.
+SIM_API void sim_get_crypto_cache_stats(SimCryptoCacheKind kind, SimCryptoCacheStats* out);
+
+// ============================================================================
+// Radio Airtime
+// ============================================================================
+
+#define SIM_AIRTIME_TABLE_LEN 256   // Payload lengths 0..255
+
+// Fill out_ms[len] with the time on air in milliseconds that the shim's radio
+// uses for a `len`-byte packet with these settings (bandwidth in kHz, as in
+// SimNodeConfig), for len < min(count, SIM_AIRTIME_TABLE_LEN). Returns the
+// number of entries written. Coordinators use it to model channel occupancy
+// with exactly the firmware's numbers.
+SIM_API size_t sim_get_airtime_table(float bw_khz, uint8_t sf, uint8_t cr,
+                                     uint32_t* out_ms, size_t count);
+
+// ============================================================================
+// Shared Runtime API
+// ============================================================================
+
+// Function table of the shared runtime library (sim_runtime.h)
+typedef struct SimRuntimeApi SimRuntimeApi;
+
+// Route this library's crypto caches, airtime tables and fiber worker pool
+// through a shared runtime (from its sim_runtime_get()), so they are shared
+// with every other library attached to it. NULL detaches. Returns 1, or 0 if
+// the table's ABI is incompatible and the library keeps its own services.
+// Attach right after loading the library: work queued or cached before
+// stays with the library's own services. The runtime must stay loaded while
+// attached.
+SIM_API int sim_attach_runtime(const SimRuntimeApi* runtime);
+
 // ============================================================================
 // Async Step API
 // ============================================================================
@@ -141,6 +426,30 @@ SIM_API SimStepResult sim_step_wait(SimNodeHandle node);
 // Combined step (blocking): equivalent to sim_step_begin() + sim_step_wait()
 SIM_API SimStepResult sim_step(SimNodeHandle node, uint64_t sim_millis, uint32_t sim_rtc_secs);
 
+// One entry of a batched step
+typedef struct {
+    SimNodeHandle node;
+    uint64_t sim_millis;
+    uint32_t sim_rtc_secs;
+} SimStepRequest;
+
+// Step several nodes created by this library and wait for all of them.
+// results[i] receives the result for requests[i]. Equivalent to calling
+// sim_step_begin() on every node and then sim_step_wait() on every node, but
+// with one FFI call and a single wait. SIM_EXEC_FIBER nodes are spread over
+// the work-stealing fiber pool; SIM_EXEC_THREAD nodes run on their own
+// threads. Each node may appear at most once per batch.
+SIM_API void sim_step_batch(const SimStepRequest* requests, SimStepResult* results, size_t count);
+
+// The wake_millis of the node's last step, read without entering the node
+// (a hibernating node stays asleep). Steps that ended without a wake time
+// (TX start, reboot, power off) report their own time, and a node not yet
+// stepped since creation, reboot or restore reports 0: step it now. If
+// inputs_pending is not NULL, it is set to 1 when a packet, serial input or
+// radio state change arrived since that step, so the node should be stepped
+// before its wake time, else 0. Call while the node is not stepping.
+SIM_API uint64_t sim_peek_next_wake(SimNodeHandle node, int* inputs_pending);
+
 // ============================================================================
 // Event Injection API (call before sim_step_begin)
 // ============================================================================
@@ -150,6 +459,21 @@ SIM_API void sim_inject_radio_rx(SimNodeHandle node,
                                   const uint8_t* data, size_t len,
                                   float rssi, float snr);
 
+// One receiver of a batched radio injection
+typedef struct {
+    SimNodeHandle node;
+    float rssi;
+    float snr;
+} SimRxTarget;
+
+// Inject the same received packet into several nodes created by this library,
+// each with its own RSSI/SNR. The payload is copied once into a shared,
+// reference-counted buffer that every receiver's RX queue points at, so the
+// cost does not grow with the number of receivers. Receivers whose queue is
+// full drop the packet, exactly as with sim_inject_radio_rx().
+SIM_API void sim_inject_radio_rx_batch(const SimRxTarget* targets, size_t count,
+                                        const uint8_t* data, size_t len);
+
 // Inject received serial data (as if received from TCP bridge).
 SIM_API void sim_inject_serial_rx(SimNodeHandle node,
                                    const uint8_t* data, size_t len);
@@ -163,6 +487,67 @@ SIM_API void sim_inject_serial_frame(SimNodeHandle node,
 SIM_API size_t sim_collect_serial_frame(SimNodeHandle node,
                                          uint8_t* buffer, size_t max_len);
 
+// Location of one frame inside a contiguous frame buffer
+typedef struct {
+    uint32_t offset;              // Byte offset of the frame in the buffer
+    uint32_t len;                 // Frame length in bytes
+} SimFrameSpan;
+
+// Inject several serial frames in one call. frames[i] locates frame i inside
+// the data_len bytes at data. Frames are queued in order; the first one that
+// is empty, longer than SIM_MAX_SERIAL_FRAME, extends past data_len or does
+// not fit in the queue stops the call. Returns the number of frames queued.
+SIM_API size_t sim_inject_serial_frames(SimNodeHandle node,
+                                         const uint8_t* data, size_t data_len,
+                                         const SimFrameSpan* frames, size_t count);
+
+// Collect pending transmitted frames in one call. Frames are copied back to
+// back into buffer and described in frames[], oldest first, until max_frames
+// are taken or the next frame does not fit in buffer_len. Returns the number
+// of frames collected; SimStepResult.serial_frames_pending says how many were
+// pending after the step.
+SIM_API size_t sim_collect_serial_frames(SimNodeHandle node,
+                                          uint8_t* buffer, size_t buffer_len,
+                                          SimFrameSpan* frames, size_t max_frames);
+
+// Longest CLI command line accepted by sim_inject_cli_line() (the firmware's
+// command buffer less its NUL)
+#define SIM_MAX_CLI_LINE 159
+
+// sim_inject_cli_line() flags
+#define SIM_CLI_ECHO 0x01         // Echo the line and its reply to Serial, as for typed input
+
+// Queue a CLI command line (without a line terminator) for the repeater or
+// room server, bypassing the firmware's byte-at-a-time Serial reader. Every
+// queued line is run through the command handler at the start of the next
+// step, before the mesh loop. Its reply is queued as one frame holding the
+// reply text and a NUL (a lone NUL when there is none): collect replies, one
+// per line and in order, with sim_collect_serial_frames(), and
+// SimStepResult.serial_frames_pending counts them. Nothing is written to
+// Serial unless flags has SIM_CLI_ECHO. Lines wait while the reply queue is
+// full. Returns 1 if queued, 0 if the line is too long, the queue is full or
+// the firmware has no CLI (companion).
+SIM_API int sim_inject_cli_line(SimNodeHandle node, const char* line, uint32_t flags);
+
+// Collect serial TX output that did not fit in the last step result (its
+// serial_tx_pending bytes). Copies up to max_len bytes, oldest first, and
+// returns the number copied. Whatever is left is returned at the start of the
+// next step's serial_tx_data, with its SIM_STEP_EVENT_SERIAL_TX chunks at the
+// start of that step's events, so no output is lost either way. Once
+// SIM_MAX_SERIAL_TX_BACKLOG bytes are queued the node stops running its
+// firmware and yields SIM_YIELD_SERIAL_BACKPRESSURE until they drain. Call
+// while the node is not stepping.
+SIM_API size_t sim_collect_serial_tx(SimNodeHandle node,
+                                      uint8_t* buffer, size_t max_len);
+
+// Log callback for SIM_LOG_STREAM. Called on the node's thread (or fiber
+// worker) during a step, once per Serial write; data is not NUL-terminated.
+typedef void (*SimLogSinkFn)(void* user, const char* data, size_t len);
+
+// Set the log callback used when the node's log_mode is SIM_LOG_STREAM
+// (NULL discards). Call while the node is not stepping; it survives reboots.
+SIM_API void sim_set_log_sink(SimNodeHandle node, SimLogSinkFn sink, void* user);
+
 // Notify that a previous TX completed (coordinator confirms propagation done)
 SIM_API void sim_notify_tx_complete(SimNodeHandle node);
 
@@ -180,6 +565,203 @@ SIM_API const char* sim_get_node_type(void);
 // Get the public key of the node (after creation)
 SIM_API void sim_get_public_key(SimNodeHandle node, uint8_t* out_key);
 
+typedef struct {
+    uint64_t allocations;         // Blocks allocated since creation
+    uint64_t frees;               // Blocks freed individually
+    uint64_t live_bytes;          // Bytes currently allocated
+    uint64_t peak_bytes;          // Highest live_bytes since creation
+    uint64_t reserved_bytes;      // Memory the heap holds from the system
+    uint64_t resets;              // Reboots that reclaimed the whole heap
+} SimHeapStats;
+
+// Read the counters of a node's heap (SimNodeConfig.node_heap; all zero when
+// disabled). Call while the node is not stepping.
+SIM_API void sim_get_heap_stats(SimNodeHandle node, SimHeapStats* out);
+
+typedef struct {
+    uint64_t coordinator_spin_waits;   // Step waits satisfied without sleeping
+    uint64_t coordinator_parked_waits; // Step waits that slept until the node yielded
+    uint64_t node_spin_waits;          // Node thread waits for a step ended while spinning
+    uint64_t node_parked_waits;        // Node thread waits that slept until the step began
+} SimHandoffStats;
+
+// Read how a node's step handoffs were satisfied (see sim_set_step_spin()).
+// Fiber nodes are woken by the scheduler and only count coordinator waits.
+SIM_API void sim_get_handoff_stats(SimNodeHandle node, SimHandoffStats* out);
+
+// Buckets of SimNodeStats.step_cpu_histogram
+#define SIM_STEP_CPU_BUCKETS 16
+
+typedef struct {
+    // Steps
+    uint64_t steps;                      // Steps since creation, skipped ones included
+    uint64_t skipped_steps;              // Steps answered without running loop()
+                                         // (SimNodeConfig.skip_idle_steps)
+    uint64_t budget_exhausted_steps;     // Steps cut short by the step budget
+    uint64_t loop_iterations;            // loop() calls across all steps
+    uint32_t max_loop_iterations;        // Most loop() calls in one step
+    uint32_t spin_detections;            // Radio polls that hit the spin threshold
+    
+    // Host CPU time of the thread running each step (ns). Skipped steps are
+    // not timed. Mean = step_cpu_total_ns / (steps - skipped_steps).
+    uint64_t step_cpu_total_ns;
+    uint64_t step_cpu_min_ns;
+    uint64_t step_cpu_max_ns;
+    uint64_t step_cpu_histogram[SIM_STEP_CPU_BUCKETS];
+                                         // Timed steps by CPU time: bucket 0 under
+                                         // 1 us, bucket i under 2^i us, the last
+                                         // bucket everything longer
+    
+    // Radio
+    uint32_t packets_recv;               // Packets the firmware received
+    uint32_t packets_sent;               // Packets the firmware transmitted
+    uint32_t packets_recv_errors;
+    uint32_t rx_dropped;                 // Injected packets dropped on a full RX queue
+    uint32_t rx_queue_high_water;        // Most packets queued at once
+    uint32_t tx_airtime_ms;              // Estimated airtime of the packets sent
+    uint32_t rx_airtime_ms;              // Estimated airtime of the packets received
+    uint32_t _padding;
+    
+    // Serial (byte stream and frames)
+    uint64_t serial_rx_bytes;            // Injected bytes queued for the firmware
+    uint64_t serial_rx_dropped;          // Injected bytes dropped on a full buffer
+    uint64_t serial_tx_bytes;            // Bytes the firmware wrote
+    
+    // Crypto, counted at the stubs (cache hits included)
+    uint64_t ed25519_verifies;
+    uint64_t ed25519_signs;
+    uint64_t key_exchanges;              // ECDH shared secrets
+    uint64_t aes_blocks;                 // 16-byte blocks encrypted or decrypted
+    uint64_t sha256_blocks;              // 64-byte blocks compressed
+    uint64_t hmacs;                      // HMAC-SHA256 computations
+    
+    // Filesystem, firmware access only (not sim_fs_*())
+    uint64_t fs_opens;
+    uint64_t fs_bytes_read;
+    uint64_t fs_bytes_written;           // Stand-in for flash wear
+    uint64_t fs_bytes_copied;            // Copy-on-write of shared file contents
+    uint64_t fs_bytes_committed;         // Write-back: bytes stored when staged files were
+                                         // committed (compare with fs_bytes_written)
+    uint64_t fs_rewrites_coalesced;      // Write-back: rewrites folded into one pending commit
+    
+    // Arduino String, blocks taken from the heap (short strings stay inline)
+    uint64_t string_heap_allocs;
+    uint64_t string_heap_bytes;
+    
+    // Packet-seen (dedup) table: duplicates found, new packets recorded, and
+    // live entries those pushed out of the ring
+    uint64_t mesh_seen_hits;
+    uint64_t mesh_seen_misses;
+    uint64_t mesh_seen_evictions;
+} SimNodeStats;
+
+// Read a node's runtime counters. Call while the node is not stepping.
+SIM_API void sim_get_stats(SimNodeHandle node, SimNodeStats* out);
+
+// ============================================================================
+// Tracing API
+// ============================================================================
+// Tracepoints inside the step (loop(), radio, filesystem, crypto, serial
+// formatting). Each host thread records into its own lock-free ring; the
+// coordinator drains all rings. Off until enabled, and compiled out entirely
+// with -DSIM_TRACEPOINTS=0.
+
+typedef enum {
+    SIM_TRACE_STEP = 1 << 0,      // Steps and loop() calls
+    SIM_TRACE_RADIO = 1 << 1,     // Packets received and transmitted
+    SIM_TRACE_FS = 1 << 2,        // File opens, reads, writes, flushes
+    SIM_TRACE_CRYPTO = 1 << 3,    // Ed25519, AES128, SHA256
+    SIM_TRACE_SERIAL = 1 << 4,    // Serial formatting and writes
+    SIM_TRACE_ALL = 0x1F
+} SimTraceCategory;
+
+typedef struct {
+    SimNodeHandle node;           // Node running on the thread (NULL if none)
+    const char* name;             // Tracepoint name (static, lives as long as the library)
+    uint64_t wall_start_ns;       // Host monotonic clock
+    uint64_t wall_duration_ns;    // 0 for instant events
+    uint64_t sim_millis;          // Simulation time of the node's step
+    uint32_t category;            // SimTraceCategory
+    uint32_t thread;              // Host thread, numbered in order of first event
+} SimTraceEvent;
+
+// Record the categories in `categories` (0 = stop). Each thread's ring holds
+// events_per_thread events (0 = 8192) until drained; events that do not fit
+// are dropped. The capacity applies to rings created afterwards.
+SIM_API void sim_trace_enable(uint32_t categories, uint32_t events_per_thread);
+
+// Move up to max_events recorded events into `out`, oldest first per
+// thread. Returns the number written. Call from one thread at a time.
+SIM_API size_t sim_trace_drain(SimTraceEvent* out, size_t max_events);
+
+// Events dropped on full rings since the library was loaded
+SIM_API uint64_t sim_trace_dropped(void);
+
+// ============================================================================
+// Benchmark API
+// ============================================================================
+// Shim primitives the firmware reaches only indirectly, timed inside the
+// library so they run with its build flags and crypto acceleration. Used by
+// simulator/bench/sim_bench.cpp.
+
+typedef enum {
+    SIM_BENCH_FS_WRITE = 0,       // Open for writing, write 256 bytes, close
+    SIM_BENCH_FS_READ,            // Open for reading, read 256 bytes, close
+    SIM_BENCH_AIRTIME,            // Radio airtime estimate for one length (1..255)
+    SIM_BENCH_ED25519_SIGN,       // Sign a 64-byte message
+    SIM_BENCH_ED25519_VERIFY,     // Verify that signature (through the verify cache)
+    SIM_BENCH_KEY_EXCHANGE,       // ECDH shared secret (through the ECDH cache)
+    SIM_BENCH_AES128,             // Encrypt 16 blocks (256 bytes)
+    SIM_BENCH_SHA256,             // Hash 256 bytes
+    SIM_BENCH_HMAC_SHA256,        // HMAC of 256 bytes with a 32-byte key
+    SIM_BENCH_KERNEL_COUNT
+} SimBenchKernel;
+
+// Run `kernel` `iterations` times on the calling thread with the node's
+// filesystem, radio settings and heap bound, and return the elapsed host time
+// in nanoseconds (0 for an unknown kernel). The filesystem kernels use a
+// scratch file that is removed afterwards; the node's counters are left
+// unchanged. Call while the node is not stepping.
+SIM_API uint64_t sim_bench_kernel(SimNodeHandle node, uint32_t kernel, uint64_t iterations);
+
+// Run `operations` random hasSeen()/clear()/saveTo()+restoreFrom() calls,
+// seeded by `seed`, on the shim's hashed packet-seen table and on MeshCore's
+// linear SimpleMeshTables side by side. Returns 0 if every result, duplicate
+// count and saved file matched, else the 1-based number of the first
+// operation that differed (operations + 1 for the final saved files).
+SIM_API uint32_t sim_check_mesh_tables(uint64_t seed, uint32_t operations);
+
+// ============================================================================
+// Replay API
+// ============================================================================
+// A node created with SimNodeConfig.record_path logs every call that feeds
+// it (see sim_record.h) until it is destroyed or restored from a snapshot.
+// Replaying that log runs the same firmware history on its own: no
+// coordinator, propagation or other nodes, and no waiting on anything but
+// the node itself. Each step's reason, wake time and outputs (radio TX,
+// serial TX, log text) and each collection of serial output are compared
+// with the recording, flagging where a changed firmware diverges.
+
+typedef struct {
+    uint64_t steps;                   // Steps replayed
+    uint64_t diverged;                // Steps and serial collections whose output differed
+    uint64_t first_divergence;        // Index of the step at (or after) the first
+                                      // difference (UINT64_MAX = none)
+    uint64_t first_divergence_millis; // Sim time of that step
+    uint32_t expected_reason;         // SimYieldReason recorded for that step
+    uint32_t actual_reason;           // SimYieldReason the replay returned
+    uint64_t expected_wake_millis;
+    uint64_t actual_wake_millis;
+    uint64_t replay_ns;               // Host time the replay took
+} SimReplayResult;
+
+// Replay the log at `path` on a new node of this library, which is destroyed
+// afterwards. The node starts from the recorded files and config; it does not
+// use the sim_set_fs_dir() directory. Returns 0 if every output matched, 1 if
+// some diverged, -1 if the log cannot be read or is for another node type
+// (`out` is filled in as far as the replay got).
+SIM_API int sim_replay(const char* path, SimReplayResult* out);
+
 // ============================================================================
 // Filesystem API (for coordinator to pre-populate or inspect)
 // ============================================================================
@@ -194,12 +776,44 @@ SIM_API int sim_fs_write(SimNodeHandle node, const char* path,
 SIM_API int sim_fs_read(SimNodeHandle node, const char* path,
                          uint8_t* data, size_t max_len);
 
-// Check if a file exists.
+// Check if a file, or a directory holding files, exists.
 SIM_API int sim_fs_exists(SimNodeHandle node, const char* path);
 
 // Delete a file.
 SIM_API int sim_fs_remove(SimNodeHandle node, const char* path);
 
+// A filesystem image is a set of files many nodes start from. Nodes created
+// with SimNodeConfig.fs_image reference the image's file contents instead of
+// copying them; a node's first change to a file gives it a private copy, so
+// per-node storage holds only what that node's firmware changed. Writing to
+// the image afterwards only affects nodes created later. The image may be
+// released as soon as its nodes are created.
+SIM_API SimFsImageHandle sim_fs_image_create(void);
+
+// Add or replace a file in the image. Returns bytes written, or -1 on error.
+SIM_API int sim_fs_image_write(SimFsImageHandle image, const char* path,
+                               const uint8_t* data, size_t len);
+
+// Release the image. Nodes keep the files they were created with.
+SIM_API void sim_fs_image_release(SimFsImageHandle image);
+
+// Keep each node's files in a memory-mapped file "<dir>/<node_name>.simfs"
+// (the public key in hex for unnamed nodes). Applies to nodes of this
+// library created afterwards; NULL or "" goes back to in-memory only. A node
+// created over an existing file resumes its files, which take precedence
+// over SimNodeConfig.fs_image. Writes reach the file lazily. A file is used
+// by one node at a time; a fork keeping its source's name stays in memory.
+SIM_API void sim_set_fs_dir(const char* dir);
+
+// Write the node's persistent files back to disk and wait for them.
+// Returns 0 on success, -1 if the node has no persistent files or on error.
+SIM_API int sim_fs_flush(SimNodeHandle node);
+
+// Pointer to a file's stored bytes without copying, or NULL if it does not
+// exist. Valid until the node is next stepped or rebooted, or its
+// filesystem is changed.
+SIM_API const uint8_t* sim_fs_view(SimNodeHandle node, const char* path, size_t* len);
+
 #ifdef __cplusplus
 }
 #endif
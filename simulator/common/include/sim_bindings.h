@@ -0,0 +1,103 @@
+#pragma once
+
+// ============================================================================
+// Firmware Global Bindings
+// ============================================================================
+// Firmware code refers to the globals board, radio_driver, rtc_clock and
+// sensors (redirected by sim_prefix.h to _sim_board_instance, etc.). The real
+// hardware objects are owned by each SimNodeImpl; the globals are thin
+// forwarding objects that dispatch to whichever node is currently bound to
+// the executing thread.
+//
+// Binding is done once per thread in SIM_EXEC_THREAD mode and on every
+// resume in SIM_EXEC_FIBER mode, so unmodified firmware keeps seeing
+// per-node globals no matter which worker thread runs it.
+//
+// Forwarders look up the binding on every call (they are defined out of line
+// in sim_bindings.cpp), so references captured by firmware at construction
+// time, e.g. CommonCLI's board pointer, stay correct after a fiber migrates.
+
+#include "sim_board.h"
+#include "sim_radio.h"
+#include "sim_clock.h"
+#include "helpers/SensorManager.h"
+
+struct SimContext;
+class SimHeap;
+class EnvironmentSensorManager;
+
+/// The set of per-node objects visible to firmware on the current thread.
+struct SimNodeBindings {
+    SimContext* ctx = nullptr;
+    SimBoard* board = nullptr;
+    SimRadio* radio = nullptr;
+    SimRTCClock* rtc = nullptr;
+    EnvironmentSensorManager* sensors = nullptr;
+    SimHeap* heap = nullptr;        // nullptr = allocate from the global heap
+};
+
+/// Install `bindings` as the current thread's firmware globals (including
+/// g_sim_ctx and g_sim_heap) and return the previous bindings so they can be restored.
+SimNodeBindings simBindNode(const SimNodeBindings& bindings);
+
+// ============================================================================
+// Forwarding globals
+// ============================================================================
+
+class SimBoardBinding : public mesh::MainBoard {
+public:
+    uint16_t getBattMilliVolts() override;
+    const char* getManufacturerName() const override;
+    void reboot() override;
+    void powerOff() override;
+    uint8_t getStartupReason() const override;
+};
+
+class SimRadioBinding : public mesh::Radio {
+public:
+    void configure(float freq, float bw, uint8_t sf, uint8_t cr, uint8_t tx_power);
+
+    // mesh::Radio interface
+    void begin() override;
+    int recvRaw(uint8_t* bytes, int sz) override;
+    uint32_t getEstAirtimeFor(int len_bytes) override;
+    float packetScore(float snr, int packet_len) override;
+    bool startSendRaw(const uint8_t* bytes, int len) override;
+    bool isSendComplete() override;
+    void onSendFinished() override;
+    bool isInRecvMode() const override;
+    bool isReceiving() override;
+    float getLastRSSI() const override;
+    float getLastSNR() const override;
+    int getNoiseFloor() const override;
+
+    // Statistics interface (used by firmware)
+    uint32_t getPacketsRecv() const;
+    uint32_t getPacketsSent() const;
+    uint32_t getPacketsRecvErrors() const;
+    void resetStats();
+    uint32_t getTotalTxAirtime() const;
+    uint32_t getTotalRxAirtime() const;
+};
+
+class SimRTCBinding : public mesh::RTCClock {
+public:
+    uint32_t getCurrentTime() override;
+    void setCurrentTime(uint32_t time) override;
+    void tick() override;
+};
+
+// The location fields are plain data members that firmware reads and writes
+// directly, so they live on the binding and are swapped in and out with the
+// node's own sensor manager by simBindNode().
+class SimSensorsBinding : public SensorManager {
+public:
+    bool begin() override;
+    void loop() override;
+    bool querySensors(uint8_t requester_permissions, CayenneLPP& telemetry) override;
+    int getNumSettings() const override;
+    const char* getSettingName(int idx) const override;
+    const char* getSettingValue(int idx) const override;
+    bool setSettingValue(const char* name, const char* value) override;
+    LocationProvider* getLocationProvider() override;
+};
@@ -55,3 +55,11 @@ public:
 private:
     uint32_t current_time_;
 };
+
+// ============================================================================
+// Thread CPU Time
+// ============================================================================
+// Host CPU time consumed by the calling thread, in nanoseconds, for the
+// per-step accounting in sim_get_stats(). Unrelated to simulated time.
+
+uint64_t simThreadCpuNanos();
@@ -15,16 +15,18 @@
 #include "sim_rng.h"
 #include "sim_serial.h"
 #include "sim_filesystem.h"
+#include "sim_handoff.h"
+#include "sim_op_stats.h"
 
 #include <mutex>
 #include <condition_variable>
 #include <cstring>
 #include <thread>
 #include <atomic>
+#include <deque>
 #include <queue>
 #include <string>
 #include <vector>
-#include <set>
 #include <cstdint>
 
 // ============================================================================
@@ -55,6 +57,27 @@ struct SpinDetectionConfig {
 
     /// Track total loop iterations across all steps.
     uint64_t total_loop_iterations = 0;
+
+    /// Track steps answered without running loop() because no input changed
+    /// since the last idle step (SimNodeConfig.skip_idle_steps).
+    uint64_t skipped_steps = 0;
+};
+
+// ============================================================================
+// Log Configuration
+// ============================================================================
+// Where Serial output goes for this node. Applied from SimNodeConfig at
+// start and reboot; the sink is set separately with sim_set_log_sink().
+
+struct LogConfig {
+    SimLogMode mode = SIM_LOG_BUFFER;
+
+    /// Callback for SIM_LOG_STREAM (no callback = discard).
+    SimLogSinkFn sink = nullptr;
+    void* sink_user = nullptr;
+
+    /// Drop Serial output instead of reporting it as serial TX.
+    bool discard_serial_tx = false;
 };
 
 // ============================================================================
@@ -62,30 +85,111 @@ struct SpinDetectionConfig {
 // ============================================================================
 // Tracks scheduled wake times for deterministic time advancement.
 // Each node has its own registry to track when it needs to wake up.
+// A node has few timers, so they are kept in a small sorted array: no
+// allocation, and expired times come off the front in one move. When the
+// array is full the latest time is dropped; the node then wakes no later
+// than its idle wake interval instead.
 
 struct WakeTimeRegistry {
-    std::set<uint64_t> pending_wake_times;
+    static constexpr size_t CAPACITY = 16;
+
+    uint64_t times[CAPACITY];
+    size_t count = 0;
 
     void registerWakeTime(uint64_t millis) {
-        pending_wake_times.insert(millis);
+        size_t pos = 0;
+        while (pos < count && times[pos] < millis) pos++;
+        if (pos < count && times[pos] == millis) {
+            return;
+        }
+        if (pos == CAPACITY) {
+            return;
+        }
+        size_t last = count < CAPACITY ? count : CAPACITY - 1;
+        memmove(&times[pos + 1], &times[pos], (last - pos) * sizeof(times[0]));
+        times[pos] = millis;
+        if (count < CAPACITY) count++;
     }
 
     uint64_t getNextWakeTime() const {
-        if (pending_wake_times.empty()) {
-            return UINT64_MAX;
-        }
-        return *pending_wake_times.begin();
+        return count ? times[0] : UINT64_MAX;
     }
 
     void clearExpired(uint64_t current_millis) {
-        auto it = pending_wake_times.begin();
-        while (it != pending_wake_times.end() && *it <= current_millis) {
-            it = pending_wake_times.erase(it);
+        size_t expired = 0;
+        while (expired < count && times[expired] <= current_millis) expired++;
+        if (expired) {
+            memmove(&times[0], &times[expired], (count - expired) * sizeof(times[0]));
+            count -= expired;
         }
     }
 
     void clear() {
-        pending_wake_times.clear();
+        count = 0;
+    }
+};
+
+// ============================================================================
+// Wake Statistics
+// ============================================================================
+// Counts how idle wake times were chosen, for measuring how many steps the
+// deadline tracking saves compared with fixed SIM_DEFAULT_IDLE_WAKE_MS polling.
+
+struct WakeStats {
+    /// Idle yields that woke at a known firmware deadline.
+    uint64_t deadline_wakes = 0;
+
+    /// Idle yields that fell back to the idle wake interval.
+    uint64_t interval_wakes = 0;
+
+    /// Steps a fixed SIM_DEFAULT_IDLE_WAKE_MS poll would have taken that
+    /// were skipped because the node slept longer.
+    uint64_t steps_avoided = 0;
+};
+
+// ============================================================================
+// Node Statistics
+// ============================================================================
+// Per-step CPU time and serial traffic, reported by sim_get_stats() together
+// with the spin, wake and radio counters kept elsewhere.
+
+struct StepStats {
+    /// Steps run, including those skipped as unchanged.
+    uint64_t steps = 0;
+
+    /// Most loop() calls in one step.
+    uint32_t max_loop_iterations = 0;
+
+    /// Steps ended by SimNodeConfig's step budget.
+    uint64_t budget_exhausted = 0;
+
+    /// Thread CPU time of the timed (not skipped) steps, in nanoseconds.
+    uint64_t cpu_total_ns = 0;
+    uint64_t cpu_min_ns = UINT64_MAX;
+    uint64_t cpu_max_ns = 0;
+    uint64_t cpu_histogram[SIM_STEP_CPU_BUCKETS] = {};
+
+    /// Serial traffic, both the byte stream and frames.
+    uint64_t serial_rx_bytes = 0;
+    uint64_t serial_rx_dropped = 0;
+    uint64_t serial_tx_bytes = 0;
+
+    /// Account one timed step.
+    void recordCpu(uint64_t ns) {
+        cpu_total_ns += ns;
+        if (ns < cpu_min_ns) cpu_min_ns = ns;
+        if (ns > cpu_max_ns) cpu_max_ns = ns;
+        uint32_t bucket = 0;
+        for (uint64_t us = ns / 1000; us > 0 && bucket < SIM_STEP_CPU_BUCKETS - 1; us >>= 1) {
+            bucket++;
+        }
+        cpu_histogram[bucket]++;
+    }
+
+    /// Account an injection of `len` bytes of which `accepted` were queued.
+    void recordSerialRx(size_t len, size_t accepted) {
+        serial_rx_bytes += accepted;
+        serial_rx_dropped += len - accepted;
     }
 };
 
@@ -96,7 +200,12 @@ struct WakeTimeRegistry {
 // This allows the Arduino stubs and firmware code to access the correct
 // instance's state without requiring code changes to the firmware.
 
+class SimPacketManager;
+
 struct SimContext {
+    // Node owning this context, for tagging trace events
+    SimNodeHandle node = nullptr;
+
     // Subsystems (implementations of MeshCore interfaces)
     SimRadio radio;
     SimBoard board;
@@ -112,6 +221,23 @@ struct SimContext {
     // Spin detection configuration for deterministic work per step
     SpinDetectionConfig spin_config;
 
+    // Idle wake bookkeeping
+    WakeStats wake_stats;
+
+    // Step timing and serial traffic (sim_get_stats())
+    StepStats step_stats;
+
+    // Crypto and filesystem work (sim_get_stats())
+    SimOpStats op_stats;
+    
+    // Log output routing
+    LogConfig log_config;
+
+    // Firmware packet manager, registered by SimPacketManager so the idle
+    // logic can see packets that are due but not yet sent, and when the next
+    // queued one is due
+    SimPacketManager* packet_manager = nullptr;
+
     // Current simulation time
     uint64_t current_millis;
     uint32_t current_rtc_secs;
@@ -119,25 +245,41 @@ struct SimContext {
     // Step result (accumulated during step)
     SimStepResult step_result;
 
-    // Log buffer for Serial output
-    std::string log_buffer;
-    std::mutex log_mutex;
+    // Output of the last completed step; step_result points into these.
+    // finalizeStepResult() swaps them with the accumulation buffers, so
+    // capacity is reused and nothing is copied.
+    std::string result_log;
+    std::vector<uint8_t> result_serial_tx;
+    std::vector<SimStepEvent> result_events;
 
-    // Serial TX buffer
+    // Accumulation buffers for Serial output. Only the node's own thread (or
+    // fiber) touches them, while it owns the step, so they take no locks;
+    // the coordinator reads the result buffers after the step handoff.
+    std::string log_buffer;
     std::vector<uint8_t> serial_tx_buffer;
-    std::mutex serial_tx_mutex;
+    size_t serial_tx_read = 0;      // serial_tx_buffer bytes already handed out
 
-    // Thread synchronization
+    // Events of the current step, in order. Serial chunks carry only their
+    // length until finalizeStepResult() points them into result_serial_tx.
+    std::vector<SimStepEvent> step_events;
+    size_t serial_event_mark = 0;   // serial_tx_buffer bytes covered by chunks
+
+    // Lengths of the chunks of earlier steps whose bytes are still queued,
+    // oldest first. They lead the events of the step that publishes them.
+    std::deque<size_t> serial_tx_chunks;
+
+    // Serial writes so far, including dropped ones. runStep() compares it
+    // across loop iterations to detect output, independent of capture.
+    uint64_t console_writes = 0;
+
+    // Thread synchronization. The step state has its own spin-then-park
+    // handoff; step_mutex and step_cv cover the rarer first boot, fiber
+    // exit and batch bookkeeping.
     std::mutex step_mutex;
     std::condition_variable step_cv;
 
-    enum class State {
-        IDLE,           // Waiting for step_begin
-        RUNNING,        // Processing loop
-        YIELDED,        // Completed step, waiting for result retrieval
-        SHUTDOWN        // Thread should exit
-    };
-    std::atomic<State> state{State::IDLE};
+    using State = SimStepState;
+    SimStepHandoff state;
 
     // Initialization
     SimContext() : current_millis(0), current_rtc_secs(0) {
@@ -146,43 +288,215 @@ struct SimContext {
 
     // Append to log buffer (called by Serial.print stub)
     void appendLog(const char* str, size_t len) {
-        std::lock_guard<std::mutex> lock(log_mutex);
-        log_buffer.append(str, len);
+        static const size_t kMaxLog = SIM_MAX_LOG_OUTPUT - 1;
+        switch (log_config.mode) {
+        case SIM_LOG_OFF:
+            return;
+        case SIM_LOG_STREAM:
+            if (log_config.sink) {
+                log_config.sink(log_config.sink_user, str, len);
+            }
+            return;
+        case SIM_LOG_RING:
+            log_buffer.append(str, len);
+            // Trim in bulk so the buffer stays bounded without shifting
+            // on every write
+            if (log_buffer.size() > 2 * kMaxLog) {
+                log_buffer.erase(0, log_buffer.size() - kMaxLog);
+            }
+            return;
+        default:
+            // Anything past the cap would be truncated when the step ends
+            if (log_buffer.size() < kMaxLog) {
+                log_buffer.append(str, (std::min)(len, kMaxLog - log_buffer.size()));
+            }
+            return;
+        }
+    }
+
+    // Serial TX queued and not yet handed out or collected
+    size_t serialTxPending() const {
+        return serial_tx_buffer.size() - serial_tx_read;
+    }
+
+    // True when the firmware must wait for the coordinator to take its
+    // serial output (SIM_YIELD_SERIAL_BACKPRESSURE)
+    bool serialTxBackedUp() const {
+        return serialTxPending() >= SIM_MAX_SERIAL_TX_BACKLOG;
+    }
+
+    // Pop up to max_len bytes of serial TX left over from the last step
+    // result, with the chunks that described them. Called by the
+    // coordinator between steps.
+    size_t collectSerialTx(uint8_t* out, size_t max_len) {
+        size_t len = (std::min)(serialTxPending(), max_len);
+        if (len > 0) {
+            memcpy(out, serial_tx_buffer.data() + serial_tx_read, len);
+            for (size_t left = len; left > 0 && !serial_tx_chunks.empty();) {
+                size_t& chunk = serial_tx_chunks.front();
+                if (chunk > left) {
+                    chunk -= left;
+                    break;
+                }
+                left -= chunk;
+                serial_tx_chunks.pop_front();
+            }
+            dropSerialTx(len);
+        }
+        return len;
     }
 
-    // Append to serial TX buffer
-    void appendSerialTx(const uint8_t* data, size_t len) {
-        std::lock_guard<std::mutex> lock(serial_tx_mutex);
-        serial_tx_buffer.insert(serial_tx_buffer.end(), data, data + len);
+    // Mark len queued bytes as taken. The buffer only moves once the taken
+    // bytes are the larger part, so each byte is moved at most once.
+    void dropSerialTx(size_t len) {
+        serial_tx_read += len;
+        if (serial_event_mark < serial_tx_read) {
+            serial_event_mark = serial_tx_read;
+        }
+        if (serial_tx_read == serial_tx_buffer.size()) {
+            serial_tx_buffer.clear();
+            serial_tx_read = 0;
+            serial_event_mark = 0;
+        } else if (serial_tx_read > serial_tx_buffer.size() / 2) {
+            serial_tx_buffer.erase(serial_tx_buffer.begin(),
+                                   serial_tx_buffer.begin() + serial_tx_read);
+            serial_event_mark -= serial_tx_read;
+            serial_tx_read = 0;
+        }
     }
 
-    // Get current serial TX buffer size (for output tracking)
-    size_t getSerialTxBufferSize() const {
-        // Note: This method is intended to be called from the same thread
-        // that writes to the buffer (during loop execution), so no lock needed
-        return serial_tx_buffer.size();
+    // Serial output from the firmware: one bulk append to the serial TX
+    // stream plus the optional log tee
+    void writeConsole(const uint8_t* data, size_t len) {
+        console_writes++;
+        step_stats.serial_tx_bytes += len;
+        if (!log_config.discard_serial_tx) {
+            serial_tx_buffer.insert(serial_tx_buffer.end(), data, data + len);
+        }
+        appendLog(reinterpret_cast<const char*>(data), len);
+    }
+
+    // True when Serial output has no consumer at all, so it need not even
+    // be formatted
+    bool discardsConsole() const {
+        bool log_off = log_config.mode == SIM_LOG_OFF ||
+                       (log_config.mode == SIM_LOG_STREAM && !log_config.sink);
+        return log_off && log_config.discard_serial_tx;
     }
 
-    // Collect accumulated output into step_result
+    // Give back the memory of the step buffers (sim_hibernate()). The last
+    // step result is dropped; serial output not yet collected is kept.
+    void releaseBuffers() {
+        memset(&step_result, 0, sizeof(step_result));
+        std::string().swap(result_log);
+        std::vector<uint8_t>().swap(result_serial_tx);
+        std::vector<SimStepEvent>().swap(result_events);
+        log_buffer.shrink_to_fit();
+        serial_tx_buffer.shrink_to_fit();
+        step_events.shrink_to_fit();
+    }
+
+    // Start a step with no events. Output written between steps (during a
+    // boot, say) goes into the step's first chunk.
+    void resetStepEvents() {
+        step_events.clear();
+    }
+
+    // Close the serial output written since the last event into a chunk
+    void markSerialEvent() {
+        if (serial_tx_buffer.size() > serial_event_mark) {
+            SimStepEvent event = {};
+            event.kind = SIM_STEP_EVENT_SERIAL_TX;
+            event.len = serial_tx_buffer.size() - serial_event_mark;
+            step_events.push_back(event);
+            serial_event_mark = serial_tx_buffer.size();
+        }
+    }
+
+    // Append an event, after any serial output that preceded it
+    void addStepEvent(const SimStepEvent& event) {
+        markSerialEvent();
+        step_events.push_back(event);
+    }
+
+    void addStepEvent(SimStepEventKind kind) {
+        SimStepEvent event = {};
+        event.kind = kind;
+        addStepEvent(event);
+    }
+
+    // Publish accumulated output through step_result
     void finalizeStepResult() {
-        // Copy log buffer
+        markSerialEvent();
+
+        // Hand over the log buffer
         {
-            std::lock_guard<std::mutex> lock(log_mutex);
-            // Use (std::min) to prevent macro expansion
-            size_t copy_len = (std::min)(log_buffer.size(), sizeof(step_result.log_output) - 1);
-            memcpy(step_result.log_output, log_buffer.c_str(), copy_len);
-            step_result.log_output[copy_len] = '\0';
-            step_result.log_output_len = copy_len;
+            result_log.swap(log_buffer);
             log_buffer.clear();
+            // Use (std::min) to prevent macro expansion
+            size_t len = (std::min)(result_log.size(), static_cast<size_t>(SIM_MAX_LOG_OUTPUT - 1));
+            if (log_config.mode == SIM_LOG_RING) {
+                result_log.erase(0, result_log.size() - len);
+            }
+            result_log.resize(len);
+            step_result.log_output = result_log.c_str();
+            step_result.log_output_len = len;
         }
 
-        // Copy serial TX buffer
-        {
-            std::lock_guard<std::mutex> lock(serial_tx_mutex);
-            size_t copy_len = (std::min)(serial_tx_buffer.size(), sizeof(step_result.serial_tx_data));
-            memcpy(step_result.serial_tx_data, serial_tx_buffer.data(), copy_len);
-            step_result.serial_tx_len = copy_len;
+        // Hand over the oldest SIM_MAX_SERIAL_TX bytes of serial TX. The rest
+        // stays queued, in order, for sim_collect_serial_tx() or the next step.
+        size_t published = (std::min)(serialTxPending(), static_cast<size_t>(SIM_MAX_SERIAL_TX));
+        if (serial_tx_read == 0 && published == serial_tx_buffer.size()) {
+            result_serial_tx.swap(serial_tx_buffer);
             serial_tx_buffer.clear();
+            serial_event_mark = 0;
+        } else {
+            const uint8_t* front = serial_tx_buffer.data() + serial_tx_read;
+            result_serial_tx.assign(front, front + published);
+            dropSerialTx(published);
+        }
+        step_result.serial_tx_data = result_serial_tx.data();
+        step_result.serial_tx_len = result_serial_tx.size();
+        step_result.serial_tx_pending = serialTxPending();
+        step_result.serial_frames_pending = serial.txFrames().count();
+
+        // Point serial chunks into the published output: first the chunks
+        // earlier steps left queued, then this step's. Chunks (or their
+        // ends) past SIM_MAX_SERIAL_TX are queued for the next step.
+        {
+            result_events.clear();
+            size_t offset = 0;
+            auto publishChunk = [&](size_t len) {
+                size_t take = offset < published ? (std::min)(len, published - offset) : 0;
+                if (take > 0) {
+                    SimStepEvent event = {};
+                    event.kind = SIM_STEP_EVENT_SERIAL_TX;
+                    event.data = result_serial_tx.data() + offset;
+                    event.len = take;
+                    result_events.push_back(event);
+                    offset += take;
+                }
+                return take;
+            };
+            while (!serial_tx_chunks.empty() && offset < published) {
+                size_t& chunk = serial_tx_chunks.front();
+                chunk -= publishChunk(chunk);
+                if (chunk == 0) {
+                    serial_tx_chunks.pop_front();
+                }
+            }
+            for (const SimStepEvent& event : step_events) {
+                if (event.kind != SIM_STEP_EVENT_SERIAL_TX) {
+                    result_events.push_back(event);
+                    continue;
+                }
+                size_t left = event.len - publishChunk(event.len);
+                if (left > 0) {
+                    serial_tx_chunks.push_back(left);
+                }
+            }
+            step_result.events = result_events.data();
+            step_result.event_count = result_events.size();
         }
 
         step_result.current_millis = current_millis;
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+// ============================================================================
+// Hardware Crypto Kernels
+// ============================================================================
+// CPU instruction paths for the crypto stubs (AES.h, SHA256.h), chosen once
+// at runtime: AES-NI / SHA-NI on x86-64, the ARMv8 crypto extension on
+// aarch64 builds that target it. The stubs keep their portable code as the
+// fallback. Setting the environment variable SIM_NO_HW_CRYPTO=1 forces the
+// fallback, for comparisons and debugging.
+
+/// AES-128 kernels. Round keys use the FIPS-197 byte layout produced by
+/// AES128's key expansion (11 round keys of 16 bytes).
+struct SimAesAccel {
+    /// Derive the equivalent-inverse-cipher round keys used by decryptBlocks
+    void (*prepareDecryptKeys)(uint8_t* dec_round_keys, const uint8_t* round_keys);
+
+    /// ECB-encrypt `blocks` consecutive 16-byte blocks (in and out may alias)
+    void (*encryptBlocks)(const uint8_t* round_keys, uint8_t* out, const uint8_t* in,
+                          size_t blocks);
+
+    /// ECB-decrypt `blocks` consecutive 16-byte blocks (in and out may alias)
+    void (*decryptBlocks)(const uint8_t* dec_round_keys, uint8_t* out, const uint8_t* in,
+                          size_t blocks);
+};
+
+/// AES kernels for this CPU, or nullptr to use the portable code
+const SimAesAccel* simAesAccel();
+
+/// SHA-256 compression function
+struct SimShaAccel {
+    /// Run the compression function over `blocks` consecutive 64-byte blocks
+    void (*compressBlocks)(uint32_t* state, const uint8_t* data, size_t blocks);
+};
+
+/// SHA-256 kernel for this CPU, or nullptr to use the portable code
+const SimShaAccel* simShaAccel();
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "sim_api.h"
+
+#include <cstdint>
+#include <cstddef>
+
+// ============================================================================
+// Process-Wide Crypto Caches
+// ============================================================================
+// Every node of a firmware library runs in one process, and many of them do
+// the same deterministic crypto: each node that hears a flooded advert
+// verifies the same signature, and every reboot or DM retry recomputes the
+// same shared secrets. These caches memoize such results across
+// nodes. They are disabled until sim_set_crypto_cache() gives them a
+// capacity, and are safe to use from any node thread or fiber worker. With
+// a shared runtime attached (sim_runtime.h) the runtime's caches are used,
+// shared by every library in the process.
+//
+// Kept free of standard container headers: Ed25519.h includes this from
+// firmware translation units that rely on the Arduino min()/max() macros.
+
+class SimCryptoCache {
+public:
+    /// ed25519_verify() through the verify cache (when enabled)
+    static bool verify(const uint8_t* sig, const uint8_t* public_key,
+                       const uint8_t* message, size_t len);
+
+    /// ed25519_key_exchange() through the ECDH cache (when enabled), keyed by
+    /// the private key's digest and the peer public key
+    static void keyExchange(uint8_t* shared_secret, const uint8_t* public_key,
+                            const uint8_t* private_key);
+
+    static void configure(SimCryptoCacheKind kind, size_t capacity);
+    static void getStats(SimCryptoCacheKind kind, SimCryptoCacheStats* out);
+};
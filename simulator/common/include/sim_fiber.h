@@ -0,0 +1,120 @@
+#pragma once
+
+// ============================================================================
+// Simulated Node Fibers
+// ============================================================================
+// Stackful coroutines used by SIM_EXEC_FIBER nodes. Instead of parking an OS
+// thread per node between steps, each node's firmware runs on its own fiber
+// stack and is resumed by one of a small pool of worker threads.
+//
+// - POSIX: ucontext (makecontext/swapcontext) on an mmap'd stack
+// - Windows: native Fibers (CreateFiber/SwitchToFiber)
+//
+// A fiber may be resumed by a different worker thread each step. Code that
+// runs on a fiber must therefore never hold a thread_local address across
+// suspend(); the firmware-visible globals are rebound by the worker before
+// every resume (see sim_bindings.h).
+
+#include "sim_runtime.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Default stack reserved for each node fiber. Pages are committed on demand,
+/// so this mostly costs address space.
+static constexpr size_t SIM_FIBER_STACK_SIZE = 256 * 1024;
+
+class SimFiber {
+public:
+    using EntryFn = void (*)(void* arg);
+
+    SimFiber(EntryFn entry, void* arg, size_t stack_size = SIM_FIBER_STACK_SIZE);
+    ~SimFiber();
+
+    SimFiber(const SimFiber&) = delete;
+    SimFiber& operator=(const SimFiber&) = delete;
+
+    /// Run the fiber on the calling thread until it suspends or its entry returns.
+    void resume();
+
+    /// Switch back to the thread that resumed this fiber (call from the fiber).
+    void suspend();
+
+    /// True once the entry function has returned. A finished fiber must not be resumed.
+    bool finished() const { return finished_; }
+
+    /// True if the platform fiber and its stack were created successfully.
+    bool valid() const { return impl_ != nullptr; }
+
+private:
+    struct Impl;
+    friend void simFiberStart(SimFiber* self);
+
+    Impl* impl_;
+    EntryFn entry_;
+    void* arg_;
+    bool finished_;
+};
+
+// ============================================================================
+// Fiber Worker Pool
+// ============================================================================
+// Process-wide pool of worker threads that run posted fiber slices. A slice
+// is a short callback (typically "bind globals, resume fiber, publish result")
+// and must not block on other slices.
+//
+// Each worker owns a deque. Posts from outside the pool are spread round-robin
+// across the deques, posts from a worker go to its own deque, and an idle
+// worker steals from the back of its neighbours' deques, so a few slow nodes
+// (e.g. room servers with large post stores) don't hold up cheap ones.
+//
+// With a shared runtime attached (sim_runtime.h), slices go to the runtime's
+// pool instead, so nodes of every library share one set of workers.
+
+class SimFiberScheduler {
+public:
+    using SliceFn = SimRuntimeSliceFn;
+    using Slice = SimRuntimeSlice;
+
+    static SimFiberScheduler& instance();
+
+    /// Set the number of worker threads (0 = one per hardware thread).
+    /// Only takes effect before the first slice is posted.
+    void setWorkerCount(uint32_t count);
+
+    /// Queue a slice for execution on any worker.
+    void post(SliceFn fn, void* arg);
+
+    /// Queue several slices at once, waking workers a single time.
+    void postBatch(const Slice* slices, size_t count);
+
+private:
+    SimFiberScheduler() = default;
+
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Slice> queue;
+    };
+
+    void ensureStarted();
+    void wakeWorkers(size_t count);
+    bool popOrSteal(size_t index, Slice& out);
+    void workerMain(size_t index);
+
+    std::once_flag start_once_;
+    std::mutex config_mutex_;
+    uint32_t worker_count_ = 0;
+    std::vector<std::unique_ptr<Worker>> workers_;
+
+    std::atomic<int64_t> pending_{0};       // Slices queued but not yet picked up
+    std::atomic<uint32_t> next_worker_{0};  // Round-robin cursor for external posts
+    std::mutex sleep_mutex_;
+    std::condition_variable sleep_cv_;
+};
@@ -1,50 +1,147 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <map>
 #include <vector>
 #include <mutex>
+#include <memory>
 #include <cstdint>
 #include <cstring>
 
+#include "sim_heap.h"
+#include "sim_op_stats.h"
+#include "sim_state_hash.h"
+#include "sim_trace.h"
+
 // ============================================================================
 // Simulated In-Memory Filesystem
 // ============================================================================
 // Provides a simple in-memory filesystem that persists across node reboots.
-// The coordinator can pre-populate files or inspect them.
+// The coordinator can pre-populate files or inspect them. With sim_set_fs_dir()
+// the files live in a memory-mapped arena file instead (sim_fs_arena.h).
+//
+// Paths are interned as nodes: each stored file, and each directory implied
+// by a '/' in a file's path, is one node found through an open-addressed
+// hash index, so opening a file hashes the path in place instead of building
+// a string. A directory lists its children in name order, and exists only
+// while some file lies below it, as on SPIFFS.
+//
+// In write-back mode (SimNodeConfig.fs_write_back) a file the firmware opens
+// for writing is staged in a private buffer, and rewriting it again in the
+// same step reuses that buffer. The firmware sees its staged contents at
+// once; the stored file, its hash and the arena only change when
+// commitStaged() runs at the end of the step, once per file however many
+// times it was rewritten. A file held open across steps is committed only
+// after steps that wrote to it.
+
+class SimFilesystem;
+class SimFsArena;
+
+// Contents of one stored file: a heap buffer, or a slot of the node's
+// persistent arena. Pointers from data() are only valid until the next
+// resize, which may move an arena extent.
+class SimFileData {
+public:
+    SimFileData() = default;
+    SimFileData(const uint8_t* data, size_t len) : bytes_(data, data + len) {}
+    SimFileData(std::shared_ptr<SimFsArena> arena, uint32_t slot)
+        : arena_(std::move(arena)), slot_(slot) {}
+    ~SimFileData();
+
+    SimFileData(const SimFileData&) = delete;
+    SimFileData& operator=(const SimFileData&) = delete;
+
+    size_t size() const { return arena_ ? mappedSize() : bytes_.size(); }
+    const uint8_t* data() const { return arena_ ? mappedData() : bytes_.data(); }
+    uint8_t* data() { return arena_ ? mappedData() : bytes_.data(); }
+    bool mapped() const { return arena_ != nullptr; }
+
+    // Change the length (new bytes read as zero); false if the arena is full
+    bool resize(size_t len);
+
+    // The file's path now names other contents (or nothing). Arena slots are
+    // kept for open readers and freed with the last reference.
+    void unlink();
+
+private:
+    std::vector<uint8_t> bytes_;
+    std::shared_ptr<SimFsArena> arena_;
+    uint32_t slot_ = 0;
+    bool linked_ = true;
+
+    uint8_t* mappedData() const;
+    size_t mappedSize() const;
+};
+
+// Stored files, keyed by normalized path. File contents are shared by
+// reference between handles, nodes and images.
+using SimFileMap = std::map<std::string, std::shared_ptr<SimFileData>>;
+
+// Base image many nodes start from (sim_fs_image_*). Its files are never
+// modified in place: a node writing one gets a private copy.
+struct SimFsImage {
+    std::mutex mutex;
+    SimFileMap files;
+
+    int writeFile(const char* path, const uint8_t* data, size_t len);
+};
 
+// File handle. Handles reference the stored bytes instead of copying them:
+// a read handle keeps a snapshot alive (a file rewritten while it is open is
+// copied first), and write/append handles modify the stored file in place.
+// Handles are pooled per filesystem and only used from the node's own thread.
+// A handle may also name a directory, for listing its entries in name
+// order with SimFilesystem::openNext().
 class SimFile {
 public:
-    SimFile() : position_(0) {}
+    SimFile()
+        : position_(0), fs_(nullptr), node_(0), writable_(false), directory_(false),
+          staged_(false) {}
+
+    SimFile(const SimFile&) = delete;
+    SimFile& operator=(const SimFile&) = delete;
 
-    std::vector<uint8_t> data;
     size_t position_;
 
-    size_t size() const { return data.size(); }
+    size_t size() const { return data_ ? data_->size() : 0; }
 
     void seek(size_t pos) {
-        position_ = (pos <= data.size()) ? pos : data.size();
+        size_t len = size();
+        position_ = (pos <= len) ? pos : len;
     }
 
     size_t read(uint8_t* buffer, size_t len) {
-        size_t avail = data.size() - position_;
+        SIM_TRACE_SCOPE(SIM_TRACE_FS, "fs.read");
+        size_t avail = size() - position_;
         size_t to_read = (len < avail) ? len : avail;
         if (to_read > 0) {
-            memcpy(buffer, data.data() + position_, to_read);
+            memcpy(buffer, data_->data() + position_, to_read);
             position_ += to_read;
+            SIM_COUNT_OP(fs_bytes_read, to_read);
         }
         return to_read;
     }
 
-    size_t write(const uint8_t* buffer, size_t len) {
-        // Extend if needed
-        if (position_ + len > data.size()) {
-            data.resize(position_ + len);
-        }
-        memcpy(data.data() + position_, buffer, len);
-        position_ += len;
-        return len;
-    }
+    size_t write(const uint8_t* buffer, size_t len);
+
+    bool isDirectory() const { return directory_; }
+
+    // Full path with a leading slash, and its last component
+    const char* path() const { return path_.c_str(); }
+    const char* name() const { return path_.c_str() + path_.rfind('/') + 1; }
+
+private:
+    friend class SimFilesystem;
+
+    std::shared_ptr<SimFileData> data_;           // Shared with the filesystem entry
+    std::string path_;                            // "/" + normalized path
+    std::string cursor_;                          // Directories: last name listed
+    SimFilesystem* fs_;                           // Set while the handle is open
+    uint32_t node_;                               // Files: node the handle was opened on
+    bool writable_;
+    bool directory_;
+    bool staged_;                                 // Writes go to the node's staged buffer
 };
 
 class SimFilesystem {
@@ -60,9 +157,17 @@ public:
     bool exists(const char* path);
     bool remove(const char* path);
 
-    // Open for reading (returns nullptr if not found)
+    // Open for reading (returns nullptr if not found). A directory, or "/",
+    // opens as a directory handle.
     SimFile* openRead(const char* path);
 
+    // Open the next entry of directory handle `dir` for reading (nullptr
+    // when there are no more), and restart its listing. Entries created or
+    // removed during a listing are seen if they sort after the last one
+    // returned.
+    SimFile* openNext(SimFile* dir);
+    void rewind(SimFile* dir);
+
     // Open for writing (creates if doesn't exist, truncates if exists)
     SimFile* openWrite(const char* path);
 
@@ -76,20 +181,62 @@ public:
     int writeFile(const char* path, const uint8_t* data, size_t len);
     int readFile(const char* path, uint8_t* data, size_t max_len);
 
+    // Contents of a file without copying, valid until the filesystem is next
+    // used (nullptr if not found)
+    const uint8_t* viewFile(const char* path, size_t* len);
+
+    // Add the files of a base image that are not already present, sharing
+    // their contents until written
+    void mountImage(SimFsImage& image);
+
+    // Keep this filesystem's files in a memory-mapped arena file, loading
+    // any files it already holds. False if the file cannot be used.
+    bool openArena(const std::string& file_path);
+
+    // Write the arena's dirty pages to disk (false without an arena)
+    bool flush();
+
+    // Stage firmware writes until commitStaged() (write-back mode). Turning
+    // it off commits what is staged.
+    void setWriteBack(bool enabled);
+    bool writeBack() const { return write_back_; }
+
+    // Store the files staged since the last commit. Run at the end of every
+    // step; coordinator access (readFile(), viewFile(), snapshots) commits
+    // first as well, so it never sees a half-written save.
+    void commitStaged() {
+        if (!staged_nodes_.empty()) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            commitLocked();
+        }
+    }
+
+    // Rolling hash of every change made to the files since creation: opens
+    // for writing, written bytes and their offsets, coordinator writes,
+    // removals and restores (folded into SimStepResult.state_hash). In
+    // write-back mode a staged file counts once, by its committed contents.
+    uint64_t writeHash() const { return write_hash_; }
+
+    // Every file, for sim_snapshot(). Heap contents are shared by
+    // reference; arena contents are copied, as the mapping may move.
+    SimFileMap snapshotFiles();
+
+    // Replace every file with `files`, sharing their contents until written
+    // (copied into the arena when there is one)
+    void restoreFiles(const SimFileMap& files);
+
+    // Close and free every handle (SimFile pointers held by the firmware
+    // become invalid). Used before a node heap is reset.
+    void releaseHandles();
+
     // Clear all files (for testing)
     void clear();
 
     // Format filesystem (alias for clear)
     void format() { clear(); }
 
-    // Storage info
-    size_t usedBytes() const {
-        size_t total = 0;
-        for (const auto& kv : files_) {
-            total += kv.second.size();
-        }
-        return total;
-    }
+    // Storage info (a running total of the stored files' sizes)
+    size_t usedBytes() const { return used_bytes_; }
 
     size_t totalBytes() const {
         // Simulated filesystem has unlimited space (4MB as a placeholder)
@@ -97,10 +244,106 @@ public:
     }
 
 private:
+    friend class SimFile;
+    friend struct SimFsImage;
+
+    static constexpr uint32_t ROOT = 0;
+    static constexpr uint32_t NO_NODE = UINT32_MAX;
+
+    // One interned path. Node ids are reused once a path is gone.
+    struct Node {
+        std::string path;                        // Normalized; "" for the root
+        uint64_t hash = 0;                       // pathHash(path)
+        uint32_t parent = ROOT;
+        uint32_t name_pos = 0;                   // Start of the last component
+        std::shared_ptr<SimFileData> data;       // Set if a file is stored here
+        std::shared_ptr<SimFileData> staged;     // Write-back contents not yet committed
+        bool dirty = false;                      // Staged contents changed since the last commit
+        size_t size = 0;                         // Bytes counted in used_bytes_
+        std::vector<uint32_t> children;          // Ordered by name
+
+        std::string_view name() const {
+            return std::string_view(path).substr(name_pos);
+        }
+    };
+
     bool mounted_;
-    std::map<std::string, std::vector<uint8_t>> files_;
-    std::map<SimFile*, std::string> open_files_;  // Track which file each handle refers to
+    uint64_t write_hash_ = SIM_HASH_SEED;
+    std::vector<Node> nodes_{1};                     // nodes_[ROOT] is "/"
+    std::vector<uint32_t> free_nodes_;
+    std::vector<uint32_t> index_;                    // Node ids by path hash
+    size_t indexed_ = 0;
+    size_t used_bytes_ = 0;
+    bool write_back_ = false;
+    std::vector<uint32_t> staged_nodes_;             // Nodes staged since the last commit
+    std::vector<std::shared_ptr<SimFileData>> spare_; // Staging buffers ready for reuse
+    std::shared_ptr<SimFsArena> arena_;              // Persistent backing, if any
+    std::vector<SimHeapPtr<SimFile>> handles_;       // Every handle ever created
+    std::vector<SimFile*> free_handles_;             // Closed handles ready for reuse
     std::mutex mutex_;
 
-    std::string normalizePath(const char* path);
+    // `path` without leading or trailing slashes, as stored
+    static std::string_view pathView(const char* path);
+    static std::string normalizePath(const char* path) { return std::string(pathView(path)); }
+    static uint64_t pathHash(std::string_view path) {
+        return simHashBytes(SIM_HASH_SEED, path.data(), path.size());
+    }
+
+    // Fold a change of `path` into write_hash_
+    void hashChange(char op, std::string_view path) {
+        write_hash_ = simHashBytes(simHashWord(write_hash_, static_cast<uint8_t>(op)),
+                                   path.data(), path.size());
+    }
+
+    // Node of `path`, or NO_NODE (caller holds mutex_)
+    uint32_t find(std::string_view path) const;
+
+    // Node of a stored or staged file, or NO_NODE
+    uint32_t findFile(std::string_view path) const {
+        uint32_t id = find(path);
+        return id != NO_NODE && (nodes_[id].data || nodes_[id].staged) ? id : NO_NODE;
+    }
+
+    // Node of `path`, created along with its parent directories if needed
+    uint32_t intern(std::string_view path);
+
+    // Store `data` as the file at node `id` (null removes it), unlinking
+    // what it held and dropping directories left empty
+    void setData(uint32_t id, std::shared_ptr<SimFileData> data);
+
+    // Bring used_bytes_ up to date with the size of node `id`'s file
+    void account(uint32_t id);
+
+    // A handle changed the size of its file
+    void resized(SimFile* file);
+
+    // Drop every node and file
+    void reset();
+
+    // Give node `id` an empty staged buffer, reusing the one it has if no
+    // handle still holds it
+    void stage(uint32_t id);
+
+    // Store every staged file (caller holds mutex_)
+    void commitLocked();
+
+    // Keep a staging buffer nothing else references for reuse
+    void recycle(std::shared_ptr<SimFileData> buffer);
+
+    void indexInsert(uint32_t id);
+    void indexPlace(uint32_t id);
+    void indexErase(uint32_t id);
+    size_t indexHome(uint64_t hash) const {
+        return static_cast<size_t>(hash >> 32) & (index_.size() - 1);
+    }
+
+    // Take a handle from the pool (caller holds mutex_)
+    SimFile* acquireHandle(uint32_t id, bool writable);
+
+    // Give a writer its own copy of bytes that a reader still references
+    void detach(SimFile* file);
+
+    // New contents for `path` (in the arena when there is one), copied from
+    // `src` or empty
+    std::shared_ptr<SimFileData> newData(const std::string& path, const SimFileData* src);
 };
@@ -0,0 +1,126 @@
+#pragma once
+
+#include "sim_api.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <string>
+
+// ============================================================================
+// Persistent Filesystem Arena
+// ============================================================================
+// Optional backing store for a node's SimFilesystem (see sim_set_fs_dir()).
+// All of the node's files live in one memory-mapped file: a fixed header, an
+// index of SIM_FS_ARENA_SLOTS path slots, then the file extents. Firmware
+// writes land directly in the mapped pages and the OS writes them back
+// lazily; sim_fs_flush() forces them out. Reopening the same file (a resumed
+// run) brings the files back without re-seeding.
+//
+// Layout (little-endian, all offsets from the start of the file):
+//   SimFsArenaHeader                   64 bytes
+//   SimFsArenaSlot[SIM_FS_ARENA_SLOTS] 128 bytes each
+//   file extents                       64-byte aligned
+
+static constexpr uint32_t SIM_FS_ARENA_VERSION = 1;
+static constexpr uint32_t SIM_FS_ARENA_SLOTS = 256;
+static constexpr size_t SIM_FS_ARENA_PATH = 96;     // Including the NUL
+static constexpr size_t SIM_FS_ARENA_INITIAL = 1024 * 1024;
+
+struct SimFsArenaHeader {
+    char magic[8];            // "MCSIMFS\0"
+    uint32_t version;         // SIM_FS_ARENA_VERSION
+    uint32_t slot_count;      // SIM_FS_ARENA_SLOTS
+    uint64_t data_end;        // End of the last allocated extent
+    uint64_t reserved[5];
+};
+
+enum SimFsArenaSlotState : uint32_t {
+    SIM_FS_SLOT_FREE = 0,     // No file; the extent (if any) is reusable
+    SIM_FS_SLOT_LIVE = 1,     // Holds the file named by path
+    SIM_FS_SLOT_ORPHAN = 2,   // Removed but still open for reading
+};
+
+struct SimFsArenaSlot {
+    char path[SIM_FS_ARENA_PATH];
+    uint64_t offset;          // Extent start
+    uint64_t size;            // File length
+    uint64_t capacity;        // Extent length
+    uint32_t state;           // SimFsArenaSlotState
+    uint32_t reserved;
+};
+
+static_assert(sizeof(SimFsArenaHeader) == 64, "arena header layout");
+static_assert(sizeof(SimFsArenaSlot) == 128, "arena slot layout");
+
+class SimFsArena {
+public:
+    static constexpr uint32_t NO_SLOT = UINT32_MAX;
+
+    // Map (creating if needed) an arena file; nullptr if it cannot be opened
+    // or is not an arena
+    static std::shared_ptr<SimFsArena> open(const std::string& file_path);
+
+    ~SimFsArena();
+
+    SimFsArena(const SimFsArena&) = delete;
+    SimFsArena& operator=(const SimFsArena&) = delete;
+
+    // Allocate a LIVE slot for `path` holding `len` bytes; NO_SLOT if the
+    // index is full, the path is too long or the file cannot grow
+    uint32_t create(const std::string& path, const uint8_t* data, size_t len);
+
+    // File contents. Valid until the next create()/resize(), which may remap.
+    uint8_t* data(uint32_t slot) { return base_ + slots()[slot].offset; }
+    size_t size(uint32_t slot) const { return static_cast<size_t>(slots()[slot].size); }
+
+    // Change a file's length, moving its extent if it must grow
+    bool resize(uint32_t slot, size_t len);
+
+    // The path no longer names this slot; its bytes stay for open readers
+    void unlink(uint32_t slot);
+
+    // Return the slot and its extent for reuse
+    void release(uint32_t slot);
+
+    // Visit every LIVE slot (used when mounting a resumed arena)
+    template <typename Fn>
+    void forEachLive(Fn&& fn) const {
+        for (uint32_t i = 0; i < SIM_FS_ARENA_SLOTS; i++) {
+            if (slots()[i].state == SIM_FS_SLOT_LIVE) {
+                fn(std::string(slots()[i].path), i);
+            }
+        }
+    }
+
+    // Write dirty pages back to the file and wait for them
+    bool flush();
+
+    // Platform file and mapping handles (defined in sim_fs_arena.cpp)
+    struct Mapping;
+
+private:
+    SimFsArena() = default;
+
+    SimFsArenaHeader* header() const { return reinterpret_cast<SimFsArenaHeader*>(base_); }
+    SimFsArenaSlot* slots() const {
+        return reinterpret_cast<SimFsArenaSlot*>(base_ + sizeof(SimFsArenaHeader));
+    }
+
+    // Find an extent of at least `capacity` bytes: a free slot's, or new
+    // space at data_end. Returns false if the file cannot grow.
+    bool allocate(uint32_t slot, uint64_t capacity);
+    bool grow(uint64_t min_size);
+
+    Mapping* mapping_ = nullptr;
+    uint8_t* base_ = nullptr;
+    uint64_t mapped_size_ = 0;
+};
+
+// Directory for node arena files (sim_set_fs_dir(); NULL or "" = none)
+void simSetFsArenaDir(const char* dir);
+
+// Arena file for a node created with `config`: "<dir>/<node_name>.simfs"
+// (the public key in hex when the name is empty), or "" when no directory
+// is set with sim_set_fs_dir()
+std::string simFsArenaPath(const SimNodeConfig& config);
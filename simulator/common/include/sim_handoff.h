@@ -0,0 +1,84 @@
+#pragma once
+
+#include "sim_api.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <initializer_list>
+#include <mutex>
+
+// ============================================================================
+// Step Handoff
+// ============================================================================
+// SimContext::state, passed back and forth between the coordinator and the
+// node's thread once per step. Most steps take a few microseconds, less
+// than a futex sleep and wake, so a waiter first spins on the atomic and
+// only then parks on a condition variable. A store takes a lock (to notify)
+// only when the other side has actually parked.
+//
+// Each side adapts its spin limit: waits satisfied while spinning let it
+// grow back to the limit set with sim_set_step_spin(), and waits that had
+// to park halve it. The same counters are reported by
+// sim_get_handoff_stats().
+
+enum class SimStepState : uint32_t {
+    IDLE,           // Waiting for step_begin
+    RUNNING,        // Processing loop
+    YIELDED,        // Completed step, waiting for result retrieval
+    SHUTDOWN        // Thread should exit
+};
+
+class SimStepHandoff {
+public:
+    using State = SimStepState;
+
+    // Which side is waiting (selects the spin limit and counters)
+    enum Waiter { COORDINATOR = 0, NODE = 1 };
+
+    SimStepState load() const {
+        return static_cast<State>(word_.load(std::memory_order_acquire) & ~PARKED);
+    }
+
+    // Publish a new state, waking the other side if it is parked. Unless
+    // it is, the exchange is this call's last access to the handoff.
+    void store(State state) {
+        uint32_t previous = word_.exchange(static_cast<uint32_t>(state), std::memory_order_acq_rel);
+        if (previous & PARKED) {
+            // Under the lock, so the waiter cannot miss the notify or free
+            // the handoff before it completes
+            std::lock_guard<std::mutex> lock(mutex_);
+            cv_.notify_one();
+        }
+    }
+
+    // Block until the state is one of `states`, and return it
+    State waitFor(Waiter waiter, std::initializer_list<State> states) {
+        uint32_t mask = 0;
+        for (State state : states) {
+            mask |= 1u << static_cast<uint32_t>(state);
+        }
+        return waitMask(waiter, mask);
+    }
+
+    void getStats(SimHandoffStats* out) const;
+
+    // Process-wide spin limits (sim_set_step_spin())
+    static void configure(uint32_t coordinator_spins, uint32_t node_spins);
+
+private:
+    static constexpr uint32_t PARKED = 0x80000000u;  // A waiter sleeps on cv_
+
+    struct Side {
+        uint32_t spin_limit = UINT32_MAX;            // Adapted; capped by configure()
+        std::atomic<uint64_t> spin_waits{0};
+        std::atomic<uint64_t> parked_waits{0};
+    };
+
+    State waitMask(Waiter waiter, uint32_t mask);
+
+    std::atomic<uint32_t> word_{static_cast<uint32_t>(State::IDLE)};
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    Side sides_[2];
+};
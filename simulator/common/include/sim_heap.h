@@ -0,0 +1,118 @@
+#pragma once
+
+#include "sim_api.h"
+
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+// ============================================================================
+// Per-Node Heap
+// ============================================================================
+// Optional allocator for the memory a node's firmware owns: the firmware
+// objects built in setup() (MyMesh, DataStore), Arduino String buffers and
+// SimFile handles. Enabled with SimNodeConfig.node_heap. Each node carves
+// these from its own chunks instead of the shared malloc, so nodes on
+// different threads do not contend and a node's state sits together in
+// memory.
+//
+// Blocks come from power-of-two size classes bump-allocated from 64 KiB
+// chunks and recycled through per-class free lists; larger blocks are
+// allocated individually. Every block starts with a header naming its heap,
+// so simFree() works from any thread and for memory allocated while no heap
+// was bound (which comes from malloc). A heap is used by one thread at a
+// time: its node's thread or fiber worker, or the coordinator while the node
+// is not running.
+//
+// reset() takes back every block at once, in time proportional to the
+// number of chunks. The node does this on reboot, after destroying the
+// firmware objects and closing its file handles, so whatever the firmware
+// leaked is reclaimed; sim_destroy() releases the chunks themselves.
+//
+// Only allocations routed through simAlloc() are covered. MeshCore's own
+// new/delete (packet pools, etc.) still use the global heap: replacing the
+// global operator new in a shared library is not safe on every platform.
+
+class SimHeap {
+public:
+    static constexpr size_t CHUNK_SIZE = 64 * 1024;
+
+    SimHeap() = default;
+    ~SimHeap();
+
+    SimHeap(const SimHeap&) = delete;
+    SimHeap& operator=(const SimHeap&) = delete;
+
+    void* allocate(size_t size);
+
+    // Free a block of any heap (or malloc'd by simAlloc())
+    static void deallocate(void* ptr);
+
+    // Take back every block, keeping the chunks for reuse
+    void reset();
+    
+    // Take back every block and return the chunks to the system
+    void purge();
+
+    void getStats(SimHeapStats* out) const;
+
+    // Block header and large-block links (defined in sim_heap.cpp)
+    struct Block;
+    struct Large;
+
+private:
+    static constexpr uint32_t CLASS_COUNT = 8;        // 32 .. 4096 bytes with header
+    static constexpr uint32_t LARGE_CLASS = CLASS_COUNT;
+
+    void release(Block* block);
+
+    void* free_lists_[CLASS_COUNT] = {};
+    std::vector<uint8_t*> chunks_;
+    size_t current_chunk_ = 0;       // Chunk being bump-allocated
+    size_t chunk_used_ = 0;          // Bytes taken from the current chunk
+    Large* large_ = nullptr;         // Individually allocated blocks
+
+    uint64_t allocations_ = 0;
+    uint64_t frees_ = 0;
+    uint64_t live_bytes_ = 0;
+    uint64_t peak_bytes_ = 0;
+    uint64_t reserved_bytes_ = 0;
+    uint64_t resets_ = 0;
+};
+
+// Heap of the node bound to this thread (nullptr = none), set by simBindNode()
+extern thread_local SimHeap* g_sim_heap;
+
+// Allocate from the bound node heap, or malloc when none is bound
+void* simAlloc(size_t size);
+void simFree(void* ptr);
+
+// unique_ptr for objects allocated with simMakeUnique()
+template <typename T>
+struct SimHeapDelete {
+    void operator()(T* ptr) const {
+        if (ptr) {
+            ptr->~T();
+            simFree(ptr);
+        }
+    }
+};
+
+template <typename T>
+using SimHeapPtr = std::unique_ptr<T, SimHeapDelete<T>>;
+
+// Construct a T in the bound node heap (blocks are 16-byte aligned)
+template <typename T, typename... Args>
+SimHeapPtr<T> simMakeUnique(Args&&... args) {
+    static_assert(alignof(T) <= 16, "SimHeap blocks are 16-byte aligned");
+    void* mem = simAlloc(sizeof(T));
+    try {
+        return SimHeapPtr<T>(new (mem) T(std::forward<Args>(args)...));
+    } catch (...) {
+        simFree(mem);
+        throw;
+    }
+}
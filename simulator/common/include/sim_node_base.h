@@ -9,18 +9,23 @@
 #include "sim_radio.h"
 #include "sim_board.h"
 #include "sim_clock.h"
+#include "sim_fiber.h"
+#include "sim_bindings.h"
+#include "sim_fs_arena.h"
+#include "sim_heap.h"
+#include "sim_packet_manager.h"
+#include "sim_placement.h"
+#include "sim_record.h"
+#include "sim_snapshot.h"
+#include "sim_state_hash.h"
+#include "sim_trace.h"
+#include "target.h"
 
 #include <thread>
 #include <chrono>
 #include <cstdio>
-
-// ============================================================================
-// Thread-local global instances (defined in each DLL's sim_main.cpp)
-// ============================================================================
-// These are the instances that firmware code uses via the macros in sim_prefix.h
-extern thread_local SimBoard _sim_board_instance;
-extern thread_local SimRadio _sim_radio_instance;
-extern thread_local SimRTCClock _sim_rtc_instance;
+#include <memory>
+#include <system_error>
 
 // ============================================================================
 // Helper Macros
@@ -49,176 +54,1068 @@ inline void sim_config_set_lora(SimNodeConfig* config,
     config->lora_tx_power = tx_power;
 }
 
+// ============================================================================
+// SimStepLatch - Completion counter for sim_step_batch()
+// ============================================================================
+
+struct SimStepLatch {
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t remaining = 0;
+    
+    void countDown() {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (--remaining == 0) {
+            cv.notify_one();
+        }
+    }
+    
+    void wait() {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [this] { return remaining == 0; });
+    }
+};
+
+// ============================================================================
+// Step inputs
+// ============================================================================
+// What outside the firmware a step could react to, kept from the end of an
+// idle step so the next one can be skipped if nothing changed
+// (SimNodeConfig.skip_idle_steps). Injected packets, TX completion and state
+// notifications all bump the radio's state version; collected serial output
+// or frames free room the firmware may be waiting for. Queued input and
+// reached deadlines are checked separately, since they may be left over from
+// the step itself.
+
+struct SimInputVersion {
+    uint32_t radio_state = 0;
+    size_t serial_tx_pending = 0;
+    size_t frames_tx_queued = 0;
+    
+    bool operator==(const SimInputVersion& other) const {
+        return radio_state == other.radio_state &&
+               serial_tx_pending == other.serial_tx_pending &&
+               frames_tx_queued == other.frames_tx_queued;
+    }
+};
+
 // ============================================================================
 // SimNodeImpl - Base implementation for all node types
 // ============================================================================
 
 struct SimNodeImpl {
+    // Per-node heap (SimNodeConfig.node_heap). Declared first so it outlives
+    // everything allocated from it.
+    SimHeap heap;
+    
     SimContext ctx;
-    std::thread node_thread;
+    SimThread node_thread;
+    std::unique_ptr<SimFiber> node_fiber;   // Set instead of node_thread in SIM_EXEC_FIBER mode
+    
+    // CPU and NUMA node the thread runs on, resolved by create()
+    SimPlacement placement;
     
     // Configuration
     SimNodeConfig config;
     
-    // Pointers to the thread-local instances used by this node's firmware thread.
-    // These are set in threadMain() and used by coordinator API calls.
-    // This allows cross-thread communication (coordinator injecting packets, etc.)
-    SimRadio* radio_ptr = nullptr;
-    SimBoard* board_ptr = nullptr;
-    SimRTCClock* rtc_ptr = nullptr;
+    // Hardware objects owned by this node. Firmware reaches them through the
+    // board/radio_driver/rtc_clock/sensors bindings (sim_bindings.h), which are
+    // pointed at this node whenever it runs. Coordinator API calls use them
+    // directly (injecting packets, clearing board flags, etc.)
+    SimBoard node_board;
+    SimRadio node_radio;
+    SimRTCClock node_rtc;
+    EnvironmentSensorManager node_sensors;
+    
+    // Set by sim_reboot(); the next run re-initializes and re-runs setup()
+    // instead of stepping.
+    std::atomic<bool> reboot_pending{false};
+    
+    // Set by sim_restore() (with reboot_pending) and sim_fork(); holds a
+    // snapshot reference until the next boot has finished restoring it
+    SimSnapshot* pending_restore = nullptr;
+    
+    // Set while the node hibernates (sim_hibernate()), when it has no
+    // thread, fiber or firmware. hibernated_state is what it wakes into, or
+    // nullptr if it had powered off and only its files were kept.
+    bool hibernating = false;
+    SimSnapshot* hibernated_state = nullptr;
+    
+    // Set when the last step yielded SIM_YIELD_POWER_OFF
+    bool powered_off = false;
+    
+    // Set once a fiber's entry function has returned (guarded by step_mutex)
+    bool fiber_exited = false;
+    
+    // Set once the thread has finished first boot (guarded by step_mutex)
+    bool booted = false;
+    
+    // Inputs and result of the last idle step, when the next step may reuse
+    // them (SimNodeConfig.skip_idle_steps)
+    bool idle_inputs_valid = false;
+    SimInputVersion idle_inputs;
+    uint64_t idle_step_millis = 0;
+    uint64_t idle_wake_millis = 0;
+    
+    // Wake time and inputs at the end of the last step, for
+    // sim_peek_next_wake(). A wake of 0 means step as soon as possible.
+    uint64_t next_wake_millis = 0;
+    SimInputVersion step_inputs;
+    
+    // SimStepResult.state_hash of the last step
+    uint64_t state_hash = SIM_HASH_SEED;
+    
+    // Batch waiting on the current step, if any (set under step_mutex before
+    // the step is handed over; taken by the node when it yields)
+    SimStepLatch* step_latch = nullptr;
+    
+    // Log of the calls feeding this node (SimNodeConfig.record_path), opened
+    // by launch(). Replayed nodes neither record nor use the arena directory.
+    std::unique_ptr<SimRecorder> recorder;
+    bool replaying = false;
     
     // Virtual methods for node-specific behavior (implemented in each DLL)
     virtual void setup() = 0;
     virtual void loop() = 0;
     virtual const char* getNodeType() const = 0;
     
-    SimNodeImpl() = default;
-    virtual ~SimNodeImpl() = default;
+    // Destroy the firmware objects setup() created, before it runs again
+    virtual void releaseFirmware() {}
     
-    // Thread entry point
-    void threadMain() {
-        // Set thread-local context
-        g_sim_ctx = &ctx;
-        
-        // Initialize thread-local global subsystems (used by firmware via macros)
-        // These are the instances that the firmware sees as board, radio_driver, etc.
-        _sim_radio_instance.configure(config.lora_freq, config.lora_bw, 
-                                       config.lora_sf, config.lora_cr, config.lora_tx_power);
-        _sim_radio_instance.begin();
-        _sim_board_instance.init();
-        _sim_rtc_instance.setCurrentTime(config.initial_rtc);
-        
-        // Store pointers to the thread-local instances for cross-thread access
-        // (coordinator thread calling sim_inject_radio_rx, etc.)
-        radio_ptr = &_sim_radio_instance;
-        board_ptr = &_sim_board_instance;
-        rtc_ptr = &_sim_rtc_instance;
+    // Fold firmware state outside the shim (its own RNG streams) into the
+    // step's state hash
+    virtual uint64_t hashFirmwareState(uint64_t hash) const { return hash; }
+    
+    // Firmware state kept in snapshots beyond the filesystem (see
+    // sim_snapshot.h). restoreFirmwareState() runs after setup() and gets
+    // what saveFirmwareState() of the same node type returned; with
+    // continue_rng false the RNGs keep the fresh seed setup() gave them.
+    virtual std::unique_ptr<SimFirmwareState> saveFirmwareState() { return nullptr; }
+    virtual void restoreFirmwareState(const SimFirmwareState& state, bool continue_rng) {
+        (void)state;
+        (void)continue_rng;
+    }
+    
+    SimNodeImpl() { ctx.node = this; }
+    
+    // Nodes live in their own pages, on their placement's NUMA node
+    static void* operator new(size_t size) { return simNodeAlloc(size, -1); }
+    static void* operator new(size_t size, const SimPlacement& placement) {
+        return simNodeAlloc(size, placement.numa_node);
+    }
+    static void operator delete(void* ptr) { simNodeFree(ptr); }
+    static void operator delete(void* ptr, const SimPlacement&) { simNodeFree(ptr); }
+    
+    // Allocate a node of type Node where its config places it and take the
+    // config (before start())
+    template <typename Node>
+    static Node* create(const SimNodeConfig& node_config) {
+        SimPlacement node_placement = simPlaceNode(node_config);
+        Node* node = new (node_placement) Node();
+        node->placement = node_placement;
+        node->setConfig(node_config);
+        return node;
+    }
+    virtual ~SimNodeImpl() {
+        // A forked fiber node destroyed before its first step
+        if (pending_restore) {
+            pending_restore->release();
+        }
+        if (hibernated_state) {
+            hibernated_state->release();
+        }
+    }
+    
+    // Queue a sim_inject_cli_line() line as an RX frame: the flags byte,
+    // then the line
+    bool queueCliLine(const char* line, uint32_t flags) {
+        size_t len = strlen(line);
+        uint8_t frame[1 + SIM_MAX_CLI_LINE];
+        if (len > SIM_MAX_CLI_LINE) {
+            return false;
+        }
+        frame[0] = static_cast<uint8_t>(flags);
+        memcpy(frame + 1, line, len);
+        if (!ctx.serial.rxFrames().push(frame, len + 1)) {
+            return false;
+        }
+        if (recorder) recorder->serialFrame(frame, len + 1);
+        ctx.step_stats.recordSerialRx(len, len);
+        return true;
+    }
+    
+    // Run the queued CLI lines through handle(command, reply), from loop().
+    // Each reply is queued as a TX frame; a line waits while there is no room
+    // for its reply. A handler that leaves reply untouched answers "".
+    template <typename Handler>
+    void runCliLines(Handler&& handle) {
+        SimFrameRing& lines = ctx.serial.rxFrames();
+        SimFrameRing& replies = ctx.serial.txFrames();
+        uint8_t frame[1 + SIM_MAX_CLI_LINE + 1];
+        while (!replies.full() && lines.count() > 0) {
+            size_t len = lines.pop(frame, 1 + SIM_MAX_CLI_LINE);
+            if (len == 0) continue;
+            bool echo = (frame[0] & SIM_CLI_ECHO) != 0;
+            char* command = reinterpret_cast<char*>(frame + 1);
+            command[len - 1] = 0;
+            if (echo) {
+                Serial.print(command);
+                Serial.print("\r\n");
+            }
+            char reply[160];
+            reply[0] = 0;
+            handle(command, reply);
+            if (echo && reply[0]) {
+                Serial.print("  -> ");
+                Serial.println(reply);
+            }
+            replies.push(reinterpret_cast<const uint8_t*>(reply), strlen(reply) + 1);
+        }
+    }
+    
+    // Key one of this node's RNG streams by (rng_seed, identity, stream)
+    void seedRng(SimRNG& rng, SimRngStream stream) const {
+        rng.seed(config.rng_seed, simRngNodeId(config.public_key), stream);
+    }
+    
+    SimNodeBindings bindings() {
+        SimNodeBindings b;
+        b.ctx = &ctx;
+        b.board = &node_board;
+        b.radio = &node_radio;
+        b.rtc = &node_rtc;
+        b.sensors = &node_sensors;
+        b.heap = config.node_heap ? &heap : nullptr;
+        return b;
+    }
+    
+    // Take the configuration for a new node (before start())
+    void setConfig(const SimNodeConfig& node_config) {
+        config = node_config;
+        
+        // Apply spin detection config from SimNodeConfig
+        ctx.spin_config.threshold = config.spin_detection_threshold;
+        ctx.spin_config.log_spin_detection = config.log_spin_detection != 0;
+        ctx.spin_config.log_loop_iterations = config.log_loop_iterations != 0;
+        // Note: idle_loops_before_yield is used in sim_node_base.cpp for yield logic
+    }
+    
+    // Start executing the firmware according to config.execution_mode and
+    // wait for first boot
+    void start() {
+        launch();
+        awaitBoot();
+    }
+    
+    // Start the firmware without waiting for its setup(), so many nodes can
+    // boot at once (sim_create_batch())
+    void launch() {
+        // Size the RX queue before any packet can be injected
+        node_radio.setRxQueueDepth(config.rx_queue_depth);
+        applyLogConfig();
+        
+        ctx.filesystem.setWriteBack(config.fs_write_back != 0);
+        
+        // Resume the node's persistent files, if sim_set_fs_dir() is set
+        std::string arena_path = replaying ? std::string() : simFsArenaPath(config);
+        // A fork keeping its source's name would share the source's arena,
+        // and its restore would overwrite the source's files
+        if (pending_restore && arena_path == simFsArenaPath(pending_restore->config)) {
+            arena_path.clear();
+        }
+        if (!arena_path.empty()) {
+            ctx.filesystem.openArena(arena_path);
+        }
+        
+        // Take the base image's files now; the coordinator may release it
+        // as soon as sim_create() returns
+        if (config.fs_image) {
+            ctx.filesystem.mountImage(*config.fs_image);
+            config.fs_image = nullptr;
+        }
+        
+        // Start the log with the files the node boots from
+        if (config.record_path && !pending_restore && !replaying) {
+            recorder.reset(SimRecorder::open(config.record_path, getNodeType(), config));
+            if (recorder) {
+                recorder->files(ctx.filesystem.snapshotFiles());
+            }
+        }
+        config.record_path = nullptr;
+        
+        // A forked node starts from its snapshot instead
+        if (pending_restore) {
+            loadSnapshot(*pending_restore);
+        }
+        
+        startExecution();
+    }
+    
+    // Create the thread or fiber that runs the firmware (boot included)
+    void startExecution() {
+        size_t stack_size = static_cast<size_t>(config.stack_size_kb) * 1024;
+        if (config.execution_mode == SIM_EXEC_FIBER) {
+            node_fiber.reset(new SimFiber(&SimNodeImpl::fiberEntry, this,
+                                          stack_size ? stack_size : SIM_FIBER_STACK_SIZE));
+            if (node_fiber->valid()) {
+                return;
+            }
+            // Could not allocate a fiber stack - fall back to a thread
+            node_fiber.reset();
+        }
+        if (!node_thread.start(&SimNodeImpl::threadEntry, this, stack_size, placement)) {
+            throw std::system_error(std::make_error_code(std::errc::resource_unavailable_try_again),
+                                    "node thread");
+        }
+    }
+    
+    // Wait for setup() so the first step cannot race first boot. Fiber nodes
+    // boot in their first step instead.
+    void awaitBoot() {
+        if (node_fiber) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(ctx.step_mutex);
+        ctx.step_cv.wait(lock, [this] { return booted; });
+    }
+    
+    // Stop the firmware thread/fiber. Must be called from the most-derived
+    // destructor, while the firmware objects are still alive.
+    void stop() {
+        if (node_fiber) {
+            // Let an in-flight step finish before tearing the fiber down
+            ctx.state.waitFor(SimStepHandoff::COORDINATOR,
+                              {SimContext::State::IDLE, SimContext::State::YIELDED,
+                               SimContext::State::SHUTDOWN});
+            std::unique_lock<std::mutex> lock(ctx.step_mutex);
+            ctx.state.store(SimContext::State::SHUTDOWN);
+            if (!node_fiber->finished()) {
+                lock.unlock();
+                SimFiberScheduler::instance().post(&SimNodeImpl::fiberSlice, this);
+                lock.lock();
+                ctx.step_cv.wait(lock, [this] { return fiber_exited; });
+            }
+            lock.unlock();
+            node_fiber.reset();
+            return;
+        }
+        
+        ctx.state.store(SimContext::State::SHUTDOWN);
+        
+        if (node_thread.joinable()) {
+            node_thread.join();
+        }
+    }
+    
+    // Release the thread or fiber, the firmware and the heap of a node that
+    // is not running, keeping what wake() needs (coordinator side)
+    void hibernate() {
+        // The log cannot describe the hibernation, so it ends here
+        if (recorder) {
+            recorder->restore();
+            recorder.reset();
+        }
+        
+        // A fiber node that has not booted yet still holds its fork snapshot
+        if (pending_restore) {
+            hibernated_state = pending_restore;
+            pending_restore = nullptr;
+        } else if (!powered_off) {
+            // The node keeps its own files and RX queue; sharing them with
+            // the snapshot would only make the next write copy the file
+            hibernated_state = captureSnapshot();
+            hibernated_state->files.clear();
+            hibernated_state->radio.releaseRx();
+        }
+        
+        stop();
+        SimNodeBindings previous = simBindNode(bindings());
+        teardownFirmware();
+        simBindNode(previous);
+        heap.purge();
+        ctx.releaseBuffers();
+        idle_inputs_valid = false;
+        hibernating = true;
+    }
+    
+    // Rebuild a hibernated node: restore its state, or power it back on
+    // over its files. Packets and serial input queued meanwhile are kept.
+    void wake() {
+        hibernating = false;
+        booted = false;
+        fiber_exited = false;
+        powered_off = false;
+        ctx.state.store(SimContext::State::IDLE);
+        
+        if (SimSnapshot* snap = hibernated_state) {
+            hibernated_state = nullptr;
+            // Counters the coordinator's injections moved while asleep
+            snap->step_stats = ctx.step_stats;
+            snap->radio.rx_dropped = node_radio.getRxDropped();
+            snap->radio.rx_high_water = node_radio.getRxHighWater();
+            loadSnapshot(*snap, true);
+            pending_restore = snap;
+        }
+        startExecution();
+        awaitBoot();
+    }
+    
+    // Prepare the next step: advance time and clear board flags
+    void beginStep(uint64_t sim_millis, uint32_t sim_rtc_secs) {
+        ctx.current_millis = sim_millis;
+        ctx.current_rtc_secs = sim_rtc_secs;
+        ctx.millis_clock.setMillis(sim_millis);
+        ctx.rtc_clock.setCurrentTime(sim_rtc_secs);
+        
+        node_board.clearRebootRequest();
+        node_board.clearPowerOffRequest();
+    }
+    
+    // Hand the node a RUNNING request (a step, or a reboot if reboot_pending)
+    void run() {
+        ctx.state.store(SimContext::State::RUNNING);
+        if (node_fiber) {
+            SimFiberScheduler::instance().post(&SimNodeImpl::fiberSlice, this);
+        }
+    }
+    
+    // Route Serial output per config (the log sink is kept)
+    void applyLogConfig() {
+        ctx.log_config.mode = static_cast<SimLogMode>(config.log_mode);
+        ctx.log_config.discard_serial_tx = config.discard_serial_tx != 0;
+    }
+    
+    // Initialize the node's subsystems from config (first boot)
+    void initSubsystems() {
+        // Hardware objects seen by the firmware as board, radio_driver, etc.
+        node_radio.configure(config.lora_freq, config.lora_bw, 
+                             config.lora_sf, config.lora_cr, config.lora_tx_power);
+        node_radio.begin();
+        node_board.init();
+        node_rtc.setCurrentTime(config.initial_rtc);
         
         // Initialize SimContext subsystems (used internally by the simulation framework)
-        ctx.rng.seed(config.rng_seed);
+        seedRng(ctx.rng, SIM_RNG_STREAM_CONTEXT);
         ctx.millis_clock.setMillis(config.initial_millis);
         ctx.rtc_clock.setCurrentTime(config.initial_rtc);
         ctx.filesystem.begin();
+    }
+    
+    // Reset subsystems for a reboot (preserves the filesystem) and re-run setup
+    void rebootFirmware() {
+        node_radio.configure(config.lora_freq, config.lora_bw,
+                             config.lora_sf, config.lora_cr, config.lora_tx_power);
+        node_radio.setRxQueueDepth(config.rx_queue_depth);
+        node_radio.begin();
+        applyLogConfig();
+        ctx.filesystem.setWriteBack(config.fs_write_back != 0);
+        node_board.init();
+        seedRng(ctx.rng, SIM_RNG_STREAM_CONTEXT);
+        ctx.millis_clock.setMillis(config.initial_millis);
+        ctx.rtc_clock.setCurrentTime(config.initial_rtc);
+        idle_inputs_valid = false;
+        next_wake_millis = 0;
+        powered_off = false;
         
-        // Run setup
+        teardownFirmware();
         setup();
+    }
+    
+    // Drop the running firmware. With a node heap, whatever it still held
+    // (leaks included) is reclaimed at once; no file handle may outlive that.
+    void teardownFirmware() {
+        releaseFirmware();
+        if (config.node_heap) {
+            ctx.filesystem.releaseHandles();
+            heap.reset();
+        }
+    }
+    
+    // Gather the counters reported by sim_get_stats()
+    void getStats(SimNodeStats* out) const {
+        const StepStats& steps = ctx.step_stats;
+        out->steps = steps.steps;
+        out->skipped_steps = ctx.spin_config.skipped_steps;
+        out->budget_exhausted_steps = steps.budget_exhausted;
+        out->loop_iterations = ctx.spin_config.total_loop_iterations;
+        out->max_loop_iterations = steps.max_loop_iterations;
+        out->spin_detections = ctx.spin_config.spin_detection_count;
+        
+        out->step_cpu_total_ns = steps.cpu_total_ns;
+        out->step_cpu_min_ns = steps.cpu_min_ns == UINT64_MAX ? 0 : steps.cpu_min_ns;
+        out->step_cpu_max_ns = steps.cpu_max_ns;
+        memcpy(out->step_cpu_histogram, steps.cpu_histogram, sizeof(out->step_cpu_histogram));
+        
+        out->packets_recv = node_radio.getPacketsRecv();
+        out->packets_sent = node_radio.getPacketsSent();
+        out->packets_recv_errors = node_radio.getPacketsRecvErrors();
+        out->rx_dropped = node_radio.getRxDropped();
+        out->rx_queue_high_water = node_radio.getRxHighWater();
+        out->tx_airtime_ms = node_radio.getTotalTxAirtime();
+        out->rx_airtime_ms = node_radio.getTotalRxAirtime();
+        
+        out->serial_rx_bytes = steps.serial_rx_bytes;
+        out->serial_rx_dropped = steps.serial_rx_dropped;
+        out->serial_tx_bytes = steps.serial_tx_bytes;
+        
+        const SimOpStats& ops = ctx.op_stats;
+        out->ed25519_verifies = ops.ed25519_verifies;
+        out->ed25519_signs = ops.ed25519_signs;
+        out->key_exchanges = ops.key_exchanges;
+        out->aes_blocks = ops.aes_blocks;
+        out->sha256_blocks = ops.sha256_blocks;
+        out->hmacs = ops.hmacs;
+        out->fs_opens = ops.fs_opens;
+        out->fs_bytes_read = ops.fs_bytes_read;
+        out->fs_bytes_written = ops.fs_bytes_written;
+        out->fs_bytes_copied = ops.fs_bytes_copied;
+        out->fs_bytes_committed = ops.fs_bytes_committed;
+        out->fs_rewrites_coalesced = ops.fs_rewrites_coalesced;
+        out->string_heap_allocs = ops.string_heap_allocs;
+        out->string_heap_bytes = ops.string_heap_bytes;
+        out->mesh_seen_hits = ops.mesh_seen_hits;
+        out->mesh_seen_misses = ops.mesh_seen_misses;
+        out->mesh_seen_evictions = ops.mesh_seen_evictions;
+    }
+    
+    // Capture the node's state (coordinator side, node not running)
+    SimSnapshot* captureSnapshot() {
+        std::unique_ptr<SimSnapshot> snap(new SimSnapshot());
+        snap->node_type = getNodeType();
+        snap->config = config;
+        snap->config.fs_image = nullptr;
+        snap->files = ctx.filesystem.snapshotFiles();
+        node_radio.saveSnapshot(snap->radio);
+        snap->node_rtc_time = node_rtc.getCurrentTime();
+        snap->current_millis = ctx.current_millis;
+        snap->current_rtc_secs = ctx.current_rtc_secs;
+        snap->rng = ctx.rng;
+        snap->wake_stats = ctx.wake_stats;
+        snap->step_stats = ctx.step_stats;
+        snap->op_stats = ctx.op_stats;
+        snap->spin_detection_count = ctx.spin_config.spin_detection_count;
+        snap->total_loop_iterations = ctx.spin_config.total_loop_iterations;
+        snap->skipped_steps = ctx.spin_config.skipped_steps;
+        snap->state_hash = state_hash;
+        snap->firmware = saveFirmwareState();
+        return snap.release();
+    }
+    
+    // First half of a restore, on the coordinator side while the node is
+    // not running: everything the firmware does not own. Uses the current
+    // config, so a fork can change identity and radio parameters. In place
+    // (wake()), the node's own files and RX queue are current and kept.
+    void loadSnapshot(const SimSnapshot& snap, bool in_place = false) {
+        node_radio.configure(config.lora_freq, config.lora_bw,
+                             config.lora_sf, config.lora_cr, config.lora_tx_power);
+        node_radio.setRxQueueDepth(config.rx_queue_depth);
+        node_radio.begin();
+        if (!in_place) {
+            node_radio.restoreRxQueue(snap.radio);
+            next_wake_millis = 0;
+        }
+        applyLogConfig();
+        node_board.init();
+        node_rtc.setCurrentTime(snap.node_rtc_time);
+        ctx.current_millis = snap.current_millis;
+        ctx.current_rtc_secs = snap.current_rtc_secs;
+        ctx.millis_clock.setMillis(snap.current_millis);
+        ctx.rtc_clock.setCurrentTime(snap.current_rtc_secs);
+        ctx.wake_registry.clear();
+        if (!in_place) {
+            ctx.filesystem.restoreFiles(snap.files);
+        }
+    }
+    
+    // Second half, on the node's thread/fiber: rebuild the firmware over the
+    // restored files, then put back the captured counters. The RNG streams
+    // continue unless the config asks for a different seed.
+    void finishRestore() {
+        SimSnapshot* snap = pending_restore;
+        pending_restore = nullptr;
+        // The saved streams carry on only if they are still this node's
+        bool continue_rng = config.rng_seed == snap->config.rng_seed &&
+                            memcmp(config.public_key, snap->config.public_key,
+                                   SIM_PUB_KEY_SIZE) == 0;
+        
+        ctx.filesystem.begin();
+        setup();
+        
+        node_radio.restoreState(snap->radio);
+        if (continue_rng) {
+            ctx.rng = snap->rng;
+        } else {
+            seedRng(ctx.rng, SIM_RNG_STREAM_CONTEXT);
+        }
+        ctx.wake_stats = snap->wake_stats;
+        ctx.step_stats = snap->step_stats;
+        ctx.op_stats = snap->op_stats;
+        ctx.spin_config.spin_detection_count = snap->spin_detection_count;
+        ctx.spin_config.total_loop_iterations = snap->total_loop_iterations;
+        ctx.spin_config.skipped_steps = snap->skipped_steps;
+        state_hash = snap->state_hash;
+        idle_inputs_valid = false;
+        if (snap->firmware) {
+            restoreFirmwareState(*snap->firmware, continue_rng);
+        }
+        snap->release();
+    }
+    
+    // Boot the firmware for the first time
+    void firstBoot() {
+        if (pending_restore) {
+            finishRestore();
+        } else {
+            initSubsystems();
+            setup();
+        }
+    }
+    
+    // Service the current RUNNING request
+    void serviceRequest() {
+        if (reboot_pending.exchange(false)) {
+            if (pending_restore) {
+                teardownFirmware();
+                finishRestore();
+            } else {
+                rebootFirmware();
+            }
+        } else {
+            runStep();
+        }
+    }
+    
+    // Signal step complete. Once the state is stored the coordinator may
+    // destroy the node, so the batch latch (which outlives every node's
+    // count) is taken first.
+    void publishYield() {
+        SimStepLatch* latch = step_latch;
+        step_latch = nullptr;
+        ctx.state.store(SimContext::State::YIELDED);
+        if (latch) {
+            latch->countDown();
+        }
+    }
+    
+    static void threadEntry(void* arg) {
+        static_cast<SimNodeImpl*>(arg)->threadMain();
+    }
+    
+    // Thread entry point (SIM_EXEC_THREAD)
+    void threadMain() {
+        // Bind this node's objects as the thread's firmware globals
+        simBindNode(bindings());
+        
+        // Run setup
+        firstBoot();
+        {
+            std::lock_guard<std::mutex> lock(ctx.step_mutex);
+            booted = true;
+            ctx.step_cv.notify_one();
+        }
         
         // Main loop
         while (ctx.state.load() != SimContext::State::SHUTDOWN) {
             // Wait for step_begin signal
-            {
-                std::unique_lock<std::mutex> lock(ctx.step_mutex);
-                ctx.step_cv.wait(lock, [this] {
-                    auto state = ctx.state.load();
-                    return state == SimContext::State::RUNNING ||
-                           state == SimContext::State::SHUTDOWN;
-                });
-                
-                if (ctx.state.load() == SimContext::State::SHUTDOWN) {
-                    break;
-                }
+            auto state = ctx.state.waitFor(SimStepHandoff::NODE,
+                                           {SimContext::State::RUNNING,
+                                            SimContext::State::SHUTDOWN});
+            if (state == SimContext::State::SHUTDOWN) {
+                break;
             }
             
-            // Clear step result
-            memset(&ctx.step_result, 0, sizeof(ctx.step_result));
-            ctx.step_result.reason = SIM_YIELD_IDLE;
-            
-            // Reset per-step loop iteration counter
-            ctx.spin_config.loop_iterations_this_step = 0;
+            serviceRequest();
+            publishYield();
+        }
+    }
+    
+    // Fiber entry point (SIM_EXEC_FIBER). Each suspend() may resume on a
+    // different worker thread, so nothing here may touch thread_local state
+    // directly; the worker rebinds the firmware globals in fiberSlice().
+    void fiberMain() {
+        if (ctx.state.load() == SimContext::State::SHUTDOWN) {
+            return;
+        }
+        
+        firstBoot();
+        
+        // A reboot requested before the first run is satisfied by this boot
+        if (!reboot_pending.exchange(false)) {
+            // First boot ran inside the first step; restore that step's clocks
+            ctx.millis_clock.setMillis(ctx.current_millis);
+            ctx.rtc_clock.setCurrentTime(ctx.current_rtc_secs);
+            runStep();
+        }
+        
+        for (;;) {
+            node_fiber->suspend();
+            if (ctx.state.load() == SimContext::State::SHUTDOWN) {
+                return;
+            }
+            serviceRequest();
+        }
+    }
+    
+    static void fiberEntry(void* arg) {
+        static_cast<SimNodeImpl*>(arg)->fiberMain();
+    }
+    
+    // Worker-side slice: bind globals, run the fiber until it yields, publish
+    static void fiberSlice(void* arg) {
+        auto* node = static_cast<SimNodeImpl*>(arg);
+        SimNodeBindings previous = simBindNode(node->bindings());
+        node->node_fiber->resume();
+        simBindNode(previous);
+        
+        if (node->node_fiber->finished()) {
+            std::lock_guard<std::mutex> lock(node->ctx.step_mutex);
+            node->fiber_exited = true;
+            node->ctx.step_cv.notify_one();
+        } else {
+            node->publishYield();
+        }
+    }
+    
+    // Pick the wake time for an idle yield: the earliest registered firmware
+    // deadline, bounded by the idle wake interval for timers the simulator
+    // cannot see (adverts, noise floor calibration, ...)
+    uint64_t nextIdleWake() {
+        uint64_t now = ctx.current_millis;
+        ctx.wake_registry.clearExpired(now);
+        
+        uint64_t interval = config.idle_wake_interval_ms ? config.idle_wake_interval_ms
+                                                         : SIM_DEFAULT_IDLE_WAKE_MS;
+        // A packet that is due but unsent is waiting on the airtime budget or
+        // channel activity, which has no registered deadline - keep polling
+        if (ctx.packet_manager &&
+            ctx.packet_manager->getOutboundCount(static_cast<uint32_t>(now)) > 0) {
+            interval = (std::min)(interval, static_cast<uint64_t>(SIM_DEFAULT_IDLE_WAKE_MS));
+        }
+        
+        uint64_t wake = now + interval;
+        uint64_t deadline = ctx.wake_registry.getNextWakeTime();
+        if (ctx.packet_manager) {
+            deadline = (std::min)(deadline, ctx.packet_manager->nextScheduledMillis(now));
+        }
+        bool at_deadline = deadline <= wake;
+        if (at_deadline) {
+            wake = deadline;
+            ctx.wake_stats.deadline_wakes++;
+        } else {
+            ctx.wake_stats.interval_wakes++;
+        }
+        ctx.wake_stats.steps_avoided += (wake - now - 1) / SIM_DEFAULT_IDLE_WAKE_MS;
+        
+        if (ctx.spin_config.log_loop_iterations) {
+            printf("[WAKE] Idle until %llu (+%llu ms, %s), %llu steps avoided total\n",
+                   (unsigned long long)wake, (unsigned long long)(wake - now),
+                   at_deadline ? "deadline" : "interval",
+                   (unsigned long long)ctx.wake_stats.steps_avoided);
+        }
+        return wake;
+    }
+    
+    // Fold the finished step into state_hash and publish it. Output buffers
+    // are only hashed when there is output, so an idle step costs a few
+    // multiplies.
+    void hashStep() {
+        const SimStepResult& result = ctx.step_result;
+        uint64_t hash = simHashWord(state_hash, static_cast<uint64_t>(result.reason));
+        hash = simHashWord(hash, result.current_millis);
+        hash = simHashWord(hash, result.wake_millis);
+        if (result.radio_tx_len > 0) {
+            hash = simHashBytes(simHashWord(hash, result.radio_tx_len),
+                                result.radio_tx_data, result.radio_tx_len);
+        }
+        if (result.serial_tx_len > 0) {
+            hash = simHashBytes(simHashWord(hash, result.serial_tx_len),
+                                result.serial_tx_data, result.serial_tx_len);
+        }
+        if (result.log_output_len > 0) {
+            hash = simHashBytes(simHashWord(hash, result.log_output_len),
+                                result.log_output, result.log_output_len);
+        }
+        hash = simHashWord(hash, result.serial_tx_pending);
+        hash = simHashWord(hash, result.serial_frames_pending);
+        
+        hash = simHashWord(hash, ctx.rng.state());
+        hash = hashFirmwareState(hash);
+        hash = simHashWord(hash, (static_cast<uint64_t>(node_radio.getPacketsRecv()) << 32) |
+                                     node_radio.getPacketsSent());
+        hash = simHashWord(hash, (static_cast<uint64_t>(node_radio.getPacketsRecvErrors()) << 32) |
+                                     node_radio.getRxDropped());
+        hash = simHashWord(hash, (static_cast<uint64_t>(node_radio.getTotalTxAirtime()) << 32) |
+                                     node_radio.getTotalRxAirtime());
+        hash = simHashWord(hash, ctx.filesystem.writeHash());
+        
+        state_hash = hash;
+        ctx.step_result.state_hash = hash;
+    }
+    
+    // Remember when the node wants its next step. A result without a wake
+    // time (a TX start, reboot or power off) wants one once the coordinator
+    // has handled it.
+    void noteStepEnd() {
+        next_wake_millis = ctx.step_result.wake_millis ? ctx.step_result.wake_millis
+                                                       : ctx.current_millis;
+        step_inputs = inputVersion();
+    }
+    
+    // Coordinator side, node not stepping: the wake time of the last step,
+    // and whether input has arrived since that the firmware has not seen
+    uint64_t peekNextWake(bool* inputs_pending) const {
+        if (inputs_pending) {
+            *inputs_pending = node_radio.hasQueuedRx() || ctx.serial.available() > 0 ||
+                              ctx.serial.rxFrames().count() > 0 ||
+                              !(inputVersion() == step_inputs);
+        }
+        return next_wake_millis;
+    }
+    
+    // Close the step's events with its wake time
+    void addWakeEvent() {
+        SimStepEvent event = {};
+        event.kind = SIM_STEP_EVENT_WAKE;
+        event.wake_millis = ctx.step_result.wake_millis;
+        ctx.addStepEvent(event);
+    }
+    
+    // Inputs the firmware has seen once the current step's result is out
+    SimInputVersion inputVersion() const {
+        SimInputVersion version;
+        version.radio_state = node_radio.stateVersion();
+        version.serial_tx_pending = ctx.serialTxPending();
+        version.frames_tx_queued = ctx.serial.txFrames().count();
+        return version;
+    }
+    
+    // True if the last step was idle and nothing it could react to has
+    // happened since: no input queued or changed and no deadline reached
+    bool inputsUnchanged() const {
+        if (!config.skip_idle_steps || !idle_inputs_valid) {
+            return false;
+        }
+        uint64_t now = ctx.current_millis;
+        if (now < idle_step_millis || now >= idle_wake_millis) {
+            return false;
+        }
+        if (node_radio.hasQueuedRx() || ctx.serial.available() > 0 ||
+            ctx.serial.rxFrames().count() > 0) {
+            return false;
+        }
+        // A due packet waits on the airtime budget, which frees up with time
+        if (ctx.packet_manager &&
+            ctx.packet_manager->getOutboundCount(static_cast<uint32_t>(now)) > 0) {
+            return false;
+        }
+        return inputVersion() == idle_inputs;
+    }
+    
+    // Run one simulation step (double-loop idle detection)
+    void runStep() {
+        SIM_TRACE_SCOPE(SIM_TRACE_STEP, "step");
+        
+        // Clear step result
+        memset(&ctx.step_result, 0, sizeof(ctx.step_result));
+        ctx.step_result.reason = SIM_YIELD_IDLE;
+        ctx.resetStepEvents();
+        powered_off = false;
+        
+        // Nothing new since the last idle step: loop() would find nothing to
+        // do, so give the same answer without running it
+        ctx.step_stats.steps++;
+        
+        // Serial output nobody has taken holds the firmware, like a blocking
+        // UART write; this step only hands out the next part of it
+        if (ctx.serialTxBackedUp()) {
+            idle_inputs_valid = false;
+            ctx.step_result.reason = SIM_YIELD_SERIAL_BACKPRESSURE;
+            ctx.step_result.wake_millis = ctx.current_millis;
+            addWakeEvent();
+            ctx.finalizeStepResult();
+            hashStep();
+            noteStepEnd();
+            return;
+        }
+        
+        if (inputsUnchanged()) {
+            SIM_TRACE_INSTANT(SIM_TRACE_STEP, "step.skipped");
+            ctx.spin_config.skipped_steps++;
+            ctx.step_result.wake_millis = idle_wake_millis;
+            addWakeEvent();
+            if (ctx.spin_config.log_loop_iterations) {
+                printf("[LOOP] Step skipped: inputs unchanged, %llu skipped total\n",
+                       (unsigned long long)ctx.spin_config.skipped_steps);
+            }
+            ctx.finalizeStepResult();
+            idle_inputs = inputVersion();
+            hashStep();
+            noteStepEnd();
+            return;
+        }
+        idle_inputs_valid = false;
+        uint64_t cpu_start = simThreadCpuNanos();
+        
+        // Reset per-step loop iteration counter
+        ctx.spin_config.loop_iterations_this_step = 0;
+        
+        // Double-loop idle detection:
+        // Run the loop until we get two consecutive iterations without output,
+        // or until a TX/reboot/power-off condition is triggered.
+        // This ensures the firmware has fully processed available input before yielding.
+        // With continue_after_tx a TX start counts as output instead: the
+        // radio stays busy, so the firmware runs on until it is idle.
+        bool continue_after_tx = config.continue_after_tx != 0;
+        bool tx_started = false;
+        int loops_without_output = 0;
+        
+        // Step budget: a burst that would keep loop() busy past it ends the
+        // step early and resumes on the next one, so other nodes get a turn.
+        // The idle check can add one loop past the budget.
+        uint32_t budget_loops = config.step_budget_loops;
+        bool budget_time = config.step_budget_us != 0;
+        auto budget_deadline = std::chrono::steady_clock::time_point();
+        if (budget_time) {
+            budget_deadline = std::chrono::steady_clock::now() +
+                              std::chrono::microseconds(config.step_budget_us);
+        }
+        bool budget_exhausted = false;
+        bool serial_backed_up = false;
+        while (loops_without_output < 2) {
+            // Track output state before loop iteration
+            uint64_t console_writes_before = ctx.console_writes;
+            bool had_pending_tx_before = node_radio.hasPendingTx();
+            uint32_t packets_sent_before = node_radio.getPacketsSent();
             
-            // Double-loop idle detection:
-            // Run the loop until we get two consecutive iterations without output,
-            // or until a TX/reboot/power-off condition is triggered.
-            // This ensures the firmware has fully processed available input before yielding.
-            int loops_without_output = 0;
-            while (loops_without_output < 2) {
-                // Track output state before loop iteration
-                size_t serial_tx_before = ctx.getSerialTxBufferSize();
-                bool had_pending_tx_before = _sim_radio_instance.hasPendingTx();
-                
-                // Run one loop iteration
+            // Run one loop iteration
+            {
+                SIM_TRACE_SCOPE(SIM_TRACE_STEP, "loop");
                 loop();
-                
-                // Track loop iteration counts for determinism verification
-                ctx.spin_config.loop_iterations_this_step++;
-                ctx.spin_config.total_loop_iterations++;
-                
-                // Check for immediate yield conditions (TX, reboot, power-off)
-                if (_sim_radio_instance.hasPendingTx() && !had_pending_tx_before) {
-                    // TX started - yield immediately for radio handling
-                    break;
-                }
-                
-                if (_sim_board_instance.wasRebootRequested()) {
-                    ctx.step_result.reason = SIM_YIELD_REBOOT;
-                    break;
-                }
-                
-                if (_sim_board_instance.wasPowerOffRequested()) {
-                    ctx.step_result.reason = SIM_YIELD_POWER_OFF;
-                    break;
-                }
-                
-                // Check if any output was produced during this loop iteration
-                bool had_serial_output = ctx.getSerialTxBufferSize() > serial_tx_before;
-                bool had_radio_tx = _sim_radio_instance.hasPendingTx();
-                bool had_output = had_serial_output || had_radio_tx;
-                
-                if (had_output) {
-                    // Output produced - reset idle counter
-                    loops_without_output = 0;
-                    if (had_radio_tx) {
-                        // TX needs immediate handling
-                        break;
-                    }
-                } else {
-                    // No output - increment idle counter
-                    loops_without_output++;
-                }
             }
             
-            // Log loop iterations if enabled (for determinism debugging)
-            if (ctx.spin_config.log_loop_iterations) {
-                printf("[LOOP] Step completed: %u iterations this step, %llu total\n",
-                       ctx.spin_config.loop_iterations_this_step,
-                       (unsigned long long)ctx.spin_config.total_loop_iterations);
+            // Track loop iteration counts for determinism verification
+            ctx.spin_config.loop_iterations_this_step++;
+            ctx.spin_config.total_loop_iterations++;
+            
+            // Check for immediate yield conditions (TX, reboot, power-off)
+            bool tx_started_now = node_radio.getPacketsSent() != packets_sent_before;
+            tx_started = tx_started || tx_started_now;
+            if (node_radio.hasPendingTx() && !had_pending_tx_before && !continue_after_tx) {
+                // TX started - yield immediately for radio handling
+                break;
             }
             
-            // Check for radio TX or other yield conditions
-            // Note: We check the thread-local global _sim_radio_instance because
-            // that's what the firmware uses (via radio_driver macro)
-            if (_sim_radio_instance.hasPendingTx()) {
-                // TX started - we already set step_result in startSendRaw
-            } else if (_sim_board_instance.wasRebootRequested()) {
+            if (node_board.wasRebootRequested()) {
                 ctx.step_result.reason = SIM_YIELD_REBOOT;
-            } else if (_sim_board_instance.wasPowerOffRequested()) {
+                break;
+            }
+            
+            if (node_board.wasPowerOffRequested()) {
                 ctx.step_result.reason = SIM_YIELD_POWER_OFF;
-            } else {
-                
-                // Clear expired wake times
-                ctx.wake_registry.clearExpired(ctx.current_millis);
-                
-                // Idle - use wake time registry if available, otherwise default
-                ctx.step_result.reason = SIM_YIELD_IDLE;
-                uint64_t next_wake = ctx.wake_registry.getNextWakeTime();
-                if (next_wake != UINT64_MAX) {
-                    ctx.step_result.wake_millis = next_wake;
-                } else {
-                    ctx.step_result.wake_millis = ctx.current_millis + 100; // Default: wake in 100ms
+                break;
+            }
+            
+            // Check if any output was produced during this loop iteration
+            bool had_serial_output = ctx.console_writes != console_writes_before;
+            bool had_radio_tx = continue_after_tx ? tx_started_now : node_radio.hasPendingTx();
+            bool had_output = had_serial_output || had_radio_tx;
+            
+            if (had_output) {
+                // Output produced - reset idle counter
+                loops_without_output = 0;
+                if (had_radio_tx && !continue_after_tx) {
+                    // TX needs immediate handling
+                    break;
                 }
+            } else {
+                // No output - increment idle counter
+                loops_without_output++;
             }
             
-            // Finalize step result (copy logs, serial TX, etc.)
-            ctx.finalizeStepResult();
+            // The serial backlog filled up: stop until the coordinator takes it
+            if (ctx.serialTxBackedUp()) {
+                serial_backed_up = true;
+                break;
+            }
             
-            // Signal step complete
-            {
-                std::lock_guard<std::mutex> lock(ctx.step_mutex);
-                ctx.state.store(SimContext::State::YIELDED);
+            // Only a loop that did work ends the step early: quiet loops
+            // finish the idle check, else a small budget never reaches idle
+            if (loops_without_output == 0 &&
+                ((budget_loops && ctx.spin_config.loop_iterations_this_step >= budget_loops) ||
+                 (budget_time && std::chrono::steady_clock::now() >= budget_deadline))) {
+                budget_exhausted = true;
+                break;
             }
-            ctx.step_cv.notify_all();
         }
+        
+        // Log loop iterations if enabled (for determinism debugging)
+        if (ctx.spin_config.log_loop_iterations) {
+            printf("[LOOP] Step completed: %u iterations this step, %llu total, %llu skipped\n",
+                   ctx.spin_config.loop_iterations_this_step,
+                   (unsigned long long)ctx.spin_config.total_loop_iterations,
+                   (unsigned long long)ctx.spin_config.skipped_steps);
+        }
+        
+        // Check for radio TX or other yield conditions
+        if (node_board.wasRebootRequested() && (continue_after_tx || !node_radio.hasPendingTx())) {
+            ctx.step_result.reason = SIM_YIELD_REBOOT;
+            ctx.addStepEvent(SIM_STEP_EVENT_REBOOT);
+        } else if (node_board.wasPowerOffRequested() &&
+                   (continue_after_tx || !node_radio.hasPendingTx())) {
+            ctx.step_result.reason = SIM_YIELD_POWER_OFF;
+            ctx.addStepEvent(SIM_STEP_EVENT_POWER_OFF);
+        } else if (continue_after_tx && tx_started) {
+            // Spin detection may have overwritten the reason since the TX.
+            // Cut short by the budget or the serial backlog, the node wants
+            // the next step now.
+            ctx.step_result.reason = SIM_YIELD_RADIO_TX_START;
+            ctx.step_result.wake_millis =
+                budget_exhausted || serial_backed_up ? ctx.current_millis : nextIdleWake();
+            addWakeEvent();
+        } else if (node_radio.hasPendingTx() && !continue_after_tx) {
+            // TX started - we already set step_result in startSendRaw
+        } else if (serial_backed_up) {
+            ctx.step_result.reason = SIM_YIELD_SERIAL_BACKPRESSURE;
+            ctx.step_result.wake_millis = ctx.current_millis;
+            addWakeEvent();
+        } else if (budget_exhausted) {
+            ctx.step_result.reason = SIM_YIELD_BUDGET_EXHAUSTED;
+            ctx.step_result.wake_millis = ctx.current_millis;
+            addWakeEvent();
+            ctx.step_stats.budget_exhausted++;
+        } else {
+            
+            ctx.step_result.reason = SIM_YIELD_IDLE;
+            ctx.step_result.wake_millis = nextIdleWake();
+            addWakeEvent();
+            
+            // Remember what this step saw, for skipping the next one
+            idle_inputs_valid = true;
+            idle_step_millis = ctx.current_millis;
+            idle_wake_millis = ctx.step_result.wake_millis;
+        }
+        
+        // Store the files the firmware saved during the step (write-back)
+        ctx.filesystem.commitStaged();
+        
+        // Finalize step result (copy logs, serial TX, etc.)
+        ctx.finalizeStepResult();
+        if (idle_inputs_valid) {
+            idle_inputs = inputVersion();
+        }
+        hashStep();
+        noteStepEnd();
+        powered_off = ctx.step_result.reason == SIM_YIELD_POWER_OFF;
+        
+        if (ctx.spin_config.loop_iterations_this_step > ctx.step_stats.max_loop_iterations) {
+            ctx.step_stats.max_loop_iterations = ctx.spin_config.loop_iterations_this_step;
+        }
+        ctx.step_stats.recordCpu(simThreadCpuNanos() - cpu_start);
     }
 };
 
+// Create this library's node type with its config (SimNodeImpl::create()),
+// not yet started (implemented in each node's sim_main.cpp, for sim_fork())
+SimNodeImpl* simNewNode(const SimNodeConfig& config);
+
 #endif // SIM_NODE_BASE_H
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstdint>
+
+// ============================================================================
+// Operation Counters
+// ============================================================================
+// Crypto, filesystem, String heap and dedup table work done by a node,
+// reported by sim_get_stats(). The stubs count into the node bound to the
+// calling thread (g_sim_ctx), which only that thread touches while it owns
+// the step, so the counters are plain integers. Work done outside a node's
+// binding, such as the coordinator's sim_fs_*() calls, is not counted.
+//
+// Kept free of standard container headers: the crypto stubs include this
+// from firmware translation units that rely on the Arduino min()/max() macros.
+
+struct SimOpStats {
+    uint64_t ed25519_verifies = 0;
+    uint64_t ed25519_signs = 0;
+    uint64_t key_exchanges = 0;
+    uint64_t aes_blocks = 0;          // Encrypted and decrypted
+    uint64_t sha256_blocks = 0;       // Compressed (memoized HMAC key pads are not)
+    uint64_t hmacs = 0;
+    uint64_t fs_opens = 0;
+    uint64_t fs_bytes_read = 0;
+    uint64_t fs_bytes_written = 0;
+    uint64_t fs_bytes_copied = 0;     // Copy-on-write of files shared with a reader or image
+    uint64_t fs_bytes_committed = 0;  // Write-back: staged files stored at the end of a step
+    uint64_t fs_rewrites_coalesced = 0; // Write-back: rewrites of a file staged since the last commit
+    uint64_t string_heap_allocs = 0;  // Arduino String buffers outgrowing inline storage
+    uint64_t string_heap_bytes = 0;
+    uint64_t mesh_seen_hits = 0;      // Packet-seen table (helpers/SimpleMeshTables.h)
+    uint64_t mesh_seen_misses = 0;
+    uint64_t mesh_seen_evictions = 0; // Live entries overwritten by a newer packet
+};
+
+// Counters of the node bound to the calling thread (nullptr if none)
+SimOpStats* simOpStats();
+
+#define SIM_COUNT_OP(field, n) \
+    do { \
+        if (SimOpStats* sim_op_stats_ = simOpStats()) sim_op_stats_->field += (n); \
+    } while (0)
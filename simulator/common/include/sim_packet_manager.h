@@ -0,0 +1,117 @@
+#pragma once
+
+#include <Dispatcher.h>
+
+#include <cstdint>
+#include <vector>
+
+struct SimContext;
+
+// ============================================================================
+// Packet Queue
+// ============================================================================
+// Same ordering as MeshCore's PacketQueue: get(now) returns, among the
+// entries scheduled at or before now, the one with the lowest priority value,
+// the earliest added on ties. Index order is the order of adding.
+//
+// PacketQueue finds that entry with a scan of the whole table. Here entries
+// wait in a min-heap on (scheduled_for, order added) until they are due, then
+// move to a min-heap on (priority, order added), so get() and add() are
+// O(log n). Times compare as raw 32-bit millis, as upstream.
+
+class SimPacketQueue {
+public:
+    explicit SimPacketQueue(int capacity);
+
+    // False if the queue is full
+    bool add(mesh::Packet* packet, uint8_t priority, uint32_t scheduled_for);
+    mesh::Packet* get(uint32_t now);
+
+    int count() const { return static_cast<int>(waiting_.size() + ready_.size()); }
+    int countBefore(uint32_t now) const;
+
+    mesh::Packet* itemAt(int i);
+    mesh::Packet* removeByIdx(int i);
+
+    // Earliest scheduled_for after now, if any entry has one
+    bool nextAfter(uint32_t now, uint32_t& scheduled_for) const;
+
+private:
+    struct Entry {
+        mesh::Packet* packet;
+        uint32_t scheduled_for;
+        uint32_t seq;           // Order added
+        uint8_t priority;
+        bool ready;             // In ready_ (due), else in waiting_
+        int heap_pos;
+    };
+
+    bool before(bool ready, int a, int b) const;
+    std::vector<int>& heap(bool ready) { return ready ? ready_ : waiting_; }
+    void push(bool ready, int slot);
+    int pop(bool ready);
+    void erase(int slot);
+    void siftUp(bool ready, size_t pos);
+    void siftDown(bool ready, size_t pos);
+    void place(bool ready, size_t pos, int slot);
+
+    // Move entries between the heaps so ready_ holds exactly those due at now
+    void advance(uint32_t now);
+    // Waiting entries due at now, and the earliest not yet due
+    void scanWaiting(uint32_t now, int& due, uint32_t& next, bool& has_next) const;
+    void scanFrom(size_t pos, uint32_t now, int& due, uint32_t& next, bool& has_next) const;
+
+    std::vector<Entry> entries_;
+    std::vector<int> free_slots_;
+    std::vector<int> waiting_;
+    std::vector<int> ready_;
+    uint32_t promoted_to_ = 0;      // ready_ holds everything due at this time
+    uint32_t next_seq_ = 0;
+
+    // Live slots in index order, rebuilt after a change
+    std::vector<int> order_;
+    bool order_valid_ = true;
+};
+
+// ============================================================================
+// Packet Manager
+// ============================================================================
+// Replaces MeshCore's StaticPoolPacketManager (see
+// helpers/StaticPoolPacketManager.h): a fixed pool of packets handed out
+// first-freed-first, and outbound and inbound queues with the same ordering.
+// Registers itself as the node's SimContext::packet_manager, so the idle
+// logic can see due packets and wake at the next scheduled one.
+
+class SimPacketManager : public mesh::PacketManager {
+public:
+    explicit SimPacketManager(int pool_size);
+    ~SimPacketManager();
+
+    SimPacketManager(const SimPacketManager&) = delete;
+    SimPacketManager& operator=(const SimPacketManager&) = delete;
+
+    mesh::Packet* allocNew() override;
+    void free(mesh::Packet* packet) override;
+    void queueOutbound(mesh::Packet* packet, uint8_t priority, uint32_t scheduled_for) override;
+    mesh::Packet* getNextOutbound(uint32_t now) override;
+    int getOutboundCount(uint32_t now) const override;
+    int getFreeCount() const override;
+    mesh::Packet* getOutboundByIdx(int i) override;
+    mesh::Packet* removeOutboundByIdx(int i) override;
+    void queueInbound(mesh::Packet* packet, uint32_t scheduled_for) override;
+    mesh::Packet* getNextInbound(uint32_t now) override;
+
+    // Simulation time of the next packet scheduled after current_millis,
+    // outbound or inbound (UINT64_MAX if none)
+    uint64_t nextScheduledMillis(uint64_t current_millis) const;
+
+private:
+    std::vector<mesh::Packet*> pool_;
+    std::vector<mesh::Packet*> unused_;     // Ring, oldest free packet first
+    size_t unused_head_ = 0;
+    size_t unused_count_ = 0;
+
+    SimPacketQueue send_queue_;
+    SimPacketQueue rx_queue_;
+    SimContext* ctx_;
+};
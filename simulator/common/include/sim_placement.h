@@ -0,0 +1,58 @@
+#pragma once
+
+#include "sim_api.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// ============================================================================
+// Node Threads and Placement
+// ============================================================================
+// Stack size, CPU and NUMA node of a node (SimNodeConfig.stack_size_kb,
+// placement, placement_target). The node object, which holds its SimContext,
+// is allocated on the NUMA node before it is constructed. The node heap's
+// chunks and the firmware's own allocations follow by first touch, since
+// setup() already runs on the pinned thread.
+//
+// - Linux: pthread attributes, sched_setaffinity and mbind (called directly,
+//   no libnuma), topology from /sys/devices/system/node
+// - Windows: CreateThread stack reserve, SetThreadGroupAffinity and
+//   VirtualAllocExNuma
+// - Elsewhere: stack size only; the placement is ignored
+
+struct SimPlacement {
+    int cpu = -1;           // CPU the thread is pinned to (-1 = any)
+    int numa_node = -1;     // NUMA node of the thread and node memory (-1 = any)
+};
+
+// Resolve a config's placement. SIM_PLACE_SPREAD hands out the process's
+// CPUs in turn, one per call.
+SimPlacement simPlaceNode(const SimNodeConfig& config);
+
+// Page-granular memory for a node object, on `numa_node` when it is >= 0
+void* simNodeAlloc(size_t size, int numa_node);
+void simNodeFree(void* ptr);
+
+// OS thread with a chosen stack size, restricted to a placement's CPU or
+// NUMA node before its entry function runs
+class SimThread {
+public:
+    using EntryFn = void (*)(void* arg);
+
+    SimThread() = default;
+    ~SimThread();
+
+    SimThread(const SimThread&) = delete;
+    SimThread& operator=(const SimThread&) = delete;
+
+    // Start entry(arg). A stack_size of 0 takes the platform default; one
+    // the platform refuses falls back to it. False if no thread started.
+    bool start(EntryFn entry, void* arg, size_t stack_size, const SimPlacement& placement);
+
+    bool joinable() const { return impl_ != nullptr; }
+    void join();
+
+private:
+    struct Impl;
+    Impl* impl_ = nullptr;
+};
@@ -60,18 +60,20 @@ class SPIFFSClass;
 // Solution: Use mangled internal names, then #define the expected names.
 // We temporarily #undef around headers that use these as parameter names.
 
-// Internal names for the global instances (defined in each DLL's sim_main.cpp)
-// IMPORTANT: These must be thread_local so each simulation thread gets its own instance
+// Internal names for the global instances (defined in sim_bindings.cpp).
+// These forward to the objects owned by whichever node is bound to the
+// current thread, so firmware sees per-node globals in both thread and
+// fiber execution modes (see sim_bindings.h).
 #ifdef __cplusplus
-class SimBoard;
-class SimRadio;
-class SimRTCClock;
-class EnvironmentSensorManager;
-
-extern thread_local SimBoard _sim_board_instance;
-extern thread_local SimRadio _sim_radio_instance;
-extern thread_local SimRTCClock _sim_rtc_instance;
-extern thread_local EnvironmentSensorManager _sim_sensors_instance;
+class SimBoardBinding;
+class SimRadioBinding;
+class SimRTCBinding;
+class SimSensorsBinding;
+
+extern thread_local SimBoardBinding _sim_board_instance;
+extern thread_local SimRadioBinding _sim_radio_instance;
+extern thread_local SimRTCBinding _sim_rtc_instance;
+extern thread_local SimSensorsBinding _sim_sensors_instance;
 #endif
 
 // Macro redirections - map firmware's expected names to our internal names
@@ -1,17 +1,59 @@
 #pragma once
 
 #include <Dispatcher.h>
-#include <queue>
-#include <mutex>
+#include "sim_airtime.h"
+#include "sim_api.h"
+#include "sim_spsc.h"
+#include <atomic>
 #include <cstring>
+#include <new>
+#include <vector>
 
 // ============================================================================
-// Configuration Constants
+// Shared Packet Buffer
 // ============================================================================
+// Immutable, reference-counted copy of a received packet. One transmission
+// heard by many nodes is copied once into a SimPacketBuffer and every
+// receiver's RX queue holds a reference to it (sim_inject_radio_rx_batch()).
+// The last receiver to consume or drop the packet frees it.
 
-/// Maximum RX queue depth - simulates radio FIFO buffer.
-/// When queue is full, new packets are dropped (overflow).
-static constexpr size_t RX_QUEUE_DEPTH = 4;
+class SimPacketBuffer {
+public:
+    // Allocate a buffer holding a copy of data, with refs initial references
+    static SimPacketBuffer* create(const uint8_t* data, size_t len, uint32_t refs) {
+        void* mem = ::operator new(sizeof(SimPacketBuffer) + len);
+        SimPacketBuffer* buffer = new (mem) SimPacketBuffer(len, refs);
+        if (len > 0) {
+            memcpy(buffer->payload(), data, len);
+        }
+        return buffer;
+    }
+
+    // Add a reference (the caller already holds one)
+    void retain() {
+        refs_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Drop one reference; frees the buffer when it was the last
+    void release() {
+        if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            this->~SimPacketBuffer();
+            ::operator delete(this);
+        }
+    }
+
+    const uint8_t* data() const { return reinterpret_cast<const uint8_t*>(this + 1); }
+    size_t size() const { return len_; }
+
+private:
+    SimPacketBuffer(size_t len, uint32_t refs) : refs_(refs), len_(len) {}
+    ~SimPacketBuffer() = default;
+
+    uint8_t* payload() { return reinterpret_cast<uint8_t*>(this + 1); }
+
+    std::atomic<uint32_t> refs_;
+    size_t len_;
+};
 
 // ============================================================================
 // Simulated Radio
@@ -20,21 +62,66 @@ static constexpr size_t RX_QUEUE_DEPTH = 4;
 // - RX packets are injected by the coordinator via sim_inject_radio_rx()
 // - TX packets are captured and reported back to the coordinator
 // - State changes are notified via sim_notify_state_change()
+// - The RX queue models the radio FIFO: it holds SimNodeConfig.rx_queue_depth
+//   packets and drops new ones when full (overflow)
 
+// One RX queue entry: a reference to the shared payload plus the link
+// quality seen by this receiver
 struct RxPacket {
-    uint8_t data[256];
-    size_t len;
+    SimPacketBuffer* buffer;
     float rssi;
     float snr;
 };
 
+// Radio state kept by sim_snapshot(). Each queued packet holds a reference
+// to its buffer; radio parameters come from the restored config instead.
+struct SimRadioSnapshot {
+    std::vector<RxPacket> rx;
+    float last_rssi = 0;
+    float last_snr = 0;
+    bool tx_pending = false;
+    bool tx_in_progress = false;
+    uint8_t tx_data[256];
+    size_t tx_len = 0;
+    uint32_t packets_recv = 0;
+    uint32_t packets_sent = 0;
+    uint32_t packets_recv_errors = 0;
+    uint32_t total_tx_airtime = 0;
+    uint32_t total_rx_airtime = 0;
+    uint32_t rx_dropped = 0;
+    uint32_t rx_high_water = 0;
+    bool recv_mode = false;
+
+    SimRadioSnapshot() = default;
+    SimRadioSnapshot(const SimRadioSnapshot&) = delete;
+    SimRadioSnapshot& operator=(const SimRadioSnapshot&) = delete;
+    ~SimRadioSnapshot() {
+        releaseRx();
+    }
+    
+    // Drop the queued packets
+    void releaseRx() {
+        for (const RxPacket& pkt : rx) {
+            pkt.buffer->release();
+        }
+        rx.clear();
+    }
+};
+
 class SimRadio : public mesh::Radio {
 public:
     SimRadio();
+    ~SimRadio();
     
     // Configuration
     void configure(float freq, float bw, uint8_t sf, uint8_t cr, uint8_t tx_power);
     
+    // Set the RX queue depth (0 = SIM_DEFAULT_RX_QUEUE_DEPTH). Changing the
+    // depth drops queued packets; call only while the node is not running
+    // and nothing is being injected.
+    void setRxQueueDepth(size_t depth);
+    size_t getRxQueueDepth() const { return rx_queue_.capacity(); }
+    
     // mesh::Radio interface
     void begin() override;
     int recvRaw(uint8_t* bytes, int sz) override;
@@ -57,11 +144,32 @@ public:
     uint32_t getTotalTxAirtime() const { return total_tx_airtime_; }
     uint32_t getTotalRxAirtime() const { return total_rx_airtime_; }
     
+    // RX queue counters, updated by the coordinator's injections
+    uint32_t getRxDropped() const { return rx_dropped_; }
+    uint32_t getRxHighWater() const { return rx_high_water_; }
+    
     // Simulation interface (called by coordinator)
     void injectRxPacket(const uint8_t* data, size_t len, float rssi, float snr);
+    // Queue a shared packet, taking over one of the caller's references.
+    // Returns false (and releases the reference) if the queue is full.
+    bool injectRxBuffer(SimPacketBuffer* buffer, float rssi, float snr);
     void notifyTxComplete();
     void notifyStateChange(uint32_t state_version);
     
+    // Capture the RX queue, TX state and counters. Call only while the node
+    // is not running and nothing is being injected.
+    void saveSnapshot(SimRadioSnapshot& out);
+    // Replace the RX queue (same conditions as saveSnapshot())
+    void restoreRxQueue(const SimRadioSnapshot& snap);
+    // Replace the TX state and counters (once the firmware is set up)
+    void restoreState(const SimRadioSnapshot& snap);
+    
+    // Incremented on every state change, including coordinator injections
+    uint32_t stateVersion() const { return state_version_; }
+    
+    // Packets waiting for the firmware to receive them
+    bool hasQueuedRx() const { return !rx_queue_.empty(); }
+    
     // Check if there's a pending TX (for yield)
     bool hasPendingTx() const { return tx_pending_; }
     
@@ -77,16 +185,19 @@ private:
     // Check for polling spin and yield if necessary
     void checkForSpin();
     
+    // Release every queued packet (consumer side)
+    void drainRx();
+    
     // Configuration
     float freq_;
     float bw_;
     uint8_t sf_;
     uint8_t cr_;
     uint8_t tx_power_;
+    const SimAirtimeTable* airtime_;  // Shared table for bw_/sf_/cr_
     
-    // RX queue (packets injected by coordinator)
-    std::queue<RxPacket> rx_queue_;
-    std::mutex rx_mutex_;
+    // RX queue (packets injected by coordinator, consumed by firmware)
+    SimSpscRing<RxPacket> rx_queue_;
     
     // Last received packet stats
     float last_rssi_;
@@ -104,6 +215,8 @@ private:
     uint32_t packets_recv_errors_;
     uint32_t total_tx_airtime_;
     uint32_t total_rx_airtime_;
+    uint32_t rx_dropped_;             // Injected packets dropped on a full queue
+    uint32_t rx_high_water_;          // Most packets queued at once
     
     // State tracking for spin detection (per design doc)
     uint32_t state_version_;          // Incremented on any state change
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "sim_api.h"
+#include "sim_filesystem.h"
+#include "sim_state_hash.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+
+// ============================================================================
+// Boundary Recording
+// ============================================================================
+// With SimNodeConfig.record_path set, every sim_api.h call that can change
+// what the node's firmware sees is appended to a per-node log: its starting
+// files, step times, injected radio packets (with RSSI/SNR), serial bytes and
+// frames, TX completions, state changes, coordinator file writes and reboots.
+// Calls that take output (step results, serial collection) are logged as a
+// digest of what they returned. sim_replay() feeds such a log to a fresh node
+// without the coordinator or any other node and compares the digests.
+//
+// Log format: the header
+//
+//     "MCSIMREC" | u32 version | u32 sizeof(SimNodeConfig) | str node type |
+//     SimNodeConfig bytes (pointer fields zeroed)
+//
+// followed by records, each a SimRecordKind byte and its fields. Integers
+// are LEB128 varints; step times are zigzag deltas from the previous step;
+// "bytes" and "str" fields are a varint length and the raw bytes; floats and
+// digests are little-endian.
+
+#define SIM_RECORD_MAGIC "MCSIMREC"
+#define SIM_RECORD_VERSION 1
+
+enum SimRecordKind : uint8_t {
+    SIM_RECORD_END = 0,            // Log closed by sim_destroy()
+    SIM_RECORD_FILE,               // str path, bytes data (starting files)
+    SIM_RECORD_STEP,               // zigzag millis delta, zigzag rtc delta
+    SIM_RECORD_RESULT,             // reason, zigzag wake - millis, u64 digest
+    SIM_RECORD_RADIO_RX,           // f32 rssi, f32 snr, bytes packet
+    SIM_RECORD_SERIAL_RX,          // bytes data
+    SIM_RECORD_SERIAL_FRAME,       // bytes frame (queued frames only)
+    SIM_RECORD_COLLECT_SERIAL_TX,  // max_len, u64 digest
+    SIM_RECORD_COLLECT_FRAME,      // max_len, u64 digest
+    SIM_RECORD_COLLECT_FRAMES,     // buffer_len, max_frames, u64 digest
+    SIM_RECORD_TX_COMPLETE,        // -
+    SIM_RECORD_STATE_CHANGE,       // state_version
+    SIM_RECORD_FS_WRITE,           // str path, bytes data
+    SIM_RECORD_FS_REMOVE,          // str path
+    SIM_RECORD_REBOOT,             // SimNodeConfig bytes (pointer fields zeroed)
+    SIM_RECORD_RESTORE,            // Log stopped by sim_restore()
+};
+
+// FNV-1a over the outputs of a call; chain calls to cover several buffers
+uint64_t simRecordDigest(const void* data, size_t len, uint64_t hash = SIM_HASH_SEED);
+
+// Digest of a step result's outputs beyond its reason and wake time
+uint64_t simRecordResultDigest(const SimStepResult& result);
+
+// Appends records to one node's log. Calls for a node may come from any
+// coordinator thread, so each record is written under a lock.
+class SimRecorder {
+public:
+    // Open `path` and write the header; nullptr if it cannot be created
+    static SimRecorder* open(const char* path, const char* node_type,
+                             const SimNodeConfig& config);
+    ~SimRecorder();
+
+    SimRecorder(const SimRecorder&) = delete;
+    SimRecorder& operator=(const SimRecorder&) = delete;
+
+    void files(const SimFileMap& files);
+    void step(uint64_t sim_millis, uint32_t sim_rtc_secs);
+    void result(const SimStepResult& result);
+    void radioRx(const uint8_t* data, size_t len, float rssi, float snr);
+    void serialRx(const uint8_t* data, size_t len);
+    void serialFrame(const uint8_t* data, size_t len);
+    void collectSerialTx(size_t max_len, const uint8_t* data, size_t len);
+    void collectFrame(size_t max_len, const uint8_t* data, size_t len);
+    void collectFrames(size_t buffer_len, size_t max_frames, const uint8_t* data,
+                       const SimFrameSpan* frames, size_t count);
+    void txComplete();
+    void stateChange(uint32_t state_version);
+    void fsWrite(const char* path, const uint8_t* data, size_t len);
+    void fsRemove(const char* path);
+    void reboot(const SimNodeConfig& config);
+    void restore();
+
+private:
+    explicit SimRecorder(FILE* file);
+
+    std::mutex mutex_;
+    FILE* file_;
+    uint64_t last_millis_ = 0;
+    uint32_t last_rtc_ = 0;
+    uint64_t step_millis_ = 0;      // Time of the step awaiting its result
+
+    void putByte(uint8_t b) { fputc(b, file_); }
+    void putVarint(uint64_t value);
+    void putZigzag(int64_t value);
+    void putFixed(uint64_t value, size_t bytes);
+    void putBytes(const void* data, size_t len);
+    void putConfig(const SimNodeConfig& config);
+};
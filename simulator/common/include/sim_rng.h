@@ -7,32 +7,96 @@
 // Simulated RNG
 // ============================================================================
 // Implements mesh::RNG interface with deterministic seeding.
-// Uses a simple xorshift algorithm for reproducibility.
+//
+// Counter-based (SplitMix64 output function): word i of a stream is
+// mix(key + (i + 1) * GAMMA), where the key is derived from (seed, node,
+// stream). Every word is independent of the others, so random() fills a
+// buffer eight bytes per word, jump() is O(1), and the whole state is the
+// key and a counter. Nearby seeds, and different nodes or streams on the
+// same seed, give unrelated keys.
+
+// Streams of one node
+enum SimRngStream : uint32_t {
+    SIM_RNG_STREAM_CONTEXT = 0,     // SimContext::rng (radio_get_rng_seed())
+    SIM_RNG_STREAM_FIRMWARE = 1,    // The RNG handed to the firmware's mesh
+};
+
+// Node part of an RNG key: the first 8 bytes of its public key
+inline uint64_t simRngNodeId(const uint8_t* public_key) {
+    uint64_t id = 0;
+    for (int i = 0; i < 8; i++) {
+        id |= static_cast<uint64_t>(public_key[i]) << (8 * i);
+    }
+    return id;
+}
 
 class SimRNG : public mesh::RNG {
 public:
-    SimRNG() : state_(1) {}
-    
-    void seed(uint32_t seed) {
-        state_ = seed ? seed : 1;  // Ensure non-zero state
+    static constexpr uint64_t GAMMA = 0x9e3779b97f4a7c15ULL;
+
+    SimRNG() { seed(1); }
+
+    void seed(uint32_t seed, uint64_t node = 0, uint32_t stream = 0) {
+        uint64_t key = mix(seed + GAMMA);
+        key = mix((key ^ node) + GAMMA);
+        key_ = mix((key ^ stream) + GAMMA);
+        counter_ = 0;
     }
-    
+
     void random(uint8_t* dest, size_t sz) override {
-        for (size_t i = 0; i < sz; i++) {
-            dest[i] = static_cast<uint8_t>(next() & 0xFF);
+        // Words are independent, so the loop carries no dependency and the
+        // compiler can interleave (or vectorize) the mixes
+        size_t words = sz / 8;
+        uint64_t base = key_ + (counter_ + 1) * GAMMA;
+        for (size_t w = 0; w < words; w++) {
+            uint64_t x = mix(base + w * GAMMA);
+            for (int b = 0; b < 8; b++) {
+                dest[w * 8 + b] = static_cast<uint8_t>(x >> (8 * b));
+            }
+        }
+        counter_ += words;
+
+        // A partial word is consumed whole
+        size_t tail = sz % 8;
+        if (tail) {
+            uint64_t x = nextWord();
+            for (size_t b = 0; b < tail; b++) {
+                dest[words * 8 + b] = static_cast<uint8_t>(x >> (8 * b));
+            }
         }
     }
-    
+
     uint32_t next() {
-        // xorshift32
-        uint32_t x = state_;
-        x ^= x << 13;
-        x ^= x >> 17;
-        x ^= x << 5;
-        state_ = x;
-        return x;
+        return static_cast<uint32_t>(nextWord() >> 32);
+    }
+
+    uint64_t nextWord() {
+        counter_++;
+        return mix(key_ + counter_ * GAMMA);
     }
 
+    // Skip `words` outputs (each next(), nextWord() or started 8 bytes of
+    // random() is one)
+    void jump(uint64_t words) { counter_ += words; }
+
+    // Serializable state: the stream key and the position in it
+    uint64_t key() const { return key_; }
+    uint64_t position() const { return counter_; }
+    void setState(uint64_t key, uint64_t position) {
+        key_ = key;
+        counter_ = position;
+    }
+
+    // Current position in the stream (for state hashing)
+    uint64_t state() const { return key_ ^ counter_; }
+
 private:
-    uint32_t state_;
+    static uint64_t mix(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    uint64_t key_;
+    uint64_t counter_;
 };
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "sim_api.h"
+
+// ============================================================================
+// Shared Runtime
+// ============================================================================
+// Each firmware library links its own copy of the simulator common code, so
+// by default the repeater, companion and room server libraries each keep
+// their own crypto caches, airtime tables and fiber worker pool. The shared
+// runtime library (mcsim_runtime) holds one set of these services for the
+// whole process. The host loads it, takes its function table from
+// sim_runtime_get() and passes the table to every firmware library with
+// sim_attach_runtime(). From then on the library's crypto caches, airtime
+// tables and fiber slices go through the runtime, so nodes of every type and
+// firmware version share one cache and one scheduler.
+//
+// The table is a versioned C ABI. Functions are only ever appended: a minor
+// version adds entries at the end and bumps `size`, a major version changes
+// what existing entries mean. A library accepts a table with its own major
+// version and at least the entries it knows; otherwise it keeps its own
+// services. Packet buffers stay in each library, since their layout depends
+// on the firmware version.
+
+#define SIM_RUNTIME_ABI_MAJOR 1
+#define SIM_RUNTIME_ABI_MINOR 0
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef void (*SimRuntimeSliceFn)(void* arg);
+
+// One fiber slice: fn(arg) runs on a runtime worker thread
+typedef struct {
+    SimRuntimeSliceFn fn;
+    void* arg;
+} SimRuntimeSlice;
+
+struct SimRuntimeApi {
+    uint32_t abi_major;           // SIM_RUNTIME_ABI_MAJOR of the runtime
+    uint32_t abi_minor;
+    uint32_t size;                // sizeof(SimRuntimeApi) of the runtime
+
+    // Crypto caches (see sim_set_crypto_cache())
+    int (*crypto_verify)(const uint8_t* sig, const uint8_t* public_key,
+                         const uint8_t* message, size_t len);
+    void (*crypto_key_exchange)(uint8_t* shared_secret, const uint8_t* public_key,
+                                const uint8_t* private_key);
+    void (*set_crypto_cache)(SimCryptoCacheKind kind, uint32_t entries);
+    void (*get_crypto_cache_stats)(SimCryptoCacheKind kind, SimCryptoCacheStats* out);
+
+    // Airtime of payload lengths 0 .. SIM_AIRTIME_TABLE_LEN - 1 (ms). The
+    // table stays valid while the runtime is loaded.
+    const uint32_t* (*airtime_table)(float bw_khz, uint8_t sf, uint8_t cr);
+
+    // Fiber worker pool (see sim_set_fiber_workers())
+    void (*set_fiber_workers)(uint32_t count);
+    void (*post_slices)(const SimRuntimeSlice* slices, size_t count);
+};
+
+// Exported by the runtime library: its table, or NULL if it does not
+// implement abi_major. The table lives as long as the runtime is loaded.
+SIM_API const SimRuntimeApi* sim_runtime_get(uint32_t abi_major);
+
+#ifdef __cplusplus
+}
+
+// The runtime this library's shared services go through, or nullptr if it
+// uses its own (always nullptr inside the runtime library itself)
+const SimRuntimeApi* simRuntime();
+#endif
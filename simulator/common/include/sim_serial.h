@@ -1,7 +1,7 @@
 #pragma once
 
-#include <queue>
-#include <mutex>
+#include "sim_api.h"
+#include "sim_spsc.h"
 #include <cstdint>
 #include <cstddef>
 #include <cstring>
@@ -9,12 +9,60 @@
 // ============================================================================
 // Simulated Serial Interface
 // ============================================================================
-// Provides a buffer for serial RX (injected by coordinator) and TX (collected).
-// The actual TCP socket is managed by the Rust coordinator.
+// Provides a buffer for serial RX (injected by coordinator). Serial TX is
+// the step stream in SimContext (writeConsole()). The actual TCP socket is
+// managed by the Rust coordinator.
+//
+// RX is a fixed-capacity SPSC ring: the coordinator is the only producer, the
+// firmware the only consumer. Bytes that do not fit are dropped, like a UART
+// FIFO overrun.
+
+/// Bytes of injected serial input held until the firmware reads them
+static constexpr size_t SIM_SERIAL_RX_CAPACITY = 16384;
+
+/// Whole frames held in each direction of the frame-based interface
+static constexpr size_t SIM_SERIAL_FRAME_DEPTH = 64;
+
+// ============================================================================
+// Serial Frame Ring
+// ============================================================================
+// Whole frames over two SPSC rings: the payloads back to back, plus one length
+// per frame. A frame's bytes are pushed before its length, so the consumer
+// never sees a partial frame.
+
+class SimFrameRing {
+public:
+    SimFrameRing()
+        : lengths_(SIM_SERIAL_FRAME_DEPTH)
+        , bytes_(SIM_SERIAL_FRAME_DEPTH * SIM_MAX_SERIAL_FRAME) {}
+
+    // Producer: queue a frame. Returns false, queueing nothing, if the frame
+    // is empty, too long or does not fit.
+    bool push(const uint8_t* data, size_t len);
+
+    // Producer: true when no further frame can be queued
+    bool full() const { return lengths_.size() >= lengths_.capacity(); }
+
+    // Number of queued frames
+    size_t count() const { return lengths_.size(); }
+
+    // Consumer: length of the oldest frame, or 0 if none is queued
+    size_t frontSize() const;
+
+    // Consumer: pop the oldest frame into buffer and return its length.
+    // A frame longer than max_len is dropped. Returns 0 if none is queued.
+    size_t pop(uint8_t* buffer, size_t max_len);
+
+private:
+    SimSpscRing<uint16_t> lengths_;
+    SimSpscRing<uint8_t> bytes_;
+};
 
 class SimSerial {
 public:
-    SimSerial() : enabled_(false) {}
+    SimSerial()
+        : enabled_(false)
+        , rx_queue_(SIM_SERIAL_RX_CAPACITY) {}
 
     // Enable/disable
     void enable() { enabled_ = true; }
@@ -22,30 +70,33 @@ public:
     bool isEnabled() const { return enabled_; }
 
     // RX interface (coordinator injects data)
-    void injectRx(const uint8_t* data, size_t len);
+    // Returns the number of bytes accepted
+    size_t injectRx(const uint8_t* data, size_t len);
 
     // Check how many bytes are available to read
-    size_t available();
+    size_t available() const;
 
     // Read a single byte (returns -1 if none available)
     int read();
 
+    // Look at the next byte without consuming it (returns -1 if none available)
+    int peek() const;
+
     // Read multiple bytes
     size_t readBytes(uint8_t* buffer, size_t len);
 
-    // TX interface (firmware writes data)
-    void write(uint8_t byte);
-    void write(const uint8_t* data, size_t len);
-
-    // Collect TX data (coordinator retrieves and sends over TCP)
-    size_t collectTx(uint8_t* buffer, size_t max_len);
+    // Frame interface (frame-based serial, e.g. the companion protocol).
+    // The coordinator injects RX frames and collects TX frames.
+    SimFrameRing& rxFrames() { return rx_frames_; }
+    const SimFrameRing& rxFrames() const { return rx_frames_; }
+    SimFrameRing& txFrames() { return tx_frames_; }
+    const SimFrameRing& txFrames() const { return tx_frames_; }
 
 private:
     bool enabled_;
 
-    std::queue<uint8_t> rx_queue_;
-    std::mutex rx_mutex_;
+    SimSpscRing<uint8_t> rx_queue_;
 
-    std::vector<uint8_t> tx_buffer_;
-    std::mutex tx_mutex_;
+    SimFrameRing rx_frames_;
+    SimFrameRing tx_frames_;
 };
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "sim_api.h"
+#include "sim_context.h"
+#include "sim_radio.h"
+#include "sim_rng.h"
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+// ============================================================================
+// Node Snapshots
+// ============================================================================
+// State of a yielded node captured by sim_snapshot(), for sim_restore() and
+// sim_fork(). File contents and queued RX packets are held by reference, so
+// taking a snapshot copies little, and a node restored from one copies a file
+// only when its firmware changes it.
+//
+// The firmware's own objects (MyMesh, DataStore, ...) hold references into
+// the node that owns them, so they are not copied. Restoring rebuilds them
+// by running setup() over the restored filesystem, the way the firmware comes
+// back from a power cycle, and then puts back the state each node type
+// exposes through SimFirmwareState (mesh tables, RNG, CLI buffer).
+
+// Firmware-specific part of a snapshot, defined by each node type
+struct SimFirmwareState {
+    virtual ~SimFirmwareState() = default;
+};
+
+struct SimSnapshot {
+    std::string node_type;          // getNodeType() of the captured node
+    SimNodeConfig config;           // fs_image cleared
+
+    // Simulator state
+    SimFileMap files;
+    SimRadioSnapshot radio;
+    uint32_t node_rtc_time = 0;
+    uint64_t current_millis = 0;
+    uint32_t current_rtc_secs = 0;
+    SimRNG rng;
+    WakeStats wake_stats;
+    StepStats step_stats;
+    SimOpStats op_stats;
+    uint32_t spin_detection_count = 0;
+    uint64_t total_loop_iterations = 0;
+    uint64_t skipped_steps = 0;
+    uint64_t state_hash = 0;
+
+    // Firmware state (nullptr if the node type keeps none)
+    std::unique_ptr<SimFirmwareState> firmware;
+
+    // The creator holds the first reference; nodes forked from the snapshot
+    // hold one until their first boot has applied it
+    void retain() { refs_.fetch_add(1, std::memory_order_relaxed); }
+    void release() {
+        if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            delete this;
+        }
+    }
+
+private:
+    std::atomic<uint32_t> refs_{1};
+};
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <atomic>
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+
+// ============================================================================
+// Single-Producer / Single-Consumer Ring
+// ============================================================================
+// Fixed-capacity lock-free queue used for coordinator -> firmware input
+// (radio packets, serial bytes) and firmware -> coordinator output. Exactly
+// one thread may push and one thread may pop at a time; in the simulator the
+// coordinator is the producer of injected input and the node's thread (or
+// fiber worker) is the consumer.
+//
+// head_ and tail_ are free-running counters; a slot is counter % capacity.
+// Each side owns one counter and publishes it with release ordering, so the
+// slot contents written before a push are visible to the matching pop.
+
+template <typename T>
+class SimSpscRing {
+public:
+    SimSpscRing() = default;
+    explicit SimSpscRing(size_t capacity) { reset(capacity); }
+
+    SimSpscRing(const SimSpscRing&) = delete;
+    SimSpscRing& operator=(const SimSpscRing&) = delete;
+
+    // Reallocate with a new capacity and drop any queued items.
+    // Not thread-safe: neither side may be using the ring.
+    void reset(size_t capacity) {
+        slots_.reset(capacity ? new T[capacity] : nullptr);
+        capacity_ = capacity;
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+    }
+
+    // Drop any queued items, keeping the storage. Same rules as reset().
+    void clear() {
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+    }
+
+    size_t capacity() const { return capacity_; }
+
+    // Number of queued items. Exact when called from either side; a snapshot
+    // from anywhere else.
+    size_t size() const {
+        return head_.load(std::memory_order_acquire) - tail_.load(std::memory_order_acquire);
+    }
+
+    bool empty() const { return size() == 0; }
+
+    // ------------------------------------------------------------------------
+    // Producer side
+    // ------------------------------------------------------------------------
+
+    // Slot to fill in place, or nullptr if the ring is full. The item becomes
+    // visible to the consumer on commitPush().
+    T* beginPush() {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head - tail_.load(std::memory_order_acquire) >= capacity_) {
+            return nullptr;
+        }
+        return &slots_[head % capacity_];
+    }
+
+    void commitPush() {
+        head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Push up to count items; returns how many fitted.
+    size_t push(const T* items, size_t count) {
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t space = capacity_ - (head - tail_.load(std::memory_order_acquire));
+        size_t n = (std::min)(count, space);
+        if (n == 0) return 0;
+
+        size_t start = head % capacity_;
+        size_t first = (std::min)(n, capacity_ - start);
+        std::copy(items, items + first, &slots_[start]);
+        std::copy(items + first, items + n, &slots_[0]);
+
+        head_.store(head + n, std::memory_order_release);
+        return n;
+    }
+
+    // ------------------------------------------------------------------------
+    // Consumer side
+    // ------------------------------------------------------------------------
+
+    // Oldest item, or nullptr if the ring is empty. It stays in the ring
+    // until popFront().
+    const T* front() const {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (head_.load(std::memory_order_acquire) == tail) {
+            return nullptr;
+        }
+        return &slots_[tail % capacity_];
+    }
+
+    void popFront() {
+        tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Pop up to count items into out; returns how many were taken.
+    size_t pop(T* out, size_t count) {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        size_t avail = head_.load(std::memory_order_acquire) - tail;
+        size_t n = (std::min)(count, avail);
+        if (n == 0) return 0;
+
+        size_t start = tail % capacity_;
+        size_t first = (std::min)(n, capacity_ - start);
+        std::copy(&slots_[start], &slots_[start] + first, out);
+        std::copy(&slots_[0], &slots_[0] + (n - first), out + first);
+
+        tail_.store(tail + n, std::memory_order_release);
+        return n;
+    }
+
+private:
+    std::unique_ptr<T[]> slots_;
+    size_t capacity_ = 0;
+
+    // Kept on separate cache lines so the two sides don't false-share
+    alignas(64) std::atomic<size_t> head_{0};   // Next slot to write (producer)
+    alignas(64) std::atomic<size_t> tail_{0};   // Next slot to read (consumer)
+};
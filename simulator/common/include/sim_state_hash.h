@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// ============================================================================
+// State Hashing
+// ============================================================================
+// Rolling 64-bit hashes of what a node has done (SimStepResult.state_hash)
+// and of what was written to its files. They are not cryptographic; they
+// only need to tell two runs of the same node apart at a few nanoseconds per
+// step.
+
+#define SIM_HASH_SEED 14695981039346656037ull
+
+// FNV-1a over a buffer
+inline uint64_t simHashBytes(uint64_t hash, const void* data, size_t len) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < len; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Fold one word in with a single multiply
+inline uint64_t simHashWord(uint64_t hash, uint64_t value) {
+    hash ^= value;
+    hash *= 0x9E3779B97F4A7C15ull;
+    return hash ^ (hash >> 29);
+}
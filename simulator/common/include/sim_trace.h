@@ -0,0 +1,72 @@
+#pragma once
+
+#include "sim_api.h"
+
+#include <atomic>
+#include <cstdint>
+
+// ============================================================================
+// Tracepoints
+// ============================================================================
+// SIM_TRACE_SCOPE() times the rest of the enclosing block and
+// SIM_TRACE_INSTANT() marks a point, both tagged with the node and sim time
+// of the current thread's binding. Events go to a ring owned by the
+// recording thread, so recording takes no lock; sim_trace_drain() empties
+// the rings from the coordinator (see sim_api.h).
+//
+// While a category is disabled a tracepoint costs one relaxed load and a
+// branch, so tracepoints stay compiled into release libraries. Building with
+// -DSIM_TRACEPOINTS=0 removes them altogether.
+
+#ifndef SIM_TRACEPOINTS
+#define SIM_TRACEPOINTS 1
+#endif
+
+// Enabled SimTraceCategory bits (sim_trace_enable())
+extern std::atomic<uint32_t> g_sim_trace_categories;
+
+inline bool simTraceEnabled(uint32_t category) {
+    return (g_sim_trace_categories.load(std::memory_order_relaxed) & category) != 0;
+}
+
+// Host steady clock in nanoseconds
+uint64_t simTraceNow();
+
+// Append an event to the calling thread's ring (dropped when full)
+void simTraceRecord(uint32_t category, const char* name, uint64_t start_ns, uint64_t duration_ns);
+
+class SimTraceScope {
+public:
+    SimTraceScope(uint32_t category, const char* name)
+        : category_(category)
+        , name_(name)
+        , start_ns_(simTraceEnabled(category) ? simTraceNow() : 0) {}
+
+    ~SimTraceScope() {
+        if (start_ns_) {
+            simTraceRecord(category_, name_, start_ns_, simTraceNow() - start_ns_);
+        }
+    }
+
+    SimTraceScope(const SimTraceScope&) = delete;
+    SimTraceScope& operator=(const SimTraceScope&) = delete;
+
+private:
+    uint32_t category_;
+    const char* name_;
+    uint64_t start_ns_;       // 0 = not recording
+};
+
+#if SIM_TRACEPOINTS
+#define SIM_TRACE_JOIN2(a, b) a##b
+#define SIM_TRACE_JOIN(a, b) SIM_TRACE_JOIN2(a, b)
+#define SIM_TRACE_SCOPE(category, name) \
+    SimTraceScope SIM_TRACE_JOIN(sim_trace_scope_, __LINE__)(category, name)
+#define SIM_TRACE_INSTANT(category, name) \
+    do { \
+        if (simTraceEnabled(category)) simTraceRecord(category, name, simTraceNow(), 0); \
+    } while (0)
+#else
+#define SIM_TRACE_SCOPE(category, name) ((void)0)
+#define SIM_TRACE_INSTANT(category, name) ((void)0)
+#endif
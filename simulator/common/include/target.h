@@ -4,7 +4,7 @@
 // Simulator Target Header
 // ============================================================================
 // This replaces the hardware-specific target.h for simulation.
-// Each node DLL has its own set of globals defined in sim_main.cpp
+// Each node owns its own board/radio/RTC/sensor objects (see SimNodeImpl)
 //
 // NOTE: The global symbols (board, radio_driver, etc.) are redirected via
 // macros in sim_prefix.h which is force-included before all source files.
@@ -17,6 +17,7 @@
 #include "sim_rng.h"
 #include "sim_context.h"
 #include "SPIFFS.h"
+#include "sim_bindings.h"
 
 // Sensor manager stub - inherits from base SensorManager
 #include "helpers/SensorManager.h"
@@ -30,11 +31,12 @@ public:
 
 // Global extern declarations using internal names
 // The macros in sim_prefix.h redirect board -> _sim_board_instance, etc.
-// These are defined in each node's sim_main.cpp as thread_local
-extern thread_local SimBoard _sim_board_instance;
-extern thread_local SimRadio _sim_radio_instance;
-extern thread_local SimRTCClock _sim_rtc_instance;
-extern thread_local EnvironmentSensorManager _sim_sensors_instance;
+// These are forwarding bindings defined in sim_bindings.cpp; the real
+// objects are owned by each node's SimNodeImpl.
+extern thread_local SimBoardBinding _sim_board_instance;
+extern thread_local SimRadioBinding _sim_radio_instance;
+extern thread_local SimRTCBinding _sim_rtc_instance;
+extern thread_local SimSensorsBinding _sim_sensors_instance;
 
 // Radio helper functions (stubs)
 // Note: these use the macro names which get redirected to internal names
@@ -1,11 +1,18 @@
 #include "sim_context.h"
 #include "Arduino.h"
+#include "sim_heap.h"
+#include "sim_trace.h"
 #include <cstdio>
 #include <cstdarg>
+#include <utility>
 
 // Thread-local context pointer
 thread_local SimContext* g_sim_ctx = nullptr;
 
+SimOpStats* simOpStats() {
+    return g_sim_ctx ? &g_sim_ctx->op_stats : nullptr;
+}
+
 // Global instances for Serial, SPI, Wire
 SimSerialClass Serial;
 SimSerialClass Serial1;
@@ -63,27 +70,34 @@ int SimSerialClass::read() {
 }
 
 int SimSerialClass::peek() {
-    // Not implemented - would need queue modification
+    if (g_sim_ctx) {
+        return g_sim_ctx->serial.peek();
+    }
     return -1;
 }
 
+bool SimSerialClass::discardsOutput() const {
+    if (g_sim_ctx && g_sim_ctx->discardsConsole()) {
+        // The skipped print still counts as output for idle detection
+        g_sim_ctx->console_writes++;
+        return true;
+    }
+    return false;
+}
+
 size_t SimSerialClass::write(uint8_t c) {
     if (g_sim_ctx) {
-        // Log to the log buffer (for console display)
-        char str[2] = {static_cast<char>(c), '\0'};
-        g_sim_ctx->appendLog(str, 1);
-        // Also send to serial TX buffer (for TCP transmission)
-        g_sim_ctx->appendSerialTx(&c, 1);
+        // Serial TX stream (for TCP transmission) plus log tee
+        g_sim_ctx->writeConsole(&c, 1);
         return 1;
     }
     return 0;
 }
 
 size_t SimSerialClass::write(const uint8_t* buffer, size_t size) {
+    SIM_TRACE_SCOPE(SIM_TRACE_SERIAL, "serial.write");
     if (g_sim_ctx && size > 0) {
-        g_sim_ctx->appendLog(reinterpret_cast<const char*>(buffer), size);
-        // Also send to serial TX buffer (for TCP transmission)
-        g_sim_ctx->appendSerialTx(buffer, size);
+        g_sim_ctx->writeConsole(buffer, size);
         return size;
     }
     return 0;
@@ -113,30 +127,35 @@ size_t Print::print(char c) {
 }
 
 size_t Print::print(int n, int base) {
+    if (discardsOutput()) return 0;
     char buf[34];
     snprintf(buf, sizeof(buf), base == 16 ? "%x" : "%d", n);
     return print(buf);
 }
 
 size_t Print::print(unsigned int n, int base) {
+    if (discardsOutput()) return 0;
     char buf[34];
     snprintf(buf, sizeof(buf), base == 16 ? "%x" : "%u", n);
     return print(buf);
 }
 
 size_t Print::print(long n, int base) {
+    if (discardsOutput()) return 0;
     char buf[34];
     snprintf(buf, sizeof(buf), base == 16 ? "%lx" : "%ld", n);
     return print(buf);
 }
 
 size_t Print::print(unsigned long n, int base) {
+    if (discardsOutput()) return 0;
     char buf[34];
     snprintf(buf, sizeof(buf), base == 16 ? "%lx" : "%lu", n);
     return print(buf);
 }
 
 size_t Print::print(double n, int digits) {
+    if (discardsOutput()) return 0;
     char buf[64];
     snprintf(buf, sizeof(buf), "%.*f", digits, n);
     return print(buf);
@@ -183,6 +202,9 @@ size_t Print::println(const String& str) {
 }
 
 size_t Print::printf(const char* format, ...) {
+    if (discardsOutput()) return 0;
+    SIM_TRACE_SCOPE(SIM_TRACE_SERIAL, "serial.printf");
+    
     char buf[512];
     va_list args;
     va_start(args, format);
@@ -209,22 +231,37 @@ size_t Stream::readBytes(uint8_t* buffer, size_t length) {
     return count;
 }
 
+// Appended a chunk at a time rather than a character at a time
 String Stream::readString() {
     String result;
+    char chunk[64];
+    unsigned int n = 0;
     int c;
     while ((c = read()) >= 0) {
-        result += static_cast<char>(c);
+        chunk[n++] = static_cast<char>(c);
+        if (n == sizeof(chunk)) {
+            result.concat(chunk, n);
+            n = 0;
+        }
     }
+    result.concat(chunk, n);
     return result;
 }
 
 String Stream::readStringUntil(char terminator) {
     String result;
+    char chunk[64];
+    unsigned int n = 0;
     int c;
     while ((c = read()) >= 0) {
         if (c == terminator) break;
-        result += static_cast<char>(c);
+        chunk[n++] = static_cast<char>(c);
+        if (n == sizeof(chunk)) {
+            result.concat(chunk, n);
+            n = 0;
+        }
     }
+    result.concat(chunk, n);
     return result;
 }
 
@@ -258,93 +295,74 @@ size_t HardwareSerial::write(const uint8_t* buffer, size_t size) {
     return Serial.write(buffer, size);
 }
 
+bool HardwareSerial::discardsOutput() const {
+    return Serial.discardsOutput();
+}
+
 void HardwareSerial::flush() {}
 
 // ============================================================================
 // String Implementation
 // ============================================================================
 
-String::String(const char* str) : buffer_(nullptr), len_(0), capacity_(0) {
+String::String(const char* str) : String() {
     if (str) {
-        len_ = strlen(str);
-        ensureCapacity(len_ + 1);
-        memcpy(buffer_, str, len_ + 1);
+        assign(str, strlen(str));
     }
 }
 
-String::String(const String& other) : buffer_(nullptr), len_(0), capacity_(0) {
-    if (other.len_ > 0) {
-        len_ = other.len_;
-        ensureCapacity(len_ + 1);
-        memcpy(buffer_, other.buffer_, len_ + 1);
-    }
+String::String(const String& other) : String() {
+    assign(other.buffer_, other.len_);
 }
 
-String::String(String&& other) noexcept 
-    : buffer_(other.buffer_), len_(other.len_), capacity_(other.capacity_) {
-    other.buffer_ = nullptr;
-    other.len_ = 0;
-    other.capacity_ = 0;
+String::String(String&& other) noexcept : String() {
+    *this = std::move(other);
 }
 
 String::~String() {
-    delete[] buffer_;
+    release();
 }
 
 String& String::operator=(const String& other) {
     if (this != &other) {
-        if (other.len_ > 0) {
-            ensureCapacity(other.len_ + 1);
-            memcpy(buffer_, other.buffer_, other.len_ + 1);
-            len_ = other.len_;
-        } else {
-            len_ = 0;
-            if (buffer_) buffer_[0] = '\0';
-        }
+        assign(other.buffer_, other.len_);
     }
     return *this;
 }
 
 String& String::operator=(String&& other) noexcept {
-    if (this != &other) {
-        delete[] buffer_;
+    if (this == &other) {
+        return *this;
+    }
+    if (other.isInline()) {
+        // Nothing to steal; keep our block, if any, for reuse
+        assign(other.buffer_, other.len_);
+    } else {
+        release();
         buffer_ = other.buffer_;
         len_ = other.len_;
         capacity_ = other.capacity_;
-        other.buffer_ = nullptr;
-        other.len_ = 0;
-        other.capacity_ = 0;
+        other.buffer_ = other.inline_;
+        other.capacity_ = SIM_STRING_INLINE;
     }
+    other.len_ = 0;
+    other.buffer_[0] = '\0';
     return *this;
 }
 
 String& String::operator=(const char* str) {
-    if (str) {
-        len_ = strlen(str);
-        ensureCapacity(len_ + 1);
-        memcpy(buffer_, str, len_ + 1);
-    } else {
-        len_ = 0;
-        if (buffer_) buffer_[0] = '\0';
-    }
+    assign(str ? str : "", str ? strlen(str) : 0);
     return *this;
 }
 
 String& String::operator+=(const String& other) {
-    if (other.len_ > 0) {
-        ensureCapacity(len_ + other.len_ + 1);
-        memcpy(buffer_ + len_, other.buffer_, other.len_ + 1);
-        len_ += other.len_;
-    }
+    concat(other.buffer_, other.len_);
     return *this;
 }
 
 String& String::operator+=(const char* str) {
     if (str) {
-        size_t slen = strlen(str);
-        ensureCapacity(len_ + slen + 1);
-        memcpy(buffer_ + len_, str, slen + 1);
-        len_ += slen;
+        concat(str, strlen(str));
     }
     return *this;
 }
@@ -356,15 +374,30 @@ String& String::operator+=(char c) {
     return *this;
 }
 
+bool String::concat(const char* str, unsigned int len) {
+    if (len > 0) {
+        // str may point into our own buffer, so copy before it moves
+        if (str >= buffer_ && str < buffer_ + len_) {
+            unsigned int offset = static_cast<unsigned int>(str - buffer_);
+            ensureCapacity(len_ + len + 1);
+            str = buffer_ + offset;
+        } else {
+            ensureCapacity(len_ + len + 1);
+        }
+        memmove(buffer_ + len_, str, len);
+        len_ += len;
+        buffer_[len_] = '\0';
+    }
+    return true;
+}
+
 bool String::operator==(const String& other) const {
-    if (len_ != other.len_) return false;
-    if (len_ == 0) return true;
-    return memcmp(buffer_, other.buffer_, len_) == 0;
+    return len_ == other.len_ && memcmp(buffer_, other.buffer_, len_) == 0;
 }
 
 bool String::operator==(const char* str) const {
     if (!str) return len_ == 0;
-    return strcmp(c_str(), str) == 0;
+    return strcmp(buffer_, str) == 0;
 }
 
 char String::operator[](unsigned int index) const {
@@ -383,7 +416,6 @@ void String::reserve(unsigned int size) {
 }
 
 int String::indexOf(char c) const {
-    if (!buffer_) return -1;
     for (unsigned int i = 0; i < len_; i++) {
         if (buffer_[i] == c) return i;
     }
@@ -391,7 +423,7 @@ int String::indexOf(char c) const {
 }
 
 int String::indexOf(const char* str) const {
-    if (!buffer_ || !str) return -1;
+    if (!str) return -1;
     const char* found = strstr(buffer_, str);
     return found ? static_cast<int>(found - buffer_) : -1;
 }
@@ -402,15 +434,12 @@ String String::substring(unsigned int from, unsigned int to) const {
     if (from >= to) return String();
     
     String result;
-    result.len_ = to - from;
-    result.ensureCapacity(result.len_ + 1);
-    memcpy(result.buffer_, buffer_ + from, result.len_);
-    result.buffer_[result.len_] = '\0';
+    result.assign(buffer_ + from, to - from);
     return result;
 }
 
 void String::trim() {
-    if (!buffer_ || len_ == 0) return;
+    if (len_ == 0) return;
     
     unsigned int start = 0;
     while (start < len_ && isspace(buffer_[start])) start++;
@@ -426,58 +455,90 @@ void String::trim() {
 }
 
 void String::toLowerCase() {
-    if (!buffer_) return;
     for (unsigned int i = 0; i < len_; i++) {
         buffer_[i] = tolower(buffer_[i]);
     }
 }
 
 void String::toUpperCase() {
-    if (!buffer_) return;
     for (unsigned int i = 0; i < len_; i++) {
         buffer_[i] = toupper(buffer_[i]);
     }
 }
 
 long String::toInt() const {
-    return buffer_ ? atol(buffer_) : 0;
+    return atol(buffer_);
 }
 
 float String::toFloat() const {
-    return buffer_ ? static_cast<float>(atof(buffer_)) : 0.0f;
+    return static_cast<float>(atof(buffer_));
 }
 
 void String::ensureCapacity(unsigned int cap) {
     if (cap <= capacity_) return;
     
-    unsigned int newCap = capacity_ ? capacity_ * 2 : 16;
+    unsigned int newCap = capacity_ * 2;
     while (newCap < cap) newCap *= 2;
     
-    char* newBuf = new char[newCap];
-    if (buffer_) {
-        memcpy(newBuf, buffer_, len_ + 1);
-        delete[] buffer_;
-    } else {
-        newBuf[0] = '\0';
-    }
+    // From the node heap when one is bound
+    char* newBuf = static_cast<char*>(simAlloc(newCap));
+    memcpy(newBuf, buffer_, len_ + 1);
+    release();
     buffer_ = newBuf;
     capacity_ = newCap;
+    
+    SIM_COUNT_OP(string_heap_allocs, 1);
+    SIM_COUNT_OP(string_heap_bytes, newCap);
+}
+
+void String::assign(const char* str, unsigned int len) {
+    ensureCapacity(len + 1);
+    memmove(buffer_, str, len);
+    len_ = len;
+    buffer_[len_] = '\0';
+}
+
+void String::release() {
+    if (!isInline()) {
+        simFree(buffer_);
+        buffer_ = inline_;
+        capacity_ = SIM_STRING_INLINE;
+    }
 }
 
+// Sized up front so the result allocates at most once
 String operator+(const String& lhs, const String& rhs) {
-    String result = lhs;
-    result += rhs;
+    String result;
+    result.reserve(lhs.length() + rhs.length() + 1);
+    result.concat(lhs.c_str(), lhs.length());
+    result.concat(rhs.c_str(), rhs.length());
     return result;
 }
 
 String operator+(const String& lhs, const char* rhs) {
-    String result = lhs;
-    result += rhs;
+    unsigned int rlen = rhs ? strlen(rhs) : 0;
+    String result;
+    result.reserve(lhs.length() + rlen + 1);
+    result.concat(lhs.c_str(), lhs.length());
+    result.concat(rhs, rlen);
     return result;
 }
 
 String operator+(const char* lhs, const String& rhs) {
-    String result(lhs);
-    result += rhs;
+    unsigned int llen = lhs ? strlen(lhs) : 0;
+    String result;
+    result.reserve(llen + rhs.length() + 1);
+    result.concat(lhs, llen);
+    result.concat(rhs.c_str(), rhs.length());
     return result;
 }
+
+String operator+(String&& lhs, const String& rhs) {
+    lhs += rhs;
+    return std::move(lhs);
+}
+
+String operator+(String&& lhs, const char* rhs) {
+    lhs += rhs;
+    return std::move(lhs);
+}
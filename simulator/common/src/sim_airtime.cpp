@@ -0,0 +1,46 @@
+#include "sim_airtime.h"
+#include "sim_runtime.h"
+
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <tuple>
+
+// ============================================================================
+// Shared Airtime Tables
+// ============================================================================
+
+// MeshCore's common presets and the shim's default (SimNodeConfig defaults)
+static const SimAirtimeTable* presetTable(float bw_khz, uint8_t sf, uint8_t cr) {
+    if (bw_khz == 62.5f && sf == 7 && cr == 5) return &SimAirtimePreset<62500, 7, 5>::table;
+    if (bw_khz == 62.5f && sf == 8 && cr == 8) return &SimAirtimePreset<62500, 8, 8>::table;
+    if (bw_khz == 125.0f && sf == 9 && cr == 5) return &SimAirtimePreset<125000, 9, 5>::table;
+    if (bw_khz == 250.0f && sf == 10 && cr == 5) return &SimAirtimePreset<250000, 10, 5>::table;
+    if (bw_khz == 250.0f && sf == 11 && cr == 5) return &SimAirtimePreset<250000, 11, 5>::table;
+    return nullptr;
+}
+
+const SimAirtimeTable* simAirtimeTable(float bw_khz, uint8_t sf, uint8_t cr) {
+    if (const SimAirtimeTable* preset = presetTable(bw_khz, sf, cr)) {
+        return preset;
+    }
+    if (const SimRuntimeApi* runtime = simRuntime()) {
+        // Same layout: SimAirtimeTable is just the array
+        return reinterpret_cast<const SimAirtimeTable*>(runtime->airtime_table(bw_khz, sf, cr));
+    }
+
+    // Keyed by the bandwidth's bits so every float maps to its own table
+    uint32_t bw_bits;
+    memcpy(&bw_bits, &bw_khz, sizeof(bw_bits));
+    auto key = std::make_tuple(bw_bits, sf, cr);
+
+    static std::mutex mutex;
+    static std::map<std::tuple<uint32_t, uint8_t, uint8_t>, std::unique_ptr<SimAirtimeTable>> tables;
+    std::lock_guard<std::mutex> lock(mutex);
+    std::unique_ptr<SimAirtimeTable>& table = tables[key];
+    if (!table) {
+        table.reset(new SimAirtimeTable(simBuildAirtimeTable(bw_khz, sf, cr)));
+    }
+    return table.get();
+}
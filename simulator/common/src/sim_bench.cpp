@@ -0,0 +1,165 @@
+#include "sim_node_base.h"
+#include "sim_api.h"
+#include "sim_bindings.h"
+#include "AES.h"
+#include "Ed25519.h"
+#include "SHA256.h"
+
+#include <chrono>
+#include <cstring>
+
+// ============================================================================
+// Benchmark Kernels
+// ============================================================================
+
+static const char kScratchPath[] = "/sim_bench/scratch";
+static const size_t kPayloadSize = 256;
+
+// Results are folded in here so the kernels cannot be optimized away
+static volatile uint32_t s_bench_sink = 0;
+
+static void benchFsWrite(SimFilesystem& fs, const uint8_t* payload, uint64_t iterations) {
+    for (uint64_t i = 0; i < iterations; i++) {
+        SimFile* file = fs.openWrite(kScratchPath);
+        s_bench_sink = s_bench_sink + static_cast<uint32_t>(file->write(payload, kPayloadSize));
+        fs.close(file);
+    }
+}
+
+static void benchFsRead(SimFilesystem& fs, const uint8_t* payload, uint64_t iterations) {
+    fs.writeFile(kScratchPath, payload, kPayloadSize);
+    uint8_t buffer[kPayloadSize];
+    for (uint64_t i = 0; i < iterations; i++) {
+        SimFile* file = fs.openRead(kScratchPath);
+        s_bench_sink = s_bench_sink + static_cast<uint32_t>(file->read(buffer, sizeof(buffer)));
+        fs.close(file);
+    }
+}
+
+static void benchAirtime(SimRadio& radio, uint64_t iterations) {
+    uint32_t total = 0;
+    for (uint64_t i = 0; i < iterations; i++) {
+        total += radio.getEstAirtimeFor(static_cast<int>(i % 255) + 1);
+    }
+    s_bench_sink = s_bench_sink + total;
+}
+
+static void benchEd25519(bool verify, const uint8_t* payload, uint64_t iterations) {
+    uint8_t seed[32];
+    memcpy(seed, payload, sizeof(seed));
+    uint8_t private_key[64];
+    uint8_t public_key[32];
+    Ed25519::generatePrivateKey(private_key, seed);
+    Ed25519::derivePublicKey(public_key, private_key);
+
+    uint8_t sig[64];
+    Ed25519::sign(sig, private_key, public_key, payload, 64);
+    for (uint64_t i = 0; i < iterations; i++) {
+        if (verify) {
+            s_bench_sink = s_bench_sink + (Ed25519::verify(sig, public_key, payload, 64) ? 1 : 0);
+        } else {
+            Ed25519::sign(sig, private_key, public_key, payload, 64);
+            s_bench_sink = s_bench_sink + sig[0];
+        }
+    }
+}
+
+static void benchKeyExchange(const uint8_t* payload, uint64_t iterations) {
+    uint8_t private_key[64];
+    uint8_t public_key[32];
+    uint8_t peer_private[64];
+    uint8_t peer_public[32];
+    Ed25519::generatePrivateKey(private_key, payload);
+    Ed25519::derivePublicKey(public_key, private_key);
+    Ed25519::generatePrivateKey(peer_private, payload + 32);
+    Ed25519::derivePublicKey(peer_public, peer_private);
+
+    uint8_t secret[32];
+    for (uint64_t i = 0; i < iterations; i++) {
+        ed25519_key_exchange(secret, peer_public, private_key);
+        s_bench_sink = s_bench_sink + secret[0];
+    }
+}
+
+static void benchAes(const uint8_t* payload, uint64_t iterations) {
+    AES128 aes;
+    aes.setKey(payload, AES128::KEY_SIZE);
+    uint8_t blocks[kPayloadSize];
+    memcpy(blocks, payload, sizeof(blocks));
+    for (uint64_t i = 0; i < iterations; i++) {
+        aes.encryptBlocks(blocks, blocks, kPayloadSize / 16);
+    }
+    s_bench_sink = s_bench_sink + blocks[0];
+}
+
+static void benchSha256(bool hmac, const uint8_t* payload, uint64_t iterations) {
+    uint8_t hash[SHA256::HASH_SIZE];
+    for (uint64_t i = 0; i < iterations; i++) {
+        SHA256 sha;
+        if (hmac) {
+            sha.resetHMAC(payload, 32);
+            sha.update(payload, kPayloadSize);
+            sha.finalizeHMAC(payload, 32, hash, sizeof(hash));
+        } else {
+            sha.update(payload, kPayloadSize);
+            sha.finalize(hash, sizeof(hash));
+        }
+        s_bench_sink = s_bench_sink + hash[0];
+    }
+}
+
+SIM_API uint64_t sim_bench_kernel(SimNodeHandle node, uint32_t kernel, uint64_t iterations) {
+    if (!node || kernel >= SIM_BENCH_KERNEL_COUNT) return 0;
+
+    uint8_t payload[kPayloadSize];
+    for (size_t i = 0; i < sizeof(payload); i++) {
+        payload[i] = static_cast<uint8_t>(i * 31 + 7);
+    }
+
+    // Run as the node, but leave its operation counters as they were
+    SimNodeBindings previous = simBindNode(node->bindings());
+    SimOpStats saved_ops = node->ctx.op_stats;
+    SimFilesystem& fs = node->ctx.filesystem;
+
+    auto start = std::chrono::steady_clock::now();
+    switch (kernel) {
+    case SIM_BENCH_FS_WRITE:
+        benchFsWrite(fs, payload, iterations);
+        break;
+    case SIM_BENCH_FS_READ:
+        benchFsRead(fs, payload, iterations);
+        break;
+    case SIM_BENCH_AIRTIME:
+        benchAirtime(node->node_radio, iterations);
+        break;
+    case SIM_BENCH_ED25519_SIGN:
+        benchEd25519(false, payload, iterations);
+        break;
+    case SIM_BENCH_ED25519_VERIFY:
+        benchEd25519(true, payload, iterations);
+        break;
+    case SIM_BENCH_KEY_EXCHANGE:
+        benchKeyExchange(payload, iterations);
+        break;
+    case SIM_BENCH_AES128:
+        benchAes(payload, iterations);
+        break;
+    case SIM_BENCH_SHA256:
+        benchSha256(false, payload, iterations);
+        break;
+    case SIM_BENCH_HMAC_SHA256:
+        benchSha256(true, payload, iterations);
+        break;
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    if (kernel == SIM_BENCH_FS_WRITE || kernel == SIM_BENCH_FS_READ) {
+        fs.remove(kScratchPath);
+        node->idle_inputs_valid = false;
+    }
+    node->ctx.op_stats = saved_ops;
+    simBindNode(previous);
+
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
@@ -0,0 +1,107 @@
+#include "sim_bindings.h"
+#include "sim_context.h"
+#include "sim_heap.h"
+#include "target.h"
+
+// Firmware-visible globals (sim_prefix.h redirects board -> _sim_board_instance, etc.)
+// These are thread_local so that the sensors location fields behave like
+// per-node state; the forwarders themselves carry no state.
+thread_local SimBoardBinding _sim_board_instance;
+thread_local SimRadioBinding _sim_radio_instance;
+thread_local SimRTCBinding _sim_rtc_instance;
+thread_local SimSensorsBinding _sim_sensors_instance;
+
+// Node currently bound to this thread
+static thread_local SimNodeBindings t_bindings;
+
+static void copyLocation(SensorManager& to, const SensorManager& from) {
+    to.node_lat = from.node_lat;
+    to.node_lon = from.node_lon;
+    to.node_altitude = from.node_altitude;
+}
+
+SimNodeBindings simBindNode(const SimNodeBindings& bindings) {
+    SimNodeBindings previous = t_bindings;
+    previous.ctx = g_sim_ctx;
+    previous.heap = g_sim_heap;
+
+    if (previous.sensors) {
+        copyLocation(*previous.sensors, _sim_sensors_instance);
+    }
+
+    t_bindings = bindings;
+    g_sim_ctx = bindings.ctx;
+    g_sim_heap = bindings.heap;
+
+    if (bindings.sensors) {
+        copyLocation(_sim_sensors_instance, *bindings.sensors);
+    }
+    return previous;
+}
+
+// ============================================================================
+// SimBoardBinding
+// ============================================================================
+
+uint16_t SimBoardBinding::getBattMilliVolts() { return t_bindings.board->getBattMilliVolts(); }
+const char* SimBoardBinding::getManufacturerName() const { return t_bindings.board->getManufacturerName(); }
+void SimBoardBinding::reboot() { t_bindings.board->reboot(); }
+void SimBoardBinding::powerOff() { t_bindings.board->powerOff(); }
+uint8_t SimBoardBinding::getStartupReason() const { return t_bindings.board->getStartupReason(); }
+
+// ============================================================================
+// SimRadioBinding
+// ============================================================================
+
+void SimRadioBinding::configure(float freq, float bw, uint8_t sf, uint8_t cr, uint8_t tx_power) {
+    t_bindings.radio->configure(freq, bw, sf, cr, tx_power);
+}
+
+void SimRadioBinding::begin() { t_bindings.radio->begin(); }
+int SimRadioBinding::recvRaw(uint8_t* bytes, int sz) { return t_bindings.radio->recvRaw(bytes, sz); }
+uint32_t SimRadioBinding::getEstAirtimeFor(int len_bytes) { return t_bindings.radio->getEstAirtimeFor(len_bytes); }
+float SimRadioBinding::packetScore(float snr, int packet_len) { return t_bindings.radio->packetScore(snr, packet_len); }
+bool SimRadioBinding::startSendRaw(const uint8_t* bytes, int len) { return t_bindings.radio->startSendRaw(bytes, len); }
+bool SimRadioBinding::isSendComplete() { return t_bindings.radio->isSendComplete(); }
+void SimRadioBinding::onSendFinished() { t_bindings.radio->onSendFinished(); }
+bool SimRadioBinding::isInRecvMode() const { return t_bindings.radio->isInRecvMode(); }
+bool SimRadioBinding::isReceiving() { return t_bindings.radio->isReceiving(); }
+float SimRadioBinding::getLastRSSI() const { return t_bindings.radio->getLastRSSI(); }
+float SimRadioBinding::getLastSNR() const { return t_bindings.radio->getLastSNR(); }
+int SimRadioBinding::getNoiseFloor() const { return t_bindings.radio->getNoiseFloor(); }
+
+uint32_t SimRadioBinding::getPacketsRecv() const { return t_bindings.radio->getPacketsRecv(); }
+uint32_t SimRadioBinding::getPacketsSent() const { return t_bindings.radio->getPacketsSent(); }
+uint32_t SimRadioBinding::getPacketsRecvErrors() const { return t_bindings.radio->getPacketsRecvErrors(); }
+void SimRadioBinding::resetStats() { t_bindings.radio->resetStats(); }
+uint32_t SimRadioBinding::getTotalTxAirtime() const { return t_bindings.radio->getTotalTxAirtime(); }
+uint32_t SimRadioBinding::getTotalRxAirtime() const { return t_bindings.radio->getTotalRxAirtime(); }
+
+// ============================================================================
+// SimRTCBinding
+// ============================================================================
+
+uint32_t SimRTCBinding::getCurrentTime() { return t_bindings.rtc->getCurrentTime(); }
+void SimRTCBinding::setCurrentTime(uint32_t time) { t_bindings.rtc->setCurrentTime(time); }
+void SimRTCBinding::tick() { t_bindings.rtc->tick(); }
+
+// ============================================================================
+// SimSensorsBinding
+// ============================================================================
+
+bool SimSensorsBinding::begin() { return t_bindings.sensors->begin(); }
+void SimSensorsBinding::loop() { t_bindings.sensors->loop(); }
+
+bool SimSensorsBinding::querySensors(uint8_t requester_permissions, CayenneLPP& telemetry) {
+    return t_bindings.sensors->querySensors(requester_permissions, telemetry);
+}
+
+int SimSensorsBinding::getNumSettings() const { return t_bindings.sensors->getNumSettings(); }
+const char* SimSensorsBinding::getSettingName(int idx) const { return t_bindings.sensors->getSettingName(idx); }
+const char* SimSensorsBinding::getSettingValue(int idx) const { return t_bindings.sensors->getSettingValue(idx); }
+
+bool SimSensorsBinding::setSettingValue(const char* name, const char* value) {
+    return t_bindings.sensors->setSettingValue(name, value);
+}
+
+LocationProvider* SimSensorsBinding::getLocationProvider() { return t_bindings.sensors->getLocationProvider(); }
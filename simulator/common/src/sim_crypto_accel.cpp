@@ -0,0 +1,373 @@
+#include "sim_crypto_accel.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define SIM_CRYPTO_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#elif defined(__aarch64__)
+#if defined(__ARM_FEATURE_AES) || defined(__ARM_FEATURE_CRYPTO)
+#define SIM_AES_ARM 1
+#endif
+#if defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO)
+#define SIM_SHA_ARM 1
+#endif
+#if defined(SIM_AES_ARM) || defined(SIM_SHA_ARM)
+#include <arm_neon.h>
+#endif
+#endif
+
+// ============================================================================
+// CPU Feature Detection
+// ============================================================================
+
+static bool hwCryptoDisabled() {
+    const char* env = getenv("SIM_NO_HW_CRYPTO");
+    return env && env[0] != '\0' && strcmp(env, "0") != 0;
+}
+
+#if defined(SIM_CRYPTO_X86) || defined(SIM_SHA_ARM)
+// SHA-256 round constants
+static const uint32_t kSha256K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+#endif
+
+#ifdef SIM_CRYPTO_X86
+
+static void cpuid(unsigned int leaf, unsigned int regs[4]) {
+    regs[0] = regs[1] = regs[2] = regs[3] = 0;
+#ifdef _MSC_VER
+    int out[4];
+    __cpuidex(out, static_cast<int>(leaf), 0);
+    for (int i = 0; i < 4; i++) {
+        regs[i] = static_cast<unsigned int>(out[i]);
+    }
+#else
+    if (leaf > __get_cpuid_max(0, nullptr)) {
+        return;
+    }
+    __cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static bool cpuHasAesNi() {
+    unsigned int regs[4];
+    cpuid(1, regs);
+    // CPUID.1:ECX bit 25 = AES-NI
+    return (regs[2] & (1u << 25)) != 0;
+}
+
+static bool cpuHasShaNi() {
+    unsigned int regs[4];
+    cpuid(1, regs);
+    // CPUID.1:ECX bit 9 = SSSE3, bit 19 = SSE4.1 (used for the shuffles)
+    if ((regs[2] & (1u << 9)) == 0 || (regs[2] & (1u << 19)) == 0) {
+        return false;
+    }
+    cpuid(7, regs);
+    // CPUID.7.0:EBX bit 29 = SHA
+    return (regs[1] & (1u << 29)) != 0;
+}
+
+// MSVC proper accepts the intrinsics without a target attribute
+#if defined(__GNUC__) || defined(__clang__)
+#define SIM_AESNI_TARGET __attribute__((target("aes,sse2")))
+#define SIM_SHANI_TARGET __attribute__((target("sha,sse4.1,ssse3")))
+#else
+#define SIM_AESNI_TARGET
+#define SIM_SHANI_TARGET
+#endif
+
+// ============================================================================
+// AES-NI Kernels
+// ============================================================================
+
+SIM_AESNI_TARGET
+static void aesniPrepareDecryptKeys(uint8_t* dec_round_keys, const uint8_t* round_keys) {
+    const __m128i* rk = reinterpret_cast<const __m128i*>(round_keys);
+    __m128i* dk = reinterpret_cast<__m128i*>(dec_round_keys);
+    _mm_storeu_si128(dk, _mm_loadu_si128(rk + 10));
+    for (int i = 1; i < 10; i++) {
+        _mm_storeu_si128(dk + i, _mm_aesimc_si128(_mm_loadu_si128(rk + 10 - i)));
+    }
+    _mm_storeu_si128(dk + 10, _mm_loadu_si128(rk));
+}
+
+SIM_AESNI_TARGET
+static void aesniEncryptBlocks(const uint8_t* round_keys, uint8_t* out, const uint8_t* in,
+                               size_t blocks) {
+    __m128i k[11];
+    for (int i = 0; i < 11; i++) {
+        k[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(round_keys) + i);
+    }
+    const __m128i* src = reinterpret_cast<const __m128i*>(in);
+    __m128i* dst = reinterpret_cast<__m128i*>(out);
+
+    size_t i = 0;
+    // Four blocks in flight hide the AESENC latency
+    for (; i + 4 <= blocks; i += 4) {
+        __m128i b0 = _mm_xor_si128(_mm_loadu_si128(src + i), k[0]);
+        __m128i b1 = _mm_xor_si128(_mm_loadu_si128(src + i + 1), k[0]);
+        __m128i b2 = _mm_xor_si128(_mm_loadu_si128(src + i + 2), k[0]);
+        __m128i b3 = _mm_xor_si128(_mm_loadu_si128(src + i + 3), k[0]);
+        for (int r = 1; r < 10; r++) {
+            b0 = _mm_aesenc_si128(b0, k[r]);
+            b1 = _mm_aesenc_si128(b1, k[r]);
+            b2 = _mm_aesenc_si128(b2, k[r]);
+            b3 = _mm_aesenc_si128(b3, k[r]);
+        }
+        _mm_storeu_si128(dst + i, _mm_aesenclast_si128(b0, k[10]));
+        _mm_storeu_si128(dst + i + 1, _mm_aesenclast_si128(b1, k[10]));
+        _mm_storeu_si128(dst + i + 2, _mm_aesenclast_si128(b2, k[10]));
+        _mm_storeu_si128(dst + i + 3, _mm_aesenclast_si128(b3, k[10]));
+    }
+    for (; i < blocks; i++) {
+        __m128i b = _mm_xor_si128(_mm_loadu_si128(src + i), k[0]);
+        for (int r = 1; r < 10; r++) {
+            b = _mm_aesenc_si128(b, k[r]);
+        }
+        _mm_storeu_si128(dst + i, _mm_aesenclast_si128(b, k[10]));
+    }
+}
+
+SIM_AESNI_TARGET
+static void aesniDecryptBlocks(const uint8_t* dec_round_keys, uint8_t* out, const uint8_t* in,
+                               size_t blocks) {
+    __m128i k[11];
+    for (int i = 0; i < 11; i++) {
+        k[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dec_round_keys) + i);
+    }
+    const __m128i* src = reinterpret_cast<const __m128i*>(in);
+    __m128i* dst = reinterpret_cast<__m128i*>(out);
+
+    size_t i = 0;
+    for (; i + 4 <= blocks; i += 4) {
+        __m128i b0 = _mm_xor_si128(_mm_loadu_si128(src + i), k[0]);
+        __m128i b1 = _mm_xor_si128(_mm_loadu_si128(src + i + 1), k[0]);
+        __m128i b2 = _mm_xor_si128(_mm_loadu_si128(src + i + 2), k[0]);
+        __m128i b3 = _mm_xor_si128(_mm_loadu_si128(src + i + 3), k[0]);
+        for (int r = 1; r < 10; r++) {
+            b0 = _mm_aesdec_si128(b0, k[r]);
+            b1 = _mm_aesdec_si128(b1, k[r]);
+            b2 = _mm_aesdec_si128(b2, k[r]);
+            b3 = _mm_aesdec_si128(b3, k[r]);
+        }
+        _mm_storeu_si128(dst + i, _mm_aesdeclast_si128(b0, k[10]));
+        _mm_storeu_si128(dst + i + 1, _mm_aesdeclast_si128(b1, k[10]));
+        _mm_storeu_si128(dst + i + 2, _mm_aesdeclast_si128(b2, k[10]));
+        _mm_storeu_si128(dst + i + 3, _mm_aesdeclast_si128(b3, k[10]));
+    }
+    for (; i < blocks; i++) {
+        __m128i b = _mm_xor_si128(_mm_loadu_si128(src + i), k[0]);
+        for (int r = 1; r < 10; r++) {
+            b = _mm_aesdec_si128(b, k[r]);
+        }
+        _mm_storeu_si128(dst + i, _mm_aesdeclast_si128(b, k[10]));
+    }
+}
+
+static const SimAesAccel kAesNi = {
+    aesniPrepareDecryptKeys,
+    aesniEncryptBlocks,
+    aesniDecryptBlocks,
+};
+
+// ============================================================================
+// SHA-NI Kernel
+// ============================================================================
+
+SIM_SHANI_TARGET
+static void shaniCompressBlocks(uint32_t* state, const uint8_t* data, size_t blocks) {
+    const __m128i byteswap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    const __m128i* k = reinterpret_cast<const __m128i*>(kSha256K);
+
+    // SHA256RNDS2 wants the state as ABEF / CDGH
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state)), 0xB1);
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(state + 4)), 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+    for (size_t blk = 0; blk < blocks; blk++, data += 64) {
+        const __m128i abef_save = state0;
+        const __m128i cdgh_save = state1;
+        const __m128i* src = reinterpret_cast<const __m128i*>(data);
+
+        __m128i w[4];
+        for (int i = 0; i < 16; i++) {
+            if (i < 4) {
+                w[i] = _mm_shuffle_epi8(_mm_loadu_si128(src + i), byteswap);
+            } else {
+                // W[4i..4i+3] from the previous four message groups
+                __m128i next = _mm_sha256msg1_epu32(w[i & 3], w[(i + 1) & 3]);
+                next = _mm_add_epi32(next, _mm_alignr_epi8(w[(i + 3) & 3], w[(i + 2) & 3], 4));
+                w[i & 3] = _mm_sha256msg2_epu32(next, w[(i + 3) & 3]);
+            }
+            __m128i msg = _mm_add_epi32(w[i & 3], _mm_loadu_si128(k + i));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(msg, 0x0E));
+        }
+
+        state0 = _mm_add_epi32(state0, abef_save);
+        state1 = _mm_add_epi32(state1, cdgh_save);
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state), _mm_blend_epi16(tmp, state1, 0xF0));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(state + 4), _mm_alignr_epi8(state1, tmp, 8));
+}
+
+static const SimShaAccel kShaNi = {
+    shaniCompressBlocks,
+};
+
+#endif // SIM_CRYPTO_X86
+
+#ifdef SIM_AES_ARM
+
+// ============================================================================
+// ARMv8 Crypto Extension Kernels
+// ============================================================================
+// Only built when the compiler already targets the crypto extension (as on
+// Apple silicon), so no runtime check is needed beyond the opt-out.
+
+static void armPrepareDecryptKeys(uint8_t* dec_round_keys, const uint8_t* round_keys) {
+    vst1q_u8(dec_round_keys, vld1q_u8(round_keys + 160));
+    for (int i = 1; i < 10; i++) {
+        vst1q_u8(dec_round_keys + 16 * i, vaesimcq_u8(vld1q_u8(round_keys + 16 * (10 - i))));
+    }
+    vst1q_u8(dec_round_keys + 160, vld1q_u8(round_keys));
+}
+
+static void armEncryptBlocks(const uint8_t* round_keys, uint8_t* out, const uint8_t* in,
+                             size_t blocks) {
+    uint8x16_t k[11];
+    for (int i = 0; i < 11; i++) {
+        k[i] = vld1q_u8(round_keys + 16 * i);
+    }
+    for (size_t i = 0; i < blocks; i++) {
+        // AESE is AddRoundKey + SubBytes + ShiftRows
+        uint8x16_t b = vld1q_u8(in + 16 * i);
+        for (int r = 0; r < 9; r++) {
+            b = vaesmcq_u8(vaeseq_u8(b, k[r]));
+        }
+        b = veorq_u8(vaeseq_u8(b, k[9]), k[10]);
+        vst1q_u8(out + 16 * i, b);
+    }
+}
+
+static void armDecryptBlocks(const uint8_t* dec_round_keys, uint8_t* out, const uint8_t* in,
+                             size_t blocks) {
+    uint8x16_t k[11];
+    for (int i = 0; i < 11; i++) {
+        k[i] = vld1q_u8(dec_round_keys + 16 * i);
+    }
+    for (size_t i = 0; i < blocks; i++) {
+        uint8x16_t b = vld1q_u8(in + 16 * i);
+        for (int r = 0; r < 9; r++) {
+            b = vaesimcq_u8(vaesdq_u8(b, k[r]));
+        }
+        b = veorq_u8(vaesdq_u8(b, k[9]), k[10]);
+        vst1q_u8(out + 16 * i, b);
+    }
+}
+
+static const SimAesAccel kArmAes = {
+    armPrepareDecryptKeys,
+    armEncryptBlocks,
+    armDecryptBlocks,
+};
+
+#endif // SIM_AES_ARM
+
+#ifdef SIM_SHA_ARM
+
+// ============================================================================
+// ARMv8 SHA2 Kernel
+// ============================================================================
+
+static void armCompressBlocks(uint32_t* state, const uint8_t* data, size_t blocks) {
+    uint32x4_t state0 = vld1q_u32(state);
+    uint32x4_t state1 = vld1q_u32(state + 4);
+
+    for (size_t blk = 0; blk < blocks; blk++, data += 64) {
+        const uint32x4_t abcd_save = state0;
+        const uint32x4_t efgh_save = state1;
+
+        uint32x4_t w[4];
+        for (int i = 0; i < 16; i++) {
+            if (i < 4) {
+                w[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(data + 16 * i)));
+            } else {
+                w[i & 3] = vsha256su1q_u32(vsha256su0q_u32(w[i & 3], w[(i + 1) & 3]),
+                                           w[(i + 2) & 3], w[(i + 3) & 3]);
+            }
+            const uint32x4_t msg = vaddq_u32(w[i & 3], vld1q_u32(kSha256K + 4 * i));
+            const uint32x4_t prev = state0;
+            state0 = vsha256hq_u32(state0, state1, msg);
+            state1 = vsha256h2q_u32(state1, prev, msg);
+        }
+
+        state0 = vaddq_u32(state0, abcd_save);
+        state1 = vaddq_u32(state1, efgh_save);
+    }
+
+    vst1q_u32(state, state0);
+    vst1q_u32(state + 4, state1);
+}
+
+static const SimShaAccel kArmSha = {
+    armCompressBlocks,
+};
+
+#endif // SIM_SHA_ARM
+
+// ============================================================================
+// Dispatch
+// ============================================================================
+
+const SimAesAccel* simAesAccel() {
+    static const SimAesAccel* const accel = []() -> const SimAesAccel* {
+        if (hwCryptoDisabled()) {
+            return nullptr;
+        }
+#if defined(SIM_CRYPTO_X86)
+        return cpuHasAesNi() ? &kAesNi : nullptr;
+#elif defined(SIM_AES_ARM)
+        return &kArmAes;
+#else
+        return nullptr;
+#endif
+    }();
+    return accel;
+}
+
+const SimShaAccel* simShaAccel() {
+    static const SimShaAccel* const accel = []() -> const SimShaAccel* {
+        if (hwCryptoDisabled()) {
+            return nullptr;
+        }
+#if defined(SIM_CRYPTO_X86)
+        return cpuHasShaNi() ? &kShaNi : nullptr;
+#elif defined(SIM_SHA_ARM)
+        return &kArmSha;
+#else
+        return nullptr;
+#endif
+    }();
+    return accel;
+}
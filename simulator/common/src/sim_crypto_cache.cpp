@@ -0,0 +1,227 @@
+// Calls the real ed25519_key_exchange(), not the redirect in our ed_25519.h
+#define SIM_CRYPTO_CACHE_IMPL 1
+
+#include "sim_crypto_cache.h"
+#include "sim_runtime.h"
+#include "SHA256.h"
+
+extern "C" {
+#include <ed_25519.h>
+}
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// ============================================================================
+// Sharded Cache
+// ============================================================================
+
+/// Cache key: SHA-256 digest of the operation's inputs
+struct SimCacheKey {
+    uint8_t bytes[32];
+
+    bool operator==(const SimCacheKey& other) const {
+        return memcmp(bytes, other.bytes, sizeof(bytes)) == 0;
+    }
+};
+
+struct SimCacheKeyHash {
+    size_t operator()(const SimCacheKey& key) const {
+        // The digest is uniformly distributed; any 8 bytes make a good hash
+        size_t h;
+        memcpy(&h, key.bytes, sizeof(h));
+        return h;
+    }
+};
+
+/// Bounded, sharded map from SimCacheKey to Value. Each shard has its own
+/// lock and evicts its oldest entry once full.
+template <typename Value>
+class SimShardedCache {
+public:
+    static constexpr size_t kShards = 16;
+
+    /// Set the total capacity in entries (0 disables) and drop all entries.
+    void configure(size_t capacity) {
+        size_t per_shard = capacity ? (capacity + kShards - 1) / kShards : 0;
+        for (Shard& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.map.clear();
+            shard.order.assign(per_shard, SimCacheKey{});
+            shard.next = 0;
+            shard.capacity = per_shard;
+        }
+        capacity_.store(capacity, std::memory_order_relaxed);
+        hits_.store(0, std::memory_order_relaxed);
+        misses_.store(0, std::memory_order_relaxed);
+    }
+
+    bool enabled() const { return capacity_.load(std::memory_order_relaxed) != 0; }
+
+    /// Copy the cached value for key into out. Counts a hit or a miss.
+    bool lookup(const SimCacheKey& key, Value& out) {
+        Shard& shard = shardFor(key);
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto it = shard.map.find(key);
+            if (it != shard.map.end()) {
+                out = it->second;
+                hits_.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+        }
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    void insert(const SimCacheKey& key, const Value& value) {
+        Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (shard.capacity == 0 || shard.map.count(key)) {
+            return;
+        }
+        if (shard.map.size() >= shard.capacity) {
+            shard.map.erase(shard.order[shard.next]);
+        }
+        shard.map.emplace(key, value);
+        shard.order[shard.next] = key;
+        shard.next = (shard.next + 1) % shard.capacity;
+    }
+
+    void getStats(SimCryptoCacheStats* out) {
+        size_t entries = 0;
+        for (Shard& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            entries += shard.map.size();
+        }
+        out->hits = hits_.load(std::memory_order_relaxed);
+        out->misses = misses_.load(std::memory_order_relaxed);
+        out->entries = entries;
+        out->capacity = capacity_.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::unordered_map<SimCacheKey, Value, SimCacheKeyHash> map;
+        std::vector<SimCacheKey> order;   // Insertion ring for eviction
+        size_t next = 0;
+        size_t capacity = 0;
+    };
+
+    Shard& shardFor(const SimCacheKey& key) {
+        // Use bytes the map's hash does not
+        return shards_[key.bytes[8] % kShards];
+    }
+
+    Shard shards_[kShards];
+    std::atomic<size_t> capacity_{0};
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+};
+
+// ============================================================================
+// Cache Instances
+// ============================================================================
+
+struct SimSharedSecret {
+    uint8_t bytes[32];
+};
+
+static SimShardedCache<bool> g_verify_cache;
+static SimShardedCache<SimSharedSecret> g_ecdh_cache;
+
+// ============================================================================
+// SimCryptoCache
+// ============================================================================
+
+bool SimCryptoCache::verify(const uint8_t* sig, const uint8_t* public_key,
+                            const uint8_t* message, size_t len) {
+    if (const SimRuntimeApi* runtime = simRuntime()) {
+        return runtime->crypto_verify(sig, public_key, message, len) != 0;
+    }
+    if (!g_verify_cache.enabled()) {
+        return ed25519_verify(sig, message, static_cast<int>(len), public_key) != 0;
+    }
+
+    SimCacheKey key;
+    SHA256 sha{SHA256::Uncounted()};
+    sha.update(sig, 64);
+    sha.update(public_key, 32);
+    sha.update(message, len);
+    sha.finalize(key.bytes, sizeof(key.bytes));
+
+    bool valid;
+    if (g_verify_cache.lookup(key, valid)) {
+        return valid;
+    }
+    valid = ed25519_verify(sig, message, static_cast<int>(len), public_key) != 0;
+    g_verify_cache.insert(key, valid);
+    return valid;
+}
+
+void SimCryptoCache::keyExchange(uint8_t* shared_secret, const uint8_t* public_key,
+                                 const uint8_t* private_key) {
+    SIM_COUNT_OP(key_exchanges, 1);
+    if (const SimRuntimeApi* runtime = simRuntime()) {
+        runtime->crypto_key_exchange(shared_secret, public_key, private_key);
+        return;
+    }
+    if (!g_ecdh_cache.enabled()) {
+        ed25519_key_exchange(shared_secret, public_key, private_key);
+        return;
+    }
+
+    SimCacheKey key;
+    SHA256 sha{SHA256::Uncounted()};
+    sha.update(private_key, 64);
+    sha.update(public_key, 32);
+    sha.finalize(key.bytes, sizeof(key.bytes));
+
+    SimSharedSecret secret;
+    if (!g_ecdh_cache.lookup(key, secret)) {
+        ed25519_key_exchange(secret.bytes, public_key, private_key);
+        g_ecdh_cache.insert(key, secret);
+    }
+    memcpy(shared_secret, secret.bytes, sizeof(secret.bytes));
+}
+
+void SimCryptoCache::configure(SimCryptoCacheKind kind, size_t capacity) {
+    if (const SimRuntimeApi* runtime = simRuntime()) {
+        runtime->set_crypto_cache(kind, static_cast<uint32_t>(capacity));
+        return;
+    }
+    switch (kind) {
+    case SIM_CRYPTO_CACHE_VERIFY:
+        g_verify_cache.configure(capacity);
+        break;
+    case SIM_CRYPTO_CACHE_ECDH:
+        g_ecdh_cache.configure(capacity);
+        break;
+    }
+}
+
+void SimCryptoCache::getStats(SimCryptoCacheKind kind, SimCryptoCacheStats* out) {
+    memset(out, 0, sizeof(*out));
+    if (const SimRuntimeApi* runtime = simRuntime()) {
+        runtime->get_crypto_cache_stats(kind, out);
+        return;
+    }
+    switch (kind) {
+    case SIM_CRYPTO_CACHE_VERIFY:
+        g_verify_cache.getStats(out);
+        break;
+    case SIM_CRYPTO_CACHE_ECDH:
+        g_ecdh_cache.getStats(out);
+        break;
+    }
+}
+
+extern "C" void sim_cached_key_exchange(unsigned char* shared_secret,
+                                        const unsigned char* public_key,
+                                        const unsigned char* private_key) {
+    SimCryptoCache::keyExchange(shared_secret, public_key, private_key);
+}
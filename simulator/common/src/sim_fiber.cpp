@@ -0,0 +1,254 @@
+#include "sim_fiber.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+#endif
+
+// ============================================================================
+// Platform Fiber Implementation
+// ============================================================================
+
+// Common entry for every fiber, called on the fiber's own stack
+void simFiberStart(SimFiber* self) {
+    self->entry_(self->arg_);
+    self->finished_ = true;
+    // The entry has returned; hand control back for good. A finished fiber
+    // is never resumed again, so this call does not return.
+    self->suspend();
+}
+
+#ifdef _WIN32
+
+struct SimFiber::Impl {
+    LPVOID fiber = nullptr;
+    LPVOID caller = nullptr;
+};
+
+static VOID CALLBACK simFiberProc(LPVOID param) {
+    simFiberStart(static_cast<SimFiber*>(param));
+}
+
+SimFiber::SimFiber(EntryFn entry, void* arg, size_t stack_size)
+    : impl_(new Impl()), entry_(entry), arg_(arg), finished_(false) {
+    impl_->fiber = CreateFiberEx(0, stack_size, FIBER_FLAG_FLOAT_SWITCH, simFiberProc, this);
+    if (!impl_->fiber) {
+        delete impl_;
+        impl_ = nullptr;
+    }
+}
+
+SimFiber::~SimFiber() {
+    if (impl_) {
+        DeleteFiber(impl_->fiber);
+        delete impl_;
+    }
+}
+
+void SimFiber::resume() {
+    if (!IsThreadAFiber()) {
+        ConvertThreadToFiberEx(nullptr, FIBER_FLAG_FLOAT_SWITCH);
+    }
+    impl_->caller = GetCurrentFiber();
+    SwitchToFiber(impl_->fiber);
+}
+
+void SimFiber::suspend() {
+    SwitchToFiber(impl_->caller);
+}
+
+#else // POSIX
+
+struct SimFiber::Impl {
+    ucontext_t context;
+    ucontext_t caller;
+    void* stack = nullptr;
+    size_t stack_size = 0;
+};
+
+// makecontext only passes int arguments, so the fiber pointer is split in two
+static void simFiberProc(unsigned int hi, unsigned int lo) {
+    uintptr_t bits = (static_cast<uintptr_t>(hi) << 16 << 16) | static_cast<uintptr_t>(lo);
+    simFiberStart(reinterpret_cast<SimFiber*>(bits));
+}
+
+SimFiber::SimFiber(EntryFn entry, void* arg, size_t stack_size)
+    : impl_(new Impl()), entry_(entry), arg_(arg), finished_(false) {
+    // Reserve the stack with a guard page below it so an overflow faults
+    // instead of silently corrupting a neighbouring node.
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    size_t usable = (stack_size + page - 1) / page * page;
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#ifdef MAP_NORESERVE
+    flags |= MAP_NORESERVE;
+#endif
+#ifdef MAP_STACK
+    flags |= MAP_STACK;
+#endif
+    void* mem = mmap(nullptr, usable + page, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (mem == MAP_FAILED || getcontext(&impl_->context) != 0) {
+        if (mem != MAP_FAILED) munmap(mem, usable + page);
+        delete impl_;
+        impl_ = nullptr;
+        return;
+    }
+    mprotect(mem, page, PROT_NONE);
+    impl_->stack = mem;
+    impl_->stack_size = usable + page;
+
+    impl_->context.uc_stack.ss_sp = static_cast<uint8_t*>(mem) + page;
+    impl_->context.uc_stack.ss_size = usable;
+    impl_->context.uc_link = nullptr;
+
+    uintptr_t bits = reinterpret_cast<uintptr_t>(this);
+    makecontext(&impl_->context, reinterpret_cast<void (*)()>(simFiberProc), 2,
+                static_cast<unsigned int>(bits >> 16 >> 16),
+                static_cast<unsigned int>(bits & 0xFFFFFFFFu));
+}
+
+SimFiber::~SimFiber() {
+    if (impl_) {
+        munmap(impl_->stack, impl_->stack_size);
+        delete impl_;
+    }
+}
+
+void SimFiber::resume() {
+    swapcontext(&impl_->caller, &impl_->context);
+}
+
+void SimFiber::suspend() {
+    swapcontext(&impl_->context, &impl_->caller);
+}
+
+#endif // _WIN32
+
+// ============================================================================
+// Worker Pool
+// ============================================================================
+
+// Index of the pool worker running on this thread (-1 for other threads)
+static thread_local int t_worker_index = -1;
+
+SimFiberScheduler& SimFiberScheduler::instance() {
+    // Intentionally leaked: workers live for the life of the process, and
+    // joining threads from a static destructor deadlocks under the Windows
+    // loader lock when the DLL is unloaded.
+    static SimFiberScheduler* scheduler = new SimFiberScheduler();
+    return *scheduler;
+}
+
+void SimFiberScheduler::setWorkerCount(uint32_t count) {
+    if (const SimRuntimeApi* runtime = simRuntime()) {
+        runtime->set_fiber_workers(count);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(config_mutex_);
+    if (workers_.empty()) {
+        worker_count_ = count;
+    }
+}
+
+void SimFiberScheduler::ensureStarted() {
+    std::call_once(start_once_, [this] {
+        std::lock_guard<std::mutex> lock(config_mutex_);
+        uint32_t count = worker_count_;
+        if (count == 0) {
+            count = std::thread::hardware_concurrency();
+        }
+        if (count == 0) {
+            count = 1;
+        }
+        workers_.reserve(count);
+        for (uint32_t i = 0; i < count; i++) {
+            workers_.emplace_back(new Worker());
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            std::thread(&SimFiberScheduler::workerMain, this, static_cast<size_t>(i)).detach();
+        }
+    });
+}
+
+void SimFiberScheduler::post(SliceFn fn, void* arg) {
+    Slice slice{fn, arg};
+    postBatch(&slice, 1);
+}
+
+void SimFiberScheduler::postBatch(const Slice* slices, size_t count) {
+    if (count == 0) return;
+    if (const SimRuntimeApi* runtime = simRuntime()) {
+        runtime->post_slices(slices, count);
+        return;
+    }
+    ensureStarted();
+
+    size_t n = workers_.size();
+    for (size_t i = 0; i < count; i++) {
+        size_t target = t_worker_index >= 0
+            ? static_cast<size_t>(t_worker_index)
+            : next_worker_.fetch_add(1, std::memory_order_relaxed) % n;
+        std::lock_guard<std::mutex> lock(workers_[target]->mutex);
+        workers_[target]->queue.push_back(slices[i]);
+    }
+    pending_.fetch_add(static_cast<int64_t>(count));
+    wakeWorkers(count);
+}
+
+void SimFiberScheduler::wakeWorkers(size_t count) {
+    // Taking the sleep mutex orders the pending_ update against a worker that
+    // is about to wait, so no wakeup is lost
+    { std::lock_guard<std::mutex> lock(sleep_mutex_); }
+    if (count == 1) {
+        sleep_cv_.notify_one();
+    } else {
+        sleep_cv_.notify_all();
+    }
+}
+
+bool SimFiberScheduler::popOrSteal(size_t index, Slice& out) {
+    size_t n = workers_.size();
+
+    // Own queue first (FIFO keeps posting order for a single worker)
+    {
+        Worker& self = *workers_[index];
+        std::lock_guard<std::mutex> lock(self.mutex);
+        if (!self.queue.empty()) {
+            out = self.queue.front();
+            self.queue.pop_front();
+            return true;
+        }
+    }
+
+    // Steal from the back of the other workers' queues
+    for (size_t k = 1; k < n; k++) {
+        Worker& victim = *workers_[(index + k) % n];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.queue.empty()) {
+            out = victim.queue.back();
+            victim.queue.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void SimFiberScheduler::workerMain(size_t index) {
+    t_worker_index = static_cast<int>(index);
+    for (;;) {
+        Slice slice;
+        if (popOrSteal(index, slice)) {
+            pending_.fetch_sub(1);
+            slice.fn(slice.arg);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleep_mutex_);
+        sleep_cv_.wait(lock, [this] { return pending_.load() > 0; });
+    }
+}
@@ -1,83 +1,488 @@
 #include "sim_filesystem.h"
+#include "sim_fs_arena.h"
 #include "sim_context.h"
+#include "sim_trace.h"
 #include "SPIFFS.h"
 
-// Thread-local SPIFFS instance
-// Each simulation thread gets its own SPIFFS instance to ensure filesystem isolation
-// between nodes running in the same DLL
-thread_local SPIFFSClass SPIFFS;
+#include <algorithm>
+
+// Global SPIFFS instance
+// Filesystem isolation between nodes comes from g_sim_ctx (see getSimFilesystem),
+// which is rebound whenever a node runs, so this object holds no per-node state
+SPIFFSClass SPIFFS;
 
 // Helper to get the filesystem from context
 SimFilesystem& getSimFilesystem() {
     return g_sim_ctx->filesystem;
 }
 
-std::string SimFilesystem::normalizePath(const char* path) {
-    std::string p(path);
-    // Remove leading slash for internal storage
-    while (!p.empty() && p[0] == '/') {
-        p = p.substr(1);
+// ============================================================================
+// SimFileData
+// ============================================================================
+
+SimFileData::~SimFileData() {
+    if (arena_ && !linked_) {
+        arena_->release(slot_);
+    }
+}
+
+uint8_t* SimFileData::mappedData() const {
+    return arena_->data(slot_);
+}
+
+size_t SimFileData::mappedSize() const {
+    return arena_->size(slot_);
+}
+
+bool SimFileData::resize(size_t len) {
+    if (arena_) {
+        return arena_->resize(slot_, len);
     }
-    return p;
+    bytes_.resize(len);
+    return true;
+}
+
+void SimFileData::unlink() {
+    if (arena_ && linked_) {
+        arena_->unlink(slot_);
+    }
+    linked_ = false;
+}
+
+// ============================================================================
+// SimFilesystem
+// ============================================================================
+
+std::string_view SimFilesystem::pathView(const char* path) {
+    std::string_view p(path ? path : "");
+    size_t first = p.find_first_not_of('/');
+    if (first == std::string_view::npos) {
+        return std::string_view();
+    }
+    return p.substr(first, p.find_last_not_of('/') - first + 1);
 }
 
 bool SimFilesystem::exists(const char* path) {
     std::lock_guard<std::mutex> lock(mutex_);
-    std::string normalized = normalizePath(path);
-    return files_.find(normalized) != files_.end();
+    return find(pathView(path)) != NO_NODE;
 }
 
 bool SimFilesystem::remove(const char* path) {
+    SIM_TRACE_SCOPE(SIM_TRACE_FS, "fs.remove");
     std::lock_guard<std::mutex> lock(mutex_);
-    std::string normalized = normalizePath(path);
-    auto it = files_.find(normalized);
-    if (it != files_.end()) {
-        files_.erase(it);
-        return true;
+    uint32_t id = findFile(pathView(path));
+    if (id == NO_NODE) {
+        return false;
     }
-    return false;
+    // Open handles keep their bytes; writes through them are discarded
+    hashChange('R', nodes_[id].path);
+    nodes_[id].staged.reset();
+    nodes_[id].dirty = false;
+    setData(id, nullptr);
+    return true;
 }
 
-SimFile* SimFilesystem::openRead(const char* path) {
+size_t SimFile::write(const uint8_t* buffer, size_t len) {
+    SIM_TRACE_SCOPE(SIM_TRACE_FS, "fs.write");
+    if (!writable_) {
+        return 0;
+    }
+    // The filesystem entry plus this handle; anything more is a read snapshot
+    if (data_.use_count() > 2) {
+        fs_->detach(this);
+    }
+    // Extend if needed
+    if (position_ + len > data_->size()) {
+        if (!data_->resize(position_ + len)) {
+            return 0;
+        }
+        fs_->resized(this);
+    }
+    memcpy(data_->data() + position_, buffer, len);
+    if (!staged_) {
+        fs_->write_hash_ = simHashBytes(simHashWord(fs_->write_hash_, position_), buffer, len);
+    } else if (node_ < fs_->nodes_.size() && fs_->nodes_[node_].staged == data_) {
+        fs_->nodes_[node_].dirty = true;
+    }
+    position_ += len;
+    SIM_COUNT_OP(fs_bytes_written, len);
+    return len;
+}
+
+// ----------------------------------------------------------------------------
+// Path Index
+// ----------------------------------------------------------------------------
+
+uint32_t SimFilesystem::find(std::string_view path) const {
+    if (path.empty()) {
+        return ROOT;
+    }
+    if (index_.empty()) {
+        return NO_NODE;
+    }
+    uint64_t hash = pathHash(path);
+    size_t mask = index_.size() - 1;
+    for (size_t pos = indexHome(hash); index_[pos] != NO_NODE; pos = (pos + 1) & mask) {
+        const Node& node = nodes_[index_[pos]];
+        if (node.hash == hash && node.path == path) {
+            return index_[pos];
+        }
+    }
+    return NO_NODE;
+}
+
+uint32_t SimFilesystem::intern(std::string_view path) {
+    uint32_t id = find(path);
+    if (id != NO_NODE) {
+        return id;
+    }
+    size_t slash = path.rfind('/');
+    uint32_t parent = (slash == std::string_view::npos) ? ROOT : intern(path.substr(0, slash));
+
+    if (free_nodes_.empty()) {
+        id = static_cast<uint32_t>(nodes_.size());
+        nodes_.emplace_back();
+    } else {
+        id = free_nodes_.back();
+        free_nodes_.pop_back();
+    }
+    Node& node = nodes_[id];
+    node.path.assign(path.data(), path.size());  // Reuses a freed node's capacity
+    node.hash = pathHash(path);
+    node.parent = parent;
+    node.name_pos = (slash == std::string_view::npos) ? 0 : static_cast<uint32_t>(slash + 1);
+    indexInsert(id);
+
+    std::vector<uint32_t>& siblings = nodes_[parent].children;
+    auto at = std::lower_bound(siblings.begin(), siblings.end(), node.name(),
+                               [this](uint32_t child, std::string_view name) {
+                                   return nodes_[child].name() < name;
+                               });
+    siblings.insert(at, id);
+    return id;
+}
+
+void SimFilesystem::setData(uint32_t id, std::shared_ptr<SimFileData> data) {
+    if (nodes_[id].data) {
+        nodes_[id].data->unlink();
+    }
+    nodes_[id].data = std::move(data);
+    account(id);
+
+    // A directory lasts only while something is stored below it
+    while (id != ROOT && !nodes_[id].data && !nodes_[id].staged && nodes_[id].children.empty()) {
+        Node& node = nodes_[id];
+        std::vector<uint32_t>& siblings = nodes_[node.parent].children;
+        siblings.erase(std::find(siblings.begin(), siblings.end(), id));
+        indexErase(id);
+        node.path.clear();
+        free_nodes_.push_back(id);
+        id = node.parent;
+    }
+}
+
+void SimFilesystem::account(uint32_t id) {
+    Node& node = nodes_[id];
+    size_t size = node.data ? node.data->size() : 0;
+    used_bytes_ = used_bytes_ - node.size + size;
+    node.size = size;
+}
+
+void SimFilesystem::resized(SimFile* file) {
     std::lock_guard<std::mutex> lock(mutex_);
-    std::string normalized = normalizePath(path);
-    
-    auto it = files_.find(normalized);
-    if (it == files_.end()) {
-        return nullptr;
+    // Writes to a removed or replaced file are not counted
+    if (file->node_ < nodes_.size() && nodes_[file->node_].data == file->data_) {
+        account(file->node_);
     }
-    
-    SimFile* file = new SimFile();
-    file->data = it->second;
+}
+
+void SimFilesystem::reset() {
+    for (Node& node : nodes_) {
+        if (node.data) {
+            node.data->unlink();
+        }
+    }
+    nodes_.resize(1);
+    nodes_[ROOT].children.clear();
+    free_nodes_.clear();
+    staged_nodes_.clear();
+    std::fill(index_.begin(), index_.end(), NO_NODE);
+    indexed_ = 0;
+    used_bytes_ = 0;
+}
+
+void SimFilesystem::indexInsert(uint32_t id) {
+    // At most half full, so probe runs stay short
+    if ((indexed_ + 1) * 2 > index_.size()) {
+        std::vector<uint32_t> old((std::max)(index_.size() * 2, size_t(16)), NO_NODE);
+        old.swap(index_);
+        for (uint32_t moved : old) {
+            if (moved != NO_NODE) indexPlace(moved);
+        }
+    }
+    indexPlace(id);
+    indexed_++;
+}
+
+void SimFilesystem::indexPlace(uint32_t id) {
+    size_t mask = index_.size() - 1;
+    size_t pos = indexHome(nodes_[id].hash);
+    while (index_[pos] != NO_NODE) pos = (pos + 1) & mask;
+    index_[pos] = id;
+}
+
+// Backward-shift deletion keeps every probe run unbroken
+void SimFilesystem::indexErase(uint32_t id) {
+    size_t mask = index_.size() - 1;
+    size_t hole = indexHome(nodes_[id].hash);
+    while (index_[hole] != id) hole = (hole + 1) & mask;
+    for (size_t next = (hole + 1) & mask; index_[next] != NO_NODE; next = (next + 1) & mask) {
+        size_t want = indexHome(nodes_[index_[next]].hash);
+        // Move the entry back unless its home lies in (hole, next]
+        if (((next - want) & mask) >= ((next - hole) & mask)) {
+            index_[hole] = index_[next];
+            hole = next;
+        }
+    }
+    index_[hole] = NO_NODE;
+    indexed_--;
+}
+
+// ----------------------------------------------------------------------------
+// Write-Back
+// ----------------------------------------------------------------------------
+
+void SimFilesystem::setWriteBack(bool enabled) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!enabled) {
+        commitLocked();
+    }
+    write_back_ = enabled;
+}
+
+void SimFilesystem::stage(uint32_t id) {
+    std::shared_ptr<SimFileData>& staged = nodes_[id].staged;
+    nodes_[id].dirty = true;
+    if (staged) {
+        SIM_COUNT_OP(fs_rewrites_coalesced, 1);
+        if (staged.use_count() == 1 && staged->resize(0)) {
+            return;
+        }
+        // Still open elsewhere: that handle keeps the old buffer
+    } else {
+        staged_nodes_.push_back(id);
+    }
+    if (spare_.empty()) {
+        staged = std::make_shared<SimFileData>();
+    } else {
+        staged = std::move(spare_.back());
+        spare_.pop_back();
+        staged->resize(0);
+    }
+}
+
+void SimFilesystem::commitLocked() {
+    size_t kept = 0;
+    for (uint32_t id : staged_nodes_) {
+        // Nodes removed since they were staged have nothing to commit
+        if (id >= nodes_.size() || !nodes_[id].staged) continue;
+        Node& node = nodes_[id];
+        if (!node.dirty) {
+            // Still open but unwritten since the last commit
+            staged_nodes_[kept++] = id;
+            continue;
+        }
+        node.dirty = false;
+        hashChange('W', node.path);
+        write_hash_ = simHashBytes(write_hash_, node.staged->data(), node.staged->size());
+        SIM_COUNT_OP(fs_bytes_committed, node.staged->size());
+        if (node.staged.use_count() > 1) {
+            // A handle still open on it goes on staging: commit a copy
+            setData(id, newData(node.path, node.staged.get()));
+            staged_nodes_[kept++] = id;
+        } else if (arena_) {
+            std::shared_ptr<SimFileData> staged = std::move(node.staged);
+            setData(id, newData(node.path, staged.get()));
+            recycle(std::move(staged));
+        } else {
+            // The staged buffer becomes the file, and the old contents the
+            // next staging buffer unless a reader or image still has them
+            std::shared_ptr<SimFileData> old = node.data;
+            setData(id, std::move(node.staged));
+            if (old && !old->mapped()) {
+                recycle(std::move(old));
+            }
+        }
+    }
+    staged_nodes_.resize(kept);
+}
+
+void SimFilesystem::recycle(std::shared_ptr<SimFileData> buffer) {
+    // A few are enough for the files one save rewrites
+    if (buffer.use_count() == 1 && spare_.size() < 4) {
+        spare_.push_back(std::move(buffer));
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Handles
+// ----------------------------------------------------------------------------
+
+SimFile* SimFilesystem::acquireHandle(uint32_t id, bool writable) {
+    SimFile* file;
+    if (free_handles_.empty()) {
+        handles_.push_back(simMakeUnique<SimFile>());
+        file = handles_.back().get();
+    } else {
+        file = free_handles_.back();
+        free_handles_.pop_back();
+    }
+    // Reuses the pooled strings' capacity
+    file->path_.assign(1, '/');
+    file->path_.append(nodes_[id].path);
+    file->cursor_.clear();
+    file->data_ = nodes_[id].staged ? nodes_[id].staged : nodes_[id].data;
     file->position_ = 0;
-    open_files_[file] = normalized;
+    file->fs_ = this;
+    file->node_ = id;
+    file->writable_ = writable;
+    file->directory_ = !file->data_;
+    file->staged_ = false;
+    SIM_COUNT_OP(fs_opens, 1);
     return file;
 }
 
+void SimFilesystem::detach(SimFile* file) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint32_t id = file->node_;
+    std::shared_ptr<SimFileData> fresh;
+    if (file->staged_ && id < nodes_.size() && nodes_[id].staged == file->data_) {
+        // A reader opened the staged contents; they stay with it
+        fresh = std::make_shared<SimFileData>(file->data_->data(), file->data_->size());
+        nodes_[id].staged = fresh;
+    } else if (!file->staged_ && id < nodes_.size() && nodes_[id].data == file->data_) {
+        fresh = newData(nodes_[id].path, file->data_.get());
+        setData(id, fresh);
+    } else {
+        // Removed or replaced since it was opened: the writes are discarded
+        fresh = std::make_shared<SimFileData>(file->data_->data(), file->data_->size());
+    }
+    SIM_COUNT_OP(fs_bytes_copied, fresh->size());
+    file->data_ = std::move(fresh);
+}
+
+std::shared_ptr<SimFileData> SimFilesystem::newData(const std::string& path,
+                                                    const SimFileData* src) {
+    size_t len = src ? src->size() : 0;
+    if (arena_) {
+        uint32_t slot = arena_->create(path, nullptr, len);
+        if (slot != SimFsArena::NO_SLOT) {
+            auto data = std::make_shared<SimFileData>(arena_, slot);
+            // Copy after create(): growing the arena may have moved src
+            if (len > 0) {
+                memcpy(data->data(), src->data(), len);
+            }
+            return data;
+        }
+        // Arena index full or out of space: keep the file on the heap
+    }
+    if (!src) {
+        return std::make_shared<SimFileData>();
+    }
+    return std::make_shared<SimFileData>(src->data(), len);
+}
+
+SimFile* SimFilesystem::openRead(const char* path) {
+    SIM_TRACE_SCOPE(SIM_TRACE_FS, "fs.open");
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint32_t id = find(pathView(path));
+    if (id == NO_NODE) {
+        return nullptr;
+    }
+    return acquireHandle(id, false);
+}
+
+SimFile* SimFilesystem::openNext(SimFile* dir) {
+    if (!dir || !dir->directory_) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint32_t id = find(std::string_view(dir->path_).substr(1));
+    if (id == NO_NODE) {
+        return nullptr;  // Everything below it was removed
+    }
+    // First entry named after the last one returned
+    const std::vector<uint32_t>& children = nodes_[id].children;
+    auto next = children.begin();
+    if (!dir->cursor_.empty()) {
+        next = std::upper_bound(children.begin(), children.end(), std::string_view(dir->cursor_),
+                                [this](std::string_view name, uint32_t child) {
+                                    return name < nodes_[child].name();
+                                });
+    }
+    if (next == children.end()) {
+        return nullptr;
+    }
+    std::string_view name = nodes_[*next].name();
+    dir->cursor_.assign(name.data(), name.size());
+    return acquireHandle(*next, false);
+}
+
+void SimFilesystem::rewind(SimFile* dir) {
+    if (dir) {
+        dir->cursor_.clear();
+    }
+}
+
 SimFile* SimFilesystem::openWrite(const char* path) {
+    SIM_TRACE_SCOPE(SIM_TRACE_FS, "fs.open");
     std::lock_guard<std::mutex> lock(mutex_);
-    std::string normalized = normalizePath(path);
+    std::string_view normalized = pathView(path);
+    if (normalized.empty()) {
+        return nullptr;
+    }
     
-    // Create or truncate
-    files_[normalized].clear();
+    // Create or truncate (leaving any open read snapshot intact)
+    uint32_t id = intern(normalized);
+    if (write_back_) {
+        stage(id);
+        SimFile* file = acquireHandle(id, true);
+        file->staged_ = true;
+        return file;
+    }
+    std::shared_ptr<SimFileData>& data = nodes_[id].data;
+    if (data && data.use_count() == 1 && data->resize(0)) {
+        account(id);
+    } else {
+        setData(id, newData(nodes_[id].path, nullptr));
+    }
     
-    SimFile* file = new SimFile();
-    file->position_ = 0;
-    open_files_[file] = normalized;
-    return file;
+    hashChange('W', normalized);
+    return acquireHandle(id, true);
 }
 
 SimFile* SimFilesystem::openAppend(const char* path) {
+    SIM_TRACE_SCOPE(SIM_TRACE_FS, "fs.open");
     std::lock_guard<std::mutex> lock(mutex_);
-    std::string normalized = normalizePath(path);
+    std::string_view normalized = pathView(path);
+    if (normalized.empty()) {
+        return nullptr;
+    }
     
     // Create if doesn't exist
-    auto& data = files_[normalized];
+    uint32_t id = intern(normalized);
+    if (!nodes_[id].data && !nodes_[id].staged) {
+        setData(id, newData(nodes_[id].path, nullptr));
+    }
     
-    SimFile* file = new SimFile();
-    file->data = data;
-    file->position_ = file->data.size();
-    open_files_[file] = normalized;
+    // Appends go to the stored file unless it is already staged
+    bool staged = nodes_[id].staged != nullptr;
+    if (!staged) {
+        hashChange('A', normalized);
+    }
+    SimFile* file = acquireHandle(id, true);
+    file->staged_ = staged;
+    file->position_ = file->data_->size();
     return file;
 }
 
@@ -85,41 +490,147 @@ void SimFilesystem::close(SimFile* file) {
     if (!file) return;
     
     std::lock_guard<std::mutex> lock(mutex_);
-    
-    auto it = open_files_.find(file);
-    if (it != open_files_.end()) {
-        // Write back to storage
-        files_[it->second] = file->data;
-        open_files_.erase(it);
+    if (file->fs_ != this) {
+        return;  // Already closed
     }
     
-    delete file;
+    // Writes already landed in storage; just release the bytes
+    file->data_.reset();
+    file->fs_ = nullptr;
+    file->writable_ = false;
+    file->directory_ = false;
+    file->staged_ = false;
+    free_handles_.push_back(file);
 }
 
+void SimFilesystem::releaseHandles() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_handles_.clear();
+    handles_.clear();
+}
+
+// ----------------------------------------------------------------------------
+// Coordinator Access
+// ----------------------------------------------------------------------------
+
 int SimFilesystem::writeFile(const char* path, const uint8_t* data, size_t len) {
     std::lock_guard<std::mutex> lock(mutex_);
-    std::string normalized = normalizePath(path);
+    std::string_view normalized = pathView(path);
+    if (normalized.empty()) {
+        return -1;
+    }
+    commitLocked();
     
-    files_[normalized].assign(data, data + len);
+    uint32_t id = intern(normalized);
+    std::shared_ptr<SimFileData>& stored = nodes_[id].data;
+    if (!(stored && stored.use_count() == 1 && stored->resize(len))) {
+        setData(id, newData(nodes_[id].path, nullptr));
+        if (!stored->resize(len)) {
+            return -1;
+        }
+    }
+    if (len > 0) {
+        memcpy(stored->data(), data, len);
+    }
+    account(id);
+    hashChange('C', normalized);
+    write_hash_ = simHashBytes(write_hash_, data, len);
     return static_cast<int>(len);
 }
 
 int SimFilesystem::readFile(const char* path, uint8_t* data, size_t max_len) {
     std::lock_guard<std::mutex> lock(mutex_);
-    std::string normalized = normalizePath(path);
-    
-    auto it = files_.find(normalized);
-    if (it == files_.end()) {
+    commitLocked();
+    uint32_t id = findFile(pathView(path));
+    if (id == NO_NODE) {
         return -1;
     }
     
-    size_t len = (std::min)(it->second.size(), max_len);
-    memcpy(data, it->second.data(), len);
+    const SimFileData& stored = *nodes_[id].data;
+    size_t len = (std::min)(stored.size(), max_len);
+    memcpy(data, stored.data(), len);
+    return static_cast<int>(len);
+}
+
+const uint8_t* SimFilesystem::viewFile(const char* path, size_t* len) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    commitLocked();
+    uint32_t id = findFile(pathView(path));
+    if (id == NO_NODE) {
+        return nullptr;
+    }
+    *len = nodes_[id].data->size();
+    return nodes_[id].data->data();
+}
+
+void SimFilesystem::mountImage(SimFsImage& image) {
+    std::lock_guard<std::mutex> image_lock(image.mutex);
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Files restored from a persistent arena take precedence
+    for (const auto& kv : image.files) {
+        if (kv.first.empty()) continue;
+        uint32_t id = intern(kv.first);
+        if (!nodes_[id].data) {
+            setData(id, kv.second);
+        }
+    }
+}
+
+bool SimFilesystem::openArena(const std::string& file_path) {
+    auto arena = SimFsArena::open(file_path);
+    if (!arena) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    arena->forEachLive([&](const std::string& path, uint32_t slot) {
+        if (path.empty()) return;
+        setData(intern(path), std::make_shared<SimFileData>(arena, slot));
+    });
+    arena_ = std::move(arena);
+    return true;
+}
+
+bool SimFilesystem::flush() {
+    SIM_TRACE_SCOPE(SIM_TRACE_FS, "fs.flush");
+    std::lock_guard<std::mutex> lock(mutex_);
+    commitLocked();
+    return arena_ && arena_->flush();
+}
+
+SimFileMap SimFilesystem::snapshotFiles() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    commitLocked();
+    SimFileMap files;
+    for (const Node& node : nodes_) {
+        if (!node.data) continue;
+        const SimFileData& data = *node.data;
+        files.emplace(node.path, data.mapped()
+                                     ? std::make_shared<SimFileData>(data.data(), data.size())
+                                     : node.data);
+    }
+    return files;
+}
+
+void SimFilesystem::restoreFiles(const SimFileMap& files) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    reset();
+    for (const auto& kv : files) {
+        if (kv.first.empty()) continue;
+        setData(intern(kv.first), arena_ ? newData(kv.first, kv.second.get()) : kv.second);
+    }
+    hashChange('S', std::string_view());
+}
+
+int SimFsImage::writeFile(const char* path, const uint8_t* data, size_t len) {
+    std::lock_guard<std::mutex> lock(mutex);
+    // Always a fresh buffer: nodes created earlier may still share the old one
+    files[SimFilesystem::normalizePath(path)] = std::make_shared<SimFileData>(data, len);
     return static_cast<int>(len);
 }
 
 void SimFilesystem::clear() {
     std::lock_guard<std::mutex> lock(mutex_);
-    files_.clear();
-    // Note: This doesn't handle open file handles - they become invalid
+    // Open handles keep their bytes alive; writes through them are discarded
+    reset();
+    hashChange('F', std::string_view());
 }
@@ -0,0 +1,375 @@
+#include "sim_fs_arena.h"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char kArenaMagic[8] = {'M', 'C', 'S', 'I', 'M', 'F', 'S', '\0'};
+static constexpr uint64_t kArenaDataStart =
+    sizeof(SimFsArenaHeader) + SIM_FS_ARENA_SLOTS * sizeof(SimFsArenaSlot);
+static constexpr uint64_t kExtentAlign = 64;
+
+static uint64_t roundExtent(uint64_t len) {
+    if (len < kExtentAlign) len = kExtentAlign;
+    return (len + kExtentAlign - 1) & ~(kExtentAlign - 1);
+}
+
+// ============================================================================
+// Platform File Mapping
+// ============================================================================
+
+#ifdef _WIN32
+
+struct SimFsArena::Mapping {
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE view_mapping = nullptr;
+};
+
+// No write sharing: one node owns an arena, a second opener fails
+static bool openArenaFile(SimFsArena::Mapping* m, const std::string& path, uint64_t* size) {
+    m->file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+                          OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m->file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER li;
+    if (!GetFileSizeEx(m->file, &li)) return false;
+    *size = static_cast<uint64_t>(li.QuadPart);
+    return true;
+}
+
+static uint8_t* mapArena(SimFsArena::Mapping* m, uint64_t size) {
+    m->view_mapping = CreateFileMappingA(m->file, nullptr, PAGE_READWRITE,
+                                         static_cast<DWORD>(size >> 32),
+                                         static_cast<DWORD>(size), nullptr);
+    if (!m->view_mapping) return nullptr;
+    void* view = MapViewOfFile(m->view_mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    if (!view) {
+        CloseHandle(m->view_mapping);
+        m->view_mapping = nullptr;
+    }
+    return static_cast<uint8_t*>(view);
+}
+
+static void unmapArena(SimFsArena::Mapping* m, uint8_t* base, uint64_t size) {
+    (void)size;
+    if (base) UnmapViewOfFile(base);
+    if (m->view_mapping) CloseHandle(m->view_mapping);
+    m->view_mapping = nullptr;
+}
+
+// The file mapping extends the file itself when it is created larger
+static bool resizeArenaFile(SimFsArena::Mapping* m, uint64_t size) {
+    (void)m;
+    (void)size;
+    return true;
+}
+
+static bool flushArena(SimFsArena::Mapping* m, uint8_t* base, uint64_t size) {
+    return FlushViewOfFile(base, static_cast<SIZE_T>(size)) && FlushFileBuffers(m->file);
+}
+
+static void closeArenaFile(SimFsArena::Mapping* m) {
+    if (m->file != INVALID_HANDLE_VALUE) CloseHandle(m->file);
+    m->file = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+struct SimFsArena::Mapping {
+    int fd = -1;
+};
+
+static bool openArenaFile(SimFsArena::Mapping* m, const std::string& path, uint64_t* size) {
+    m->fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (m->fd < 0) return false;
+    // One node owns an arena; a second opener (even in this process) fails
+    if (flock(m->fd, LOCK_EX | LOCK_NB) != 0) return false;
+    struct stat st;
+    if (fstat(m->fd, &st) != 0) return false;
+    *size = static_cast<uint64_t>(st.st_size);
+    return true;
+}
+
+static uint8_t* mapArena(SimFsArena::Mapping* m, uint64_t size) {
+    void* base = mmap(nullptr, static_cast<size_t>(size), PROT_READ | PROT_WRITE, MAP_SHARED,
+                      m->fd, 0);
+    return base == MAP_FAILED ? nullptr : static_cast<uint8_t*>(base);
+}
+
+static void unmapArena(SimFsArena::Mapping* m, uint8_t* base, uint64_t size) {
+    (void)m;
+    if (base) munmap(base, static_cast<size_t>(size));
+}
+
+static bool resizeArenaFile(SimFsArena::Mapping* m, uint64_t size) {
+    return ftruncate(m->fd, static_cast<off_t>(size)) == 0;
+}
+
+static bool flushArena(SimFsArena::Mapping* m, uint8_t* base, uint64_t size) {
+    (void)m;
+    return msync(base, static_cast<size_t>(size), MS_SYNC) == 0;
+}
+
+static void closeArenaFile(SimFsArena::Mapping* m) {
+    if (m->fd >= 0) ::close(m->fd);
+    m->fd = -1;
+}
+
+#endif // _WIN32
+
+// ============================================================================
+// SimFsArena
+// ============================================================================
+
+std::shared_ptr<SimFsArena> SimFsArena::open(const std::string& file_path) {
+    std::shared_ptr<SimFsArena> arena(new SimFsArena());
+    arena->mapping_ = new Mapping();
+
+    uint64_t size = 0;
+    if (!openArenaFile(arena->mapping_, file_path, &size)) {
+        return nullptr;
+    }
+    bool fresh = (size == 0);
+    if (fresh) {
+        size = SIM_FS_ARENA_INITIAL;
+        if (!resizeArenaFile(arena->mapping_, size)) {
+            return nullptr;
+        }
+    } else if (size < kArenaDataStart) {
+        return nullptr;
+    }
+
+    arena->base_ = mapArena(arena->mapping_, size);
+    if (!arena->base_) {
+        return nullptr;
+    }
+    arena->mapped_size_ = size;
+
+    SimFsArenaHeader* hdr = arena->header();
+    if (fresh) {
+        // A new mapping reads as zeros: every slot is already FREE
+        memcpy(hdr->magic, kArenaMagic, sizeof(kArenaMagic));
+        hdr->version = SIM_FS_ARENA_VERSION;
+        hdr->slot_count = SIM_FS_ARENA_SLOTS;
+        hdr->data_end = kArenaDataStart;
+        return arena;
+    }
+
+    if (memcmp(hdr->magic, kArenaMagic, sizeof(kArenaMagic)) != 0 ||
+        hdr->version != SIM_FS_ARENA_VERSION || hdr->slot_count != SIM_FS_ARENA_SLOTS ||
+        hdr->data_end < kArenaDataStart || hdr->data_end > size) {
+        return nullptr;
+    }
+    // Files still open for reading when the last run stopped are gone now
+    for (uint32_t i = 0; i < SIM_FS_ARENA_SLOTS; i++) {
+        if (arena->slots()[i].state == SIM_FS_SLOT_ORPHAN) {
+            arena->release(i);
+        }
+    }
+    return arena;
+}
+
+SimFsArena::~SimFsArena() {
+    if (mapping_) {
+        // Dirty pages are written back by the OS after unmapping
+        unmapArena(mapping_, base_, mapped_size_);
+        closeArenaFile(mapping_);
+        delete mapping_;
+    }
+}
+
+bool SimFsArena::grow(uint64_t min_size) {
+    uint64_t size = mapped_size_;
+    while (size < min_size) {
+        size *= 2;
+    }
+    unmapArena(mapping_, base_, mapped_size_);
+    base_ = nullptr;
+    if (!resizeArenaFile(mapping_, size)) {
+        size = mapped_size_;
+    }
+    base_ = mapArena(mapping_, size);
+    if (!base_) {
+        // Fall back to the old size so the existing files stay reachable
+        size = mapped_size_;
+        base_ = mapArena(mapping_, size);
+    }
+    bool grown = base_ && size >= min_size;
+    if (base_) mapped_size_ = size;
+    return grown;
+}
+
+bool SimFsArena::allocate(uint32_t slot, uint64_t capacity) {
+    SimFsArenaSlot* table = slots();
+
+    // Best fit among the extents of free slots: swap it in, parking this
+    // slot's old extent in the free slot
+    uint32_t best = NO_SLOT;
+    for (uint32_t i = 0; i < SIM_FS_ARENA_SLOTS; i++) {
+        if (i != slot && table[i].state == SIM_FS_SLOT_FREE && table[i].capacity >= capacity &&
+            (best == NO_SLOT || table[i].capacity < table[best].capacity)) {
+            best = i;
+        }
+    }
+    if (best != NO_SLOT) {
+        uint64_t offset = table[best].offset;
+        uint64_t cap = table[best].capacity;
+        table[best].offset = table[slot].offset;
+        table[best].capacity = table[slot].capacity;
+        table[slot].offset = offset;
+        table[slot].capacity = cap;
+        return true;
+    }
+
+    // New space at the end of the arena
+    uint64_t start = header()->data_end;
+    if (start + capacity > mapped_size_ && !grow(start + capacity)) {
+        return false;
+    }
+    table = slots();
+    if (table[slot].capacity > 0) {
+        // Keep the old extent reusable through an empty free slot
+        for (uint32_t i = 0; i < SIM_FS_ARENA_SLOTS; i++) {
+            if (i != slot && table[i].state == SIM_FS_SLOT_FREE && table[i].capacity == 0) {
+                table[i].offset = table[slot].offset;
+                table[i].capacity = table[slot].capacity;
+                break;
+            }
+        }
+    }
+    table[slot].offset = start;
+    table[slot].capacity = capacity;
+    header()->data_end = start + capacity;
+    return true;
+}
+
+uint32_t SimFsArena::create(const std::string& path, const uint8_t* data, size_t len) {
+    if (path.size() >= SIM_FS_ARENA_PATH) {
+        return NO_SLOT;
+    }
+    // Prefer a free slot whose extent already fits
+    SimFsArenaSlot* table = slots();
+    uint32_t slot = NO_SLOT;
+    for (uint32_t i = 0; i < SIM_FS_ARENA_SLOTS; i++) {
+        if (table[i].state != SIM_FS_SLOT_FREE) continue;
+        if (table[i].capacity >= len) {
+            slot = i;
+            break;
+        }
+        if (slot == NO_SLOT) slot = i;
+    }
+    if (slot == NO_SLOT) {
+        return NO_SLOT;
+    }
+    if (table[slot].capacity < len && !allocate(slot, roundExtent(len))) {
+        return NO_SLOT;
+    }
+
+    table = slots();
+    memset(table[slot].path, 0, SIM_FS_ARENA_PATH);
+    memcpy(table[slot].path, path.data(), path.size());
+    table[slot].size = len;
+    table[slot].state = SIM_FS_SLOT_LIVE;
+    if (data && len > 0) {
+        memcpy(base_ + table[slot].offset, data, len);
+    } else if (len > 0) {
+        memset(base_ + table[slot].offset, 0, len);
+    }
+    return slot;
+}
+
+bool SimFsArena::resize(uint32_t slot, size_t len) {
+    SimFsArenaSlot* table = slots();
+    uint64_t old_size = table[slot].size;
+    if (len > table[slot].capacity) {
+        uint64_t old_offset = table[slot].offset;
+        uint64_t capacity = roundExtent((std::max)(static_cast<uint64_t>(len),
+                                                   table[slot].capacity * 2));
+        if (!allocate(slot, capacity)) {
+            return false;
+        }
+        table = slots();
+        // The old extent now belongs to a free slot but still holds the bytes
+        memmove(base_ + table[slot].offset, base_ + old_offset, static_cast<size_t>(old_size));
+    }
+    if (len > old_size) {
+        memset(base_ + table[slot].offset + old_size, 0, static_cast<size_t>(len - old_size));
+    }
+    table[slot].size = len;
+    return true;
+}
+
+void SimFsArena::unlink(uint32_t slot) {
+    SimFsArenaSlot& entry = slots()[slot];
+    memset(entry.path, 0, SIM_FS_ARENA_PATH);
+    entry.state = SIM_FS_SLOT_ORPHAN;
+}
+
+void SimFsArena::release(uint32_t slot) {
+    SimFsArenaSlot& entry = slots()[slot];
+    memset(entry.path, 0, SIM_FS_ARENA_PATH);
+    entry.size = 0;
+    entry.state = SIM_FS_SLOT_FREE;
+}
+
+bool SimFsArena::flush() {
+    return flushArena(mapping_, base_, mapped_size_);
+}
+
+// ============================================================================
+// Arena Directory
+// ============================================================================
+
+static std::mutex g_arena_dir_mutex;
+static std::string g_arena_dir;
+
+void simSetFsArenaDir(const char* dir) {
+    std::lock_guard<std::mutex> lock(g_arena_dir_mutex);
+    g_arena_dir = dir ? dir : "";
+}
+
+std::string simFsArenaPath(const SimNodeConfig& config) {
+    std::string dir;
+    {
+        std::lock_guard<std::mutex> lock(g_arena_dir_mutex);
+        dir = g_arena_dir;
+    }
+    if (dir.empty()) {
+        return std::string();
+    }
+
+    // Node names become file names; anything unusual is replaced
+    std::string name;
+    for (size_t i = 0; i < SIM_MAX_NODE_NAME && config.node_name[i] != '\0'; i++) {
+        char c = config.node_name[i];
+        bool plain = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                     (c >= '0' && c <= '9') || c == '-' || c == '_' || c == '.';
+        name += plain ? c : '_';
+    }
+    if (name.empty() || name == "." || name == "..") {
+        static const char hex[] = "0123456789abcdef";
+        name.clear();
+        for (size_t i = 0; i < SIM_PUB_KEY_SIZE; i++) {
+            name += hex[config.public_key[i] >> 4];
+            name += hex[config.public_key[i] & 0xF];
+        }
+    }
+
+    char last = dir.back();
+    if (last != '/' && last != '\\') {
+        dir += '/';
+    }
+    return dir + name + ".simfs";
+}
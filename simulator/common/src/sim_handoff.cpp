@@ -0,0 +1,101 @@
+#include "sim_handoff.h"
+
+#include <thread>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+// ============================================================================
+// Spin Limits
+// ============================================================================
+
+// A parked side never spins less than this, so it can notice that steps
+// have become short again
+static constexpr uint32_t kMinSpins = 32;
+
+static constexpr uint32_t kDefaultCoordinatorSpins = 4096;
+static constexpr uint32_t kDefaultNodeSpins = 512;
+
+static std::atomic<uint32_t> s_spin_limits[2] = {{kDefaultCoordinatorSpins}, {kDefaultNodeSpins}};
+static std::atomic<bool> s_configured{false};
+
+// Configured limit for `waiter`. Spinning only helps when another core runs
+// the other side, so by default there is none on a single CPU.
+static uint32_t spinLimit(SimStepHandoff::Waiter waiter) {
+    if (!s_configured.load(std::memory_order_relaxed)) {
+        static const bool multicore = std::thread::hardware_concurrency() > 1;
+        if (!multicore) return 0;
+    }
+    return s_spin_limits[waiter].load(std::memory_order_relaxed);
+}
+
+static inline void cpuRelax() {
+#if defined(__x86_64__) || defined(_M_X64)
+    _mm_pause();
+#elif defined(__aarch64__) && (defined(__GNUC__) || defined(__clang__))
+    __asm__ __volatile__("yield");
+#endif
+}
+
+void SimStepHandoff::configure(uint32_t coordinator_spins, uint32_t node_spins) {
+    s_spin_limits[COORDINATOR].store(coordinator_spins, std::memory_order_relaxed);
+    s_spin_limits[NODE].store(node_spins, std::memory_order_relaxed);
+    s_configured.store(true, std::memory_order_relaxed);
+}
+
+// ============================================================================
+// SimStepHandoff
+// ============================================================================
+
+SimStepState SimStepHandoff::waitMask(Waiter waiter, uint32_t mask) {
+    Side& side = sides_[waiter];
+    uint32_t max_spins = spinLimit(waiter);
+    if (side.spin_limit > max_spins) {
+        side.spin_limit = max_spins;
+    }
+
+    for (uint32_t i = 0; i <= side.spin_limit; i++) {
+        uint32_t word = word_.load(std::memory_order_acquire);
+        if (mask & (1u << (word & ~PARKED))) {
+            side.spin_waits.fetch_add(1, std::memory_order_relaxed);
+            // Grow back towards the configured limit
+            uint32_t grown = side.spin_limit + side.spin_limit / 4 + kMinSpins;
+            side.spin_limit = grown < max_spins ? grown : max_spins;
+            return static_cast<State>(word & ~PARKED);
+        }
+        cpuRelax();
+    }
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    bool parked = false;
+    for (;;) {
+        uint32_t word = word_.load(std::memory_order_acquire);
+        if (mask & (1u << (word & ~PARKED))) {
+            if (parked) {
+                side.parked_waits.fetch_add(1, std::memory_order_relaxed);
+                uint32_t halved = side.spin_limit / 2;
+                uint32_t floor = max_spins < kMinSpins ? max_spins : kMinSpins;
+                side.spin_limit = halved > floor ? halved : floor;
+            } else {
+                side.spin_waits.fetch_add(1, std::memory_order_relaxed);
+            }
+            return static_cast<State>(word & ~PARKED);
+        }
+        // Flag the wait so the next store() notifies; a store that slips in
+        // first fails the exchange and is seen on the next pass
+        if (!(word & PARKED) &&
+            !word_.compare_exchange_weak(word, word | PARKED, std::memory_order_acq_rel)) {
+            continue;
+        }
+        cv_.wait(lock);
+        parked = true;
+    }
+}
+
+void SimStepHandoff::getStats(SimHandoffStats* out) const {
+    out->coordinator_spin_waits = sides_[COORDINATOR].spin_waits.load(std::memory_order_relaxed);
+    out->coordinator_parked_waits = sides_[COORDINATOR].parked_waits.load(std::memory_order_relaxed);
+    out->node_spin_waits = sides_[NODE].spin_waits.load(std::memory_order_relaxed);
+    out->node_parked_waits = sides_[NODE].parked_waits.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,193 @@
+#include "sim_heap.h"
+
+#include <cstdlib>
+#include <cstring>
+
+thread_local SimHeap* g_sim_heap = nullptr;
+
+// ============================================================================
+// Block Layout
+// ============================================================================
+
+// Precedes every block handed out; keeps the payload 16-byte aligned
+struct SimHeap::Block {
+    SimHeap* owner;       // nullptr = malloc'd with no heap bound
+    uint32_t size_class;  // Index into free_lists_, or LARGE_CLASS
+    uint32_t size;        // Requested bytes (for the live byte count)
+};
+
+// Precedes the Block of an individually allocated block, so reset() and
+// the destructor can find it
+struct SimHeap::Large {
+    Large* prev;
+    Large* next;
+};
+
+static_assert(sizeof(SimHeap::Block) == 16, "heap block header keeps 16-byte alignment");
+static_assert(sizeof(SimHeap::Large) == 16, "large block links keep 16-byte alignment");
+
+static constexpr size_t MIN_BLOCK = 32;
+
+static inline SimHeap::Block* blockOf(void* ptr) {
+    return reinterpret_cast<SimHeap::Block*>(static_cast<uint8_t*>(ptr) - sizeof(SimHeap::Block));
+}
+
+static inline void* payloadOf(SimHeap::Block* block) {
+    return reinterpret_cast<uint8_t*>(block) + sizeof(SimHeap::Block);
+}
+
+// Smallest size class (MIN_BLOCK << class) that fits `total` bytes
+static inline uint32_t classFor(size_t total) {
+    uint32_t cls = 0;
+    for (size_t block = MIN_BLOCK; block < total; block <<= 1) {
+        cls++;
+    }
+    return cls;
+}
+
+// ============================================================================
+// SimHeap
+// ============================================================================
+
+SimHeap::~SimHeap() {
+    while (large_) {
+        Large* next = large_->next;
+        free(large_);
+        large_ = next;
+    }
+    for (uint8_t* chunk : chunks_) {
+        free(chunk);
+    }
+}
+
+void* SimHeap::allocate(size_t size) {
+    size_t total = size + sizeof(Block);
+    uint32_t cls = total <= (MIN_BLOCK << (CLASS_COUNT - 1)) ? classFor(total) : LARGE_CLASS;
+    Block* block;
+
+    if (cls == LARGE_CLASS) {
+        Large* large = static_cast<Large*>(malloc(sizeof(Large) + total));
+        if (!large) throw std::bad_alloc();
+        large->prev = nullptr;
+        large->next = large_;
+        if (large_) large_->prev = large;
+        large_ = large;
+        reserved_bytes_ += sizeof(Large) + total;
+        block = reinterpret_cast<Block*>(large + 1);
+    } else if (free_lists_[cls]) {
+        void* payload = free_lists_[cls];
+        memcpy(&free_lists_[cls], payload, sizeof(void*));
+        block = blockOf(payload);
+    } else {
+        size_t block_size = MIN_BLOCK << cls;
+        if (chunks_.empty() || chunk_used_ + block_size > CHUNK_SIZE) {
+            // Move on to the next kept chunk, or add one
+            if (!chunks_.empty()) {
+                current_chunk_++;
+            }
+            if (current_chunk_ == chunks_.size()) {
+                uint8_t* chunk = static_cast<uint8_t*>(malloc(CHUNK_SIZE));
+                if (!chunk) throw std::bad_alloc();
+                chunks_.push_back(chunk);
+                reserved_bytes_ += CHUNK_SIZE;
+            }
+            chunk_used_ = 0;
+        }
+        block = reinterpret_cast<Block*>(chunks_[current_chunk_] + chunk_used_);
+        chunk_used_ += block_size;
+    }
+
+    block->owner = this;
+    block->size_class = cls;
+    block->size = static_cast<uint32_t>(size);
+
+    allocations_++;
+    live_bytes_ += size;
+    if (live_bytes_ > peak_bytes_) {
+        peak_bytes_ = live_bytes_;
+    }
+    return payloadOf(block);
+}
+
+void SimHeap::deallocate(void* ptr) {
+    if (!ptr) return;
+    Block* block = blockOf(ptr);
+    if (!block->owner) {
+        free(block);
+        return;
+    }
+    block->owner->release(block);
+}
+
+void SimHeap::release(Block* block) {
+    frees_++;
+    live_bytes_ -= block->size;
+
+    if (block->size_class == LARGE_CLASS) {
+        Large* large = reinterpret_cast<Large*>(block) - 1;
+        if (large->prev) large->prev->next = large->next;
+        else large_ = large->next;
+        if (large->next) large->next->prev = large->prev;
+        reserved_bytes_ -= sizeof(Large) + sizeof(Block) + block->size;
+        free(large);
+        return;
+    }
+
+    void* payload = payloadOf(block);
+    memcpy(payload, &free_lists_[block->size_class], sizeof(void*));
+    free_lists_[block->size_class] = payload;
+}
+
+void SimHeap::reset() {
+    while (large_) {
+        Large* next = large_->next;
+        free(large_);
+        large_ = next;
+    }
+    memset(free_lists_, 0, sizeof(free_lists_));
+    reserved_bytes_ = chunks_.size() * CHUNK_SIZE;
+    current_chunk_ = 0;
+    chunk_used_ = 0;
+    live_bytes_ = 0;
+    resets_++;
+}
+
+void SimHeap::purge() {
+    reset();
+    for (uint8_t* chunk : chunks_) {
+        free(chunk);
+    }
+    std::vector<uint8_t*>().swap(chunks_);
+    reserved_bytes_ = 0;
+}
+
+void SimHeap::getStats(SimHeapStats* out) const {
+    out->allocations = allocations_;
+    out->frees = frees_;
+    out->live_bytes = live_bytes_;
+    out->peak_bytes = peak_bytes_;
+    out->reserved_bytes = reserved_bytes_;
+    out->resets = resets_;
+}
+
+// ============================================================================
+// Routing
+// ============================================================================
+
+void* simAlloc(size_t size) {
+    if (g_sim_heap) {
+        return g_sim_heap->allocate(size);
+    }
+    // Same header, so simFree() need not know where a block came from
+    void* mem = malloc(size + sizeof(SimHeap::Block));
+    if (!mem) throw std::bad_alloc();
+    SimHeap::Block* block = static_cast<SimHeap::Block*>(mem);
+    block->owner = nullptr;
+    block->size_class = 0;
+    block->size = static_cast<uint32_t>(size);
+    return payloadOf(block);
+}
+
+void simFree(void* ptr) {
+    SimHeap::deallocate(ptr);
+}
@@ -0,0 +1,136 @@
+#include "sim_api.h"
+#include "sim_filesystem.h"
+#include "SPIFFS.h"
+
+#include <helpers/SimpleMeshTables.h>
+
+#include <cstring>
+
+// ============================================================================
+// Packet-Seen Table Equivalence Check
+// ============================================================================
+// Drives SimHashedMeshTables and MeshCore's own SimpleMeshTables through the
+// same random operations and compares every observable result. The shim's
+// header redirects the SimpleMeshTables name; lifting the macro here reaches
+// the upstream class pulled in with #include_next.
+
+#ifndef SIM_LINEAR_MESH_TABLES
+
+#pragma push_macro("SimpleMeshTables")
+#undef SimpleMeshTables
+using UpstreamMeshTables = ::SimpleMeshTables;
+#pragma pop_macro("SimpleMeshTables")
+
+namespace {
+
+// splitmix64: small, seedable and the same on every platform
+struct CheckRng {
+    uint64_t state;
+
+    uint64_t next() {
+        uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
+    }
+
+    uint32_t below(uint32_t n) { return static_cast<uint32_t>(next() % n); }
+};
+
+// Packet `id` of the pool: ACKs carry their CRC in the payload (id 0 is the
+// zero CRC, which upstream matches against empty slots), other packets are
+// told apart by payload, so their hashes repeat exactly when ids do
+void makePacket(mesh::Packet& packet, uint32_t id, bool ack, bool direct) {
+    uint8_t type = ack ? PAYLOAD_TYPE_ACK : PAYLOAD_TYPE_TXT_MSG;
+    uint8_t route = direct ? ROUTE_TYPE_DIRECT : ROUTE_TYPE_FLOOD;
+    packet.header = static_cast<uint8_t>(route | (type << PH_TYPE_SHIFT));
+    packet.path_len = 0;
+    if (ack) {
+        uint32_t crc = id ? id * 0x9e3779b1u : 0;
+        memcpy(packet.payload, &crc, sizeof(crc));
+        packet.payload_len = sizeof(crc);
+    } else {
+        memcpy(packet.payload, &id, sizeof(id));
+        packet.payload_len = sizeof(id);
+    }
+}
+
+// Bytes saveTo() writes: both rings, each followed by its next slot
+const size_t kSavedSize = sizeof(uint64_t) * MAX_PACKET_HASHES + sizeof(int) +
+                          sizeof(uint32_t) * MAX_PACKET_ACKS + sizeof(int);
+
+// Save both tables, as the firmware's saveTo() writes them, and compare the
+// files: identical slots and next positions mean identical eviction order
+bool saveSame(SimFilesystem& fs, UpstreamMeshTables& upstream, SimHashedMeshTables& hashed) {
+    upstream.saveTo(File(&fs, fs.openWrite("/upstream")));
+    hashed.saveTo(File(&fs, fs.openWrite("/hashed")));
+    uint8_t saved[2][kSavedSize + 1];
+    int upstream_len = fs.readFile("/upstream", saved[0], sizeof(saved[0]));
+    int hashed_len = fs.readFile("/hashed", saved[1], sizeof(saved[1]));
+    return upstream_len == static_cast<int>(kSavedSize) && hashed_len == upstream_len &&
+           memcmp(saved[0], saved[1], kSavedSize) == 0;
+}
+
+} // namespace
+
+SIM_API uint32_t sim_check_mesh_tables(uint64_t seed, uint32_t operations) {
+    // Enough distinct packets to overflow the rings, few enough to repeat
+    CheckRng rng{seed};
+    uint32_t hash_pool = MAX_PACKET_HASHES / 2 + rng.below(3 * MAX_PACKET_HASHES);
+    uint32_t ack_pool = MAX_PACKET_ACKS / 2 + rng.below(3 * MAX_PACKET_ACKS);
+
+    SimFilesystem fs;
+    fs.begin();
+    UpstreamMeshTables* upstream = new UpstreamMeshTables();
+    SimHashedMeshTables* hashed = new SimHashedMeshTables();
+    mesh::Packet packet;
+    uint32_t failed = 0;
+
+    for (uint32_t op = 1; op <= operations && !failed; op++) {
+        uint32_t action = rng.below(100);
+        bool ack = rng.below(4) == 0;
+        makePacket(packet, rng.below(ack ? ack_pool : hash_pool), ack, rng.below(2) == 0);
+
+        if (action < 75) {
+            if (upstream->hasSeen(&packet) != hashed->hasSeen(&packet)) failed = op;
+        } else if (action < 90) {
+            upstream->clear(&packet);
+            hashed->clear(&packet);
+        } else if (action < 92) {
+            upstream->resetStats();
+            hashed->resetStats();
+        } else {
+            // Round trip, each file restored into a fresh table of the
+            // other kind (statistics are not saved, so both start at zero)
+            if (!saveSame(fs, *upstream, *hashed)) {
+                failed = op;
+                break;
+            }
+            delete upstream;
+            delete hashed;
+            upstream = new UpstreamMeshTables();
+            hashed = new SimHashedMeshTables();
+            upstream->restoreFrom(File(&fs, fs.openRead("/hashed")));
+            hashed->restoreFrom(File(&fs, fs.openRead("/upstream")));
+        }
+
+        if (upstream->getNumDirectDups() != hashed->getNumDirectDups() ||
+            upstream->getNumFloodDups() != hashed->getNumFloodDups()) {
+            failed = op;
+        }
+    }
+
+    if (!failed && !saveSame(fs, *upstream, *hashed)) failed = operations + 1;
+
+    delete upstream;
+    delete hashed;
+    return failed;
+}
+
+#else
+
+SIM_API uint32_t sim_check_mesh_tables(uint64_t, uint32_t) {
+    return 0;  // Only MeshCore's class is built: nothing to compare
+}
+
+#endif // SIM_LINEAR_MESH_TABLES
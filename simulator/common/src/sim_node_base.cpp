@@ -1,9 +1,13 @@
 #include "../include/sim_node_base.h"
 #include "sim_context.h"
+#include "sim_airtime.h"
 #include "sim_api.h"
+#include "sim_crypto_cache.h"
+#include "sim_fs_arena.h"
 
 #include <thread>
 #include <chrono>
+#include <vector>
 
 // SimNodeImpl is defined in sim_node_base.h
 
@@ -13,58 +17,78 @@
 
 // Note: sim_create and sim_destroy are implemented in each node's sim_main.cpp
 // because they need to instantiate the node-specific SimNodeImpl subclass.
+// sim_reboot is shared: it re-runs setup() through the virtual interface.
+
+// Static storage for SimStepResult.error_msg when there is no node to own it
+static const char kInvalidHandleMsg[] = "Invalid node handle";
+
+// Block until the node is not running a step
+static void waitUntilIdle(SimNodeHandle node) {
+    node->ctx.state.waitFor(SimStepHandoff::COORDINATOR,
+                            {SimContext::State::IDLE, SimContext::State::YIELDED});
+}
+
+// Rebuild a hibernated node before anything that needs its firmware
+static void wakeIfHibernating(SimNodeHandle node) {
+    if (node->hibernating) {
+        node->wake();
+    }
+}
+
+// A node of this library that will boot from the snapshot, not yet launched
+static SimNodeImpl* newForkedNode(SimSnapshot* snapshot, const SimNodeConfig* config) {
+    SimNodeImpl* node = simNewNode(config ? *config : snapshot->config);
+    node->config.fs_image = nullptr;
+    node->config.record_path = nullptr;
+    snapshot->retain();
+    node->pending_restore = snapshot;
+    return node;
+}
+
+// Run the pending reboot (or restore) on the node's thread/fiber and wait
+// for its setup to complete
+static void runBoot(SimNodeHandle node) {
+    node->reboot_pending.store(true);
+    node->run();
+    
+    node->ctx.state.waitFor(SimStepHandoff::COORDINATOR,
+                            {SimContext::State::YIELDED, SimContext::State::SHUTDOWN});
+    node->ctx.state.store(SimContext::State::IDLE);
+}
 
 extern "C" {
 
 SIM_API void sim_step_begin(SimNodeHandle node, uint64_t sim_millis, uint32_t sim_rtc_secs) {
     if (!node) return;
+    wakeIfHibernating(node);
+    if (node->recorder) node->recorder->step(sim_millis, sim_rtc_secs);
     
-    // Update time
-    node->ctx.current_millis = sim_millis;
-    node->ctx.current_rtc_secs = sim_rtc_secs;
-    node->ctx.millis_clock.setMillis(sim_millis);
-    node->ctx.rtc_clock.setCurrentTime(sim_rtc_secs);
-    
-    // Clear board flags (use pointer to firmware thread's board instance)
-    if (node->board_ptr) {
-        node->board_ptr->clearRebootRequest();
-        node->board_ptr->clearPowerOffRequest();
-    }
+    // Update time and clear board flags
+    node->beginStep(sim_millis, sim_rtc_secs);
     
-    // Signal node thread to run
-    {
-        std::lock_guard<std::mutex> lock(node->ctx.step_mutex);
-        node->ctx.state.store(SimContext::State::RUNNING);
-    }
-    node->ctx.step_cv.notify_all();
+    // Signal node thread (or schedule its fiber) to run
+    node->run();
 }
 
 SIM_API SimStepResult sim_step_wait(SimNodeHandle node) {
     SimStepResult result = {};
     if (!node) {
         result.reason = SIM_YIELD_ERROR;
-        snprintf(result.error_msg, sizeof(result.error_msg), "Invalid node handle");
+        result.error_msg = kInvalidHandleMsg;
         return result;
     }
     
-    // Wait for node to yield
-    {
-        std::unique_lock<std::mutex> lock(node->ctx.step_mutex);
-        node->ctx.step_cv.wait(lock, [node] {
-            return node->ctx.state.load() == SimContext::State::YIELDED ||
-                   node->ctx.state.load() == SimContext::State::SHUTDOWN;
-        });
-    }
+    // Wait for node to yield (spinning first; most steps are short)
+    node->ctx.state.waitFor(SimStepHandoff::COORDINATOR,
+                            {SimContext::State::YIELDED, SimContext::State::SHUTDOWN});
     
     // Copy result
     result = node->ctx.step_result;
     
     // Reset state to idle for next step
-    {
-        std::lock_guard<std::mutex> lock(node->ctx.step_mutex);
-        node->ctx.state.store(SimContext::State::IDLE);
-    }
+    node->ctx.state.store(SimContext::State::IDLE);
     
+    if (node->recorder) node->recorder->result(result);
     return result;
 }
 
@@ -73,30 +97,299 @@ SIM_API SimStepResult sim_step(SimNodeHandle node, uint64_t sim_millis, uint32_t
     return sim_step_wait(node);
 }
 
+SIM_API void sim_step_batch(const SimStepRequest* requests, SimStepResult* results, size_t count) {
+    if (!requests || !results || count == 0) return;
+    
+    SimStepLatch latch;
+    std::vector<SimFiberScheduler::Slice> slices;
+    slices.reserve(count);
+    
+    // Count the valid nodes first so no completion can reach zero early
+    for (size_t i = 0; i < count; i++) {
+        if (requests[i].node) latch.remaining++;
+    }
+    if (latch.remaining == 0) {
+        for (size_t i = 0; i < count; i++) {
+            results[i] = SimStepResult{};
+            results[i].reason = SIM_YIELD_ERROR;
+            results[i].error_msg = kInvalidHandleMsg;
+        }
+        return;
+    }
+    
+    // Start every node; fiber slices are queued together so the pool is
+    // woken once for the whole batch
+    for (size_t i = 0; i < count; i++) {
+        SimNodeImpl* node = requests[i].node;
+        if (!node) continue;
+        wakeIfHibernating(node);
+        if (node->recorder) node->recorder->step(requests[i].sim_millis, requests[i].sim_rtc_secs);
+        node->beginStep(requests[i].sim_millis, requests[i].sim_rtc_secs);
+        {
+            std::lock_guard<std::mutex> lock(node->ctx.step_mutex);
+            node->step_latch = &latch;
+            node->ctx.state.store(SimContext::State::RUNNING);
+        }
+        if (node->node_fiber) {
+            slices.push_back({&SimNodeImpl::fiberSlice, node});
+        }
+    }
+    SimFiberScheduler::instance().postBatch(slices.data(), slices.size());
+    
+    // Single wait for the whole batch
+    latch.wait();
+    
+    // Collect results and return every node to idle
+    for (size_t i = 0; i < count; i++) {
+        SimNodeImpl* node = requests[i].node;
+        if (!node) {
+            results[i] = SimStepResult{};
+            results[i].reason = SIM_YIELD_ERROR;
+            results[i].error_msg = kInvalidHandleMsg;
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(node->ctx.step_mutex);
+        results[i] = node->ctx.step_result;
+        node->ctx.state.store(SimContext::State::IDLE);
+        if (node->recorder) node->recorder->result(results[i]);
+    }
+}
+
 SIM_API void sim_inject_radio_rx(SimNodeHandle node, 
                                   const uint8_t* data, size_t len,
                                   float rssi, float snr) {
-    if (!node || !node->radio_ptr) return;
-    // Use the pointer to the firmware thread's radio instance
-    node->radio_ptr->injectRxPacket(data, len, rssi, snr);
+    if (!node) return;
+    if (node->recorder) node->recorder->radioRx(data, len, rssi, snr);
+    node->node_radio.injectRxPacket(data, len, rssi, snr);
+}
+
+SIM_API void sim_inject_radio_rx_batch(const SimRxTarget* targets, size_t count,
+                                        const uint8_t* data, size_t len) {
+    if (!targets || count == 0) return;
+    if (len > SIM_MAX_RADIO_PACKET) {
+        len = SIM_MAX_RADIO_PACKET;
+    }
+    
+    // One reference per receiver, taken up front so no receiver can free
+    // the buffer while it is still being handed out
+    uint32_t refs = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (targets[i].node) refs++;
+    }
+    if (refs == 0) return;
+    
+    SimPacketBuffer* buffer = SimPacketBuffer::create(data, len, refs);
+    for (size_t i = 0; i < count; i++) {
+        SimNodeImpl* node = targets[i].node;
+        if (!node) continue;
+        if (node->recorder) node->recorder->radioRx(data, len, targets[i].rssi, targets[i].snr);
+        node->node_radio.injectRxBuffer(buffer, targets[i].rssi, targets[i].snr);
+    }
 }
 
 SIM_API void sim_inject_serial_rx(SimNodeHandle node,
                                    const uint8_t* data, size_t len) {
     if (!node) return;
-    node->ctx.serial.injectRx(data, len);
+    if (node->recorder) node->recorder->serialRx(data, len);
+    size_t accepted = node->ctx.serial.injectRx(data, len);
+    node->ctx.step_stats.recordSerialRx(len, accepted);
+}
+
+SIM_API size_t sim_collect_serial_tx(SimNodeHandle node,
+                                      uint8_t* buffer, size_t max_len) {
+    if (!node || !buffer) return 0;
+    size_t len = node->ctx.collectSerialTx(buffer, max_len);
+    if (node->recorder) node->recorder->collectSerialTx(max_len, buffer, len);
+    return len;
+}
+
+// TX frames: companion protocol frames, or repeater and room server CLI
+// replies (sim_inject_cli_line())
+SIM_API size_t sim_collect_serial_frame(SimNodeHandle node,
+                                         uint8_t* buffer, size_t max_len) {
+    if (!node || !buffer) return 0;
+    SimFrameRing& frames = node->ctx.serial.txFrames();
+    size_t len = frames.frontSize();
+    len = (len == 0 || len > max_len) ? 0 : frames.pop(buffer, max_len);
+    if (node->recorder) node->recorder->collectFrame(max_len, buffer, len);
+    return len;
+}
+
+SIM_API size_t sim_collect_serial_frames(SimNodeHandle node,
+                                          uint8_t* buffer, size_t buffer_len,
+                                          SimFrameSpan* frames, size_t max_frames) {
+    if (!node || !buffer || !frames) return 0;
+    SimFrameRing& tx = node->ctx.serial.txFrames();
+    size_t collected = 0;
+    size_t offset = 0;
+    while (collected < max_frames) {
+        size_t len = tx.frontSize();
+        if (len == 0 || len > buffer_len - offset) break;
+        tx.pop(buffer + offset, len);
+        frames[collected].offset = static_cast<uint32_t>(offset);
+        frames[collected].len = static_cast<uint32_t>(len);
+        offset += len;
+        collected++;
+    }
+    if (node->recorder) {
+        node->recorder->collectFrames(buffer_len, max_frames, buffer, frames, collected);
+    }
+    return collected;
+}
+
+SIM_API void sim_set_log_sink(SimNodeHandle node, SimLogSinkFn sink, void* user) {
+    if (!node) return;
+    node->ctx.log_config.sink = sink;
+    node->ctx.log_config.sink_user = user;
 }
 
 SIM_API void sim_notify_tx_complete(SimNodeHandle node) {
-    if (!node || !node->radio_ptr) return;
-    // Use the pointer to the firmware thread's radio instance
-    node->radio_ptr->notifyTxComplete();
+    if (!node) return;
+    if (node->recorder) node->recorder->txComplete();
+    node->node_radio.notifyTxComplete();
 }
 
 SIM_API void sim_notify_state_change(SimNodeHandle node, uint32_t state_version) {
-    if (!node || !node->radio_ptr) return;
-    // Use the pointer to the firmware thread's radio instance
-    node->radio_ptr->notifyStateChange(state_version);
+    if (!node) return;
+    if (node->recorder) node->recorder->stateChange(state_version);
+    node->node_radio.notifyStateChange(state_version);
+}
+
+SIM_API void sim_reboot(SimNodeHandle node, const SimNodeConfig* config) {
+    if (!node || !config) return;
+    
+    wakeIfHibernating(node);
+    waitUntilIdle(node);
+    if (node->recorder) node->recorder->reboot(*config);
+    
+    // Reset subsystems (but preserve filesystem) and re-run setup on the
+    // node's own thread/fiber, so the firmware is bound to the node's globals.
+    // The execution mode is fixed at creation.
+    uint8_t execution_mode = node->config.execution_mode;
+    node->config = *config;
+    node->config.execution_mode = execution_mode;
+    node->config.fs_image = nullptr;  // The filesystem survives reboots as is
+    node->config.record_path = nullptr;
+    runBoot(node);
+}
+
+SIM_API SimSnapshotHandle sim_snapshot(SimNodeHandle node) {
+    if (!node) return nullptr;
+    wakeIfHibernating(node);
+    waitUntilIdle(node);
+    return node->captureSnapshot();
+}
+
+SIM_API int sim_restore(SimNodeHandle node, SimSnapshotHandle snapshot) {
+    if (!node || !snapshot || snapshot->node_type != node->getNodeType()) return -1;
+    
+    wakeIfHibernating(node);
+    waitUntilIdle(node);
+    
+    // The log cannot describe the restored state, so it ends here
+    if (node->recorder) {
+        node->recorder->restore();
+        node->recorder.reset();
+    }
+    
+    // Same sequence as sim_reboot(), with the snapshot's config and state
+    uint8_t execution_mode = node->config.execution_mode;
+    node->config = snapshot->config;
+    node->config.execution_mode = execution_mode;
+    node->loadSnapshot(*snapshot);
+    snapshot->retain();
+    node->pending_restore = snapshot;
+    runBoot(node);
+    return 0;
+}
+
+SIM_API SimNodeHandle sim_fork(SimSnapshotHandle snapshot, const SimNodeConfig* config) {
+    if (!snapshot || snapshot->node_type != sim_get_node_type()) return nullptr;
+    
+    SimNodeImpl* node = newForkedNode(snapshot, config);
+    node->start();
+    return node;
+}
+
+SIM_API size_t sim_create_batch(const SimNodeConfig* configs, SimNodeHandle* nodes,
+                                size_t count) {
+    if (!configs || !nodes) return 0;
+    
+    // Launch every node first so their setup() calls overlap
+    for (size_t i = 0; i < count; i++) {
+        nodes[i] = simNewNode(configs[i]);
+        nodes[i]->launch();
+    }
+    for (size_t i = 0; i < count; i++) {
+        nodes[i]->awaitBoot();
+    }
+    return count;
+}
+
+SIM_API size_t sim_fork_batch(SimSnapshotHandle snapshot, const SimNodeConfig* configs,
+                              SimNodeHandle* nodes, size_t count) {
+    if (!snapshot || !configs || !nodes) return 0;
+    if (snapshot->node_type != sim_get_node_type()) {
+        for (size_t i = 0; i < count; i++) {
+            nodes[i] = nullptr;
+        }
+        return 0;
+    }
+    
+    for (size_t i = 0; i < count; i++) {
+        nodes[i] = newForkedNode(snapshot, &configs[i]);
+        nodes[i]->launch();
+    }
+    for (size_t i = 0; i < count; i++) {
+        nodes[i]->awaitBoot();
+    }
+    return count;
+}
+
+SIM_API void sim_snapshot_release(SimSnapshotHandle snapshot) {
+    if (snapshot) snapshot->release();
+}
+
+SIM_API int sim_hibernate(SimNodeHandle node) {
+    if (!node || node->hibernating) return -1;
+    waitUntilIdle(node);
+    node->hibernate();
+    return 0;
+}
+
+SIM_API int sim_wake(SimNodeHandle node) {
+    if (!node || !node->hibernating) return -1;
+    node->wake();
+    return 0;
+}
+
+SIM_API int sim_is_hibernating(SimNodeHandle node) {
+    return node && node->hibernating ? 1 : 0;
+}
+
+SIM_API void sim_set_fiber_workers(uint32_t count) {
+    SimFiberScheduler::instance().setWorkerCount(count);
+}
+
+SIM_API void sim_set_step_spin(uint32_t coordinator_spins, uint32_t node_spins) {
+    SimStepHandoff::configure(coordinator_spins, node_spins);
+}
+
+SIM_API void sim_set_crypto_cache(SimCryptoCacheKind kind, uint32_t entries) {
+    SimCryptoCache::configure(kind, entries);
+}
+
+SIM_API void sim_get_crypto_cache_stats(SimCryptoCacheKind kind, SimCryptoCacheStats* out) {
+    if (!out) return;
+    SimCryptoCache::getStats(kind, out);
+}
+
+SIM_API size_t sim_get_airtime_table(float bw_khz, uint8_t sf, uint8_t cr,
+                                     uint32_t* out_ms, size_t count) {
+    if (!out_ms) return 0;
+    if (count > SIM_AIRTIME_TABLE_LEN) count = SIM_AIRTIME_TABLE_LEN;
+    memcpy(out_ms, simAirtimeTable(bw_khz, sf, cr)->ms, count * sizeof(uint32_t));
+    return count;
 }
 
 SIM_API void sim_get_public_key(SimNodeHandle node, uint8_t* out_key) {
@@ -104,10 +397,46 @@ SIM_API void sim_get_public_key(SimNodeHandle node, uint8_t* out_key) {
     memcpy(out_key, node->config.public_key, SIM_PUB_KEY_SIZE);
 }
 
+SIM_API void sim_get_handoff_stats(SimNodeHandle node, SimHandoffStats* out) {
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+    if (node) {
+        node->ctx.state.getStats(out);
+    }
+}
+
+SIM_API void sim_get_heap_stats(SimNodeHandle node, SimHeapStats* out) {
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+    if (node && node->config.node_heap) {
+        node->heap.getStats(out);
+    }
+}
+
+SIM_API uint64_t sim_peek_next_wake(SimNodeHandle node, int* inputs_pending) {
+    if (inputs_pending) *inputs_pending = 0;
+    if (!node) return UINT64_MAX;
+    bool pending = false;
+    uint64_t wake = node->peekNextWake(&pending);
+    if (inputs_pending) *inputs_pending = pending ? 1 : 0;
+    return wake;
+}
+
+SIM_API void sim_get_stats(SimNodeHandle node, SimNodeStats* out) {
+    if (!out) return;
+    memset(out, 0, sizeof(*out));
+    if (node) {
+        node->getStats(out);
+    }
+}
+
 SIM_API int sim_fs_write(SimNodeHandle node, const char* path, 
                           const uint8_t* data, size_t len) {
     if (!node) return -1;
-    return node->ctx.filesystem.writeFile(path, data, len);
+    node->idle_inputs_valid = false;  // The firmware may read it back
+    int result = node->ctx.filesystem.writeFile(path, data, len);
+    if (node->recorder && result >= 0) node->recorder->fsWrite(path, data, len);
+    return result;
 }
 
 SIM_API int sim_fs_read(SimNodeHandle node, const char* path,
@@ -123,7 +452,37 @@ SIM_API int sim_fs_exists(SimNodeHandle node, const char* path) {
 
 SIM_API int sim_fs_remove(SimNodeHandle node, const char* path) {
     if (!node) return 0;
+    node->idle_inputs_valid = false;
+    if (node->recorder && path) node->recorder->fsRemove(path);
     return node->ctx.filesystem.remove(path) ? 1 : 0;
 }
 
+SIM_API SimFsImageHandle sim_fs_image_create(void) {
+    return new SimFsImage();
+}
+
+SIM_API int sim_fs_image_write(SimFsImageHandle image, const char* path,
+                               const uint8_t* data, size_t len) {
+    if (!image || !path || (!data && len > 0)) return -1;
+    return image->writeFile(path, data, len);
+}
+
+SIM_API void sim_fs_image_release(SimFsImageHandle image) {
+    delete image;
+}
+
+SIM_API void sim_set_fs_dir(const char* dir) {
+    simSetFsArenaDir(dir);
+}
+
+SIM_API int sim_fs_flush(SimNodeHandle node) {
+    if (!node) return -1;
+    return node->ctx.filesystem.flush() ? 0 : -1;
+}
+
+SIM_API const uint8_t* sim_fs_view(SimNodeHandle node, const char* path, size_t* len) {
+    if (!node || !path || !len) return nullptr;
+    return node->ctx.filesystem.viewFile(path, len);
+}
+
 } // extern "C"
@@ -0,0 +1,328 @@
+#include "sim_packet_manager.h"
+#include "sim_context.h"
+
+#include <algorithm>
+
+// ============================================================================
+// Packet Queue
+// ============================================================================
+
+static bool seqBefore(uint32_t a, uint32_t b) {
+    return static_cast<int32_t>(a - b) < 0;
+}
+
+SimPacketQueue::SimPacketQueue(int capacity) {
+    if (capacity < 0) capacity = 0;
+    entries_.resize(capacity);
+    free_slots_.reserve(capacity);
+    for (int slot = capacity - 1; slot >= 0; slot--) {
+        free_slots_.push_back(slot);
+    }
+    waiting_.reserve(capacity);
+    ready_.reserve(capacity);
+    order_.reserve(capacity);
+}
+
+bool SimPacketQueue::add(mesh::Packet* packet, uint8_t priority, uint32_t scheduled_for) {
+    if (free_slots_.empty()) {
+        return false;
+    }
+    int slot = free_slots_.back();
+    free_slots_.pop_back();
+
+    Entry& entry = entries_[slot];
+    entry.packet = packet;
+    entry.scheduled_for = scheduled_for;
+    entry.seq = next_seq_++;
+    entry.priority = priority;
+    push(scheduled_for <= promoted_to_, slot);
+
+    // The newest entry is always last in index order
+    if (order_valid_) {
+        order_.push_back(slot);
+    }
+    return true;
+}
+
+mesh::Packet* SimPacketQueue::get(uint32_t now) {
+    advance(now);
+    if (ready_.empty()) {
+        return nullptr;
+    }
+    int slot = pop(true);
+    free_slots_.push_back(slot);
+    order_valid_ = false;
+    return entries_[slot].packet;
+}
+
+int SimPacketQueue::countBefore(uint32_t now) const {
+    if (now >= promoted_to_) {
+        int due;
+        uint32_t next;
+        bool has_next;
+        scanWaiting(now, due, next, has_next);
+        return static_cast<int>(ready_.size()) + due;
+    }
+    // Asked about an earlier time than the last get(): every waiting entry
+    // is later still
+    int due = 0;
+    for (int slot : ready_) {
+        if (entries_[slot].scheduled_for <= now) due++;
+    }
+    return due;
+}
+
+mesh::Packet* SimPacketQueue::itemAt(int i) {
+    if (i < 0 || i >= count()) {
+        return nullptr;
+    }
+    if (!order_valid_) {
+        order_.assign(waiting_.begin(), waiting_.end());
+        order_.insert(order_.end(), ready_.begin(), ready_.end());
+        std::sort(order_.begin(), order_.end(), [this](int a, int b) {
+            return seqBefore(entries_[a].seq, entries_[b].seq);
+        });
+        order_valid_ = true;
+    }
+    return entries_[order_[i]].packet;
+}
+
+mesh::Packet* SimPacketQueue::removeByIdx(int i) {
+    mesh::Packet* packet = itemAt(i);
+    if (!packet) {
+        return nullptr;
+    }
+    int slot = order_[i];
+    erase(slot);
+    free_slots_.push_back(slot);
+    order_.erase(order_.begin() + i);
+    return packet;
+}
+
+bool SimPacketQueue::nextAfter(uint32_t now, uint32_t& scheduled_for) const {
+    bool found = false;
+    if (now >= promoted_to_) {
+        // Everything ready is due; the answer is among the waiting
+        int due;
+        scanWaiting(now, due, scheduled_for, found);
+        return found;
+    }
+    for (const std::vector<int>* h : {&waiting_, &ready_}) {
+        for (int slot : *h) {
+            uint32_t at = entries_[slot].scheduled_for;
+            if (at > now && (!found || at < scheduled_for)) {
+                scheduled_for = at;
+                found = true;
+            }
+        }
+    }
+    return found;
+}
+
+// ----------------------------------------------------------------------------
+// Heaps
+// ----------------------------------------------------------------------------
+
+bool SimPacketQueue::before(bool ready, int a, int b) const {
+    const Entry& x = entries_[a];
+    const Entry& y = entries_[b];
+    if (ready) {
+        if (x.priority != y.priority) return x.priority < y.priority;
+    } else {
+        if (x.scheduled_for != y.scheduled_for) return x.scheduled_for < y.scheduled_for;
+    }
+    return seqBefore(x.seq, y.seq);
+}
+
+void SimPacketQueue::place(bool ready, size_t pos, int slot) {
+    heap(ready)[pos] = slot;
+    entries_[slot].ready = ready;
+    entries_[slot].heap_pos = static_cast<int>(pos);
+}
+
+void SimPacketQueue::push(bool ready, int slot) {
+    std::vector<int>& h = heap(ready);
+    h.push_back(slot);
+    place(ready, h.size() - 1, slot);
+    siftUp(ready, h.size() - 1);
+}
+
+int SimPacketQueue::pop(bool ready) {
+    int top = heap(ready).front();
+    erase(top);
+    return top;
+}
+
+void SimPacketQueue::erase(int slot) {
+    bool ready = entries_[slot].ready;
+    std::vector<int>& h = heap(ready);
+    size_t pos = static_cast<size_t>(entries_[slot].heap_pos);
+    int last = h.back();
+    h.pop_back();
+    if (pos < h.size()) {
+        place(ready, pos, last);
+        siftUp(ready, pos);
+        siftDown(ready, static_cast<size_t>(entries_[last].heap_pos));
+    }
+}
+
+void SimPacketQueue::siftUp(bool ready, size_t pos) {
+    std::vector<int>& h = heap(ready);
+    int slot = h[pos];
+    while (pos > 0) {
+        size_t parent = (pos - 1) / 2;
+        if (!before(ready, slot, h[parent])) break;
+        place(ready, pos, h[parent]);
+        pos = parent;
+    }
+    place(ready, pos, slot);
+}
+
+void SimPacketQueue::siftDown(bool ready, size_t pos) {
+    std::vector<int>& h = heap(ready);
+    int slot = h[pos];
+    for (;;) {
+        size_t child = 2 * pos + 1;
+        if (child >= h.size()) break;
+        if (child + 1 < h.size() && before(ready, h[child + 1], h[child])) child++;
+        if (!before(ready, h[child], slot)) break;
+        place(ready, pos, h[child]);
+        pos = child;
+    }
+    place(ready, pos, slot);
+}
+
+void SimPacketQueue::advance(uint32_t now) {
+    if (now >= promoted_to_) {
+        while (!waiting_.empty() && entries_[waiting_.front()].scheduled_for <= now) {
+            push(true, pop(false));
+        }
+    } else {
+        // The clock went back: entries no longer due wait again
+        std::vector<int> later;
+        for (int slot : ready_) {
+            if (entries_[slot].scheduled_for > now) later.push_back(slot);
+        }
+        for (int slot : later) {
+            erase(slot);
+            push(false, slot);
+        }
+    }
+    promoted_to_ = now;
+}
+
+void SimPacketQueue::scanWaiting(uint32_t now, int& due, uint32_t& next, bool& has_next) const {
+    due = 0;
+    has_next = false;
+    if (!waiting_.empty()) {
+        scanFrom(0, now, due, next, has_next);
+    }
+}
+
+// A due entry counts and its children are looked at. One not due is a
+// candidate for next, and its subtree is all later still, so the walk visits
+// only the due entries and their children.
+void SimPacketQueue::scanFrom(size_t pos, uint32_t now, int& due, uint32_t& next,
+                              bool& has_next) const {
+    uint32_t scheduled_for = entries_[waiting_[pos]].scheduled_for;
+    if (scheduled_for > now) {
+        if (!has_next || scheduled_for < next) {
+            next = scheduled_for;
+            has_next = true;
+        }
+        return;
+    }
+    due++;
+    for (size_t child = 2 * pos + 1; child <= 2 * pos + 2 && child < waiting_.size(); child++) {
+        scanFrom(child, now, due, next, has_next);
+    }
+}
+
+// ============================================================================
+// Packet Manager
+// ============================================================================
+
+SimPacketManager::SimPacketManager(int pool_size)
+    : send_queue_(pool_size), rx_queue_(pool_size), ctx_(g_sim_ctx) {
+    // Constructed from firmware setup(), so g_sim_ctx is this node's context
+    for (int i = 0; i < pool_size; i++) {
+        pool_.push_back(new mesh::Packet());
+    }
+    unused_ = pool_;
+    unused_count_ = pool_.size();
+    if (ctx_) {
+        ctx_->packet_manager = this;
+    }
+}
+
+SimPacketManager::~SimPacketManager() {
+    if (ctx_ && ctx_->packet_manager == this) {
+        ctx_->packet_manager = nullptr;
+    }
+    for (mesh::Packet* packet : pool_) {
+        delete packet;
+    }
+}
+
+mesh::Packet* SimPacketManager::allocNew() {
+    if (unused_count_ == 0) {
+        return nullptr;
+    }
+    mesh::Packet* packet = unused_[unused_head_];
+    unused_head_ = (unused_head_ + 1) % unused_.size();
+    unused_count_--;
+    return packet;
+}
+
+void SimPacketManager::free(mesh::Packet* packet) {
+    // Dropped when the pool is already full, as upstream
+    if (unused_count_ < unused_.size()) {
+        unused_[(unused_head_ + unused_count_) % unused_.size()] = packet;
+        unused_count_++;
+    }
+}
+
+void SimPacketManager::queueOutbound(mesh::Packet* packet, uint8_t priority, uint32_t scheduled_for) {
+    send_queue_.add(packet, priority, scheduled_for);
+}
+
+mesh::Packet* SimPacketManager::getNextOutbound(uint32_t now) {
+    return send_queue_.get(now);
+}
+
+int SimPacketManager::getOutboundCount(uint32_t now) const {
+    return send_queue_.countBefore(now);
+}
+
+int SimPacketManager::getFreeCount() const {
+    return static_cast<int>(unused_count_);
+}
+
+mesh::Packet* SimPacketManager::getOutboundByIdx(int i) {
+    return send_queue_.itemAt(i);
+}
+
+mesh::Packet* SimPacketManager::removeOutboundByIdx(int i) {
+    return send_queue_.removeByIdx(i);
+}
+
+void SimPacketManager::queueInbound(mesh::Packet* packet, uint32_t scheduled_for) {
+    rx_queue_.add(packet, 0, scheduled_for);
+}
+
+mesh::Packet* SimPacketManager::getNextInbound(uint32_t now) {
+    return rx_queue_.get(now);
+}
+
+uint64_t SimPacketManager::nextScheduledMillis(uint64_t current_millis) const {
+    uint32_t now = static_cast<uint32_t>(current_millis);
+    uint64_t next = UINT64_MAX;
+    for (const SimPacketQueue* queue : {&send_queue_, &rx_queue_}) {
+        uint32_t scheduled_for;
+        if (queue->nextAfter(now, scheduled_for)) {
+            uint64_t at = current_millis + (scheduled_for - now);
+            if (at < next) next = at;
+        }
+    }
+    return next;
+}
@@ -0,0 +1,361 @@
+#include "sim_placement.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <climits>
+#include <cstdio>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <dirent.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+// ============================================================================
+// Topology
+// ============================================================================
+
+namespace {
+
+struct Topology {
+    std::vector<int> cpus;          // CPUs this process may run on, ascending
+    std::vector<int> cpu_node;      // NUMA node of each CPU id (-1 = unknown)
+
+    int nodeOf(int cpu) const {
+        return (cpu >= 0 && cpu < static_cast<int>(cpu_node.size())) ? cpu_node[cpu] : -1;
+    }
+};
+
+#ifdef __linux__
+
+// Parse a sysfs CPU list such as "0-3,8-11"
+static void parseCpuList(const char* text, std::vector<int>& out) {
+    while (*text) {
+        char* end;
+        long first = strtol(text, &end, 10);
+        if (end == text) break;
+        long last = first;
+        if (*end == '-') {
+            text = end + 1;
+            last = strtol(text, &end, 10);
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            out.push_back(static_cast<int>(cpu));
+        }
+        if (*end != ',') break;
+        text = end + 1;
+    }
+}
+
+static Topology loadTopology() {
+    Topology topo;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+            if (CPU_ISSET(cpu, &set)) topo.cpus.push_back(cpu);
+        }
+    }
+
+    // Node directories may be sparse, so list them rather than count up
+    if (DIR* dir = opendir("/sys/devices/system/node")) {
+        while (dirent* entry = readdir(dir)) {
+            int node;
+            if (sscanf(entry->d_name, "node%d", &node) != 1) continue;
+            char path[96];
+            snprintf(path, sizeof(path), "/sys/devices/system/node/node%d/cpulist", node);
+            FILE* file = fopen(path, "r");
+            if (!file) continue;
+            char text[1024] = {};
+            size_t len = fread(text, 1, sizeof(text) - 1, file);
+            fclose(file);
+            text[len] = '\0';
+
+            std::vector<int> cpus;
+            parseCpuList(text, cpus);
+            for (int cpu : cpus) {
+                if (cpu >= static_cast<int>(topo.cpu_node.size())) {
+                    topo.cpu_node.resize(cpu + 1, -1);
+                }
+                topo.cpu_node[cpu] = node;
+            }
+        }
+        closedir(dir);
+    }
+    return topo;
+}
+
+#elif defined(_WIN32)
+
+static Topology loadTopology() {
+    Topology topo;
+    WORD groups = GetActiveProcessorGroupCount();
+    for (WORD group = 0; group < groups; group++) {
+        DWORD count = GetActiveProcessorCount(group);
+        for (DWORD i = 0; i < count && i < 64; i++) {
+            int cpu = group * 64 + static_cast<int>(i);
+            topo.cpus.push_back(cpu);
+
+            PROCESSOR_NUMBER number = {};
+            number.Group = group;
+            number.Number = static_cast<BYTE>(i);
+            USHORT node;
+            if (cpu >= static_cast<int>(topo.cpu_node.size())) {
+                topo.cpu_node.resize(cpu + 1, -1);
+            }
+            if (GetNumaProcessorNodeEx(&number, &node)) {
+                topo.cpu_node[cpu] = node;
+            }
+        }
+    }
+    return topo;
+}
+
+#else
+
+static Topology loadTopology() {
+    return Topology();
+}
+
+#endif
+
+static const Topology& topology() {
+    static const Topology topo = loadTopology();
+    return topo;
+}
+
+// Restrict the calling thread to the placement's CPU, else its NUMA node
+static void applyPlacement(const SimPlacement& placement) {
+    if (placement.cpu < 0 && placement.numa_node < 0) {
+        return;
+    }
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (placement.cpu >= 0) {
+        if (placement.cpu < CPU_SETSIZE) CPU_SET(placement.cpu, &set);
+    } else {
+        for (int cpu : topology().cpus) {
+            if (topology().nodeOf(cpu) == placement.numa_node) CPU_SET(cpu, &set);
+        }
+    }
+    if (CPU_COUNT(&set) > 0) {
+        sched_setaffinity(0, sizeof(set), &set);
+    }
+#elif defined(_WIN32)
+    GROUP_AFFINITY affinity = {};
+    if (placement.cpu >= 0) {
+        affinity.Group = static_cast<WORD>(placement.cpu / 64);
+        affinity.Mask = static_cast<KAFFINITY>(1) << (placement.cpu % 64);
+    } else if (!GetNumaNodeProcessorMaskEx(static_cast<USHORT>(placement.numa_node), &affinity)) {
+        return;
+    }
+    SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr);
+#endif
+}
+
+} // namespace
+
+SimPlacement simPlaceNode(const SimNodeConfig& config) {
+    SimPlacement placement;
+    const Topology& topo = topology();
+
+    switch (config.placement) {
+    case SIM_PLACE_CPU:
+        placement.cpu = config.placement_target;
+        placement.numa_node = topo.nodeOf(placement.cpu);
+        break;
+    case SIM_PLACE_NUMA_NODE:
+        placement.numa_node = config.placement_target;
+        break;
+    case SIM_PLACE_SPREAD:
+        if (!topo.cpus.empty()) {
+            static std::atomic<uint32_t> next{0};
+            placement.cpu = topo.cpus[next.fetch_add(1) % topo.cpus.size()];
+            placement.numa_node = topo.nodeOf(placement.cpu);
+        }
+        break;
+    default:
+        break;
+    }
+    return placement;
+}
+
+// ============================================================================
+// Node Memory
+// ============================================================================
+// Each block starts with a header holding its mapped length, padded so the
+// object stays cache-line aligned.
+
+static constexpr size_t NODE_HEADER = 64;
+
+void* simNodeAlloc(size_t size, int numa_node) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    size_t page = info.dwPageSize;
+#else
+    size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+    size_t mapped = (size + NODE_HEADER + page - 1) / page * page;
+
+#ifdef _WIN32
+    void* mem = nullptr;
+    if (numa_node >= 0) {
+        mem = VirtualAllocExNuma(GetCurrentProcess(), nullptr, mapped, MEM_RESERVE | MEM_COMMIT,
+                                 PAGE_READWRITE, static_cast<DWORD>(numa_node));
+    }
+    if (!mem) {
+        mem = VirtualAlloc(nullptr, mapped, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    }
+    if (!mem) throw std::bad_alloc();
+#else
+    void* mem = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mem == MAP_FAILED) throw std::bad_alloc();
+#ifdef __linux__
+    // Set the policy before anything touches the pages, so the constructor
+    // faults them in on the node. Best effort: without NUMA support the call
+    // fails and the pages land wherever they would have.
+    unsigned long mask = 1;
+    if (numa_node >= 0 && numa_node < static_cast<int>(sizeof(mask) * 8)) {
+        const int MPOL_PREFERRED_MODE = 1;
+        mask <<= numa_node;
+        syscall(SYS_mbind, mem, mapped, MPOL_PREFERRED_MODE, &mask, sizeof(mask) * 8 + 1, 0);
+    }
+#endif
+#endif
+
+    *static_cast<size_t*>(mem) = mapped;
+    return static_cast<uint8_t*>(mem) + NODE_HEADER;
+}
+
+void simNodeFree(void* ptr) {
+    if (!ptr) return;
+    void* mem = static_cast<uint8_t*>(ptr) - NODE_HEADER;
+#ifdef _WIN32
+    VirtualFree(mem, 0, MEM_RELEASE);
+#else
+    munmap(mem, *static_cast<size_t*>(mem));
+#endif
+}
+
+// ============================================================================
+// Threads
+// ============================================================================
+
+namespace {
+
+struct ThreadLaunch {
+    SimThread::EntryFn entry;
+    void* arg;
+    SimPlacement placement;
+};
+
+static void runThread(ThreadLaunch* launch) {
+    applyPlacement(launch->placement);
+    SimThread::EntryFn entry = launch->entry;
+    void* arg = launch->arg;
+    delete launch;
+    entry(arg);
+}
+
+} // namespace
+
+#ifdef _WIN32
+
+struct SimThread::Impl {
+    HANDLE handle;
+};
+
+static DWORD WINAPI simThreadProc(LPVOID param) {
+    runThread(static_cast<ThreadLaunch*>(param));
+    return 0;
+}
+
+bool SimThread::start(EntryFn entry, void* arg, size_t stack_size, const SimPlacement& placement) {
+    ThreadLaunch* launch = new ThreadLaunch{entry, arg, placement};
+    // Reserve rather than commit the stack, as the default stack does
+    HANDLE handle = CreateThread(nullptr, stack_size, simThreadProc, launch,
+                                 STACK_SIZE_PARAM_IS_A_RESERVATION, nullptr);
+    if (!handle && stack_size) {
+        handle = CreateThread(nullptr, 0, simThreadProc, launch, 0, nullptr);
+    }
+    if (!handle) {
+        delete launch;
+        return false;
+    }
+    impl_ = new Impl{handle};
+    return true;
+}
+
+void SimThread::join() {
+    if (!impl_) return;
+    WaitForSingleObject(impl_->handle, INFINITE);
+    CloseHandle(impl_->handle);
+    delete impl_;
+    impl_ = nullptr;
+}
+
+#else // POSIX
+
+struct SimThread::Impl {
+    pthread_t thread;
+};
+
+static void* simThreadProc(void* param) {
+    runThread(static_cast<ThreadLaunch*>(param));
+    return nullptr;
+}
+
+bool SimThread::start(EntryFn entry, void* arg, size_t stack_size, const SimPlacement& placement) {
+    ThreadLaunch* launch = new ThreadLaunch{entry, arg, placement};
+    pthread_t thread;
+    int rc = -1;
+    if (stack_size) {
+        size_t page = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        size_t minimum = static_cast<size_t>(PTHREAD_STACK_MIN);
+        if (stack_size < minimum) stack_size = minimum;
+        stack_size = (stack_size + page - 1) / page * page;
+
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        if (pthread_attr_setstacksize(&attr, stack_size) == 0) {
+            rc = pthread_create(&thread, &attr, simThreadProc, launch);
+        }
+        pthread_attr_destroy(&attr);
+    }
+    if (rc != 0) {
+        rc = pthread_create(&thread, nullptr, simThreadProc, launch);
+    }
+    if (rc != 0) {
+        delete launch;
+        return false;
+    }
+    impl_ = new Impl{thread};
+    return true;
+}
+
+void SimThread::join() {
+    if (!impl_) return;
+    pthread_join(impl_->thread, nullptr);
+    delete impl_;
+    impl_ = nullptr;
+}
+
+#endif // _WIN32
+
+SimThread::~SimThread() {
+    join();
+}
@@ -1,6 +1,6 @@
 #include "sim_radio.h"
 #include "sim_context.h"
-#include <cmath>
+#include "sim_trace.h"
 #include <cstdio>
 
 SimRadio::SimRadio() 
@@ -9,6 +9,7 @@ SimRadio::SimRadio()
     , sf_(11)
     , cr_(5)
     , tx_power_(20)
+    , airtime_(simAirtimeTable(250.0f, 11, 5))
     , last_rssi_(-100.0f)
     , last_snr_(0.0f)
     , tx_pending_(false)
@@ -19,11 +20,18 @@ SimRadio::SimRadio()
     , packets_recv_errors_(0)
     , total_tx_airtime_(0)
     , total_rx_airtime_(0)
+    , rx_dropped_(0)
+    , rx_high_water_(0)
     , state_version_(0)
     , last_polled_version_(0)
     , poll_count_(0)
     , recv_mode_(false)
 {
+    rx_queue_.reset(SIM_DEFAULT_RX_QUEUE_DEPTH);
+}
+
+SimRadio::~SimRadio() {
+    drainRx();
 }
 
 void SimRadio::configure(float freq, float bw, uint8_t sf, uint8_t cr, uint8_t tx_power) {
@@ -32,6 +40,77 @@ void SimRadio::configure(float freq, float bw, uint8_t sf, uint8_t cr, uint8_t t
     sf_ = sf;
     cr_ = cr;
     tx_power_ = tx_power;
+    airtime_ = simAirtimeTable(bw, sf, cr);
+}
+
+void SimRadio::setRxQueueDepth(size_t depth) {
+    if (depth == 0) {
+        depth = SIM_DEFAULT_RX_QUEUE_DEPTH;
+    }
+    if (depth != rx_queue_.capacity()) {
+        drainRx();
+        rx_queue_.reset(depth);
+    }
+}
+
+void SimRadio::drainRx() {
+    while (const RxPacket* pkt = rx_queue_.front()) {
+        SimPacketBuffer* buffer = pkt->buffer;
+        rx_queue_.popFront();
+        buffer->release();
+    }
+}
+
+void SimRadio::saveSnapshot(SimRadioSnapshot& out) {
+    // Cycle the queue through the snapshot, keeping the order
+    out.rx.resize(rx_queue_.size());
+    out.rx.resize(rx_queue_.pop(out.rx.data(), out.rx.size()));
+    rx_queue_.push(out.rx.data(), out.rx.size());
+    for (const RxPacket& pkt : out.rx) {
+        pkt.buffer->retain();
+    }
+    
+    out.last_rssi = last_rssi_;
+    out.last_snr = last_snr_;
+    out.tx_pending = tx_pending_;
+    out.tx_in_progress = tx_in_progress_;
+    memcpy(out.tx_data, tx_data_, sizeof(tx_data_));
+    out.tx_len = tx_len_;
+    out.packets_recv = packets_recv_;
+    out.packets_sent = packets_sent_;
+    out.packets_recv_errors = packets_recv_errors_;
+    out.total_tx_airtime = total_tx_airtime_;
+    out.total_rx_airtime = total_rx_airtime_;
+    out.rx_dropped = rx_dropped_;
+    out.rx_high_water = rx_high_water_;
+    out.recv_mode = recv_mode_;
+}
+
+void SimRadio::restoreRxQueue(const SimRadioSnapshot& snap) {
+    drainRx();
+    for (const RxPacket& pkt : snap.rx) {
+        pkt.buffer->retain();
+        injectRxBuffer(pkt.buffer, pkt.rssi, pkt.snr);
+    }
+}
+
+void SimRadio::restoreState(const SimRadioSnapshot& snap) {
+    last_rssi_ = snap.last_rssi;
+    last_snr_ = snap.last_snr;
+    tx_pending_ = snap.tx_pending;
+    tx_in_progress_ = snap.tx_in_progress;
+    memcpy(tx_data_, snap.tx_data, sizeof(tx_data_));
+    tx_len_ = snap.tx_len;
+    packets_recv_ = snap.packets_recv;
+    packets_sent_ = snap.packets_sent;
+    packets_recv_errors_ = snap.packets_recv_errors;
+    total_tx_airtime_ = snap.total_tx_airtime;
+    total_rx_airtime_ = snap.total_rx_airtime;
+    rx_dropped_ = snap.rx_dropped;
+    rx_high_water_ = snap.rx_high_water;
+    recv_mode_ = snap.recv_mode;
+    state_version_++;  // State changed - restored
+    poll_count_ = 0;
 }
 
 void SimRadio::begin() {
@@ -42,21 +121,25 @@ void SimRadio::begin() {
 }
 
 int SimRadio::recvRaw(uint8_t* bytes, int sz) {
-    std::lock_guard<std::mutex> lock(rx_mutex_);
-    
-    if (rx_queue_.empty()) {
+    const RxPacket* pkt = rx_queue_.front();
+    if (!pkt) {
         return 0;
     }
     
-    RxPacket& pkt = rx_queue_.front();
-    int len = static_cast<int>(pkt.len);
+    // Copy straight out of the shared buffer, then release the ring slot
+    // and our reference to the payload
+    SimPacketBuffer* buffer = pkt->buffer;
+    int len = static_cast<int>(buffer->size());
     if (len > sz) len = sz;
     
-    memcpy(bytes, pkt.data, len);
-    last_rssi_ = pkt.rssi;
-    last_snr_ = pkt.snr;
+    memcpy(bytes, buffer->data(), len);
+    last_rssi_ = pkt->rssi;
+    last_snr_ = pkt->snr;
+    
+    rx_queue_.popFront();
+    buffer->release();
     
-    rx_queue_.pop();
+    SIM_TRACE_INSTANT(SIM_TRACE_RADIO, "radio.rx");
     
     // Update statistics
     packets_recv_++;
@@ -66,30 +149,7 @@ int SimRadio::recvRaw(uint8_t* bytes, int sz) {
 }
 
 uint32_t SimRadio::getEstAirtimeFor(int len_bytes) {
-    // LoRa airtime calculation (simplified)
-    // Based on Semtech SX1276 datasheet formulas
-    
-    float bw_hz = bw_ * 1000.0f;
-    float ts = pow(2.0f, sf_) / bw_hz;  // Symbol time in seconds
-    
-    // Preamble: 8 symbols + 4.25
-    float t_preamble = (8.0f + 4.25f) * ts;
-    
-    // Payload symbols (simplified calculation)
-    int de = (bw_ <= 125.0f && sf_ >= 11) ? 1 : 0;  // Low data rate optimize
-    int ih = 0;  // Implicit header off
-    int crc = 1; // CRC on
-    
-    float payload_symbols = 8.0f + fmax(
-        ceil((8.0f * len_bytes - 4.0f * sf_ + 28.0f + 16.0f * crc - 20.0f * ih) / 
-             (4.0f * (sf_ - 2.0f * de))) * (cr_ + 4.0f),
-        0.0f
-    );
-    
-    float t_payload = payload_symbols * ts;
-    
-    // Total time in milliseconds
-    return static_cast<uint32_t>((t_preamble + t_payload) * 1000.0f);
+    return airtime_->lookup(bw_, sf_, cr_, len_bytes);
 }
 
 float SimRadio::packetScore(float snr, int packet_len) {
@@ -114,16 +174,27 @@ bool SimRadio::startSendRaw(const uint8_t* bytes, int len) {
     recv_mode_ = false;
     state_version_++;  // State changed - starting TX
     
+    SIM_TRACE_INSTANT(SIM_TRACE_RADIO, "radio.tx");
+    
     // Update statistics
     packets_sent_++;
-    total_tx_airtime_ += getEstAirtimeFor(len);
+    uint32_t airtime_ms = getEstAirtimeFor(len);
+    total_tx_airtime_ += airtime_ms;
     
     // Signal to SimContext that we have a TX event
     if (g_sim_ctx) {
         g_sim_ctx->step_result.reason = SIM_YIELD_RADIO_TX_START;
-        memcpy(g_sim_ctx->step_result.radio_tx_data, tx_data_, tx_len_);
+        // View into tx_data_, which is unchanged until the next startSendRaw()
+        g_sim_ctx->step_result.radio_tx_data = tx_data_;
         g_sim_ctx->step_result.radio_tx_len = tx_len_;
-        g_sim_ctx->step_result.radio_tx_airtime_ms = getEstAirtimeFor(len);
+        g_sim_ctx->step_result.radio_tx_airtime_ms = airtime_ms;
+        
+        SimStepEvent event = {};
+        event.kind = SIM_STEP_EVENT_RADIO_TX;
+        event.airtime_ms = airtime_ms;
+        event.data = tx_data_;
+        event.len = tx_len_;
+        g_sim_ctx->addStepEvent(event);
     }
     
     return true;
@@ -205,7 +276,6 @@ bool SimRadio::isReceiving() {
     checkForSpin();
     // In simulation, we don't have a concept of "currently receiving"
     // Return true if there are packets in the queue
-    std::lock_guard<std::mutex> lock(rx_mutex_);
     return !rx_queue_.empty();
 }
 
@@ -222,39 +292,41 @@ int SimRadio::getNoiseFloor() const {
 }
 
 void SimRadio::injectRxPacket(const uint8_t* data, size_t len, float rssi, float snr) {
-    std::lock_guard<std::mutex> lock(rx_mutex_);
-    
+    // Check queue depth first so a dropped packet costs no copy
+    if (rx_queue_.size() >= rx_queue_.capacity()) {
+        rx_dropped_++;
+        return;
+    }
+    if (len > SIM_MAX_RADIO_PACKET) {
+        len = SIM_MAX_RADIO_PACKET;
+    }
+    injectRxBuffer(SimPacketBuffer::create(data, len, 1), rssi, snr);
+}
+
+bool SimRadio::injectRxBuffer(SimPacketBuffer* buffer, float rssi, float snr) {
     // Check queue depth - drop if full (simulates FIFO overflow)
-    if (rx_queue_.size() >= RX_QUEUE_DEPTH) {
+    RxPacket* pkt = rx_queue_.beginPush();
+    if (!pkt) {
         // Packet dropped - queue is full
-        // Optionally could report this back to coordinator for trace analysis
-        return;
+        rx_dropped_++;
+        buffer->release();
+        return false;
     }
     
-    RxPacket pkt;
-    if (len > sizeof(pkt.data)) {
-        len = sizeof(pkt.data);
-    }
-    memcpy(pkt.data, data, len);
-    pkt.len = len;
-    pkt.rssi = rssi;
-    pkt.snr = snr;
+    pkt->buffer = buffer;
+    pkt->rssi = rssi;
+    pkt->snr = snr;
     
-    rx_queue_.push(pkt);
+    rx_queue_.commitPush();
     state_version_++;  // State changed - packet arrived
+    
+    uint32_t queued = static_cast<uint32_t>(rx_queue_.size());
+    if (queued > rx_high_water_) {
+        rx_high_water_ = queued;
+    }
+    return true;
 }
 
 uint32_t SimRadio::getTxAirtime() const {
-    // Use same formula as getEstAirtimeFor but as const method
-    float bw_hz = bw_ * 1000.0f;
-    float ts = pow(2.0f, static_cast<float>(sf_)) / bw_hz;
-    float t_preamble = (8.0f + 4.25f) * ts;
-    int de = (bw_ <= 125.0f && sf_ >= 11) ? 1 : 0;
-    float payload_symbols = 8.0f + fmax(
-        ceil((8.0f * tx_len_ - 4.0f * sf_ + 28.0f + 16.0f - 0.0f) / 
-             (4.0f * (sf_ - 2.0f * de))) * (cr_ + 4.0f),
-        0.0f
-    );
-    float t_payload = payload_symbols * ts;
-    return static_cast<uint32_t>((t_preamble + t_payload) * 1000.0f);
+    return airtime_->lookup(bw_, sf_, cr_, static_cast<int>(tx_len_));
 }
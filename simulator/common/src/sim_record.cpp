@@ -0,0 +1,527 @@
+#include "sim_record.h"
+#include "sim_node_base.h"
+#include "sim_api.h"
+
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+// ============================================================================
+// Digests
+// ============================================================================
+
+uint64_t simRecordDigest(const void* data, size_t len, uint64_t hash) {
+    return simHashBytes(hash, data, len);
+}
+
+// Lengths are hashed with the contents so empty and missing outputs, or
+// output moved from one buffer to the next, still differ
+static uint64_t digestBuffer(uint64_t hash, const void* data, size_t len) {
+    uint64_t len64 = len;
+    hash = simRecordDigest(&len64, sizeof(len64), hash);
+    return data ? simRecordDigest(data, len, hash) : hash;
+}
+
+uint64_t simRecordResultDigest(const SimStepResult& result) {
+    uint64_t hash = simRecordDigest(nullptr, 0);
+    hash = digestBuffer(hash, result.radio_tx_data, result.radio_tx_len);
+    hash = digestBuffer(hash, &result.radio_tx_airtime_ms, sizeof(result.radio_tx_airtime_ms));
+    hash = digestBuffer(hash, result.serial_tx_data, result.serial_tx_len);
+    hash = digestBuffer(hash, &result.serial_tx_pending, sizeof(result.serial_tx_pending));
+    hash = digestBuffer(hash, &result.serial_frames_pending, sizeof(result.serial_frames_pending));
+    return digestBuffer(hash, result.log_output, result.log_output_len);
+}
+
+static uint64_t framesDigest(const uint8_t* data, const SimFrameSpan* frames, size_t count) {
+    uint64_t hash = digestBuffer(simRecordDigest(nullptr, 0), nullptr, count);
+    for (size_t i = 0; i < count; i++) {
+        hash = digestBuffer(hash, data + frames[i].offset, frames[i].len);
+    }
+    return hash;
+}
+
+// The config as logged: pointers mean nothing in another process
+static SimNodeConfig loggedConfig(const SimNodeConfig& config) {
+    SimNodeConfig logged = config;
+    logged.fs_image = nullptr;
+    logged.record_path = nullptr;
+    return logged;
+}
+
+// ============================================================================
+// SimRecorder
+// ============================================================================
+
+SimRecorder* SimRecorder::open(const char* path, const char* node_type,
+                               const SimNodeConfig& config) {
+    FILE* file = fopen(path, "wb");
+    if (!file) return nullptr;
+    SimRecorder* recorder = new SimRecorder(file);
+    recorder->putBytes(SIM_RECORD_MAGIC, 8);
+    recorder->putFixed(SIM_RECORD_VERSION, 4);
+    recorder->putFixed(sizeof(SimNodeConfig), 4);
+    size_t type_len = strlen(node_type);
+    recorder->putVarint(type_len);
+    recorder->putBytes(node_type, type_len);
+    recorder->putConfig(config);
+    return recorder;
+}
+
+SimRecorder::SimRecorder(FILE* file) : file_(file) {
+    // Steps are a few bytes each; let stdio batch them into large writes
+    setvbuf(file_, nullptr, _IOFBF, 1 << 16);
+}
+
+SimRecorder::~SimRecorder() {
+    putByte(SIM_RECORD_END);
+    fclose(file_);
+}
+
+void SimRecorder::putVarint(uint64_t value) {
+    while (value >= 0x80) {
+        putByte(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    putByte(static_cast<uint8_t>(value));
+}
+
+void SimRecorder::putZigzag(int64_t value) {
+    putVarint((static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+void SimRecorder::putFixed(uint64_t value, size_t bytes) {
+    for (size_t i = 0; i < bytes; i++) {
+        putByte(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+void SimRecorder::putBytes(const void* data, size_t len) {
+    if (len > 0) {
+        fwrite(data, 1, len, file_);
+    }
+}
+
+void SimRecorder::putConfig(const SimNodeConfig& config) {
+    SimNodeConfig logged = loggedConfig(config);
+    putBytes(&logged, sizeof(logged));
+}
+
+static uint32_t floatBits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+void SimRecorder::files(const SimFileMap& files) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& kv : files) {
+        putByte(SIM_RECORD_FILE);
+        putVarint(kv.first.size());
+        putBytes(kv.first.data(), kv.first.size());
+        putVarint(kv.second->size());
+        putBytes(kv.second->data(), kv.second->size());
+    }
+}
+
+void SimRecorder::step(uint64_t sim_millis, uint32_t sim_rtc_secs) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    putByte(SIM_RECORD_STEP);
+    putZigzag(static_cast<int64_t>(sim_millis - last_millis_));
+    putZigzag(static_cast<int64_t>(sim_rtc_secs) - static_cast<int64_t>(last_rtc_));
+    last_millis_ = sim_millis;
+    last_rtc_ = sim_rtc_secs;
+    step_millis_ = sim_millis;
+}
+
+void SimRecorder::result(const SimStepResult& result) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    putByte(SIM_RECORD_RESULT);
+    putVarint(static_cast<uint32_t>(result.reason));
+    putZigzag(static_cast<int64_t>(result.wake_millis - step_millis_));
+    putFixed(simRecordResultDigest(result), 8);
+}
+
+void SimRecorder::radioRx(const uint8_t* data, size_t len, float rssi, float snr) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    putByte(SIM_RECORD_RADIO_RX);
+    putFixed(floatBits(rssi), 4);
+    putFixed(floatBits(snr), 4);
+    putVarint(len);
+    putBytes(data, len);
+}
+
+void SimRecorder::serialRx(const uint8_t* data, size_t len) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    putByte(SIM_RECORD_SERIAL_RX);
+    putVarint(len);
+    putBytes(data, len);
+}
+
+void SimRecorder::serialFrame(const uint8_t* data, size_t len) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    putByte(SIM_RECORD_SERIAL_FRAME);
+    putVarint(len);
+    putBytes(data, len);
+}
+
+void SimRecorder::collectSerialTx(size_t max_len, const uint8_t* data, size_t len) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    putByte(SIM_RECORD_COLLECT_SERIAL_TX);
+    putVarint(max_len);
+    putFixed(digestBuffer(simRecordDigest(nullptr, 0), data, len), 8);
+}
+
+void SimRecorder::collectFrame(size_t max_len, const uint8_t* data, size_t len) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    putByte(SIM_RECORD_COLLECT_FRAME);
+    putVarint(max_len);
+    putFixed(digestBuffer(simRecordDigest(nullptr, 0), data, len), 8);
+}
+
+void SimRecorder::collectFrames(size_t buffer_len, size_t max_frames, const uint8_t* data,
+                                const SimFrameSpan* frames, size_t count) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    putByte(SIM_RECORD_COLLECT_FRAMES);
+    putVarint(buffer_len);
+    putVarint(max_frames);
+    putFixed(framesDigest(data, frames, count), 8);
+}
+
+void SimRecorder::txComplete() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    putByte(SIM_RECORD_TX_COMPLETE);
+}
+
+void SimRecorder::stateChange(uint32_t state_version) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    putByte(SIM_RECORD_STATE_CHANGE);
+    putVarint(state_version);
+}
+
+void SimRecorder::fsWrite(const char* path, const uint8_t* data, size_t len) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t path_len = strlen(path);
+    putByte(SIM_RECORD_FS_WRITE);
+    putVarint(path_len);
+    putBytes(path, path_len);
+    putVarint(len);
+    putBytes(data, len);
+}
+
+void SimRecorder::fsRemove(const char* path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t path_len = strlen(path);
+    putByte(SIM_RECORD_FS_REMOVE);
+    putVarint(path_len);
+    putBytes(path, path_len);
+}
+
+void SimRecorder::reboot(const SimNodeConfig& config) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    putByte(SIM_RECORD_REBOOT);
+    putConfig(config);
+}
+
+void SimRecorder::restore() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    putByte(SIM_RECORD_RESTORE);
+}
+
+// ============================================================================
+// Log Reader
+// ============================================================================
+
+// Longest byte field accepted, so a corrupt length cannot exhaust memory
+static const uint64_t kMaxFieldLen = 64u << 20;
+
+class SimRecordReader {
+public:
+    explicit SimRecordReader(FILE* file) : file_(file) {
+        setvbuf(file_, nullptr, _IOFBF, 1 << 16);
+    }
+    ~SimRecordReader() { fclose(file_); }
+
+    bool ok() const { return ok_; }
+
+    // Next record kind, or -1 at the end of the file
+    int kind() { return fgetc(file_); }
+
+    uint64_t varint() {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            int c = fgetc(file_);
+            if (c == EOF) break;
+            value |= static_cast<uint64_t>(c & 0x7F) << shift;
+            if (!(c & 0x80)) return value;
+        }
+        ok_ = false;
+        return 0;
+    }
+
+    int64_t zigzag() {
+        uint64_t value = varint();
+        return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+    }
+
+    uint64_t fixed(size_t bytes) {
+        uint8_t raw[8] = {};
+        read(raw, bytes);
+        uint64_t value = 0;
+        for (size_t i = 0; i < bytes; i++) {
+            value |= static_cast<uint64_t>(raw[i]) << (8 * i);
+        }
+        return value;
+    }
+
+    float f32() {
+        uint32_t bits = static_cast<uint32_t>(fixed(4));
+        float value;
+        memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    void bytes(std::vector<uint8_t>& out) {
+        uint64_t len = varint();
+        if (len > kMaxFieldLen) {
+            ok_ = false;
+            len = 0;
+        }
+        out.resize(static_cast<size_t>(len));
+        read(out.data(), out.size());
+    }
+
+    std::string str() {
+        std::vector<uint8_t> raw;
+        bytes(raw);
+        return std::string(raw.begin(), raw.end());
+    }
+
+    void config(SimNodeConfig& out) {
+        read(&out, sizeof(out));
+    }
+
+    void read(void* out, size_t len) {
+        if (len > 0 && fread(out, 1, len, file_) != len) {
+            ok_ = false;
+            memset(out, 0, len);
+        }
+    }
+
+private:
+    FILE* file_;
+    bool ok_ = true;
+};
+
+// ============================================================================
+// Replay
+// ============================================================================
+
+// Collection buffers are sized from the recorded limits, within reason
+static size_t collectLimit(uint64_t recorded) {
+    return static_cast<size_t>(recorded < kMaxFieldLen ? recorded : kMaxFieldLen);
+}
+
+static void replayCollectFrames(SimNodeHandle node, size_t buffer_len, size_t max_frames,
+                                std::vector<uint8_t>& buffer, std::vector<SimFrameSpan>& frames,
+                                size_t* count) {
+    // Same loop as sim_collect_serial_frames(), without recording
+    buffer.resize(buffer_len);
+    frames.resize(max_frames);
+    SimFrameRing& tx = node->ctx.serial.txFrames();
+    size_t collected = 0;
+    size_t offset = 0;
+    while (collected < max_frames) {
+        size_t len = tx.frontSize();
+        if (len == 0 || len > buffer_len - offset) break;
+        tx.pop(buffer.data() + offset, len);
+        frames[collected].offset = static_cast<uint32_t>(offset);
+        frames[collected].len = static_cast<uint32_t>(len);
+        offset += len;
+        collected++;
+    }
+    *count = collected;
+}
+
+SIM_API int sim_replay(const char* path, SimReplayResult* out) {
+    SimReplayResult summary = {};
+    summary.first_divergence = UINT64_MAX;
+    int status = -1;
+    auto start = std::chrono::steady_clock::now();
+
+    FILE* file = path ? fopen(path, "rb") : nullptr;
+    if (!file) {
+        if (out) *out = summary;
+        return -1;
+    }
+    SimRecordReader reader(file);
+
+    // Header
+    char magic[8];
+    reader.read(magic, sizeof(magic));
+    uint64_t version = reader.fixed(4);
+    uint64_t config_size = reader.fixed(4);
+    std::string node_type = reader.str();
+    SimNodeConfig config;
+    reader.config(config);
+    bool usable = reader.ok() && memcmp(magic, SIM_RECORD_MAGIC, 8) == 0 &&
+                  version == SIM_RECORD_VERSION && config_size == sizeof(SimNodeConfig) &&
+                  node_type == sim_get_node_type();
+
+    // The node is created at the first record past the starting files
+    SimFsImage image;
+    SimNodeHandle node = nullptr;
+    uint64_t millis = 0;
+    uint32_t rtc = 0;
+    uint64_t step_millis = 0;
+    std::vector<uint8_t> data;
+    std::vector<uint8_t> buffer;
+    std::vector<SimFrameSpan> frames;
+
+    auto diverge = [&](uint32_t expected_reason, uint32_t actual_reason,
+                       uint64_t expected_wake, uint64_t actual_wake) {
+        if (summary.diverged++ == 0) {
+            summary.first_divergence = summary.steps > 0 ? summary.steps - 1 : 0;
+            summary.first_divergence_millis = step_millis;
+            summary.expected_reason = expected_reason;
+            summary.actual_reason = actual_reason;
+            summary.expected_wake_millis = expected_wake;
+            summary.actual_wake_millis = actual_wake;
+        }
+    };
+
+    while (usable) {
+        int kind = reader.kind();
+        if (kind == SIM_RECORD_FILE) {
+            std::string file_path = reader.str();
+            reader.bytes(data);
+            if (node || !reader.ok()) {
+                usable = false;
+                break;
+            }
+            image.writeFile(file_path.c_str(), data.data(), data.size());
+            continue;
+        }
+
+        if (!node && kind != EOF) {
+            config.fs_image = &image;
+            config.record_path = nullptr;
+            node = simNewNode(config);
+            node->replaying = true;
+            node->start();
+        }
+
+        bool done = false;
+        switch (kind) {
+        case EOF:               // Recording process did not close the log
+        case SIM_RECORD_END:
+        case SIM_RECORD_RESTORE:
+            done = true;
+            break;
+        case SIM_RECORD_STEP:
+            millis += static_cast<uint64_t>(reader.zigzag());
+            rtc = static_cast<uint32_t>(static_cast<int64_t>(rtc) + reader.zigzag());
+            step_millis = millis;
+            sim_step_begin(node, millis, rtc);
+            summary.steps++;
+            break;
+        case SIM_RECORD_RESULT: {
+            uint32_t reason = static_cast<uint32_t>(reader.varint());
+            uint64_t wake = step_millis + static_cast<uint64_t>(reader.zigzag());
+            uint64_t digest = reader.fixed(8);
+            SimStepResult result = sim_step_wait(node);
+            if (static_cast<uint32_t>(result.reason) != reason || result.wake_millis != wake ||
+                simRecordResultDigest(result) != digest) {
+                diverge(reason, result.reason, wake, result.wake_millis);
+            }
+            break;
+        }
+        case SIM_RECORD_RADIO_RX: {
+            float rssi = reader.f32();
+            float snr = reader.f32();
+            reader.bytes(data);
+            sim_inject_radio_rx(node, data.data(), data.size(), rssi, snr);
+            break;
+        }
+        case SIM_RECORD_SERIAL_RX:
+            reader.bytes(data);
+            sim_inject_serial_rx(node, data.data(), data.size());
+            break;
+        case SIM_RECORD_SERIAL_FRAME:
+            reader.bytes(data);
+            node->ctx.serial.rxFrames().push(data.data(), data.size());
+            break;
+        case SIM_RECORD_COLLECT_SERIAL_TX: {
+            buffer.resize(collectLimit(reader.varint()));
+            uint64_t digest = reader.fixed(8);
+            size_t len = sim_collect_serial_tx(node, buffer.data(), buffer.size());
+            if (digestBuffer(simRecordDigest(nullptr, 0), buffer.data(), len) != digest) {
+                diverge(0, 0, 0, 0);
+            }
+            break;
+        }
+        case SIM_RECORD_COLLECT_FRAME: {
+            buffer.resize(collectLimit(reader.varint()));
+            uint64_t digest = reader.fixed(8);
+            SimFrameRing& tx = node->ctx.serial.txFrames();
+            size_t len = tx.frontSize();
+            len = (len == 0 || len > buffer.size()) ? 0 : tx.pop(buffer.data(), buffer.size());
+            if (digestBuffer(simRecordDigest(nullptr, 0), buffer.data(), len) != digest) {
+                diverge(0, 0, 0, 0);
+            }
+            break;
+        }
+        case SIM_RECORD_COLLECT_FRAMES: {
+            size_t buffer_len = collectLimit(reader.varint());
+            size_t max_frames = collectLimit(reader.varint());
+            uint64_t digest = reader.fixed(8);
+            size_t count = 0;
+            replayCollectFrames(node, buffer_len, max_frames, buffer, frames, &count);
+            if (framesDigest(buffer.data(), frames.data(), count) != digest) {
+                diverge(0, 0, 0, 0);
+            }
+            break;
+        }
+        case SIM_RECORD_TX_COMPLETE:
+            sim_notify_tx_complete(node);
+            break;
+        case SIM_RECORD_STATE_CHANGE:
+            sim_notify_state_change(node, static_cast<uint32_t>(reader.varint()));
+            break;
+        case SIM_RECORD_FS_WRITE: {
+            std::string file_path = reader.str();
+            reader.bytes(data);
+            sim_fs_write(node, file_path.c_str(), data.data(), data.size());
+            break;
+        }
+        case SIM_RECORD_FS_REMOVE:
+            sim_fs_remove(node, reader.str().c_str());
+            break;
+        case SIM_RECORD_REBOOT: {
+            SimNodeConfig reboot_config;
+            reader.config(reboot_config);
+            if (reader.ok()) {
+                sim_reboot(node, &reboot_config);
+            }
+            break;
+        }
+        default:
+            usable = false;
+            break;
+        }
+        if (!reader.ok()) {
+            usable = false;
+        }
+        if (done) {
+            status = summary.diverged > 0 ? 1 : 0;
+            break;
+        }
+    }
+
+    if (node) {
+        sim_destroy(node);
+    }
+    summary.replay_ns = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start).count());
+    if (out) *out = summary;
+    return status;
+}
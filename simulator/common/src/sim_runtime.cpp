@@ -0,0 +1,22 @@
+#include "sim_runtime.h"
+
+#include <atomic>
+
+// ============================================================================
+// Shared Runtime Attachment
+// ============================================================================
+
+static std::atomic<const SimRuntimeApi*> g_sim_runtime{nullptr};
+
+const SimRuntimeApi* simRuntime() {
+    return g_sim_runtime.load(std::memory_order_acquire);
+}
+
+SIM_API int sim_attach_runtime(const SimRuntimeApi* runtime) {
+    if (runtime && (runtime->abi_major != SIM_RUNTIME_ABI_MAJOR ||
+                    runtime->size < sizeof(SimRuntimeApi))) {
+        return 0;
+    }
+    g_sim_runtime.store(runtime, std::memory_order_release);
+    return 1;
+}
@@ -1,53 +1,70 @@
 #include "sim_serial.h"
 
-void SimSerial::injectRx(const uint8_t* data, size_t len) {
-    std::lock_guard<std::mutex> lock(rx_mutex_);
-    for (size_t i = 0; i < len; i++) {
-        rx_queue_.push(data[i]);
+// ============================================================================
+// SimFrameRing
+// ============================================================================
+
+bool SimFrameRing::push(const uint8_t* data, size_t len) {
+    if (len == 0 || len > SIM_MAX_SERIAL_FRAME || full() ||
+        bytes_.capacity() - bytes_.size() < len) {
+        return false;
     }
+    bytes_.push(data, len);
+    uint16_t frame_len = static_cast<uint16_t>(len);
+    lengths_.push(&frame_len, 1);
+    return true;
 }
 
-size_t SimSerial::available() {
-    std::lock_guard<std::mutex> lock(rx_mutex_);
-    return rx_queue_.size();
+size_t SimFrameRing::frontSize() const {
+    const uint16_t* len = lengths_.front();
+    return len ? *len : 0;
 }
 
-int SimSerial::read() {
-    std::lock_guard<std::mutex> lock(rx_mutex_);
-    if (rx_queue_.empty()) {
-        return -1;
+size_t SimFrameRing::pop(uint8_t* buffer, size_t max_len) {
+    const uint16_t* front = lengths_.front();
+    if (!front) {
+        return 0;
     }
-    uint8_t byte = rx_queue_.front();
-    rx_queue_.pop();
-    return byte;
-}
-
-size_t SimSerial::readBytes(uint8_t* buffer, size_t len) {
-    std::lock_guard<std::mutex> lock(rx_mutex_);
-    size_t count = 0;
-    while (count < len && !rx_queue_.empty()) {
-        buffer[count++] = rx_queue_.front();
-        rx_queue_.pop();
+    size_t len = *front;
+    if (len <= max_len) {
+        bytes_.pop(buffer, len);
+    } else {
+        // Too long for the reader: drop it
+        uint8_t discard[64];
+        for (size_t left = len; left > 0;) {
+            left -= bytes_.pop(discard, (std::min)(left, sizeof(discard)));
+        }
+        len = 0;
     }
-    return count;
+    lengths_.popFront();
+    return len;
 }
 
-void SimSerial::write(uint8_t byte) {
-    std::lock_guard<std::mutex> lock(tx_mutex_);
-    tx_buffer_.push_back(byte);
+// ============================================================================
+// SimSerial
+// ============================================================================
+
+size_t SimSerial::injectRx(const uint8_t* data, size_t len) {
+    return rx_queue_.push(data, len);
 }
 
-void SimSerial::write(const uint8_t* data, size_t len) {
-    std::lock_guard<std::mutex> lock(tx_mutex_);
-    tx_buffer_.insert(tx_buffer_.end(), data, data + len);
+size_t SimSerial::available() const {
+    return rx_queue_.size();
 }
 
-size_t SimSerial::collectTx(uint8_t* buffer, size_t max_len) {
-    std::lock_guard<std::mutex> lock(tx_mutex_);
-    size_t len = (std::min)(tx_buffer_.size(), max_len);
-    if (len > 0) {
-        memcpy(buffer, tx_buffer_.data(), len);
-        tx_buffer_.erase(tx_buffer_.begin(), tx_buffer_.begin() + len);
+int SimSerial::read() {
+    uint8_t byte;
+    if (rx_queue_.pop(&byte, 1) == 0) {
+        return -1;
     }
-    return len;
+    return byte;
+}
+
+int SimSerial::peek() const {
+    const uint8_t* byte = rx_queue_.front();
+    return byte ? *byte : -1;
+}
+
+size_t SimSerial::readBytes(uint8_t* buffer, size_t len) {
+    return rx_queue_.pop(buffer, len);
 }
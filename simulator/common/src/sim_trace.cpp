@@ -0,0 +1,128 @@
+#include "sim_trace.h"
+#include "sim_context.h"
+#include "sim_spsc.h"
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<uint32_t> g_sim_trace_categories{0};
+
+static constexpr uint32_t kDefaultEventsPerThread = 8192;
+
+// ============================================================================
+// Thread Rings
+// ============================================================================
+
+// One thread's events: the thread is the only producer, sim_trace_drain()
+// (under s_rings_mutex) the only consumer
+struct SimTraceRing {
+    SimSpscRing<SimTraceEvent> events;
+    uint32_t thread;
+    std::atomic<bool> retired{false};    // The thread has exited; freed once drained
+
+    SimTraceRing(size_t capacity, uint32_t id) : events(capacity), thread(id) {}
+};
+
+static std::mutex s_rings_mutex;
+static std::vector<std::unique_ptr<SimTraceRing>> s_rings;
+static size_t s_next_ring = 0;                        // Where the next drain starts
+static uint32_t s_next_thread = 0;
+static std::atomic<uint32_t> s_events_per_thread{kDefaultEventsPerThread};
+static std::atomic<uint64_t> s_dropped{0};
+
+// Retires the thread's ring when the thread exits
+struct SimTraceRingOwner {
+    SimTraceRing* ring = nullptr;
+
+    ~SimTraceRingOwner() {
+        if (ring) {
+            ring->retired.store(true, std::memory_order_release);
+        }
+    }
+};
+
+static thread_local SimTraceRingOwner t_ring;
+
+static SimTraceRing* threadRing() {
+    if (!t_ring.ring) {
+        std::lock_guard<std::mutex> lock(s_rings_mutex);
+        s_rings.emplace_back(new SimTraceRing(
+            s_events_per_thread.load(std::memory_order_relaxed), s_next_thread++));
+        t_ring.ring = s_rings.back().get();
+    }
+    return t_ring.ring;
+}
+
+// ============================================================================
+// Recording
+// ============================================================================
+
+uint64_t simTraceNow() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void simTraceRecord(uint32_t category, const char* name, uint64_t start_ns, uint64_t duration_ns) {
+    SimTraceRing* ring = threadRing();
+    SimTraceEvent* event = ring->events.beginPush();
+    if (!event) {
+        s_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    SimContext* ctx = g_sim_ctx;
+    event->node = ctx ? ctx->node : nullptr;
+    event->name = name;
+    event->wall_start_ns = start_ns;
+    event->wall_duration_ns = duration_ns;
+    event->sim_millis = ctx ? ctx->current_millis : 0;
+    event->category = category;
+    event->thread = ring->thread;
+    ring->events.commitPush();
+}
+
+// ============================================================================
+// Trace API
+// ============================================================================
+
+extern "C" {
+
+SIM_API void sim_trace_enable(uint32_t categories, uint32_t events_per_thread) {
+    s_events_per_thread.store(events_per_thread ? events_per_thread : kDefaultEventsPerThread,
+                              std::memory_order_relaxed);
+    g_sim_trace_categories.store(categories & SIM_TRACE_ALL, std::memory_order_relaxed);
+}
+
+SIM_API size_t sim_trace_drain(SimTraceEvent* out, size_t max_events) {
+    if (!out) return 0;
+    std::lock_guard<std::mutex> lock(s_rings_mutex);
+    size_t written = 0;
+    size_t count = s_rings.size();
+    // Start where the last drain stopped, so a small buffer does not always
+    // favour the first threads
+    for (size_t n = 0; n < count && written < max_events; n++) {
+        SimTraceRing& ring = *s_rings[(s_next_ring + n) % count];
+        written += ring.events.pop(out + written, max_events - written);
+    }
+    if (count > 0) {
+        s_next_ring = (s_next_ring + 1) % count;
+    }
+
+    // Free the drained rings of exited threads. retired is read first: once
+    // it is set, every event of the ring is visible to empty().
+    s_rings.erase(std::remove_if(s_rings.begin(), s_rings.end(),
+                                 [](const std::unique_ptr<SimTraceRing>& ring) {
+                                     return ring->retired.load(std::memory_order_acquire) &&
+                                            ring->events.empty();
+                                 }),
+                  s_rings.end());
+    return written;
+}
+
+SIM_API uint64_t sim_trace_dropped(void) {
+    return s_dropped.load(std::memory_order_relaxed);
+}
+
+} // extern "C"
@@ -27,15 +27,55 @@
 // ============================================================================
 // Global variables expected by firmware
 // ============================================================================
-// These use internal names; sim_prefix.h redirects board -> _sim_board_instance, etc.
-// IMPORTANT: These must be thread_local so each simulation thread gets its own instance
-thread_local SimBoard _sim_board_instance;
-thread_local SimRadio _sim_radio_instance;
-thread_local SimRTCClock _sim_rtc_instance;
-thread_local EnvironmentSensorManager _sim_sensors_instance;
-
+// board, radio_driver, rtc_clock and sensors are forwarding bindings defined in
+// sim_bindings.cpp; the objects they forward to are owned by SimNodeImpl.
 // Note: g_sim_ctx is defined in Arduino.cpp (sim_common library)
 
+// ============================================================================
+// Frame-capable serial interface
+// ============================================================================
+// ArduinoSerialInterface frames the companion protocol as bytes on Serial.
+// Frames injected with sim_inject_serial_frame(s) are read ahead of that byte
+// stream, and with SimNodeConfig.serial_frames set, outgoing frames are queued
+// for sim_collect_serial_frames() instead of being written to Serial.
+
+class SimFrameSerialInterface : public ArduinoSerialInterface {
+public:
+    void setFrameTx(bool enabled) { frame_tx_ = enabled; }
+
+    bool isWriteBusy() const override {
+        if (frame_tx_) {
+            // Back-pressure the firmware until the coordinator collects
+            return SIM_SERIAL().txFrames().full();
+        }
+        return ArduinoSerialInterface::isWriteBusy();
+    }
+
+    size_t writeFrame(const uint8_t src[], size_t len) override {
+        if (!frame_tx_) {
+            return ArduinoSerialInterface::writeFrame(src, len);
+        }
+        if (!isEnabled() || len > MAX_FRAME_SIZE || !SIM_SERIAL().txFrames().push(src, len)) {
+            return 0;
+        }
+        // Counts as output for the step's idle detection
+        SIM_CTX()->console_writes++;
+        SIM_CTX()->step_stats.serial_tx_bytes += len;
+        return len;
+    }
+
+    size_t checkRecvFrame(uint8_t dest[]) override {
+        size_t len = SIM_SERIAL().rxFrames().pop(dest, MAX_FRAME_SIZE);
+        if (len > 0) {
+            return len;
+        }
+        return ArduinoSerialInterface::checkRecvFrame(dest);
+    }
+
+private:
+    bool frame_tx_ = false;
+};
+
 // ============================================================================
 // Companion-specific SimNode implementation
 // ============================================================================
@@ -44,39 +84,37 @@ struct CompanionSimNode : public SimNodeImpl {
     // Firmware objects
     SimRNG fast_rng;
     SimpleMeshTables tables;
-    std::unique_ptr<DataStore> store;
-    std::unique_ptr<MyMesh> mesh;
-    ArduinoSerialInterface serial_interface;
+    SimHeapPtr<DataStore> store;        // In the node heap, if enabled
+    SimHeapPtr<MyMesh> mesh;
+    SimFrameSerialInterface serial_interface;
     
     CompanionSimNode() : mesh(nullptr), store(nullptr) {}
     
     ~CompanionSimNode() override {
-        // Shutdown the thread
-        {
-            std::lock_guard<std::mutex> lock(ctx.step_mutex);
-            ctx.state.store(SimContext::State::SHUTDOWN);
-        }
-        ctx.step_cv.notify_all();
-        
-        if (node_thread.joinable()) {
-            node_thread.join();
-        }
+        // Shutdown the thread/fiber while the firmware objects are still alive
+        stop();
+    }
+    
+    void releaseFirmware() override {
+        // The mesh refers to the store
+        mesh.reset();
+        store.reset();
     }
     
     void setup() override {
         // Initialize the RNG with the configured seed
-        fast_rng.seed(config.rng_seed);
+        seedRng(fast_rng, SIM_RNG_STREAM_FIRMWARE);
         
         // Create the data store (uses the SPIFFS global filesystem and RTC)
-        store = std::make_unique<DataStore>(SPIFFS, _sim_rtc_instance);
+        store = simMakeUnique<DataStore>(SPIFFS, node_rtc);
         store->begin();
         
         // Create the mesh instance
         // Note: Companion's MyMesh constructor takes radio, rng, rtc, tables, store, ui=NULL
-        mesh = std::make_unique<MyMesh>(
-            _sim_radio_instance,
+        mesh = simMakeUnique<MyMesh>(
+            node_radio,
             fast_rng,
-            _sim_rtc_instance,
+            node_rtc,
             tables,
             *store,
             nullptr  // no UI
@@ -104,6 +142,7 @@ struct CompanionSimNode : public SimNodeImpl {
         
         // Initialize the serial interface with the simulated Serial stream
         serial_interface.begin(Serial);
+        serial_interface.setFrameTx(config.serial_frames != 0);
         
         // Start the serial interface (must be done after begin() but before loop())
         mesh->startInterface(serial_interface);
@@ -119,8 +158,37 @@ struct CompanionSimNode : public SimNodeImpl {
     const char* getNodeType() const override {
         return "companion";
     }
+    
+    // Snapshot state: the mesh tables and RNG stream
+    struct CompanionState : SimFirmwareState {
+        SimRNG fast_rng;
+        SimpleMeshTables tables;
+    };
+    
+    uint64_t hashFirmwareState(uint64_t hash) const override {
+        return simHashWord(hash, fast_rng.state());
+    }
+    
+    std::unique_ptr<SimFirmwareState> saveFirmwareState() override {
+        auto state = std::make_unique<CompanionState>();
+        state->fast_rng = fast_rng;
+        state->tables = tables;
+        return state;
+    }
+    
+    void restoreFirmwareState(const SimFirmwareState& base, bool continue_rng) override {
+        const auto& state = static_cast<const CompanionState&>(base);
+        if (continue_rng) {
+            fast_rng = state.fast_rng;
+        }
+        tables = state.tables;
+    }
 };
 
+SimNodeImpl* simNewNode(const SimNodeConfig& config) {
+    return SimNodeImpl::create<CompanionSimNode>(config);
+}
+
 // ============================================================================
 // C API Implementation
 // ============================================================================
@@ -130,17 +198,10 @@ extern "C" {
 SIM_API SimNodeHandle sim_create(const SimNodeConfig* config) {
     if (!config) return nullptr;
     
-    auto* node = new CompanionSimNode();
-    node->config = *config;
+    auto* node = SimNodeImpl::create<CompanionSimNode>(*config);
     
-    // Apply spin detection config from SimNodeConfig
-    node->ctx.spin_config.threshold = config->spin_detection_threshold;
-    node->ctx.spin_config.log_spin_detection = config->log_spin_detection != 0;
-    node->ctx.spin_config.log_loop_iterations = config->log_loop_iterations != 0;
-    // Note: idle_loops_before_yield is used in sim_node_base.cpp for yield logic
-    
-    // Start the node thread
-    node->node_thread = std::thread(&CompanionSimNode::threadMain, node);
+    // Start the node thread (or fiber, per config->execution_mode)
+    node->start();
     
     return node;
 }
@@ -152,55 +213,44 @@ SIM_API void sim_destroy(SimNodeHandle node) {
     delete companion;
 }
 
-SIM_API void sim_reboot(SimNodeHandle node, const SimNodeConfig* config) {
-    if (!node || !config) return;
-    
-    auto* companion = static_cast<CompanionSimNode*>(node);
-    
-    // Wait for node to be idle
-    {
-        std::unique_lock<std::mutex> lock(companion->ctx.step_mutex);
-        companion->ctx.step_cv.wait(lock, [companion] {
-            return companion->ctx.state.load() == SimContext::State::IDLE ||
-                   companion->ctx.state.load() == SimContext::State::YIELDED;
-        });
-    }
-    
-    // Reset subsystems (but preserve filesystem)
-    // Use the pointers to the firmware thread's instances
-    companion->config = *config;
-    if (companion->radio_ptr) {
-        companion->radio_ptr->configure(config->lora_freq, config->lora_bw,
-                                        config->lora_sf, config->lora_cr, config->lora_tx_power);
-        companion->radio_ptr->begin();
-    }
-    if (companion->board_ptr) {
-        companion->board_ptr->init();
-    }
-    companion->ctx.rng.seed(config->rng_seed);
-    companion->ctx.millis_clock.setMillis(config->initial_millis);
-    companion->ctx.rtc_clock.setCurrentTime(config->initial_rtc);
-    
-    // Re-run setup
-    companion->setup();
-}
+// sim_reboot is implemented in sim_node_base.cpp
 
 SIM_API const char* sim_get_node_type(void) {
     return "companion";
 }
 
-// Frame-based serial API - companion uses ArduinoSerialInterface with byte-based SimSerial
-// These are stubs since the framing is handled internally by ArduinoSerialInterface
+// Frame-based serial API - frames bypass the byte framing of
+// ArduinoSerialInterface (see SimFrameSerialInterface above). Frames are
+// collected with sim_collect_serial_frame(s) (sim_node_base.cpp).
 SIM_API void sim_inject_serial_frame(SimNodeHandle node,
                                       const uint8_t* data, size_t len) {
-    (void)node; (void)data; (void)len;
-    // Not used - companion uses byte-based sim_inject_serial_rx instead
+    if (!node || !data) return;
+    bool queued = node->ctx.serial.rxFrames().push(data, len);
+    if (queued && node->recorder) node->recorder->serialFrame(data, len);
+    node->ctx.step_stats.recordSerialRx(len, queued ? len : 0);
+}
+
+SIM_API size_t sim_inject_serial_frames(SimNodeHandle node,
+                                         const uint8_t* data, size_t data_len,
+                                         const SimFrameSpan* frames, size_t count) {
+    if (!node || !data || !frames) return 0;
+    SimFrameRing& rx = node->ctx.serial.rxFrames();
+    size_t queued = 0;
+    while (queued < count &&
+           static_cast<uint64_t>(frames[queued].offset) + frames[queued].len <= data_len &&
+           rx.push(data + frames[queued].offset, frames[queued].len)) {
+        if (node->recorder) {
+            node->recorder->serialFrame(data + frames[queued].offset, frames[queued].len);
+        }
+        node->ctx.step_stats.recordSerialRx(frames[queued].len, frames[queued].len);
+        queued++;
+    }
+    return queued;
 }
 
-SIM_API size_t sim_collect_serial_frame(SimNodeHandle node,
-                                         uint8_t* buffer, size_t max_len) {
-    (void)node; (void)buffer; (void)max_len;
-    // Not used - companion uses byte-based serial TX via SimSerial
+// Companion commands are frames, not CLI lines
+SIM_API int sim_inject_cli_line(SimNodeHandle node, const char* line, uint32_t flags) {
+    (void)node; (void)line; (void)flags;
     return 0;
 }
 
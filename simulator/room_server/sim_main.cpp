@@ -25,13 +25,8 @@
 // ============================================================================
 // Global variables expected by firmware
 // ============================================================================
-// These use internal names; sim_prefix.h redirects board -> _sim_board_instance, etc.
-// IMPORTANT: These must be thread_local so each simulation thread gets its own instance
-thread_local SimBoard _sim_board_instance;
-thread_local SimRadio _sim_radio_instance;
-thread_local SimRTCClock _sim_rtc_instance;
-thread_local EnvironmentSensorManager _sim_sensors_instance;
-
+// board, radio_driver, rtc_clock and sensors are forwarding bindings defined in
+// sim_bindings.cpp; the objects they forward to are owned by SimNodeImpl.
 // Note: g_sim_ctx is defined in Arduino.cpp (sim_common library)
 
 // ============================================================================
@@ -42,7 +37,7 @@ struct RoomServerSimNode : public SimNodeImpl {
     // Firmware objects
     SimRNG fast_rng;
     SimpleMeshTables tables;
-    std::unique_ptr<MyMesh> mesh;
+    SimHeapPtr<MyMesh> mesh;            // In the node heap, if enabled
     
     // CLI command buffer (matches firmware's main.cpp)
     char command[160];
@@ -52,30 +47,25 @@ struct RoomServerSimNode : public SimNodeImpl {
     }
     
     ~RoomServerSimNode() override {
-        // Shutdown the thread
-        {
-            std::lock_guard<std::mutex> lock(ctx.step_mutex);
-            ctx.state.store(SimContext::State::SHUTDOWN);
-        }
-        ctx.step_cv.notify_all();
-        
-        if (node_thread.joinable()) {
-            node_thread.join();
-        }
+        // Shutdown the thread/fiber while the firmware objects are still alive
+        stop();
+    }
+    
+    void releaseFirmware() override {
+        mesh.reset();
     }
     
     void setup() override {
         // Initialize the RNG with the configured seed
-        fast_rng.seed(config.rng_seed);
+        seedRng(fast_rng, SIM_RNG_STREAM_FIRMWARE);
         
-        // Create the mesh instance using the global board/radio references
-        // (which are redirected via macros to _sim_board_instance etc.)
-        mesh = std::make_unique<MyMesh>(
-            _sim_board_instance,
-            _sim_radio_instance,
+        // Create the mesh instance using this node's board/radio/RTC objects
+        mesh = simMakeUnique<MyMesh>(
+            node_board,
+            node_radio,
             ctx.millis_clock,
             fast_rng,
-            _sim_rtc_instance,
+            node_rtc,
             tables
         );
         
@@ -129,6 +119,13 @@ struct RoomServerSimNode : public SimNodeImpl {
             command[0] = 0;  // reset command buffer
         }
         
+        // Lines from sim_inject_cli_line(), several per loop
+        runCliLines([this](char* line, char* reply) {
+            if (mesh) {
+                mesh->handleCommand(0, line, reply);
+            }
+        });
+        
         // Run mesh loop
         if (mesh) {
             mesh->loop();
@@ -140,8 +137,40 @@ struct RoomServerSimNode : public SimNodeImpl {
     const char* getNodeType() const override {
         return "room_server";
     }
+    
+    // Snapshot state: the mesh tables and RNG stream plus the CLI buffer
+    struct RoomServerState : SimFirmwareState {
+        SimRNG fast_rng;
+        SimpleMeshTables tables;
+        char command[160];
+    };
+    
+    uint64_t hashFirmwareState(uint64_t hash) const override {
+        return simHashWord(hash, fast_rng.state());
+    }
+    
+    std::unique_ptr<SimFirmwareState> saveFirmwareState() override {
+        auto state = std::make_unique<RoomServerState>();
+        state->fast_rng = fast_rng;
+        state->tables = tables;
+        memcpy(state->command, command, sizeof(command));
+        return state;
+    }
+    
+    void restoreFirmwareState(const SimFirmwareState& base, bool continue_rng) override {
+        const auto& state = static_cast<const RoomServerState&>(base);
+        if (continue_rng) {
+            fast_rng = state.fast_rng;
+        }
+        tables = state.tables;
+        memcpy(command, state.command, sizeof(command));
+    }
 };
 
+SimNodeImpl* simNewNode(const SimNodeConfig& config) {
+    return SimNodeImpl::create<RoomServerSimNode>(config);
+}
+
 // ============================================================================
 // C API Implementation
 // ============================================================================
@@ -151,17 +180,10 @@ extern "C" {
 SIM_API SimNodeHandle sim_create(const SimNodeConfig* config) {
     if (!config) return nullptr;
     
-    auto* node = new RoomServerSimNode();
-    node->config = *config;
+    auto* node = SimNodeImpl::create<RoomServerSimNode>(*config);
     
-    // Apply spin detection config from SimNodeConfig
-    node->ctx.spin_config.threshold = config->spin_detection_threshold;
-    node->ctx.spin_config.log_spin_detection = config->log_spin_detection != 0;
-    node->ctx.spin_config.log_loop_iterations = config->log_loop_iterations != 0;
-    // Note: idle_loops_before_yield is used in sim_node_base.cpp for yield logic
-    
-    // Start the node thread
-    node->node_thread = std::thread(&RoomServerSimNode::threadMain, node);
+    // Start the node thread (or fiber, per config->execution_mode)
+    node->start();
     
     return node;
 }
@@ -173,55 +195,30 @@ SIM_API void sim_destroy(SimNodeHandle node) {
     delete room_server;
 }
 
-SIM_API void sim_reboot(SimNodeHandle node, const SimNodeConfig* config) {
-    if (!node || !config) return;
-    
-    auto* room_server = static_cast<RoomServerSimNode*>(node);
-    
-    // Wait for node to be idle
-    {
-        std::unique_lock<std::mutex> lock(room_server->ctx.step_mutex);
-        room_server->ctx.step_cv.wait(lock, [room_server] {
-            return room_server->ctx.state.load() == SimContext::State::IDLE ||
-                   room_server->ctx.state.load() == SimContext::State::YIELDED;
-        });
-    }
-    
-    // Reset subsystems (but preserve filesystem)
-    // Use the pointers to the firmware thread's instances
-    room_server->config = *config;
-    if (room_server->radio_ptr) {
-        room_server->radio_ptr->configure(config->lora_freq, config->lora_bw,
-                                          config->lora_sf, config->lora_cr, config->lora_tx_power);
-        room_server->radio_ptr->begin();
-    }
-    if (room_server->board_ptr) {
-        room_server->board_ptr->init();
-    }
-    room_server->ctx.rng.seed(config->rng_seed);
-    room_server->ctx.millis_clock.setMillis(config->initial_millis);
-    room_server->ctx.rtc_clock.setCurrentTime(config->initial_rtc);
-    
-    // Re-run setup
-    room_server->setup();
-}
+// sim_reboot is implemented in sim_node_base.cpp
 
 SIM_API const char* sim_get_node_type(void) {
     return "room_server";
 }
 
-// Room server doesn't use frame-based serial interface, provide stubs
+// Room server doesn't use frame-based serial input; its TX frames are CLI
+// replies, collected with sim_collect_serial_frame(s) (sim_node_base.cpp)
 SIM_API void sim_inject_serial_frame(SimNodeHandle node,
                                       const uint8_t* data, size_t len) {
     (void)node; (void)data; (void)len;
     // Room server uses byte-based Serial, not frame-based interface
 }
 
-SIM_API size_t sim_collect_serial_frame(SimNodeHandle node,
-                                         uint8_t* buffer, size_t max_len) {
-    (void)node; (void)buffer; (void)max_len;
-    // Room server uses byte-based Serial, not frame-based interface
+SIM_API size_t sim_inject_serial_frames(SimNodeHandle node,
+                                         const uint8_t* data, size_t data_len,
+                                         const SimFrameSpan* frames, size_t count) {
+    (void)node; (void)data; (void)data_len; (void)frames; (void)count;
     return 0;
 }
 
+SIM_API int sim_inject_cli_line(SimNodeHandle node, const char* line, uint32_t flags) {
+    if (!node || !line) return 0;
+    return node->queueCliLine(line, flags) ? 1 : 0;
+}
+
 } // extern "C"
@@ -0,0 +1,80 @@
+// Shared Runtime Library Entry Point
+//
+// Built from the same common sources as the firmware libraries (crypto
+// caches, airtime tables, fiber worker pool) and exports them as the
+// SimRuntimeApi table. Contains no node code.
+
+#define SIM_DLL_EXPORT 1
+
+#include "sim_runtime.h"
+#include "sim_airtime.h"
+#include "sim_crypto_cache.h"
+#include "sim_fiber.h"
+#include "sim_op_stats.h"
+
+// ============================================================================
+// Runtime Globals
+// ============================================================================
+
+// The runtime is the implementation, never a client of another runtime
+const SimRuntimeApi* simRuntime() {
+    return nullptr;
+}
+
+// No node is ever bound here; callers count their operations before
+// calling in
+SimOpStats* simOpStats() {
+    return nullptr;
+}
+
+// ============================================================================
+// Function Table
+// ============================================================================
+
+static int runtimeCryptoVerify(const uint8_t* sig, const uint8_t* public_key,
+                               const uint8_t* message, size_t len) {
+    return SimCryptoCache::verify(sig, public_key, message, len) ? 1 : 0;
+}
+
+static void runtimeCryptoKeyExchange(uint8_t* shared_secret, const uint8_t* public_key,
+                                     const uint8_t* private_key) {
+    SimCryptoCache::keyExchange(shared_secret, public_key, private_key);
+}
+
+static void runtimeSetCryptoCache(SimCryptoCacheKind kind, uint32_t entries) {
+    SimCryptoCache::configure(kind, entries);
+}
+
+static void runtimeGetCryptoCacheStats(SimCryptoCacheKind kind, SimCryptoCacheStats* out) {
+    if (!out) return;
+    SimCryptoCache::getStats(kind, out);
+}
+
+static const uint32_t* runtimeAirtimeTable(float bw_khz, uint8_t sf, uint8_t cr) {
+    return simAirtimeTable(bw_khz, sf, cr)->ms;
+}
+
+static void runtimeSetFiberWorkers(uint32_t count) {
+    SimFiberScheduler::instance().setWorkerCount(count);
+}
+
+static void runtimePostSlices(const SimRuntimeSlice* slices, size_t count) {
+    SimFiberScheduler::instance().postBatch(slices, count);
+}
+
+static const SimRuntimeApi g_runtime_api = {
+    SIM_RUNTIME_ABI_MAJOR,
+    SIM_RUNTIME_ABI_MINOR,
+    sizeof(SimRuntimeApi),
+    runtimeCryptoVerify,
+    runtimeCryptoKeyExchange,
+    runtimeSetCryptoCache,
+    runtimeGetCryptoCacheStats,
+    runtimeAirtimeTable,
+    runtimeSetFiberWorkers,
+    runtimePostSlices,
+};
+
+SIM_API const SimRuntimeApi* sim_runtime_get(uint32_t abi_major) {
+    return abi_major == SIM_RUNTIME_ABI_MAJOR ? &g_runtime_api : nullptr;
+}